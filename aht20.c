@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+#include "aht20.h"
+#include "applog.h"
+#include "placement.h"
+
+static const AHT22Result FAILRESULT = {
+#if !AHT20_FIXED_POINT
+    .temp = -100.0f,
+    .hum = -100.0f,
+#endif
+    .temp_deci = -1000,
+    .hum_deci = -1000,
+    .temp_centi = -10000,
+    .hum_centi = -10000,
+};
+static const int SUCCESS = 6; // 6バイト読めたら成功
+
+#if AHT20_FIXED_POINT
+// v / 2^shift を最近接に丸める。ちょうど半分のときは偶数側（printf の %.1f と同じ）
+static int32_t HOT_FUNC(round_shift)(int32_t v, unsigned shift)
+{
+    uint32_t a = (uint32_t)(v < 0 ? -v : v);
+    uint32_t half = 1u << (shift - 1);
+    uint32_t q = (a + half) >> shift;
+    if ((a & ((half << 1) - 1)) == half)
+        q &= ~1u;
+    return v < 0 ? -(int32_t)q : (int32_t)q;
+}
+#else
+// v * scale を最近接に丸める
+static int16_t HOT_FUNC(to_fixed)(float v, float scale)
+{
+    return (int16_t)(v * scale + (v < 0.0f ? -0.5f : 0.5f));
+}
+
+static AHT22Result HOT_FUNC(new_aht22result)(float temperature, float humidity)
+{
+    AHT22Result r = {temperature,
+                     humidity,
+                     to_fixed(temperature, 10.0f),
+                     to_fixed(humidity, 10.0f),
+                     to_fixed(temperature, 100.0f),
+                     to_fixed(humidity, 100.0f)};
+    return r;
+}
+#endif
+
+bool HOT_FUNC(is_failed)(AHT22Result *result)
+{
+    return result->hum_deci == -1000 || result->temp_deci <= -1000;
+}
+
+void aht20_init(void)
+{
+    i2c_init(i2c0, 100 * 1000);
+    gpio_set_function(AHT20_SCL_PIN, GPIO_FUNC_I2C);
+    gpio_set_function(AHT20_SDA_PIN, GPIO_FUNC_I2C);
+    gpio_pull_up(AHT20_SCL_PIN);
+    gpio_pull_up(AHT20_SDA_PIN);
+}
+
+void HOT_FUNC(aht20_trigger)(void)
+{
+    uint8_t cmd[3] = {0xAC, 0x33, 0x00};
+    i2c_write_timeout_us(i2c0, 0x38, cmd, 3, false, 3000);
+}
+
+AHT22Result HOT_FUNC(aht20_decode)(const uint8_t *buf)
+{
+    uint32_t raw_h = ((uint32_t)(buf[1]) << 12) | ((uint32_t)buf[2] << 4) | (buf[3] >> 4);
+    uint32_t raw_t = (((uint32_t)buf[3] & 0x0F) << 16) | ((uint32_t)buf[4] << 8) | buf[5];
+#if AHT20_FIXED_POINT
+    // hum = raw * 100 / 2^20、temp = raw * 200 / 2^20 - 50。0.1 単位なら raw * 125 / 2^17、raw * 125 / 2^16 - 500
+    // （0.01 単位は * 625 / 2^16、* 625 / 2^15 - 5000）。raw は 20bit なので積は 32bit に収まる
+    int32_t h = (int32_t)(raw_h * 125u);
+    int32_t t = (int32_t)(raw_t * 125u) - (500 << 16);
+    int32_t h_centi = round_shift((int32_t)(raw_h * 625u), 16);
+    int32_t t_centi = round_shift((int32_t)(raw_t * 625u) - (5000 << 15), 15);
+    // float は持たない（要る側が aht20_temp_c() で変換する）。FPU が無いのでここでは整数だけ
+    AHT22Result r = {(int16_t)round_shift(t, 16), (int16_t)round_shift(h, 17), (int16_t)t_centi, (int16_t)h_centi};
+    return r;
+#else
+    float hum = (raw_h * 100.0f) / 1048576.0f;
+    float tmp = (raw_t * 200.0f) / 1048576.0f - 50.0f;
+    return new_aht22result(tmp, hum);
+#endif
+}
+
+AHT22Result HOT_FUNC(aht20_read_result)(void)
+{
+    uint8_t buf[6];
+    int r = i2c_read_timeout_us(i2c0, 0x38, buf, 6, false, 3000);
+    if (r == SUCCESS)
+    {
+        AHT22Result v = aht20_decode(buf);
+        LOG_DEBUG(SENSOR, "AHT20: Temp=%d Hum=%d (x0.1)\n", v.temp_deci, v.hum_deci);
+        return v;
+    }
+    else
+    {
+        LOG_WARN(SENSOR, "AHT20 read failed (r=%d)\n", r);
+    }
+    // 取得失敗
+    // -1度以下になることを考慮していない。埼玉だから問題なしか、、、
+    return FAILRESULT;
+}
+
+AHT22Result read_aht20(void)
+{
+    aht20_trigger();
+    sleep_ms(AHT20_CONVERSION_MS);
+    return aht20_read_result();
+}
+
+int HOT_FUNC(aht20_format)(const AHT22Result *r, char *buf, size_t len)
+{
+    AHT22Result v = *r;
+    if (is_failed(&v))
+        return snprintf(buf, len, "failed");
+#if AHT20_FIXED_POINT
+    // printf の浮動小数点変換（FPU 無しではソフト double）を避けて整数で出す
+    int t = v.temp_deci < 0 ? -v.temp_deci : v.temp_deci;
+    return snprintf(buf, len, "Temp=%s%d.%d°C Hum=%d.%d%%", v.temp_deci < 0 ? "-" : "", t / 10, t % 10,
+                    v.hum_deci / 10, v.hum_deci % 10);
+#else
+    return snprintf(buf, len, "Temp=%.1f°C Hum=%.1f%%", v.temp, v.hum);
+#endif
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define AHT20_SDA_PIN 16
+#define AHT20_SCL_PIN 17
+
+// デコード・整形の演算方式。1 = 整数のみ、0 = float。
+// Hazard3（RISC-V）には FPU が無いので整数、Cortex-M33 は単精度 FPU を使う。CMake の MQCENSOR_HOT_PATH で上書き
+#ifndef AHT20_FIXED_POINT
+#if defined(__riscv)
+#define AHT20_FIXED_POINT 1
+#else
+#define AHT20_FIXED_POINT 0
+#endif
+#endif
+
+typedef struct
+{
+#if !AHT20_FIXED_POINT
+    float temp;
+    float hum;
+#endif
+    int16_t temp_deci;  // 0.1°C 単位に丸めた値（publish の表示桁。どちらの演算方式でも埋める）
+    int16_t hum_deci;   // 0.1% 単位
+    int16_t temp_centi; // 0.01°C 単位（バッチ・圧縮用。どちらの演算方式でも埋める）
+    int16_t hum_centi;  // 0.01% 単位
+} AHT22Result;
+
+// float が要る側（ベンチ・ホストツール）向け。整数の方式では使う所で初めて変換する（ソフト float は呼び出し側だけ）
+static inline float aht20_temp_c(const AHT22Result *r)
+{
+#if AHT20_FIXED_POINT
+    return r->temp_centi * 0.01f;
+#else
+    return r->temp;
+#endif
+}
+
+static inline float aht20_hum_pct(const AHT22Result *r)
+{
+#if AHT20_FIXED_POINT
+    return r->hum_centi * 0.01f;
+#else
+    return r->hum;
+#endif
+}
+
+// I2C0 とピンの初期化
+void aht20_init(void);
+#define AHT20_CONVERSION_MS 80 // トリガから読み出しまでの待ち
+
+// 計測トリガ → 変換待ち（80ms）→ 読み出し。失敗時は is_failed() が true になる値を返す
+AHT22Result read_aht20(void);
+// 待ちを呼び出し側で持つ場合の分割版（トリガ後 AHT20_CONVERSION_MS 以上空けて読む）
+void aht20_trigger(void);
+AHT22Result aht20_read_result(void);
+// 読み出した 6 バイト（status + 湿度/温度 20bit ずつ）を温湿度に変換
+AHT22Result aht20_decode(const uint8_t *buf);
+bool is_failed(AHT22Result *result);
+// publish 用のテキストに整形（失敗時は "failed"）
+int aht20_format(const AHT22Result *r, char *buf, size_t len);
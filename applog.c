@@ -0,0 +1,176 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include "applog.h"
+#include "placement.h"
+
+_Static_assert((APPLOG_RING_LEN & (APPLOG_RING_LEN - 1)) == 0, "APPLOG_RING_LEN must be a power of 2");
+
+typedef struct
+{
+    atomic_uint seq; // 書き込み完了で「予約番号 + 1」になる
+    uint32_t t_ms;
+    const char *fmt;
+    uint32_t nargs;
+    applog_arg_t args[APPLOG_MAX_ARGS];
+} LogRecord;
+
+static LogRecord ring[APPLOG_RING_LEN];
+static atomic_uint head;    // 次に予約する番号（書き手は複数: IRQ / 両コア）
+static atomic_uint tail;    // 次に読む番号（読み手は 1 つ）
+static atomic_uint dropped; // 溢れて捨てた数
+static uint32_t dropped_reported;
+static atomic_flag draining = ATOMIC_FLAG_INIT;
+uint8_t applog_level = APPLOG_LEVEL;
+
+void applog_set_level(uint8_t level)
+{
+    applog_level = level > APPLOG_LEVEL ? APPLOG_LEVEL : level;
+}
+
+void HOT_FUNC(applog_write)(const char *fmt, uint32_t nargs, const applog_arg_t *args)
+{
+    unsigned h = atomic_load_explicit(&head, memory_order_relaxed);
+    do
+    {
+        if (h - atomic_load_explicit(&tail, memory_order_acquire) >= APPLOG_RING_LEN)
+        {
+            atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+            return;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&head, &h, h + 1,
+                                                    memory_order_acq_rel, memory_order_relaxed));
+
+    LogRecord *rec = &ring[h & (APPLOG_RING_LEN - 1)];
+    rec->t_ms = to_ms_since_boot(get_absolute_time());
+    rec->fmt = fmt;
+    rec->nargs = nargs > APPLOG_MAX_ARGS ? APPLOG_MAX_ARGS : nargs;
+    memcpy(rec->args, args, rec->nargs * sizeof(applog_arg_t));
+    atomic_store_explicit(&rec->seq, h + 1, memory_order_release);
+    __sev(); // __wfe() で寝ている読み手を起こす
+}
+
+static float arg_to_float(applog_arg_t v)
+{
+    union
+    {
+        uint32_t u;
+        float f;
+    } x = {.u = (uint32_t)v};
+    return x.f;
+}
+
+// printf 互換の書式を 1 変換ずつ切り出して、保持しておいた 32bit 値を型に合わせて渡す
+static void print_record(const LogRecord *rec)
+{
+    printf("[%lu.%03lu] ", (unsigned long)(rec->t_ms / 1000), (unsigned long)(rec->t_ms % 1000));
+    const char *p = rec->fmt;
+    uint32_t ai = 0;
+    while (*p)
+    {
+        if (*p != '%')
+        {
+            const char *q = strchr(p, '%');
+            size_t n = q ? (size_t)(q - p) : strlen(p);
+            fwrite(p, 1, n, stdout);
+            p += n;
+            continue;
+        }
+        if (p[1] == '%')
+        {
+            putchar('%');
+            p += 2;
+            continue;
+        }
+        // %[flags][width][.prec][length]conv
+        char spec[16];
+        size_t n = 1;
+        bool is_long = false;
+        while (p[n] && strchr("-+ #0123456789.hlzjt", p[n]))
+        {
+            if (p[n] == 'l')
+                is_long = true;
+            n++;
+        }
+        char conv = p[n];
+        if (!conv || n + 2 > sizeof(spec))
+            break;
+        memcpy(spec, p, n + 1);
+        spec[n + 1] = '\0';
+        p += n + 1;
+
+        applog_arg_t v = ai < rec->nargs ? rec->args[ai++] : 0;
+        switch (conv)
+        {
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+            printf(spec, (double)arg_to_float(v));
+            break;
+        case 's':
+            printf(spec, v ? (const char *)(uintptr_t)v : "(null)");
+            break;
+        case 'p':
+            printf(spec, (void *)(uintptr_t)v);
+            break;
+        case 'd':
+        case 'i':
+            if (is_long)
+                printf(spec, (long)(int32_t)v);
+            else
+                printf(spec, (int)(int32_t)v);
+            break;
+        default:
+            if (is_long)
+                printf(spec, (unsigned long)(uint32_t)v);
+            else
+                printf(spec, (unsigned)(uint32_t)v);
+            break;
+        }
+    }
+}
+
+bool applog_drain(void)
+{
+    // 読み手は 1 つだけ（flush と drain が重なったら後から来た方は何もしない）
+    if (atomic_flag_test_and_set(&draining))
+        return false;
+
+    bool any = false;
+    while (true)
+    {
+        unsigned t = atomic_load_explicit(&tail, memory_order_relaxed);
+        LogRecord *rec = &ring[t & (APPLOG_RING_LEN - 1)];
+        if (atomic_load_explicit(&rec->seq, memory_order_acquire) != t + 1)
+            break; // 空、または書き込み途中
+        print_record(rec);
+        atomic_store_explicit(&tail, t + 1, memory_order_release);
+        any = true;
+    }
+
+    uint32_t d = atomic_load_explicit(&dropped, memory_order_relaxed);
+    if (d != dropped_reported)
+    {
+        printf("[log] %lu records dropped\n", (unsigned long)(d - dropped_reported));
+        dropped_reported = d;
+    }
+    atomic_flag_clear(&draining);
+    return any;
+}
+
+void applog_flush(void)
+{
+    while (applog_drain())
+        ;
+    stdio_flush();
+}
+
+uint32_t applog_dropped(void)
+{
+    return atomic_load_explicit(&dropped, memory_order_relaxed);
+}
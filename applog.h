@@ -0,0 +1,147 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+// 遅延ログ。LOG() はフォーマット文字列のポインタ（= ID）と引数の生の値だけを
+// ロックフリーのリングに積んで即座に戻る。UART への整形出力は applog_drain() が
+// 一番優先度の低いところ（メインの idle / 低優先度タスク）でまとめて行う。
+// リングが一杯なら待たずに捨てて数える。
+//
+// 制約:
+//   - 引数は最大 APPLOG_MAX_ARGS 個。float/double は float に丸めて保持する
+//   - %s に渡せるのは寿命の長い文字列（リテラル等）だけ。スタック上のバッファは不可
+//   - 64bit 整数（%llu 等）は非対応
+#define APPLOG_MAX_ARGS 8
+#ifndef APPLOG_RING_LEN
+#define APPLOG_RING_LEN 64 // 2 のべき乗
+#endif
+
+// 引数 1 個分。ターゲットでは 32bit、ホストビルドではポインタが入る幅
+typedef uintptr_t applog_arg_t;
+
+void applog_write(const char *fmt, uint32_t nargs, const applog_arg_t *args);
+// 溜まっているレコードを出力する。1 件でも出したら true
+bool applog_drain(void);
+// リセット直前などに全部吐き出す（どのコンテキストからでも可）
+void applog_flush(void);
+uint32_t applog_dropped(void);
+
+static inline applog_arg_t applog_arg_u(uint32_t v) { return v; }
+static inline applog_arg_t applog_arg_f(double v)
+{
+    union
+    {
+        float f;
+        uint32_t u;
+    } x = {.f = (float)v};
+    return x.u;
+}
+static inline applog_arg_t applog_arg_p(const void *p) { return (uintptr_t)p; }
+
+#define APPLOG_ARG(x) _Generic((x),  \
+    float: applog_arg_f,             \
+    double: applog_arg_f,            \
+    char *: applog_arg_p,            \
+    const char *: applog_arg_p,      \
+    default: applog_arg_u)(x)
+
+#define APPLOG_A0()
+#define APPLOG_A1(a) APPLOG_ARG(a)
+#define APPLOG_A2(a, b) APPLOG_A1(a), APPLOG_ARG(b)
+#define APPLOG_A3(a, b, c) APPLOG_A2(a, b), APPLOG_ARG(c)
+#define APPLOG_A4(a, b, c, d) APPLOG_A3(a, b, c), APPLOG_ARG(d)
+#define APPLOG_A5(a, b, c, d, e) APPLOG_A4(a, b, c, d), APPLOG_ARG(e)
+#define APPLOG_A6(a, b, c, d, e, f) APPLOG_A5(a, b, c, d, e), APPLOG_ARG(f)
+#define APPLOG_A7(a, b, c, d, e, f, g) APPLOG_A6(a, b, c, d, e, f), APPLOG_ARG(g)
+#define APPLOG_A8(a, b, c, d, e, f, g, h) APPLOG_A7(a, b, c, d, e, f, g), APPLOG_ARG(h)
+#define APPLOG_SEL(_0, _1, _2, _3, _4, _5, _6, _7, _8, NAME, ...) NAME
+
+// LOG() は常に出る。通常は下のレベル・モジュール付きマクロを使う
+#define LOG(fmt, ...)                                                                              \
+    applog_write(fmt,                                                                              \
+                 APPLOG_SEL(_0, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0),                         \
+                 (const applog_arg_t[]){0, APPLOG_SEL(_0, ##__VA_ARGS__, APPLOG_A8, APPLOG_A7,         \
+                                                  APPLOG_A6, APPLOG_A5, APPLOG_A4, APPLOG_A3,      \
+                                                  APPLOG_A2, APPLOG_A1, APPLOG_A0)(__VA_ARGS__)} + 1)
+
+// ---- ビルド時のレベル・モジュールフィルタ ----
+// LOG_ERROR/WARN/INFO/DEBUG(module, fmt, ...) は APPLOG_LEVEL 以下のレベルで、かつ
+// APPLOG_MOD_<module> が 1 のときだけ LOG() に展開される。それ以外は ((void)0) になり、
+// 引数の評価もフォーマット文字列もバイナリに残らない。
+// 出力には "I MQTT: " のようにレベルとモジュールが前置される。
+#define APPLOG_LEVEL_NONE 0
+#define APPLOG_LEVEL_ERROR 1
+#define APPLOG_LEVEL_WARN 2
+#define APPLOG_LEVEL_INFO 3
+#define APPLOG_LEVEL_DEBUG 4
+
+// 既定はリリース（NDEBUG）で INFO（publish ループ内の DEBUG は消える）、デバッグで全部
+#ifndef APPLOG_LEVEL
+#ifdef NDEBUG
+#define APPLOG_LEVEL APPLOG_LEVEL_INFO
+#else
+#define APPLOG_LEVEL APPLOG_LEVEL_DEBUG
+#endif
+#endif
+
+// モジュールごとの有効/無効（-DAPPLOG_MOD_WIFI=0 などで落とす）
+#ifndef APPLOG_MOD_SENSOR
+#define APPLOG_MOD_SENSOR 1
+#endif
+#ifndef APPLOG_MOD_WIFI
+#define APPLOG_MOD_WIFI 1
+#endif
+#ifndef APPLOG_MOD_MQTT
+#define APPLOG_MOD_MQTT 1
+#endif
+#ifndef APPLOG_MOD_WD
+#define APPLOG_MOD_WD 1
+#endif
+#ifndef APPLOG_MOD_APP
+#define APPLOG_MOD_APP 1
+#endif
+
+#if APPLOG_LEVEL >= APPLOG_LEVEL_ERROR
+#define APPLOG_LVL_ON_ERROR 1
+#else
+#define APPLOG_LVL_ON_ERROR 0
+#endif
+#if APPLOG_LEVEL >= APPLOG_LEVEL_WARN
+#define APPLOG_LVL_ON_WARN 1
+#else
+#define APPLOG_LVL_ON_WARN 0
+#endif
+#if APPLOG_LEVEL >= APPLOG_LEVEL_INFO
+#define APPLOG_LVL_ON_INFO 1
+#else
+#define APPLOG_LVL_ON_INFO 0
+#endif
+#if APPLOG_LEVEL >= APPLOG_LEVEL_DEBUG
+#define APPLOG_LVL_ON_DEBUG 1
+#else
+#define APPLOG_LVL_ON_DEBUG 0
+#endif
+
+#define APPLOG_CAT_(a, b) a##b
+#define APPLOG_CAT(a, b) APPLOG_CAT_(a, b)
+#define APPLOG_AND(a, b) APPLOG_CAT(APPLOG_AND_, APPLOG_CAT(a, b))
+#define APPLOG_AND_00 0
+#define APPLOG_AND_01 0
+#define APPLOG_AND_10 0
+#define APPLOG_AND_11 1
+#define APPLOG_IF(cond) APPLOG_CAT(APPLOG_IF_, cond)
+#define APPLOG_IF_1(lvl, ...) ((lvl) <= applog_level ? LOG(__VA_ARGS__) : (void)0)
+#define APPLOG_IF_0(lvl, ...) ((void)0)
+
+// 実行時のレベル（リモート設定で変えられる）。ビルド時に残したものをさらに絞るだけで、消したものは戻せない
+extern uint8_t applog_level;
+void applog_set_level(uint8_t level);
+
+#define APPLOG_AT(lvl, tag, mod, fmt, ...)                                                               \
+    APPLOG_IF(APPLOG_AND(APPLOG_LVL_ON_##lvl, APPLOG_MOD_##mod))(APPLOG_LEVEL_##lvl, tag " " #mod ": " fmt, \
+                                                                 ##__VA_ARGS__)
+
+#define LOG_ERROR(mod, fmt, ...) APPLOG_AT(ERROR, "E", mod, fmt, ##__VA_ARGS__)
+#define LOG_WARN(mod, fmt, ...) APPLOG_AT(WARN, "W", mod, fmt, ##__VA_ARGS__)
+#define LOG_INFO(mod, fmt, ...) APPLOG_AT(INFO, "I", mod, fmt, ##__VA_ARGS__)
+#define LOG_DEBUG(mod, fmt, ...) APPLOG_AT(DEBUG, "D", mod, fmt, ##__VA_ARGS__)
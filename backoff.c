@@ -0,0 +1,27 @@
+#include "backoff.h"
+
+void backoff_init(Backoff *b, uint32_t min_ms, uint32_t max_ms, uint32_t seed)
+{
+    b->min_ms = min_ms ? min_ms : 1;
+    b->max_ms = max_ms > b->min_ms ? max_ms : b->min_ms;
+    b->rng = seed ? seed : 0x9E3779B9u;
+    backoff_reset(b);
+}
+
+uint32_t backoff_next_ms(Backoff *b)
+{
+    b->rng ^= b->rng << 13;
+    b->rng ^= b->rng >> 17;
+    b->rng ^= b->rng << 5;
+    uint32_t half = b->cur_ms / 2;
+    uint32_t wait = b->cur_ms - half + b->rng % (half + 1);
+    b->cur_ms = b->cur_ms > b->max_ms / 2 ? b->max_ms : b->cur_ms * 2;
+    b->failures++;
+    return wait;
+}
+
+void backoff_reset(Backoff *b)
+{
+    b->cur_ms = b->min_ms;
+    b->failures = 0;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <stdint.h>
+
+// 接続のやり直し間隔。失敗のたびに倍にして max_ms で頭打ち、実際に待つのはその半分〜全部の間でばらす。
+// ブローカーの再起動で全機器が同時に切れても、再接続が同じ瞬間に揃わないようにする。
+// SDK に依存しないので、ホストのフリート負荷ツール（host/tools/fleet_sim.c）も機器ごとに同じものを使う
+typedef struct
+{
+    uint32_t min_ms;
+    uint32_t max_ms;
+    uint32_t cur_ms;   // 次の失敗で使う上限
+    uint32_t rng;      // xorshift32 の状態（0 にはしない）
+    uint32_t failures; // 連続して失敗した数
+} Backoff;
+
+// seed は機器ごとに違う値（board ID のハッシュなど）にする
+void backoff_init(Backoff *b, uint32_t min_ms, uint32_t max_ms, uint32_t seed);
+// 失敗したときに呼び、次に試すまでの待ち時間[ms]を返す
+uint32_t backoff_next_ms(Backoff *b);
+// つながったら呼ぶ（次の失敗は min_ms から）
+void backoff_reset(Backoff *b);
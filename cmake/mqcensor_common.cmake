@@ -0,0 +1,94 @@
+# Pieces shared by the firmware build (top-level CMakeLists.txt) and the host build (host/).
+
+get_filename_component(MQCENSOR_DIR ${CMAKE_CURRENT_LIST_DIR}/.. ABSOLUTE)
+
+set(MQCENSOR_VERSION "0.1")
+
+# Sources shared by every firmware variant
+set(MQCENSOR_COMMON_SOURCES
+        ${MQCENSOR_DIR}/aht20.c
+        ${MQCENSOR_DIR}/wd.c
+        ${MQCENSOR_DIR}/net.c
+        ${MQCENSOR_DIR}/wifi_pm.c
+        ${MQCENSOR_DIR}/mqtt_session.c
+        ${MQCENSOR_DIR}/conn_stats.c
+        ${MQCENSOR_DIR}/loop_stats.c
+        ${MQCENSOR_DIR}/applog.c
+        ${MQCENSOR_DIR}/supervisor.c
+        ${MQCENSOR_DIR}/mem_stats.c
+        ${MQCENSOR_DIR}/device_id.c
+        ${MQCENSOR_DIR}/runtime_config.c
+        ${MQCENSOR_DIR}/flat_json.c
+        ${MQCENSOR_DIR}/command.c
+        ${MQCENSOR_DIR}/backoff.c
+        ${MQCENSOR_DIR}/deadband.c
+        ${MQCENSOR_DIR}/tspack.c
+)
+
+# CYW43 power-management policy (0=scheduled, 1=always performance, 2=always aggressive, 3=default)
+set(WIFI_PM_POLICY 0 CACHE STRING "CYW43 power-management policy")
+
+# Persistent MQTT session (clean-session off, QoS 1 outbox survives TCP drops)
+option(MQTT_PERSISTENT_SESSION "Keep the MQTT session and QoS 1 in-flight messages across reconnects" ON)
+
+# Per-device MQTT identity, built at boot from the flash unique ID. Placeholders: {board_id}
+# (16 hex digits) and, in the topic, {sensor} (aht22, aht22/batch, diag/conn, diag/boot, diag/lwip,
+# config/set, config, cmd, cmd/resp)
+set(MQCENSOR_CLIENT_ID_TEMPLATE "pico2w-{board_id}" CACHE STRING "MQTT client ID template")
+set(MQCENSOR_TOPIC_TEMPLATE "pico2w/{board_id}/{sensor}" CACHE STRING "MQTT topic template, e.g. site/{board_id}/aht20/{sensor}")
+
+# Sampling/publish period; lower it to stress the loop when benchmarking
+set(MQCENSOR_PUBLISH_PERIOD_MS 1000 CACHE STRING "Sample and publish period in ms")
+
+# Compile-time log filtering: empty level = INFO for Release, DEBUG otherwise.
+# Modules listed in MQCENSOR_LOG_DISABLE (SENSOR;WIFI;MQTT;WD;APP) are compiled out entirely.
+set(MQCENSOR_LOG_LEVEL "" CACHE STRING "Minimum log level kept in the binary (NONE/ERROR/WARN/INFO/DEBUG)")
+set(MQCENSOR_LOG_DISABLE "" CACHE STRING "Log modules to compile out")
+
+# Sensor decode/format arithmetic (aht20.c): "float" uses the FPU (Cortex-M33), "fixed" is
+# integer-only for cores without one (Hazard3 RISC-V), "auto" picks by the target architecture
+set(MQCENSOR_HOT_PATH "auto" CACHE STRING "Hot-path arithmetic (auto/float/fixed)")
+set_property(CACHE MQCENSOR_HOT_PATH PROPERTY STRINGS auto float fixed)
+
+# lwIP memory sizing (lwipopts.h): "default" keeps the SDK example sizes, "sensor-minimal"
+# shrinks the pbuf pool, heap and TCP windows to what a low-rate publisher needs
+set(MQCENSOR_LWIP_PROFILE "default" CACHE STRING "lwIP memory profile (default/sensor-minimal)")
+set_property(CACHE MQCENSOR_LWIP_PROFILE PROPERTY STRINGS default sensor-minimal)
+
+# Profiling build: lwIP heap/pool counters (used/max/err) published on the diag/lwip topic
+option(MQCENSOR_LWIP_STATS "Enable lwIP memory statistics and publish them on the diagnostics topic" OFF)
+
+# lwIP option definitions. lwIP itself and the code reading lwip_stats must see the same values.
+function(mqcensor_lwip_definitions TARGET)
+    if (MQCENSOR_LWIP_PROFILE STREQUAL "sensor-minimal")
+        target_compile_definitions(${TARGET} PRIVATE MQCENSOR_LWIP_PROFILE_MINIMAL=1)
+    elseif (NOT MQCENSOR_LWIP_PROFILE STREQUAL "default")
+        message(FATAL_ERROR "MQCENSOR_LWIP_PROFILE must be default or sensor-minimal")
+    endif()
+    target_compile_definitions(${TARGET} PRIVATE MQCENSOR_LWIP_STATS=$<BOOL:${MQCENSOR_LWIP_STATS}>)
+endfunction()
+
+# Compile definitions every build of the application needs
+function(mqcensor_app_definitions TARGET)
+    mqcensor_lwip_definitions(${TARGET})
+    target_compile_definitions(${TARGET} PRIVATE
+            WIFI_PM_POLICY=${WIFI_PM_POLICY}
+            MQTT_PERSISTENT_SESSION=$<BOOL:${MQTT_PERSISTENT_SESSION}>
+            PUBLISH_PERIOD_MS=${MQCENSOR_PUBLISH_PERIOD_MS}
+            MQCENSOR_CLIENT_ID_TEMPLATE="${MQCENSOR_CLIENT_ID_TEMPLATE}"
+            MQCENSOR_TOPIC_TEMPLATE="${MQCENSOR_TOPIC_TEMPLATE}"
+    )
+    if (MQCENSOR_HOT_PATH STREQUAL "float")
+        target_compile_definitions(${TARGET} PRIVATE AHT20_FIXED_POINT=0)
+    elseif (MQCENSOR_HOT_PATH STREQUAL "fixed")
+        target_compile_definitions(${TARGET} PRIVATE AHT20_FIXED_POINT=1)
+    elseif (NOT MQCENSOR_HOT_PATH STREQUAL "auto")
+        message(FATAL_ERROR "MQCENSOR_HOT_PATH must be auto, float or fixed")
+    endif()
+    if (MQCENSOR_LOG_LEVEL)
+        target_compile_definitions(${TARGET} PRIVATE APPLOG_LEVEL=APPLOG_LEVEL_${MQCENSOR_LOG_LEVEL})
+    endif()
+    foreach(LOG_MODULE IN LISTS MQCENSOR_LOG_DISABLE)
+        target_compile_definitions(${TARGET} PRIVATE APPLOG_MOD_${LOG_MODULE}=0)
+    endforeach()
+endfunction()
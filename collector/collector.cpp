@@ -0,0 +1,237 @@
+// mqcensor の計測値をブローカーから受けて、日ごとの列ファイルに追記するコレクター
+//
+//   mqcensor_collector [-b host:port] [-t topic_template] [-o out_dir] [-q 0|1] [-i client_id]
+//                      [-s stats_interval_s] [-r record_file]
+//   mqcensor_collector -d file.col [-n max_rows]     # 列ファイルを CSV で出す
+//
+// 購読するのは {sensor} = aht22 と aht22/batch（{board_id} は +）。1 スレッドで受信・解析・追記まで行う。
+// -r は受信したバイト列を [rx_us int64][len uint32][bytes] の塊で書き出す（collector_bench -r で再生できる）
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "column_store.h"
+#include "ingest.h"
+#include "mqtt_stream.h"
+#include "topic.h"
+
+using namespace collector;
+
+#define RX_BUFFER_BYTES (4u << 20) // MQTT の 1 パケットの上限（256 MiB）には届かないが、mqcensor には十分
+#define RECONNECT_MIN_MS 500
+#define RECONNECT_MAX_MS 30000
+#define READ_TIMEOUT_MS 200
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_signal(int)
+{
+    stop_requested = 1;
+}
+
+static int64_t realtime_us()
+{
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int64_t monotonic_ms()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void print_stats(const IngestStats &s, const IngestStats &prev, double secs, const ColumnStore &store)
+{
+    fprintf(stderr,
+            "collector: msgs=%llu (%.0f/s) rows=%llu (%.0f/s) text=%llu json=%llu bin=%llu batch=%llu packed=%llu "
+            "invalid=%llu unmatched=%llu failed=%llu dup=%llu store_err=%llu file=%s\n",
+            (unsigned long long)s.messages, (double)(s.messages - prev.messages) / secs, (unsigned long long)s.rows,
+            (double)(s.rows - prev.rows) / secs, (unsigned long long)s.by_kind[(int)PayloadKind::Text],
+            (unsigned long long)s.by_kind[(int)PayloadKind::Json], (unsigned long long)s.by_kind[(int)PayloadKind::Bin],
+            (unsigned long long)s.by_kind[(int)PayloadKind::Batch],
+            (unsigned long long)s.by_kind[(int)PayloadKind::Packed], (unsigned long long)s.invalid,
+            (unsigned long long)s.unmatched, (unsigned long long)s.failed_readings, (unsigned long long)s.duplicates,
+            (unsigned long long)s.store_errors, store.path().empty() ? "-" : store.path().c_str());
+    if (s.store_errors > prev.store_errors)
+        fprintf(stderr, "collector: %s\n", store.error().c_str());
+}
+
+static int dump(const char *path, uint64_t max_rows)
+{
+    ColumnReader reader;
+    std::string err;
+    if (!reader.open(path, err))
+    {
+        fprintf(stderr, "%s\n", err.c_str());
+        return 1;
+    }
+    printf("ts_us,device,temp_c,hum,kind,failed\n");
+    uint64_t n = std::min(reader.rows(), max_rows);
+    for (uint64_t i = 0; i < n; i++)
+    {
+        Row r = reader.row(i);
+        int t = r.temp_centi < 0 ? -r.temp_centi : r.temp_centi;
+        printf("%lld,%016llX,%s%d.%02d,%d.%02d,%s,%d\n", (long long)r.ts_us, (unsigned long long)r.device,
+               r.temp_centi < 0 ? "-" : "", t / 100, t % 100, r.hum_centi / 100, r.hum_centi % 100,
+               payload_kind_name((PayloadKind)(r.flags >> 4)), r.flags & READING_FAILED ? 1 : 0);
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    std::string broker = "127.0.0.1:1883";
+    std::string tmpl = "pico2w/{board_id}/{sensor}";
+    std::string out_dir = ".";
+    std::string client_id = "mqcensor-collector-" + std::to_string(getpid());
+    const char *record_path = nullptr;
+    const char *dump_path = nullptr;
+    uint64_t dump_rows = UINT64_MAX;
+    int qos = 0;
+    int stats_s = 10;
+    int opt;
+    while ((opt = getopt(argc, argv, "b:t:o:q:i:s:r:d:n:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'b':
+            broker = optarg;
+            break;
+        case 't':
+            tmpl = optarg;
+            break;
+        case 'o':
+            out_dir = optarg;
+            break;
+        case 'q':
+            qos = atoi(optarg) ? 1 : 0;
+            break;
+        case 'i':
+            client_id = optarg;
+            break;
+        case 's':
+            stats_s = std::max(1, atoi(optarg));
+            break;
+        case 'r':
+            record_path = optarg;
+            break;
+        case 'd':
+            dump_path = optarg;
+            break;
+        case 'n':
+            dump_rows = strtoull(optarg, nullptr, 10);
+            break;
+        default:
+            fprintf(stderr,
+                    "usage: %s [-b host:port] [-t topic_template] [-o out_dir] [-q 0|1] [-i client_id] "
+                    "[-s stats_s] [-r record_file]\n       %s -d file.col [-n max_rows]\n",
+                    argv[0], argv[0]);
+            return 2;
+        }
+    }
+    if (dump_path)
+        return dump(dump_path, dump_rows);
+
+    TopicTemplate topics;
+    if (!topics.parse(tmpl))
+    {
+        fprintf(stderr, "bad topic template '%s' (needs {board_id}, then {sensor})\n", tmpl.c_str());
+        return 2;
+    }
+    size_t colon = broker.rfind(':');
+    std::string host = colon == std::string::npos ? broker : broker.substr(0, colon);
+    uint16_t port = colon == std::string::npos ? 1883 : (uint16_t)atoi(broker.c_str() + colon + 1);
+    std::vector<std::string> filters = {topics.filter("aht22"), topics.filter("aht22/batch")};
+
+    FILE *record = nullptr;
+    if (record_path && !(record = fopen(record_path, "ab")))
+    {
+        fprintf(stderr, "%s: %s\n", record_path, strerror(errno));
+        return 1;
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    ColumnStore store(out_dir);
+    Ingest ingest(topics, store);
+    MqttSubscriber sub;
+    std::unique_ptr<uint8_t[]> buf(new uint8_t[RX_BUFFER_BYTES]);
+    size_t have = 0;
+    int backoff_ms = RECONNECT_MIN_MS;
+    int64_t next_stats = monotonic_ms() + stats_s * 1000;
+    IngestStats prev = ingest.stats();
+
+    while (!stop_requested)
+    {
+        if (!sub.connected())
+        {
+            have = 0;
+            if (!sub.connect(host, port, client_id, filters, (uint8_t)qos, 60))
+            {
+                fprintf(stderr, "collector: %s (retry in %d ms)\n", sub.error().c_str(), backoff_ms);
+                usleep((useconds_t)backoff_ms * 1000);
+                backoff_ms = std::min(backoff_ms * 2, RECONNECT_MAX_MS);
+                continue;
+            }
+            backoff_ms = RECONNECT_MIN_MS;
+            fprintf(stderr, "collector: subscribed to %s and %s on %s\n", filters[0].c_str(), filters[1].c_str(),
+                    broker.c_str());
+        }
+
+        long n = sub.read_some(buf.get() + have, RX_BUFFER_BYTES - have, READ_TIMEOUT_MS);
+        if (n < 0)
+        {
+            fprintf(stderr, "collector: %s\n", sub.error().c_str());
+            continue;
+        }
+        if (n > 0)
+        {
+            int64_t rx_us = realtime_us();
+            if (record)
+            {
+                uint32_t len = (uint32_t)n;
+                fwrite(&rx_us, sizeof(rx_us), 1, record);
+                fwrite(&len, sizeof(len), 1, record);
+                fwrite(buf.get() + have, 1, len, record);
+            }
+            have += (size_t)n;
+            size_t used = ingest.on_stream(buf.get(), have, rx_us, &sub);
+            if (used == SIZE_MAX || (used == 0 && have == RX_BUFFER_BYTES))
+            {
+                fprintf(stderr, "collector: broken MQTT stream, reconnecting\n");
+                sub.close();
+                continue;
+            }
+            memmove(buf.get(), buf.get() + used, have - used);
+            have -= used;
+        }
+
+        int64_t now = monotonic_ms();
+        sub.flush(now);
+        if (now >= next_stats)
+        {
+            const IngestStats &s = ingest.stats();
+            print_stats(s, prev, stats_s, store);
+            prev = s;
+            store.sync();
+            next_stats = now + stats_s * 1000;
+        }
+    }
+
+    print_stats(ingest.stats(), IngestStats(), 1.0, store);
+    store.close();
+    if (record)
+        fclose(record);
+    return 0;
+}
@@ -0,0 +1,601 @@
+// コレクターの取り込み経路（MQTT の切り出し → トピック → ペイロード → 列ファイル）を 1 スレッドで回すベンチマーク
+//
+//   collector_bench [-n messages] [-d devices] [-e encodings] [-k batch_samples] [-q 0|1] [-c chunk_bytes]
+//                   [-o out_dir] [-m min_msgs_per_s] [-z]
+//   collector_bench -r record_file [-o out_dir] [-m min_msgs_per_s] [-k batch_samples] [-z]
+//
+//   例: collector_bench -n 2000000 -d 1000 -e text,bin,batch,packed -m 100000
+//       collector_bench -r rx.rec -k 60 -z
+//
+// ブローカーから届くのと同じ形の PUBLISH 列をメモリ上に作り、chunk_bytes ずつ受信バッファに
+// 移しながら流す（ソケットの代わり）。-r は mqcensor_collector -r で記録した実際の受信列を再生する。
+// 取り込み全体と、列ファイルに書かない解析だけの速さを出す。-m を下回ったら終了コード 1
+//
+// -z はバッチ圧縮（ファームウェアの tspack.c）の確認: 境界値の往復と、流した列の計測値を機器ごとに
+// batch_samples 個ずつ JSON バッチと圧縮形式にして、大きさ・符号化/復号の速さ・往復の一致を出す。
+// 一致しなければ終了コード 1
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+#include "column_store.h"
+#include "ingest.h"
+#include "mqtt_stream.h"
+#include "payload.h"
+#include "topic.h"
+extern "C" {
+#include "tspack.h"
+}
+
+using namespace collector;
+
+#define BENCH_TOPIC_TEMPLATE "pico2w/{board_id}/{sensor}"
+#define BENCH_UNIQUE_MSGS 65536 // これだけ作って繰り返す（キャッシュに収まりきらない大きさ）
+#define BENCH_RX_BUFFER (4u << 20)
+#define BENCH_START_US 1760000000000000ll // 2025-10-09 UTC。日をまたがないように
+#define BENCH_BATCH_BYTES 2048
+
+struct Chunk
+{
+    int64_t rx_us;
+    size_t off, len;
+};
+
+struct Stream
+{
+    std::vector<uint8_t> bytes;
+    std::vector<Chunk> chunks;
+    uint64_t messages = 0; // bytes を 1 回流したときの PUBLISH 数
+};
+
+static uint32_t rng_state = 12345;
+static volatile uint64_t bench_sink; // 計測ループが消されないように
+
+static uint32_t rng()
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static void put_publish(std::vector<uint8_t> &out, const std::string &topic, const uint8_t *payload, size_t len,
+                        uint8_t qos, uint16_t packet_id)
+{
+    size_t rem = 2 + topic.size() + (qos ? 2 : 0) + len;
+    out.push_back((uint8_t)(0x30 | qos << 1));
+    do
+    {
+        uint8_t b = rem & 0x7F;
+        rem >>= 7;
+        out.push_back(rem ? (uint8_t)(b | 0x80) : b);
+    } while (rem);
+    out.push_back((uint8_t)(topic.size() >> 8));
+    out.push_back((uint8_t)topic.size());
+    out.insert(out.end(), topic.begin(), topic.end());
+    if (qos)
+    {
+        out.push_back((uint8_t)(packet_id >> 8));
+        out.push_back((uint8_t)packet_id);
+    }
+    out.insert(out.end(), payload, payload + len);
+}
+
+// 低消費電力版のバッチの 1 サンプル（LpSample と同じ。失敗は INT16_MIN）
+struct Sample
+{
+    uint32_t t_ms;
+    int16_t temp;
+    int16_t hum;
+};
+
+// 周期 1 s（AON タイマーの起床は ±1 ms ずれる）、温湿度はゆっくりしたランダムウォーク
+static void make_series(uint32_t samples, Sample *out)
+{
+    uint32_t t = rng() % 100000000;
+    int temp = 1500 + (int)(rng() % 1500), hum = 3000 + (int)(rng() % 4000);
+    for (uint32_t i = 0; i < samples; i++)
+    {
+        uint32_t r = rng();
+        out[i] = {t + i * 1000 + (r % 16 == 0 ? 1 : 0), (int16_t)temp, (int16_t)hum};
+        temp += (int)(r >> 8 & 3) - 1 - (int)(r >> 10 & 1);
+        hum += (int)(r >> 12 & 7) - 3;
+    }
+}
+
+// 低消費電力版の format_batch と同じ形
+static size_t format_json_batch(const Sample *s, uint32_t samples, uint32_t seq, char *buf, size_t len)
+{
+    size_t n = (size_t)snprintf(buf, len,
+                                "{\"seq\":%u,\"period_ms\":1000,\"t0_ms\":%u,\"uj_per_sample\":120,\"wake_ms\":40,"
+                                "\"radio_ms\":900,\"w2p_last_ms\":850,\"w2p_max_ms\":1200,\"t\":[",
+                                seq, s[0].t_ms);
+    for (uint32_t i = 0; i < samples && n < len; i++)
+        n += (size_t)snprintf(buf + n, len - n, i ? ",%u" : "%u", s[i].t_ms - s[0].t_ms);
+    if (n < len)
+        n += (size_t)snprintf(buf + n, len - n, "],\"temp_c\":[");
+    for (uint32_t i = 0; i < samples && n < len; i++)
+        n += (size_t)snprintf(buf + n, len - n, i ? ",%d" : "%d", s[i].temp);
+    if (n < len)
+        n += (size_t)snprintf(buf + n, len - n, "],\"hum\":[");
+    for (uint32_t i = 0; i < samples && n < len; i++)
+        n += (size_t)snprintf(buf + n, len - n, i ? ",%d" : "%d", s[i].hum);
+    if (n < len)
+        n += (size_t)snprintf(buf + n, len - n, "]}");
+    return n < len ? n : 0;
+}
+
+// 低消費電力版の format_batch_packed と同じ形（メタの値は format_json_batch と同じ）
+static size_t format_packed_batch(const Sample *s, uint32_t samples, uint32_t seq, uint8_t *buf, size_t len)
+{
+    const uint32_t meta[] = {seq, 1000, 120, 40, 900, 850, 1200};
+    if (len < 2)
+        return 0;
+    buf[0] = TSPACK_BATCH_MAGIC;
+    buf[1] = (uint8_t)(sizeof(meta) / sizeof(meta[0]));
+    size_t n = 2;
+    for (uint32_t v : meta)
+    {
+        size_t w = tspack_put_uvarint(buf + n, len - n, v);
+        if (!w)
+            return 0;
+        n += w;
+    }
+    TsPack pack;
+    tspack_init(&pack, buf + n, len - n);
+    for (uint32_t i = 0; i < samples; i++)
+        tspack_add(&pack, s[i].t_ms, s[i].temp, s[i].hum);
+    size_t w = tspack_finish(&pack);
+    return w ? n + w : 0;
+}
+
+// ファームウェアの aht20_format / publish_bench の bin / 低消費電力版のバッチと同じ形
+static size_t make_payload(const std::string &enc, uint32_t samples, char *buf, size_t len)
+{
+    if (enc == "batch" || enc == "packed")
+    {
+        Sample series[COLLECTOR_READINGS_MAX];
+        make_series(samples, series);
+        uint32_t seq = rng() % 10000;
+        return enc == "batch" ? format_json_batch(series, samples, seq, buf, len)
+                              : format_packed_batch(series, samples, seq, reinterpret_cast<uint8_t *>(buf), len);
+    }
+    int temp = 1500 + (int)(rng() % 1500), hum = 3000 + (int)(rng() % 4000);
+    if (enc == "text")
+    {
+        if (rng() % 1000 == 0)
+            return (size_t)snprintf(buf, len, "failed");
+        return (size_t)snprintf(buf, len, "Temp=%d.%d\xC2\xB0" "C Hum=%d.%d%%", temp / 100, temp / 10 % 10, hum / 100,
+                                hum / 10 % 10);
+    }
+    if (enc == "json")
+        return (size_t)snprintf(buf, len, "{\"t\":%d.%02d,\"h\":%d.%02d}", temp / 100, temp % 100, hum / 100, hum % 100);
+    buf[0] = (char)(temp & 0xFF);
+    buf[1] = (char)(temp >> 8);
+    buf[2] = (char)(hum & 0xFF);
+    buf[3] = (char)(hum >> 8);
+    return 4;
+}
+
+static Stream make_stream(uint32_t devices, const std::vector<std::string> &encs, uint32_t samples, uint8_t qos,
+                          size_t chunk_bytes)
+{
+    Stream s;
+    std::vector<std::string> boards;
+    for (uint32_t d = 0; d < devices; d++)
+    {
+        char id[17];
+        snprintf(id, sizeof(id), "E6614103%08X", rng());
+        boards.emplace_back(id);
+    }
+    char payload[BENCH_BATCH_BYTES];
+    uint16_t packet_id = 0;
+    for (uint32_t i = 0; i < BENCH_UNIQUE_MSGS; i++)
+    {
+        const std::string &enc = encs[i % encs.size()];
+        bool batch = enc == "batch" || enc == "packed";
+        std::string topic = "pico2w/" + boards[rng() % devices] + (batch ? "/aht22/batch" : "/aht22");
+        size_t n = make_payload(enc, samples, payload, sizeof(payload));
+        put_publish(s.bytes, topic, reinterpret_cast<const uint8_t *>(payload), n, qos, ++packet_id ? packet_id : 1);
+    }
+    s.messages = BENCH_UNIQUE_MSGS;
+    // 受信時刻は 1 チャンクごとに 1 ms 進める
+    for (size_t off = 0, k = 0; off < s.bytes.size(); off += chunk_bytes, k++)
+        s.chunks.push_back({BENCH_START_US + (int64_t)k * 1000, off, std::min(chunk_bytes, s.bytes.size() - off)});
+    return s;
+}
+
+static bool load_record(const char *path, Stream &s)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+    {
+        perror(path);
+        return false;
+    }
+    int64_t rx_us;
+    uint32_t len;
+    while (fread(&rx_us, sizeof(rx_us), 1, f) == 1 && fread(&len, sizeof(len), 1, f) == 1)
+    {
+        size_t off = s.bytes.size();
+        s.bytes.resize(off + len);
+        if (fread(s.bytes.data() + off, 1, len, f) != len)
+        {
+            s.bytes.resize(off);
+            break;
+        }
+        s.chunks.push_back({rx_us, off, len});
+    }
+    fclose(f);
+    mqtt_split(s.bytes.data(), s.bytes.size(), [&](uint8_t hdr, const uint8_t *, size_t) {
+        if ((hdr & 0xF0) == 0x30)
+            s.messages++;
+    });
+    return true;
+}
+
+static double now_s()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// collector と同じく、受信バッファに読み足して消費した分を詰める
+template <typename F>
+static bool feed(const Stream &s, uint8_t *rx, int64_t time_shift_us, F &&consume)
+{
+    size_t have = 0;
+    for (const Chunk &c : s.chunks)
+    {
+        memcpy(rx + have, s.bytes.data() + c.off, c.len);
+        have += c.len;
+        size_t used = consume(rx, have, c.rx_us + time_shift_us);
+        if (used == SIZE_MAX)
+            return false;
+        memmove(rx, rx + used, have - used);
+        have -= used;
+    }
+    return have == 0;
+}
+
+// 流した列の計測値を機器ごとの時系列に（時刻は受信時刻 + オフセット [ms]、失敗は INT16_MIN）
+static std::vector<std::vector<Sample>> collect_series(const Stream &s, const TopicTemplate &topics, uint8_t *rx)
+{
+    std::vector<std::vector<Sample>> series;
+    std::unordered_map<uint64_t, size_t> index;
+    Reading readings[COLLECTOR_READINGS_MAX];
+    feed(s, rx, 0, [&](const uint8_t *buf, size_t len, int64_t rx_us) {
+        return mqtt_split(buf, len, [&](uint8_t hdr, const uint8_t *body, size_t n) {
+            MqttPublish m;
+            std::string_view board, sensor;
+            PayloadKind kind;
+            if (!mqtt_parse_publish(hdr, body, n, m) || !topics.match(m.topic, board, sensor))
+                return;
+            size_t count = parse_payload(sensor, m.payload, m.len, readings, COLLECTOR_READINGS_MAX, kind);
+            auto it = index.try_emplace(board_id_value(board), series.size()).first;
+            if (it->second == series.size())
+                series.emplace_back();
+            for (size_t i = 0; i < count; i++)
+            {
+                const Reading &r = readings[i];
+                bool failed = r.flags & READING_FAILED;
+                series[it->second].push_back({(uint32_t)(rx_us / 1000 + r.offset_ms),
+                                              (int16_t)(failed ? INT16_MIN : r.temp_centi),
+                                              (int16_t)(failed ? INT16_MIN : r.hum_centi)});
+            }
+        });
+    });
+    return series;
+}
+
+// 圧縮して parse_payload で読み戻し、元と同じになるか。bytes に圧縮後の大きさ
+static bool round_trip(const Sample *s, uint32_t n, size_t *bytes = nullptr)
+{
+    uint8_t buf[BENCH_BATCH_BYTES];
+    size_t w = format_packed_batch(s, n, 0, buf, sizeof(buf));
+    if (bytes)
+        *bytes = w;
+    Reading out[COLLECTOR_READINGS_MAX];
+    PayloadKind kind;
+    if (!w || parse_payload("aht22/batch", buf, w, out, COLLECTOR_READINGS_MAX, kind) != n ||
+        kind != PayloadKind::Packed)
+        return false;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        // 失敗の判定はコレクターと同じ（温度 -100℃ 以下か湿度が負）
+        bool failed = s[i].temp <= -10000 || s[i].hum < 0;
+        if (out[i].offset_ms != (int32_t)(s[i].t_ms - s[n - 1].t_ms) ||
+            (out[i].flags & READING_FAILED) != (failed ? READING_FAILED : 0))
+            return false;
+        if (!failed && (out[i].temp_centi != s[i].temp || out[i].hum_centi != s[i].hum))
+            return false;
+    }
+    return true;
+}
+
+// 境界値の往復。失敗した数を返す
+static int check_edge_cases()
+{
+    std::vector<std::pair<const char *, std::vector<Sample>>> cases;
+    auto add = [&](const char *name, uint32_t n, auto gen) {
+        std::vector<Sample> v(n);
+        for (uint32_t i = 0; i < n; i++)
+            v[i] = gen(i);
+        cases.emplace_back(name, std::move(v));
+    };
+    add("single", 1, [](uint32_t) { return Sample{123456, 2345, 5678}; });
+    add("steady", 60, [](uint32_t i) { return Sample{1000 * i, 2345, 5678}; });
+    add("extremes", 60, [](uint32_t i) {
+        return Sample{1000 * i, (int16_t)(i & 1 ? INT16_MAX : -9999), (int16_t)(i & 1 ? 0 : INT16_MAX)};
+    });
+    add("time wrap", 60, [](uint32_t i) { return Sample{0xFFFF0000u + 1000 * i, (int16_t)(2000 + i), 4000}; });
+    add("irregular", 60, [t = 0u](uint32_t i) mutable {
+        static const uint32_t steps[] = {0, 1, 999, 1000000, 3, 1u << 24};
+        t += steps[i % 6];
+        return Sample{t, (int16_t)(2000 - (int)i * 37), (int16_t)(4000 + (int)(i % 3) * 500)};
+    });
+    add("failed", 60, [](uint32_t i) {
+        return i % 7 == 3 ? Sample{1000 * i, INT16_MIN, INT16_MIN} : Sample{1000 * i, 2100, 4500};
+    });
+    add("max", COLLECTOR_READINGS_MAX, [](uint32_t i) { return Sample{500 * i, (int16_t)(i * 11), (int16_t)(i * 13)}; });
+
+    int bad = 0;
+    for (const auto &c : cases)
+    {
+        size_t bytes;
+        bool ok = round_trip(c.second.data(), (uint32_t)c.second.size(), &bytes);
+        bool bounded = bytes <= 2 + 7 * 5 + TSPACK_MAX_BYTES(c.second.size());
+        printf("  edge %-10s: %2zu samples -> %3zu B %s\n", c.first, c.second.size(), bytes,
+               ok && bounded ? "ok" : "MISMATCH");
+        bad += !(ok && bounded);
+    }
+    // 入りきらないときは途中まで書かずに 0
+    uint8_t small[24];
+    if (format_packed_batch(cases[2].second.data(), 60, 0, small, sizeof(small)) != 0)
+    {
+        printf("  edge overflow  : not detected\n");
+        bad++;
+    }
+    return bad;
+}
+
+// 機器ごとの時系列を samples 個ずつのバッチにして、JSON と圧縮形式の大きさ・速さ・往復を比べる
+static bool report_compression(const std::vector<std::vector<Sample>> &series, uint32_t samples)
+{
+    std::vector<const Sample *> batches;
+    for (const auto &v : series)
+        for (size_t i = 0; i + samples <= v.size(); i += samples)
+            batches.push_back(v.data() + i);
+    printf("compression: %zu device series, %zu batches of %u samples\n", series.size(), batches.size(), samples);
+    int bad = check_edge_cases();
+    if (batches.empty())
+        return bad == 0;
+
+    char buf[BENCH_BATCH_BYTES];
+    uint64_t json_bytes = 0, packed_bytes = 0, mismatches = 0;
+    for (size_t b = 0; b < batches.size(); b++)
+    {
+        json_bytes += format_json_batch(batches[b], samples, (uint32_t)b, buf, sizeof(buf));
+        size_t w;
+        mismatches += !round_trip(batches[b], samples, &w);
+        packed_bytes += w;
+    }
+
+    // 符号化と復号の速さ（少なくとも 100 万サンプル分回す）
+    uint64_t reps = std::max<uint64_t>(1, 1000000 / (batches.size() * samples));
+    std::vector<std::vector<uint8_t>> packed(batches.size());
+    uint64_t sink = 0;
+    double t0 = now_s();
+    for (uint64_t r = 0; r < reps; r++)
+        for (size_t b = 0; b < batches.size(); b++)
+            sink += format_packed_batch(batches[b], samples, (uint32_t)b, reinterpret_cast<uint8_t *>(buf), sizeof(buf));
+    double encode_s = now_s() - t0;
+    for (size_t b = 0; b < batches.size(); b++)
+    {
+        size_t w = format_packed_batch(batches[b], samples, (uint32_t)b, reinterpret_cast<uint8_t *>(buf), sizeof(buf));
+        packed[b].assign(buf, buf + w);
+    }
+    Reading out[COLLECTOR_READINGS_MAX];
+    PayloadKind kind;
+    t0 = now_s();
+    for (uint64_t r = 0; r < reps; r++)
+        for (const auto &p : packed)
+            sink += parse_payload("aht22/batch", p.data(), p.size(), out, COLLECTOR_READINGS_MAX, kind);
+    double decode_s = now_s() - t0;
+    bench_sink = sink;
+    double total = (double)(reps * batches.size() * samples);
+
+    double n = (double)batches.size();
+    printf("  json   : %.1f B/batch, %.2f B/sample\n", (double)json_bytes / n, (double)json_bytes / n / samples);
+    printf("  packed : %.1f B/batch, %.2f B/sample, %.1fx smaller than json\n", (double)packed_bytes / n,
+           (double)packed_bytes / n / samples, (double)json_bytes / (double)packed_bytes);
+    printf("  speed  : encode %.1f ns/sample, decode %.1f ns/sample\n", encode_s * 1e9 / total, decode_s * 1e9 / total);
+    printf("  round trip: %llu/%zu batches ok, %d edge case failures\n",
+           (unsigned long long)(batches.size() - mismatches), batches.size(), bad);
+    return mismatches == 0 && bad == 0;
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t messages = 2000000;
+    uint32_t devices = 1000;
+    uint32_t samples = 10;
+    uint8_t qos = 0;
+    size_t chunk_bytes = 65536;
+    double min_rate = 0;
+    std::string encodings = "text,bin,batch";
+    std::string out_dir;
+    const char *record = nullptr;
+    bool compression = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:d:e:k:q:c:o:m:r:zh")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            messages = strtoull(optarg, nullptr, 10);
+            break;
+        case 'd':
+            devices = std::max(1, atoi(optarg));
+            break;
+        case 'e':
+            encodings = optarg;
+            break;
+        case 'k':
+            samples = (uint32_t)std::clamp(atoi(optarg), 1, COLLECTOR_READINGS_MAX);
+            break;
+        case 'q':
+            qos = atoi(optarg) ? 1 : 0;
+            break;
+        case 'c':
+            chunk_bytes = std::clamp<size_t>(strtoull(optarg, nullptr, 10), 64, BENCH_RX_BUFFER / 2);
+            break;
+        case 'o':
+            out_dir = optarg;
+            break;
+        case 'm':
+            min_rate = atof(optarg);
+            break;
+        case 'r':
+            record = optarg;
+            break;
+        case 'z':
+            compression = true;
+            break;
+        default:
+            fprintf(stderr,
+                    "usage: %s [-n messages] [-d devices] [-e text,json,bin,batch,packed] [-k batch_samples] "
+                    "[-q 0|1] [-c chunk_bytes] [-o out_dir] [-m min_msgs_per_s] [-z]\n       %s -r record_file "
+                    "[-o out_dir] [-m min_msgs_per_s] [-k batch_samples] [-z]\n",
+                    argv[0], argv[0]);
+            return 2;
+        }
+    }
+
+    Stream s;
+    if (record)
+    {
+        if (!load_record(record, s))
+            return 1;
+    }
+    else
+    {
+        std::vector<std::string> encs;
+        for (size_t pos = 0; pos <= encodings.size();)
+        {
+            size_t comma = std::min(encodings.find(',', pos), encodings.size());
+            std::string e = encodings.substr(pos, comma - pos);
+            if (e != "text" && e != "json" && e != "bin" && e != "batch" && e != "packed")
+            {
+                fprintf(stderr, "unknown encoding '%s'\n", e.c_str());
+                return 2;
+            }
+            encs.push_back(e);
+            pos = comma + 1;
+        }
+        s = make_stream(devices, encs, samples, qos, chunk_bytes);
+    }
+    if (s.messages == 0)
+    {
+        fprintf(stderr, "no messages to feed\n");
+        return 1;
+    }
+    // 記録の再生は 1 回だけ、合成した列は -n に届くまで繰り返す
+    uint64_t rounds = record ? 1 : std::max<uint64_t>(1, (messages + s.messages - 1) / s.messages);
+
+    bool temp_dir = out_dir.empty();
+    if (temp_dir)
+    {
+        char tmpl[] = "/tmp/collector_bench.XXXXXX";
+        if (!mkdtemp(tmpl))
+        {
+            perror("mkdtemp");
+            return 1;
+        }
+        out_dir = tmpl;
+    }
+
+    TopicTemplate topics;
+    topics.parse(BENCH_TOPIC_TEMPLATE);
+    std::vector<uint8_t> rx(BENCH_RX_BUFFER);
+    // 1 周ぶん時刻をずらす（同じ行が同じ時刻に重ならないように）
+    int64_t round_us = s.chunks.back().rx_us - s.chunks.front().rx_us + 1000;
+
+    // 解析だけ（列ファイルに書かない）
+    uint64_t parsed = 0, parsed_rows = 0;
+    Reading readings[COLLECTOR_READINGS_MAX];
+    double t0 = now_s();
+    for (uint64_t r = 0; r < rounds; r++)
+    {
+        feed(s, rx.data(), 0, [&](const uint8_t *buf, size_t len, int64_t) {
+            return mqtt_split(buf, len, [&](uint8_t hdr, const uint8_t *body, size_t n) {
+                MqttPublish m;
+                std::string_view board, sensor;
+                PayloadKind kind;
+                if (mqtt_parse_publish(hdr, body, n, m) && topics.match(m.topic, board, sensor))
+                {
+                    parsed_rows += parse_payload(sensor, m.payload, m.len, readings, COLLECTOR_READINGS_MAX, kind);
+                    parsed += board_id_value(board) != 0;
+                }
+            });
+        });
+    }
+    double parse_s = now_s() - t0;
+
+    // 取り込み全体
+    ColumnStore store(out_dir);
+    Ingest ingest(topics, store);
+    t0 = now_s();
+    for (uint64_t r = 0; r < rounds; r++)
+    {
+        if (!feed(s, rx.data(), (int64_t)r * round_us,
+                  [&](const uint8_t *buf, size_t len, int64_t rx_us) { return ingest.on_stream(buf, len, rx_us, nullptr); }))
+        {
+            fprintf(stderr, "broken MQTT stream\n");
+            return 1;
+        }
+    }
+    double ingest_s = now_s() - t0;
+    std::string path = store.path();
+    if (ingest.stats().store_errors)
+        fprintf(stderr, "store: %s\n", store.error().c_str());
+    store.close();
+
+    const IngestStats &st = ingest.stats();
+    double rate = (double)st.messages / ingest_s;
+    printf("collector_bench: %s, %llu messages (%llu bytes), %u devices, chunk %zu B\n",
+           record ? record : encodings.c_str(), (unsigned long long)st.messages, (unsigned long long)st.bytes,
+           record ? 0 : devices, chunk_bytes);
+    printf("  kinds: text=%llu json=%llu bin=%llu batch=%llu packed=%llu invalid=%llu unmatched=%llu store_err=%llu\n",
+           (unsigned long long)st.by_kind[(int)PayloadKind::Text], (unsigned long long)st.by_kind[(int)PayloadKind::Json],
+           (unsigned long long)st.by_kind[(int)PayloadKind::Bin], (unsigned long long)st.by_kind[(int)PayloadKind::Batch],
+           (unsigned long long)st.by_kind[(int)PayloadKind::Packed], (unsigned long long)st.invalid,
+           (unsigned long long)st.unmatched, (unsigned long long)st.store_errors);
+    printf("  parse only: %.0f msgs/s, %.0f rows/s, %.1f ns/msg\n", (double)parsed / parse_s,
+           (double)parsed_rows / parse_s, parse_s * 1e9 / (double)std::max<uint64_t>(parsed, 1));
+    printf("  ingest    : %.0f msgs/s, %.0f rows/s, %.1f ns/msg, %.1f MB/s -> %s (%llu rows)\n", rate,
+           (double)st.rows / ingest_s, ingest_s * 1e9 / (double)std::max<uint64_t>(st.messages, 1),
+           (double)st.bytes / ingest_s / 1e6, path.c_str(), (unsigned long long)st.rows);
+
+    if (temp_dir)
+    {
+        unlink(path.c_str());
+        rmdir(out_dir.c_str());
+    }
+    int status = 0;
+    if (min_rate > 0 && rate < min_rate)
+    {
+        printf("  FAIL: below %.0f msgs/s\n", min_rate);
+        status = 1;
+    }
+    if (compression && !report_compression(collect_series(s, topics, rx.data()), samples))
+    {
+        printf("  FAIL: packed batches do not round-trip\n");
+        status = 1;
+    }
+    return status;
+}
@@ -0,0 +1,213 @@
+#include "column_store.h"
+
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace collector
+{
+
+static const ColumnDesc COLUMNS[] = {
+    {"ts_us", 8, 0}, {"device", 8, 8}, {"temp_centi", 2, 16}, {"hum_centi", 2, 18}, {"flags", 1, 20},
+};
+static constexpr uint32_t ROW_BYTES = 21;
+static constexpr uint64_t GROW_MAX_BLOCKS = 64; // 倍々で広げるが、一度に増やすのはここまで
+
+static_assert(sizeof(ColumnFileHeader) <= COLUMN_HEADER_SIZE, "header must fit");
+
+ColumnStore::ColumnStore(std::string dir, uint32_t block_rows)
+    : dir_(std::move(dir)), block_rows_(block_rows), block_bytes_((uint64_t)block_rows * ROW_BYTES)
+{
+}
+
+ColumnStore::~ColumnStore()
+{
+    close();
+}
+
+void ColumnStore::close()
+{
+    if (base_)
+    {
+        msync(base_, mapped_, MS_ASYNC);
+        munmap(base_, mapped_);
+        base_ = nullptr;
+    }
+    if (fd_ >= 0)
+    {
+        // 未使用の末尾ブロックは残す（次に開いたときそのまま使う）
+        ::close(fd_);
+        fd_ = -1;
+    }
+    day_ = INT64_MIN;
+    rows_ = cap_rows_ = 0;
+    mapped_ = 0;
+}
+
+void ColumnStore::sync()
+{
+    if (base_)
+        msync(base_, mapped_, MS_ASYNC);
+}
+
+bool ColumnStore::map(uint64_t blocks)
+{
+    size_t size = COLUMN_HEADER_SIZE + blocks * block_bytes_;
+    // 疎なファイルだと書き込みのページフォルトごとにブロックを割り当てるので、先に確保しておく
+    int err = posix_fallocate(fd_, 0, (off_t)size);
+    if (err != 0)
+    {
+        error_ = path_ + ": fallocate: " + strerror(err);
+        return false;
+    }
+    void *p = base_ ? mremap(base_, mapped_, size, MREMAP_MAYMOVE)
+                    : mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (p == MAP_FAILED)
+    {
+        error_ = path_ + ": mmap: " + strerror(errno);
+        return false;
+    }
+#ifdef MADV_POPULATE_WRITE
+    // 書き込みのページフォルトを 1 ページずつ起こさず、広げた範囲をまとめて用意する（古いカーネルでは何もしない）
+    madvise(static_cast<uint8_t *>(p) + mapped_, size - mapped_, MADV_POPULATE_WRITE);
+#endif
+    base_ = static_cast<uint8_t *>(p);
+    mapped_ = size;
+    cap_rows_ = blocks * block_rows_;
+    return true;
+}
+
+bool ColumnStore::grow()
+{
+    uint64_t blocks = cap_rows_ / block_rows_;
+    uint64_t add = blocks < GROW_MAX_BLOCKS ? (blocks ? blocks : 1) : GROW_MAX_BLOCKS;
+    return map(blocks + add);
+}
+
+bool ColumnStore::open_day(int64_t day)
+{
+    close();
+    if (day < 0)
+    {
+        error_ = "timestamp before 1970";
+        return false;
+    }
+    time_t t = (time_t)(day * 86400);
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    uint32_t ymd = (uint32_t)((tm.tm_year + 1900) * 10000 + (tm.tm_mon + 1) * 100 + tm.tm_mday);
+    path_ = dir_ + "/mqcensor-" + std::to_string(ymd) + ".col";
+
+    if (mkdir(dir_.c_str(), 0755) != 0 && errno != EEXIST)
+    {
+        error_ = dir_ + ": " + strerror(errno);
+        return false;
+    }
+    fd_ = ::open(path_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd_ < 0)
+    {
+        error_ = path_ + ": " + strerror(errno);
+        return false;
+    }
+    struct stat st;
+    fstat(fd_, &st);
+    if (st.st_size == 0)
+    {
+        if (!map(1))
+            return false;
+        ColumnFileHeader *h = header();
+        memcpy(h->magic, COLUMN_MAGIC, sizeof(h->magic));
+        h->header_size = COLUMN_HEADER_SIZE;
+        h->block_rows = block_rows_;
+        h->day = ymd;
+        h->column_count = sizeof(COLUMNS) / sizeof(COLUMNS[0]);
+        for (uint32_t c = 0; c < h->column_count; c++)
+        {
+            h->columns[c] = COLUMNS[c];
+            h->columns[c].offset *= block_rows_;
+        }
+        h->rows = 0;
+    }
+    else
+    {
+        // 再起動後は続きから書く
+        ColumnFileHeader h;
+        if (pread(fd_, &h, sizeof(h), 0) != (ssize_t)sizeof(h) || memcmp(h.magic, COLUMN_MAGIC, sizeof(h.magic)) != 0 ||
+            h.block_rows != block_rows_ || st.st_size < COLUMN_HEADER_SIZE)
+        {
+            error_ = path_ + ": not a column file with " + std::to_string(block_rows_) + "-row blocks";
+            ::close(fd_);
+            fd_ = -1;
+            return false;
+        }
+        uint64_t blocks = ((uint64_t)st.st_size - COLUMN_HEADER_SIZE) / block_bytes_;
+        if (!map(blocks ? blocks : 1))
+            return false;
+        rows_ = header()->rows < cap_rows_ ? header()->rows : cap_rows_;
+    }
+    day_ = day;
+    return true;
+}
+
+ColumnReader::~ColumnReader()
+{
+    if (base_)
+        munmap(const_cast<uint8_t *>(base_), size_);
+}
+
+bool ColumnReader::open(const std::string &path, std::string &error)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        error = path + ": " + strerror(errno);
+        return false;
+    }
+    struct stat st;
+    fstat(fd, &st);
+    if (st.st_size < COLUMN_HEADER_SIZE)
+    {
+        ::close(fd);
+        error = path + ": too short";
+        return false;
+    }
+    void *p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED)
+    {
+        error = path + ": mmap: " + strerror(errno);
+        return false;
+    }
+    base_ = static_cast<const uint8_t *>(p);
+    size_ = (size_t)st.st_size;
+    header_ = reinterpret_cast<const ColumnFileHeader *>(base_);
+    if (memcmp(header_->magic, COLUMN_MAGIC, sizeof(header_->magic)) != 0 || header_->block_rows == 0)
+    {
+        error = path + ": bad magic";
+        return false;
+    }
+    block_bytes_ = (uint64_t)header_->block_rows * ROW_BYTES;
+    uint64_t cap = (size_ - COLUMN_HEADER_SIZE) / block_bytes_ * header_->block_rows;
+    rows_ = header_->rows < cap ? header_->rows : cap;
+    return true;
+}
+
+Row ColumnReader::row(uint64_t i) const
+{
+    uint64_t n = header_->block_rows;
+    const uint8_t *blk = base_ + COLUMN_HEADER_SIZE + i / n * block_bytes_;
+    i %= n;
+    Row r;
+    r.ts_us = reinterpret_cast<const int64_t *>(blk)[i];
+    r.device = reinterpret_cast<const uint64_t *>(blk + 8 * n)[i];
+    r.temp_centi = reinterpret_cast<const int16_t *>(blk + 16 * n)[i];
+    r.hum_centi = reinterpret_cast<const int16_t *>(blk + 18 * n)[i];
+    r.flags = (blk + 20 * n)[i];
+    return r;
+}
+
+} // namespace collector
@@ -0,0 +1,121 @@
+#pragma once
+// 受信した計測値を 1 日 1 ファイルの列指向ファイルに追記する（mmap、UTC の日付で切り替え）
+//
+//   <dir>/mqcensor-YYYYMMDD.col
+//     ヘッダ（COLUMN_HEADER_SIZE）: magic, ブロックの行数, 列の並び, 書き終えた行数
+//     ブロック × n: BLOCK_ROWS 行ずつ、中は列ごとに連続
+//       ts_us[N] int64 | device[N] uint64 | temp_centi[N] int16 | hum_centi[N] int16 | flags[N] uint8
+//
+// 行数はヘッダに 1 行ごとに書くので、落ちても書き終えた行までは読める。ブロック単位なので
+// 1 列だけ読むときも連続領域をなめるだけで済む
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace collector
+{
+
+#define COLUMN_HEADER_SIZE 4096
+#define COLUMN_BLOCK_ROWS 65536 // 1 ブロック 21 B/行 × 65536 = 1.3 MiB（ページ境界に揃う）
+#define COLUMN_MAGIC "MQCOL01"
+
+struct ColumnDesc
+{
+    char name[16];
+    uint32_t elem_size;
+    uint32_t offset; // ブロック先頭から（要素数 × それまでの列の幅）
+};
+
+struct ColumnFileHeader
+{
+    char magic[8];
+    uint32_t header_size;
+    uint32_t block_rows;
+    uint32_t day; // YYYYMMDD（UTC）
+    uint32_t column_count;
+    uint64_t rows;
+    ColumnDesc columns[5];
+};
+
+// flags 列: 下位 4 ビットは Reading の flags、上位 4 ビットはペイロードの種類（PayloadKind）
+struct Row
+{
+    int64_t ts_us; // UNIX 時刻 [us]（受信時刻、バッチは各サンプルの推定時刻）
+    uint64_t device;
+    int16_t temp_centi;
+    int16_t hum_centi;
+    uint8_t flags;
+};
+
+class ColumnStore
+{
+public:
+    explicit ColumnStore(std::string dir, uint32_t block_rows = COLUMN_BLOCK_ROWS);
+    ~ColumnStore();
+    ColumnStore(const ColumnStore &) = delete;
+    ColumnStore &operator=(const ColumnStore &) = delete;
+
+    // 失敗（ファイルが作れない・広げられない）は false。理由は error()
+    bool append(const Row &r)
+    {
+        int64_t day = r.ts_us >= 0 ? r.ts_us / 86400000000ll : -1;
+        if (day != day_ && !open_day(day))
+            return false;
+        if (rows_ == cap_rows_ && !grow())
+            return false;
+        uint64_t b = rows_ / block_rows_, i = rows_ % block_rows_;
+        uint8_t *blk = base_ + COLUMN_HEADER_SIZE + b * block_bytes_;
+        reinterpret_cast<int64_t *>(blk)[i] = r.ts_us;
+        reinterpret_cast<uint64_t *>(blk + 8ull * block_rows_)[i] = r.device;
+        reinterpret_cast<int16_t *>(blk + 16ull * block_rows_)[i] = r.temp_centi;
+        reinterpret_cast<int16_t *>(blk + 18ull * block_rows_)[i] = r.hum_centi;
+        (blk + 20ull * block_rows_)[i] = r.flags;
+        header()->rows = ++rows_;
+        return true;
+    }
+    // ページキャッシュからの書き出しを促す（待たない）
+    void sync();
+    void close();
+
+    uint64_t rows() const { return rows_; }
+    const std::string &path() const { return path_; }
+    const std::string &error() const { return error_; }
+
+private:
+    ColumnFileHeader *header() { return reinterpret_cast<ColumnFileHeader *>(base_); }
+    bool open_day(int64_t day);
+    bool map(uint64_t blocks);
+    bool grow();
+
+    std::string dir_;
+    std::string path_;
+    std::string error_;
+    uint32_t block_rows_;
+    uint64_t block_bytes_;
+    int fd_ = -1;
+    int64_t day_ = INT64_MIN;
+    uint8_t *base_ = nullptr;
+    size_t mapped_ = 0;
+    uint64_t rows_ = 0;
+    uint64_t cap_rows_ = 0;
+};
+
+// 読み出し（ダンプと検証用）
+class ColumnReader
+{
+public:
+    ~ColumnReader();
+    bool open(const std::string &path, std::string &error);
+    uint64_t rows() const { return rows_; }
+    uint32_t day() const { return header_->day; }
+    Row row(uint64_t i) const;
+
+private:
+    const ColumnFileHeader *header_ = nullptr;
+    const uint8_t *base_ = nullptr;
+    size_t size_ = 0;
+    uint64_t rows_ = 0;
+    uint64_t block_bytes_ = 0;
+};
+
+} // namespace collector
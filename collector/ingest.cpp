@@ -0,0 +1,81 @@
+#include "ingest.h"
+
+namespace collector
+{
+
+bool Ingest::is_duplicate(uint64_t device, uint32_t seq)
+{
+    SeqWindow &w = seq_windows_[device];
+    uint32_t behind = w.latest - seq;
+    if (w.seen && seq <= w.latest && behind < 32)
+    {
+        if (w.seen & (1u << behind))
+            return true;
+        w.seen |= 1u << behind;
+        return false;
+    }
+    // 新しい番号、またはウィンドウより大きく戻った（再起動して 1 から振り直した）
+    uint32_t ahead = seq - w.latest;
+    w.seen = w.seen && seq > w.latest && ahead < 32 ? (w.seen << ahead) | 1 : 1;
+    w.latest = seq;
+    return false;
+}
+
+void Ingest::on_publish(const MqttPublish &m, int64_t rx_us)
+{
+    stats_.messages++;
+    stats_.bytes += m.len;
+    std::string_view board, sensor;
+    if (!topics_.match(m.topic, board, sensor))
+    {
+        stats_.unmatched++;
+        return;
+    }
+    PayloadKind kind;
+    size_t n = parse_payload(sensor, m.payload, m.len, readings_, COLLECTOR_READINGS_MAX, kind);
+    stats_.by_kind[(int)kind]++;
+    if (n == 0)
+    {
+        stats_.invalid++;
+        return;
+    }
+    Row row;
+    row.device = board_id_value(board);
+    size_t stored = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        const Reading &r = readings_[i];
+        if (r.seq && is_duplicate(row.device, r.seq))
+        {
+            stats_.duplicates++;
+            continue;
+        }
+        row.ts_us = rx_us + (int64_t)r.offset_ms * 1000;
+        row.temp_centi = r.temp_centi;
+        row.hum_centi = r.hum_centi;
+        row.flags = (uint8_t)(r.flags | (uint8_t)kind << 4);
+        if (!store_.append(row))
+        {
+            stats_.store_errors++;
+            return;
+        }
+        if (r.flags & READING_FAILED)
+            stats_.failed_readings++;
+        stored++;
+    }
+    stats_.rows += stored;
+}
+
+size_t Ingest::on_stream(const uint8_t *buf, size_t len, int64_t rx_us, MqttSubscriber *sub)
+{
+    return mqtt_split(buf, len, [&](uint8_t hdr, const uint8_t *body, size_t n) {
+        MqttPublish m;
+        if (!mqtt_parse_publish(hdr, body, n, m))
+            return; // PINGRESP など
+        on_publish(m, rx_us);
+        if (m.qos && sub)
+            sub->queue_puback(m.packet_id);
+    });
+}
+
+} // namespace collector
@@ -0,0 +1,59 @@
+#pragma once
+// 受信ストリーム → MQTT パケット → トピック分解 → ペイロード解析 → 列ファイル。
+// 1 メッセージあたりのヒープ確保はゼロ（string_view と固定長の Reading 配列だけ）
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include "column_store.h"
+#include "mqtt_stream.h"
+#include "payload.h"
+#include "topic.h"
+
+namespace collector
+{
+
+struct IngestStats
+{
+    uint64_t messages = 0;
+    uint64_t rows = 0;
+    uint64_t failed_readings = 0; // センサー失敗として記録した行
+    uint64_t duplicates = 0;      // 再送で 2 度目に届いた計測値（記録しない）
+    uint64_t invalid = 0;         // 読めなかったペイロード
+    uint64_t unmatched = 0;       // テンプレートに合わないトピック
+    uint64_t store_errors = 0;
+    uint64_t bytes = 0;
+    uint64_t by_kind[(int)PayloadKind::Invalid + 1] = {};
+};
+
+class Ingest
+{
+public:
+    Ingest(const TopicTemplate &topics, ColumnStore &store) : topics_(topics), store_(store) {}
+
+    // PUBLISH 1 つ分。rx_us は受信時刻（UNIX 時刻 [us]）
+    void on_publish(const MqttPublish &m, int64_t rx_us);
+    // 受信バッファを先頭から処理し、消費したバイト数を返す（ストリームが壊れていたら SIZE_MAX）。
+    // QoS1 の PUBACK は sub に積む（nullptr なら返さない）
+    size_t on_stream(const uint8_t *buf, size_t len, int64_t rx_us, MqttSubscriber *sub);
+
+    const IngestStats &stats() const { return stats_; }
+
+private:
+    // 機器ごとに最近見た通し番号（latest から 32 個ぶんのビット）。再送は outbox（MQTT_OUTBOX_LEN = 16）の
+    // 範囲でしか起きないので 32 あれば足りる。大きく戻ったら再起動とみなしてやり直す（32 個も送らずに
+    // 再起動した機器の最初の数個は重複と見分けられず落ちる）
+    struct SeqWindow
+    {
+        uint32_t latest = 0;
+        uint32_t seen = 0; // bit i = latest - i を見た
+    };
+    bool is_duplicate(uint64_t device, uint32_t seq);
+
+    const TopicTemplate &topics_;
+    ColumnStore &store_;
+    IngestStats stats_;
+    Reading readings_[COLLECTOR_READINGS_MAX];
+    std::unordered_map<uint64_t, SeqWindow> seq_windows_; // 機器が増えたときだけ確保する
+};
+
+} // namespace collector
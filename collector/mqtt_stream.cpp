@@ -0,0 +1,292 @@
+#include "mqtt_stream.h"
+
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace collector
+{
+
+bool mqtt_parse_publish(uint8_t hdr, const uint8_t *body, size_t len, MqttPublish &out)
+{
+    if ((hdr >> 4) != 3 || len < 2)
+        return false;
+    size_t tlen = (size_t)body[0] << 8 | body[1];
+    size_t pos = 2 + tlen;
+    out.qos = (hdr >> 1) & 3;
+    if (pos > len)
+        return false;
+    out.topic = std::string_view(reinterpret_cast<const char *>(body + 2), tlen);
+    out.packet_id = 0;
+    if (out.qos)
+    {
+        if (pos + 2 > len)
+            return false;
+        out.packet_id = (uint16_t)(body[pos] << 8 | body[pos + 1]);
+        pos += 2;
+    }
+    out.payload = body + pos;
+    out.len = len - pos;
+    return true;
+}
+
+static int64_t monotonic_ms()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void put_u16(std::vector<uint8_t> &v, uint16_t x)
+{
+    v.push_back((uint8_t)(x >> 8));
+    v.push_back((uint8_t)x);
+}
+
+static void put_str(std::vector<uint8_t> &v, std::string_view s)
+{
+    put_u16(v, (uint16_t)s.size());
+    v.insert(v.end(), s.begin(), s.end());
+}
+
+MqttSubscriber::~MqttSubscriber()
+{
+    close();
+}
+
+void MqttSubscriber::close()
+{
+    if (fd_ < 0)
+        return;
+    static const uint8_t disconnect[] = {0xE0, 0x00};
+    send_all(disconnect, sizeof(disconnect));
+    ::close(fd_);
+    fd_ = -1;
+    tx_.clear();
+    pending_.clear();
+}
+
+bool MqttSubscriber::send_all(const uint8_t *p, size_t n)
+{
+    while (n)
+    {
+        ssize_t w = ::send(fd_, p, n, MSG_NOSIGNAL);
+        if (w < 0 && errno == EINTR)
+            continue;
+        if (w <= 0)
+        {
+            error_ = std::string("send: ") + strerror(errno);
+            return false;
+        }
+        p += w;
+        n -= (size_t)w;
+    }
+    last_tx_ms_ = monotonic_ms();
+    return true;
+}
+
+bool MqttSubscriber::send_packet(uint8_t hdr, const uint8_t *body, size_t n)
+{
+    uint8_t head[5] = {hdr};
+    size_t h = 1;
+    size_t rl = n;
+    do
+    {
+        uint8_t b = rl % 128;
+        rl /= 128;
+        head[h++] = (uint8_t)(b | (rl ? 0x80 : 0));
+    } while (rl);
+    return send_all(head, h) && (n == 0 || send_all(body, n));
+}
+
+// 接続手順の間だけ使う（ストリーム受信は read_some + mqtt_split）。
+// SUBACK と同じ読み出しで届いた保持メッセージなどは pending_ に残り、次の read_some が先に返す
+bool MqttSubscriber::read_packet(uint8_t &hdr, std::vector<uint8_t> &body, int timeout_ms)
+{
+    uint8_t tmp[512];
+    int64_t deadline = monotonic_ms() + timeout_ms;
+    while (true)
+    {
+        bool got = false;
+        size_t used = 0;
+        mqtt_split(pending_.data(), pending_.size(), [&](uint8_t h, const uint8_t *b, size_t n) {
+            if (got)
+                return;
+            hdr = h;
+            body.assign(b, b + n);
+            used = (size_t)(b + n - pending_.data());
+            got = true;
+        });
+        if (got)
+        {
+            pending_.erase(pending_.begin(), pending_.begin() + (long)used);
+            return true;
+        }
+        int left = (int)(deadline - monotonic_ms());
+        if (left <= 0)
+        {
+            error_ = "timeout waiting for the broker";
+            return false;
+        }
+        long n = read_socket(tmp, sizeof(tmp), left);
+        if (n < 0)
+            return false;
+        pending_.insert(pending_.end(), tmp, tmp + n);
+    }
+}
+
+bool MqttSubscriber::connect(const std::string &host, uint16_t port, const std::string &client_id,
+                             const std::vector<std::string> &filters, uint8_t qos, uint16_t keep_alive_s)
+{
+    close();
+    error_.clear();
+    keep_alive_s_ = keep_alive_s;
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *res = nullptr;
+    std::string port_str = std::to_string(port);
+    if (int rc = getaddrinfo(host.c_str(), port_str.c_str(), &hints, &res); rc != 0)
+    {
+        error_ = std::string("resolve: ") + gai_strerror(rc);
+        return false;
+    }
+    for (addrinfo *ai = res; ai; ai = ai->ai_next)
+    {
+        fd_ = ::socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd_ < 0)
+            continue;
+        if (::connect(fd_, ai->ai_addr, ai->ai_addrlen) == 0)
+            break;
+        ::close(fd_);
+        fd_ = -1;
+    }
+    freeaddrinfo(res);
+    if (fd_ < 0)
+    {
+        error_ = std::string("connect: ") + strerror(errno);
+        return false;
+    }
+    int one = 1;
+    setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    // 受信が追いつかない瞬間をカーネル側で吸収する
+    int rcvbuf = 4 << 20;
+    setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    std::vector<uint8_t> body;
+    put_str(body, "MQTT");
+    body.push_back(4);    // 3.1.1
+    body.push_back(0x02); // clean session
+    put_u16(body, keep_alive_s);
+    put_str(body, client_id);
+    uint8_t hdr;
+    std::vector<uint8_t> resp;
+    if (!send_packet(0x10, body.data(), body.size()) || !read_packet(hdr, resp, 5000))
+    {
+        close();
+        return false;
+    }
+    if ((hdr >> 4) != 2 || resp.size() < 2 || resp[1] != 0)
+    {
+        error_ = "CONNACK refused";
+        close();
+        return false;
+    }
+
+    body.clear();
+    put_u16(body, 1);
+    for (const std::string &f : filters)
+    {
+        put_str(body, f);
+        body.push_back(qos);
+    }
+    if (!send_packet(0x82, body.data(), body.size()) || !read_packet(hdr, resp, 5000))
+    {
+        close();
+        return false;
+    }
+    if ((hdr >> 4) != 9)
+    {
+        error_ = "no SUBACK";
+        close();
+        return false;
+    }
+    for (size_t i = 2; i < resp.size(); i++)
+    {
+        if (resp[i] == 0x80)
+        {
+            error_ = "subscription refused: " + filters[i - 2];
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+long MqttSubscriber::read_some(uint8_t *buf, size_t cap, int timeout_ms)
+{
+    if (!pending_.empty())
+    {
+        size_t n = pending_.size() < cap ? pending_.size() : cap;
+        memcpy(buf, pending_.data(), n);
+        pending_.erase(pending_.begin(), pending_.begin() + (long)n);
+        return (long)n;
+    }
+    return read_socket(buf, cap, timeout_ms);
+}
+
+long MqttSubscriber::read_socket(uint8_t *buf, size_t cap, int timeout_ms)
+{
+    if (fd_ < 0)
+        return -1;
+    pollfd pfd{fd_, POLLIN, 0};
+    int pr = poll(&pfd, 1, timeout_ms);
+    if (pr == 0 || (pr < 0 && errno == EINTR))
+        return 0;
+    ssize_t n = ::recv(fd_, buf, cap, 0);
+    if (n < 0 && (errno == EINTR || errno == EAGAIN))
+        return 0;
+    if (n <= 0)
+    {
+        error_ = n == 0 ? "broker closed the connection" : std::string("recv: ") + strerror(errno);
+        ::close(fd_);
+        fd_ = -1;
+        return -1;
+    }
+    return (long)n;
+}
+
+void MqttSubscriber::queue_puback(uint16_t packet_id)
+{
+    uint8_t ack[4] = {0x40, 0x02, (uint8_t)(packet_id >> 8), (uint8_t)packet_id};
+    tx_.insert(tx_.end(), ack, ack + sizeof(ack));
+}
+
+bool MqttSubscriber::flush(int64_t now_ms)
+{
+    if (fd_ < 0)
+        return false;
+    if (!tx_.empty())
+    {
+        bool ok = send_all(tx_.data(), tx_.size());
+        tx_.clear();
+        if (!ok)
+            return false;
+    }
+    // keep_alive の半分を過ぎて何も送っていなければ PINGREQ
+    if (now_ms - last_tx_ms_ > keep_alive_s_ * 500)
+    {
+        static const uint8_t ping[] = {0xC0, 0x00};
+        return send_all(ping, sizeof(ping));
+    }
+    return true;
+}
+
+} // namespace collector
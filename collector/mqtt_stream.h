@@ -0,0 +1,92 @@
+#pragma once
+// MQTT 3.1.1 の受信側。ソケットから読んだバッファの上でパケットを切り出し、トピックもペイロードも
+// コピーせずに指す（バッファを次に読み足すまで有効）
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace collector
+{
+
+struct MqttPublish
+{
+    std::string_view topic;
+    const uint8_t *payload;
+    size_t len;
+    uint8_t qos;
+    uint16_t packet_id;
+};
+
+// buf[0..len) から完全なパケットを順に取り出す。残り（途中で切れたパケット）の先頭位置を返す
+// on_packet(uint8_t hdr, const uint8_t *body, size_t body_len)
+template <typename F>
+size_t mqtt_split(const uint8_t *buf, size_t len, F &&on_packet)
+{
+    size_t pos = 0;
+    while (pos + 2 <= len)
+    {
+        size_t body_len = 0;
+        size_t i = pos + 1;
+        int shift = 0;
+        while (true)
+        {
+            if (i >= len)
+                return pos;
+            uint8_t b = buf[i++];
+            body_len |= (size_t)(b & 0x7F) << shift;
+            if (!(b & 0x80))
+                break;
+            shift += 7;
+            if (shift > 21)
+                return SIZE_MAX; // 壊れたストリーム
+        }
+        if (len - i < body_len)
+            return pos;
+        on_packet(buf[pos], buf + i, body_len);
+        pos = i + body_len;
+    }
+    return pos;
+}
+
+// PUBLISH の本体を分解する。形がおかしければ false
+bool mqtt_parse_publish(uint8_t hdr, const uint8_t *body, size_t len, MqttPublish &out);
+
+// ブローカーへの購読接続。受信は呼び出し側のバッファに読み、QoS1 の PUBACK はまとめて返す
+class MqttSubscriber
+{
+public:
+    MqttSubscriber() = default;
+    ~MqttSubscriber();
+    MqttSubscriber(const MqttSubscriber &) = delete;
+    MqttSubscriber &operator=(const MqttSubscriber &) = delete;
+
+    // 接続して CONNACK・SUBACK まで待つ。失敗したら理由を error() に入れて false
+    bool connect(const std::string &host, uint16_t port, const std::string &client_id,
+                 const std::vector<std::string> &filters, uint8_t qos, uint16_t keep_alive_s);
+    void close();
+    bool connected() const { return fd_ >= 0; }
+    const std::string &error() const { return error_; }
+
+    // 最大 cap バイト読む（timeout_ms 待って何も来なければ 0、切断なら -1）
+    long read_some(uint8_t *buf, size_t cap, int timeout_ms);
+    void queue_puback(uint16_t packet_id);
+    // 溜めた PUBACK と、必要なら PINGREQ を送る
+    bool flush(int64_t now_ms);
+
+private:
+    bool send_all(const uint8_t *p, size_t n);
+    bool send_packet(uint8_t hdr, const uint8_t *body, size_t n);
+    bool read_packet(uint8_t &hdr, std::vector<uint8_t> &body, int timeout_ms);
+    long read_socket(uint8_t *buf, size_t cap, int timeout_ms);
+
+    int fd_ = -1;
+    uint16_t keep_alive_s_ = 60;
+    int64_t last_tx_ms_ = 0;
+    std::vector<uint8_t> tx_;
+    std::vector<uint8_t> pending_;
+    std::string error_;
+};
+
+} // namespace collector
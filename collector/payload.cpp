@@ -0,0 +1,421 @@
+#include "payload.h"
+
+#include <cstring>
+
+namespace collector
+{
+
+const char *payload_kind_name(PayloadKind kind)
+{
+    switch (kind)
+    {
+    case PayloadKind::Text:
+        return "text";
+    case PayloadKind::Json:
+        return "json";
+    case PayloadKind::Bin:
+        return "bin";
+    case PayloadKind::Batch:
+        return "batch";
+    case PayloadKind::Packed:
+        return "packed";
+    default:
+        return "invalid";
+    }
+}
+
+namespace
+{
+
+// 失敗時の値（AHT20 ドライバの FAILRESULT = -100）以下は失敗扱い
+constexpr int FAILED_CENTI = -10000;
+
+struct Cursor
+{
+    const char *p;
+    const char *end;
+
+    bool eat(char c)
+    {
+        if (p < end && *p == c)
+        {
+            p++;
+            return true;
+        }
+        return false;
+    }
+    bool eat(const char *lit, size_t n)
+    {
+        if ((size_t)(end - p) < n || memcmp(p, lit, n) != 0)
+            return false;
+        p += n;
+        return true;
+    }
+    template <size_t N>
+    bool eat_lit(const char (&lit)[N])
+    {
+        return eat(lit, N - 1);
+    }
+    void skip_ws()
+    {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+            p++;
+    }
+    bool done() const { return p >= end; }
+};
+
+// "-12.34" → -1234。小数 3 桁目以降は切り捨て
+bool parse_centi(Cursor &c, int32_t &out)
+{
+    bool neg = c.eat('-');
+    if (c.done() || *c.p < '0' || *c.p > '9')
+        return false;
+    int32_t v = 0;
+    while (!c.done() && *c.p >= '0' && *c.p <= '9')
+    {
+        v = v * 10 + (*c.p++ - '0');
+        if (v > 1000000)
+            return false;
+    }
+    int32_t frac = 0, scale = 100;
+    if (c.eat('.'))
+    {
+        while (!c.done() && *c.p >= '0' && *c.p <= '9')
+        {
+            if (scale > 1)
+            {
+                scale /= 10;
+                frac += (*c.p - '0') * scale;
+            }
+            c.p++;
+        }
+    }
+    v = v * 100 + frac;
+    out = neg ? -v : v;
+    return true;
+}
+
+bool parse_int(Cursor &c, int64_t &out)
+{
+    bool neg = c.eat('-');
+    if (c.done() || *c.p < '0' || *c.p > '9')
+        return false;
+    int64_t v = 0;
+    while (!c.done() && *c.p >= '0' && *c.p <= '9')
+    {
+        v = v * 10 + (*c.p++ - '0');
+        if (v > INT32_MAX)
+            return false;
+    }
+    out = neg ? -v : v;
+    return true;
+}
+
+bool set_reading(Reading &r, int32_t temp, int32_t hum)
+{
+    r.offset_ms = 0;
+    r.seq = 0;
+    if (temp <= FAILED_CENTI || hum < 0)
+    {
+        r.temp_centi = 0;
+        r.hum_centi = 0;
+        r.flags = READING_FAILED;
+        return true;
+    }
+    if (temp > INT16_MAX || hum > INT16_MAX)
+        return false;
+    r.temp_centi = (int16_t)temp;
+    r.hum_centi = (int16_t)hum;
+    r.flags = 0;
+    return true;
+}
+
+// "Temp=23.4°C Hum=45.6%" / "failed"、末尾に " seq=N" があってもよい。';' 区切り
+size_t parse_text(Cursor c, Reading *out, size_t cap)
+{
+    size_t n = 0;
+    while (n < cap)
+    {
+        if (c.eat_lit("failed"))
+        {
+            set_reading(out[n], FAILED_CENTI, -1);
+        }
+        else
+        {
+            int32_t t, h;
+            if (!c.eat_lit("Temp=") || !parse_centi(c, t) || !c.eat_lit("\xC2\xB0" "C Hum=") || !parse_centi(c, h) ||
+                !c.eat('%') || !set_reading(out[n], t, h))
+                return 0;
+        }
+        if (c.eat_lit(" seq="))
+        {
+            int64_t seq;
+            if (!parse_int(c, seq) || seq <= 0)
+                return 0;
+            out[n].seq = (uint32_t)seq;
+        }
+        n++;
+        if (c.done())
+            return n;
+        if (!c.eat(';'))
+            return 0;
+    }
+    return 0;
+}
+
+// {"t":23.4,"h":45.6}、',' 区切り
+size_t parse_json(Cursor c, Reading *out, size_t cap)
+{
+    size_t n = 0;
+    while (n < cap)
+    {
+        int32_t t = 0, h = 0;
+        bool have_t = false, have_h = false;
+        c.skip_ws();
+        if (!c.eat('{'))
+            return 0;
+        do
+        {
+            c.skip_ws();
+            bool is_t = c.eat_lit("\"t\"");
+            bool is_h = !is_t && c.eat_lit("\"h\"");
+            c.skip_ws();
+            if (!(is_t || is_h) || !c.eat(':'))
+                return 0;
+            c.skip_ws();
+            if (!parse_centi(c, is_t ? t : h))
+                return 0;
+            (is_t ? have_t : have_h) = true;
+            c.skip_ws();
+        } while (c.eat(','));
+        if (!c.eat('}') || !have_t || !have_h || !set_reading(out[n], t, h))
+            return 0;
+        n++;
+        c.skip_ws();
+        if (c.done())
+            return n;
+        if (!c.eat(','))
+            return 0;
+    }
+    return 0;
+}
+
+size_t parse_bin(const uint8_t *p, size_t len, Reading *out, size_t cap)
+{
+    if (len == 0 || len % 4 || len / 4 > cap)
+        return 0;
+    size_t n = len / 4;
+    for (size_t i = 0; i < n; i++, p += 4)
+    {
+        int16_t t = (int16_t)(p[0] | p[1] << 8);
+        uint16_t h = (uint16_t)(p[2] | p[3] << 8);
+        if (!set_reading(out[i], t, h))
+            return 0;
+    }
+    return n;
+}
+
+// 整数配列を読んで out[i].*field に入れる。要素数を返す（失敗は SIZE_MAX）
+template <typename Store>
+size_t parse_int_array(Cursor &c, Reading *out, size_t cap, Store store)
+{
+    if (!c.eat('['))
+        return SIZE_MAX;
+    c.skip_ws();
+    if (c.eat(']'))
+        return 0;
+    size_t n = 0;
+    do
+    {
+        int64_t v;
+        c.skip_ws();
+        if (n >= cap || !parse_int(c, v))
+            return SIZE_MAX;
+        store(out[n++], v);
+        c.skip_ws();
+    } while (c.eat(','));
+    return c.eat(']') ? n : SIZE_MAX;
+}
+
+// 低消費電力版のバッチ。t / temp_c / hum 以外の数値フィールドは読み飛ばす
+size_t parse_batch(Cursor c, Reading *out, size_t cap)
+{
+    size_t n_t = SIZE_MAX, n_temp = SIZE_MAX, n_hum = SIZE_MAX;
+    c.skip_ws();
+    if (!c.eat('{'))
+        return 0;
+    do
+    {
+        c.skip_ws();
+        if (!c.eat('"'))
+            return 0;
+        const char *key = c.p;
+        while (!c.done() && *c.p != '"')
+            c.p++;
+        std::string_view k(key, (size_t)(c.p - key));
+        if (!c.eat('"'))
+            return 0;
+        c.skip_ws();
+        if (!c.eat(':'))
+            return 0;
+        c.skip_ws();
+        if (k == "t")
+            n_t = parse_int_array(c, out, cap, [](Reading &r, int64_t v) { r.offset_ms = (int32_t)v; });
+        else if (k == "temp_c")
+            n_temp = parse_int_array(c, out, cap, [](Reading &r, int64_t v) { r.temp_centi = (int16_t)v; });
+        else if (k == "hum")
+            n_hum = parse_int_array(c, out, cap, [](Reading &r, int64_t v) { r.hum_centi = (int16_t)v; });
+        else
+        {
+            int64_t skip;
+            if (!parse_int(c, skip))
+                return 0;
+        }
+        c.skip_ws();
+    } while (c.eat(','));
+    if (!c.eat('}') || n_t == SIZE_MAX || n_t != n_temp || n_t != n_hum || n_t == 0)
+        return 0;
+    // 時刻は先頭からの差分 → 最後のサンプル（受信時刻に一番近い）からの差に
+    int32_t last = out[n_t - 1].offset_ms;
+    for (size_t i = 0; i < n_t; i++)
+    {
+        int32_t offset = out[i].offset_ms - last;
+        set_reading(out[i], out[i].temp_centi, out[i].hum_centi);
+        out[i].offset_ms = offset;
+    }
+    return n_t;
+}
+
+// ファームウェアの tspack.h と合わせること
+constexpr uint8_t PACKED_MAGIC = 0xB1;
+constexpr uint8_t PACKED_TIME_WIDTHS[4] = {7, 12, 20, 32};
+constexpr uint8_t PACKED_VALUE_WIDTHS[4] = {3, 6, 10, 17};
+
+// MSB から読む。読みすぎたら ok = false
+struct BitReader
+{
+    const uint8_t *p;
+    size_t bits; // 全体のビット数
+    size_t pos = 0;
+    bool ok = true;
+
+    uint32_t get(unsigned n)
+    {
+        if (pos + n > bits)
+        {
+            ok = false;
+            return 0;
+        }
+        uint32_t v = 0;
+        while (n)
+        {
+            unsigned room = 8 - (unsigned)(pos % 8);
+            unsigned take = n < room ? n : room;
+            v = v << take | ((p[pos / 8] >> (room - take)) & ((1u << take) - 1));
+            pos += take;
+            n -= take;
+        }
+        return v;
+    }
+    // '0' / '10' / '110' / '1110' / '1111' + 幅
+    uint32_t get_var(const uint8_t (&widths)[4])
+    {
+        unsigned ones = 0;
+        while (ones < 4 && get(1))
+            ones++;
+        return ones ? get(widths[ones - 1]) : 0;
+    }
+};
+
+int32_t unzigzag(uint32_t z)
+{
+    return (int32_t)(z >> 1) ^ -(int32_t)(z & 1);
+}
+
+// TSPACK_BATCH_MAGIC | メタ数 | LEB128 × メタ数 | 件数 | ビット列
+size_t parse_packed(const uint8_t *p, size_t len, Reading *out, size_t cap)
+{
+    if (len < 3 || p[0] != PACKED_MAGIC)
+        return 0;
+    size_t i = 2;
+    for (unsigned m = 0; m < p[1]; m++)
+    {
+        // メタは今のところ使わない（列ファイルには計測値だけ）
+        while (i < len && p[i] & 0x80)
+            i++;
+        if (++i > len)
+            return 0;
+    }
+    if (i >= len)
+        return 0;
+    size_t n = p[i++];
+    if (n == 0 || n > cap)
+        return 0;
+    BitReader br{p + i, (len - i) * 8};
+    uint32_t t0 = br.get(32), t = t0;
+    int16_t temp = (int16_t)br.get(16), hum = (int16_t)br.get(16);
+    int32_t dt = 0;
+    for (size_t k = 0; k < n; k++)
+    {
+        if (k)
+        {
+            dt = (int32_t)((uint32_t)dt + (uint32_t)unzigzag(br.get_var(PACKED_TIME_WIDTHS)));
+            t += (uint32_t)dt;
+            temp = (int16_t)(temp + unzigzag(br.get_var(PACKED_VALUE_WIDTHS)));
+            hum = (int16_t)(hum + unzigzag(br.get_var(PACKED_VALUE_WIDTHS)));
+        }
+        if (!br.ok)
+            return 0;
+        set_reading(out[k], temp, hum);
+        out[k].offset_ms = (int32_t)(t - t0);
+    }
+    // 余りは最後のバイトの詰め物だけ
+    if (br.bits - br.pos >= 8)
+        return 0;
+    // 時刻は最後のサンプル（受信時刻に一番近い）からの差に
+    uint32_t last = (uint32_t)out[n - 1].offset_ms;
+    for (size_t k = 0; k < n; k++)
+        out[k].offset_ms = (int32_t)((uint32_t)out[k].offset_ms - last);
+    return n;
+}
+
+} // namespace
+
+size_t parse_payload(std::string_view sensor, const uint8_t *p, size_t len, Reading *out, size_t cap,
+                     PayloadKind &kind)
+{
+    Cursor c{reinterpret_cast<const char *>(p), reinterpret_cast<const char *>(p) + len};
+    size_t n = 0;
+    if (sensor == "aht22/batch")
+    {
+        if (len && p[0] == PACKED_MAGIC)
+        {
+            kind = PayloadKind::Packed;
+            n = parse_packed(p, len, out, cap);
+        }
+        else
+        {
+            kind = PayloadKind::Batch;
+            n = parse_batch(c, out, cap);
+        }
+    }
+    else if (len && (p[0] == 'T' || p[0] == 'f') && (n = parse_text(c, out, cap)) > 0)
+    {
+        kind = PayloadKind::Text;
+    }
+    else if (len && p[0] == '{' && (n = parse_json(c, out, cap)) > 0)
+    {
+        kind = PayloadKind::Json;
+    }
+    else
+    {
+        // 先頭がたまたま 'T' や '{' のバイナリもあるので、テキストとして読めなければここに来る
+        kind = PayloadKind::Bin;
+        n = parse_bin(p, len, out, cap);
+    }
+    if (n == 0)
+        kind = PayloadKind::Invalid;
+    return n;
+}
+
+} // namespace collector
@@ -0,0 +1,48 @@
+#pragma once
+// mqcensor のペイロードを読む。ヒープもコピーも使わず、呼び出し側の配列に 0.01 単位の整数で書き出す
+//
+//   text  : "Temp=23.4°C Hum=45.6%"（ファームウェアの aht20_format）、"failed"。';' 区切りで複数可。
+//           永続セッションのファームウェアは末尾に " seq=N"（outbox の通し番号、mqtt_session.h）を付ける
+//   json  : {"t":23.4,"h":45.6}（publish_bench の json。',' 区切りで複数可）
+//   bin   : 温度 int16 LE + 湿度 uint16 LE（0.01 単位）の 4 バイトを並べたもの
+//   batch : 低消費電力版の aht22/batch（{"t":[ms...],"temp_c":[...],"hum":[...], ...}）
+//   packed: 同じく aht22/batch のビット詰め形式（ファームウェアの tspack.h。先頭バイトで見分ける）
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace collector
+{
+
+enum class PayloadKind : uint8_t
+{
+    Text = 0,
+    Json,
+    Bin,
+    Batch,
+    Packed,
+    Invalid,
+};
+const char *payload_kind_name(PayloadKind kind);
+
+enum ReadingFlags : uint8_t
+{
+    READING_FAILED = 1 << 0, // センサーが読めなかった（値は 0）
+};
+
+struct Reading
+{
+    int32_t offset_ms; // 最後のサンプルからの時刻差（≤ 0。バッチ以外は 0）
+    int16_t temp_centi;
+    int16_t hum_centi;
+    uint8_t flags;
+    uint32_t seq; // ファームウェアの outbox の通し番号（0 = 付いていない）
+};
+
+#define COLLECTOR_READINGS_MAX 64 // 1 メッセージの上限（ファームウェアのバッチは最大 60）
+
+// sensor はトピックの {sensor} 部分（"aht22" / "aht22/batch"）。読めた件数を返し、読めなければ 0（kind = Invalid）
+size_t parse_payload(std::string_view sensor, const uint8_t *p, size_t len, Reading *out, size_t cap,
+                     PayloadKind &kind);
+
+} // namespace collector
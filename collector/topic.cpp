@@ -0,0 +1,66 @@
+#include "topic.h"
+
+namespace collector
+{
+
+static const std::string_view BOARD = "{board_id}";
+static const std::string_view SENSOR = "{sensor}";
+
+bool TopicTemplate::parse(std::string_view tmpl)
+{
+    size_t b = tmpl.find(BOARD);
+    size_t s = tmpl.find(SENSOR);
+    if (b == std::string_view::npos || s == std::string_view::npos || s < b + BOARD.size())
+        return false;
+    head_ = std::string(tmpl.substr(0, b));
+    mid_ = std::string(tmpl.substr(b + BOARD.size(), s - b - BOARD.size()));
+    tail_ = std::string(tmpl.substr(s + SENSOR.size()));
+    // board_id の終わりを mid_ で見つけるので空だと区切れない
+    return !mid_.empty();
+}
+
+bool TopicTemplate::match(std::string_view topic, std::string_view &board_id, std::string_view &sensor) const
+{
+    if (topic.size() < head_.size() + mid_.size() + tail_.size() || topic.compare(0, head_.size(), head_) != 0 ||
+        topic.compare(topic.size() - tail_.size(), tail_.size(), tail_) != 0)
+        return false;
+    std::string_view rest = topic.substr(head_.size(), topic.size() - head_.size() - tail_.size());
+    size_t m = rest.find(mid_);
+    if (m == 0 || m == std::string_view::npos)
+        return false;
+    board_id = rest.substr(0, m);
+    sensor = rest.substr(m + mid_.size());
+    return !sensor.empty();
+}
+
+std::string TopicTemplate::filter(std::string_view sensor) const
+{
+    return head_ + "+" + mid_ + std::string(sensor) + tail_;
+}
+
+uint64_t board_id_value(std::string_view board_id)
+{
+    if (board_id.size() == 16)
+    {
+        uint64_t v = 0;
+        bool hex = true;
+        for (char c : board_id)
+        {
+            int d = c >= '0' && c <= '9' ? c - '0' : c >= 'A' && c <= 'F' ? c - 'A' + 10 : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+            if (d < 0)
+            {
+                hex = false;
+                break;
+            }
+            v = v << 4 | (uint64_t)d;
+        }
+        if (hex)
+            return v;
+    }
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (char c : board_id)
+        h = (h ^ (uint8_t)c) * 0x100000001b3ull;
+    return h;
+}
+
+} // namespace collector
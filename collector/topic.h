@@ -0,0 +1,29 @@
+#pragma once
+// ファームウェアと同じトピックテンプレート（MQCENSOR_TOPIC_TEMPLATE、既定 "pico2w/{board_id}/{sensor}"）で
+// 受信トピックを分解する。文字列は作らず、元のトピックを指す string_view を返す
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace collector
+{
+
+class TopicTemplate
+{
+public:
+    // {board_id} が {sensor} より前にあるテンプレートだけ扱える。違えば false
+    bool parse(std::string_view tmpl);
+    bool match(std::string_view topic, std::string_view &board_id, std::string_view &sensor) const;
+    // 購読フィルタ（{board_id} を + に置き換え、センサー名ごとに 1 つ）
+    std::string filter(std::string_view sensor) const;
+
+private:
+    std::string head_; // {board_id} の前
+    std::string mid_;  // {board_id} と {sensor} の間
+    std::string tail_; // {sensor} の後
+};
+
+// 16 桁の 16 進（pico_get_unique_board_id）ならその値、それ以外は FNV-1a 64 のハッシュ
+uint64_t board_id_value(std::string_view board_id);
+
+} // namespace collector
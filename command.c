@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/cyw43_arch.h"
+#include "command.h"
+#include "flat_json.h"
+#include "applog.h"
+
+typedef struct
+{
+    char id[COMMAND_ID_MAX + 1];
+    bool id_is_num;    // 整数で来た ID は整数で返す
+    bool read;         // 計測結果を待つ要求か
+    const char *error; // 計測の要らない返信の理由（リテラル）
+    uint32_t seq;      // 受信順の通し番号。ログは id（スタック上の文字列）を持てないのでこれで突き合わせる
+    absolute_time_t rx;
+} CommandRequest;
+
+static CommandRequest queue[COMMAND_QUEUE_MAX];
+static uint8_t q_head = 0;
+static uint8_t q_count = 0;
+static uint8_t reads_pending = 0;
+static uint32_t dropped = 0;
+static uint32_t received = 0;
+static void (*listener)(void) = NULL;
+
+void command_set_listener(void (*cb)(void))
+{
+    listener = cb;
+}
+
+// 成功なら NULL、失敗なら理由（リテラル）。内容が不正でも最後まで読んで、ID は返信に使えるよう req->id に入れる
+static const char *parse(const uint8_t *payload, size_t len, CommandRequest *req)
+{
+    FlatJson j;
+    FlatJsonField f;
+    int r;
+    const char *err = NULL;
+    bool have_cmd = false;
+    flat_json_init(&j, payload, len);
+    while ((r = flat_json_next(&j, &f)) > 0)
+    {
+        if (flat_json_eq(f.key, f.key_len, "id"))
+        {
+            if (f.str && f.str_len > COMMAND_ID_MAX)
+            {
+                err = err ? err : "id too long";
+            }
+            else if (f.str)
+            {
+                memcpy(req->id, f.str, f.str_len);
+                req->id[f.str_len] = '\0';
+            }
+            else
+            {
+                snprintf(req->id, sizeof(req->id), "%ld", (long)f.num);
+                req->id_is_num = true;
+            }
+        }
+        else if (flat_json_eq(f.key, f.key_len, "cmd"))
+        {
+            if (!f.str || !flat_json_eq(f.str, f.str_len, "read"))
+                err = err ? err : "unknown cmd";
+            have_cmd = true;
+        }
+        else
+        {
+            err = err ? err : "unknown key";
+        }
+    }
+    if (r < 0)
+        return j.error;
+    if (err)
+        return err;
+    if (!have_cmd)
+        return "missing cmd";
+    return req->id[0] ? NULL : "missing id";
+}
+
+void command_handle(const uint8_t *payload, size_t len)
+{
+    CommandRequest req = {.rx = get_absolute_time(), .seq = ++received};
+    req.error = parse(payload, len, &req);
+    req.read = !req.error;
+    if (q_count >= COMMAND_QUEUE_MAX)
+    {
+        dropped++;
+        LOG_WARN(APP, "cmd: queue full, dropped #%lu (total %lu)\n", (unsigned long)req.seq, (unsigned long)dropped);
+        return;
+    }
+    if (req.error)
+        LOG_WARN(APP, "cmd: rejected #%lu (%s)\n", (unsigned long)req.seq, req.error);
+    queue[(q_head + q_count) % COMMAND_QUEUE_MAX] = req;
+    q_count++;
+    if (req.read)
+        reads_pending++;
+    // エラーの返信も次のワーカーで返すので、どちらでも起こす
+    if (listener)
+        listener();
+}
+
+bool command_read_pending(void)
+{
+    return reads_pending > 0;
+}
+
+// 0.1 単位の整数を "-1.5" のように
+static void format_deci(char *buf, size_t len, int16_t v)
+{
+    int a = v < 0 ? -v : v;
+    snprintf(buf, len, "%s%d.%d", v < 0 ? "-" : "", a / 10, a % 10);
+}
+
+size_t command_next_reply(const AHT22Result *r, absolute_time_t triggered, absolute_time_t converted, char *buf,
+                          size_t len)
+{
+    CommandRequest req;
+    cyw43_arch_lwip_begin();
+    bool ready = q_count > 0 && (!queue[q_head].read || r);
+    if (ready)
+    {
+        req = queue[q_head];
+        q_head = (uint8_t)((q_head + 1) % COMMAND_QUEUE_MAX);
+        q_count--;
+        if (req.read)
+            reads_pending--;
+    }
+    cyw43_arch_lwip_end();
+    if (!ready)
+        return 0;
+
+    const char *quote = req.id_is_num ? "" : "\"";
+    int n;
+    if (!req.read)
+    {
+        n = snprintf(buf, len, "{\"id\":%s%s%s,\"result\":\"%s\"}", quote, req.id, quote, req.error);
+    }
+    else if (is_failed((AHT22Result *)r))
+    {
+        n = snprintf(buf, len, "{\"id\":%s%s%s,\"result\":\"failed\",\"trigger_us\":%ld,\"conv_us\":%ld,\"reply_us\":%ld}",
+                     quote, req.id, quote, (long)absolute_time_diff_us(req.rx, triggered),
+                     (long)absolute_time_diff_us(req.rx, converted),
+                     (long)absolute_time_diff_us(req.rx, get_absolute_time()));
+    }
+    else
+    {
+        char temp[8], hum[8];
+        format_deci(temp, sizeof(temp), r->temp_deci);
+        format_deci(hum, sizeof(hum), r->hum_deci);
+        n = snprintf(buf, len,
+                     "{\"id\":%s%s%s,\"result\":\"ok\",\"temp\":%s,\"hum\":%s,\"trigger_us\":%ld,\"conv_us\":%ld,"
+                     "\"reply_us\":%ld}",
+                     quote, req.id, quote, temp, hum, (long)absolute_time_diff_us(req.rx, triggered),
+                     (long)absolute_time_diff_us(req.rx, converted),
+                     (long)absolute_time_diff_us(req.rx, get_absolute_time()));
+    }
+    LOG_DEBUG(APP, "cmd: reply #%lu %s\n", (unsigned long)req.seq, req.error ? req.error : "read");
+    return n > 0 && (size_t)n < len ? (size_t)n : 0;
+}
@@ -0,0 +1,28 @@
+#pragma once
+// cmd トピックで受けるオンデマンド要求。"read" は周期を待たずに AHT20 を読み、cmd/resp へ返す
+//
+//   cmd      : {"cmd":"read","id":"req-42"}
+//   cmd/resp : {"id":"req-42","result":"ok","temp":23.4,"hum":45.6,
+//               "trigger_us":-12000,"conv_us":68000,"reply_us":68900}
+//
+// *_us は要求を受けた時刻からの経過（トリガ・変換完了・返信を lwIP に渡した時刻）。
+// 周期の計測がすでに変換中ならその結果を共有するので trigger_us は負になりうる
+#include <stdbool.h>
+#include <stddef.h>
+#include "pico/stdlib.h"
+#include "aht20.h"
+
+#define COMMAND_QUEUE_MAX 4 // 返信待ちにしておける要求の数（あふれた分は捨てて数える）
+#define COMMAND_ID_MAX 32   // 相関 ID（文字列か整数）の最大長
+#define COMMAND_REPLY_MAX 192
+
+// cmd の受信（lwIP コールバックから）。検証して積み、リスナーを呼ぶ
+void command_handle(const uint8_t *payload, size_t len);
+// 要求が積まれるたびに呼ばれる（lwIP コールバックのコンテキスト）。変換・返信を始めるきっかけ
+void command_set_listener(void (*listener)(void));
+// 計測結果を待っている要求があるか
+bool command_read_pending(void);
+// 先頭の要求に答えられれば返信を整形して取り除き、長さを返す。無ければ 0。
+// r が NULL なら計測の要らない返信（エラーなど）だけを返す。reply_us は呼んだ時刻
+size_t command_next_reply(const AHT22Result *r, absolute_time_t triggered, absolute_time_t converted, char *buf,
+                          size_t len);
@@ -0,0 +1,195 @@
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/cyw43_arch.h"
+#include "lwip/apps/mqtt_priv.h"
+#include "conn_stats.h"
+
+#ifndef PICO_PROGRAM_VERSION_STRING
+#define PICO_PROGRAM_VERSION_STRING "dev"
+#endif
+
+// lwIP mqtt.c 内部の conn_state（TCP_DISCONNECTED, TCP_CONNECTING, MQTT_CONNECTING, MQTT_CONNECTED）
+// MQTT_CONNECTING 以上なら TCP は確立して CONNECT を送っている
+#define LWIP_MQTT_STATE_MQTT_CONNECTING 2
+
+// バケットの上限 [ms]。最後のバケットはそれ以上すべて
+static const uint32_t BUCKET_EDGES_MS[CONN_STATS_BUCKETS - 1] = {
+    10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000};
+
+static const char *const PHASE_NAMES[CONN_PHASE_COUNT] = {
+    "boot", "arch_init", "assoc", "dhcp", "tcp", "connack", "first_ack", "total"};
+
+typedef struct
+{
+    uint32_t count;
+    uint32_t sum_ms;
+    uint32_t max_ms;
+    uint16_t buckets[CONN_STATS_BUCKETS];
+} PhaseHist;
+
+static PhaseHist hist[CONN_PHASE_COUNT];
+
+// 現在の接続試行の各時点 [us since boot]。0 は未到達
+typedef struct
+{
+    uint64_t start;
+    uint64_t assoc;
+    uint64_t dhcp;
+    uint64_t connect_sent;
+    uint64_t tcp;
+    uint64_t connack;
+} Attempt;
+
+static volatile Attempt cur;
+static volatile bool attempt_active = false;
+static volatile bool attempt_completed = false;
+static mqtt_client_t *volatile poll_client;
+static repeating_timer_t poll_timer;
+static bool poll_timer_running = false;
+
+static uint64_t arch_init_begin_us;
+static absolute_time_t last_publish;
+
+static void hist_add_us(conn_phase_t phase, uint64_t us)
+{
+    uint32_t ms = (uint32_t)(us / 1000);
+    PhaseHist *h = &hist[phase];
+    int b = 0;
+    while (b < CONN_STATS_BUCKETS - 1 && ms > BUCKET_EDGES_MS[b])
+        b++;
+    if (h->buckets[b] != UINT16_MAX)
+        h->buckets[b]++;
+    h->count++;
+    h->sum_ms += ms;
+    if (ms > h->max_ms)
+        h->max_ms = ms;
+}
+
+// 片方でも未到達（0）なら数えない
+static void hist_add_span(conn_phase_t phase, uint64_t from_us, uint64_t to_us)
+{
+    if (from_us == 0 || to_us == 0 || to_us < from_us)
+        return;
+    hist_add_us(phase, to_us - from_us);
+}
+
+void conn_stats_boot_arch_init_begin(void)
+{
+    arch_init_begin_us = time_us_64();
+    hist_add_us(CONN_PHASE_BOOT, arch_init_begin_us); // 起点は電源投入
+}
+
+void conn_stats_boot_arch_init_end(void)
+{
+    hist_add_span(CONN_PHASE_ARCH_INIT, arch_init_begin_us, time_us_64());
+}
+
+// アラーム IRQ から呼ばれる。状態を読むだけで cyw43/lwIP の API は呼ばない
+static bool poll_cb(repeating_timer_t *t)
+{
+    (void)t;
+    uint64_t now = time_us_64();
+    if (!cur.assoc && cyw43_wifi_link_status(&cyw43_state, CYW43_ITF_STA) == CYW43_LINK_JOIN)
+        cur.assoc = now;
+    if (!cur.dhcp && cyw43_tcpip_link_status(&cyw43_state, CYW43_ITF_STA) == CYW43_LINK_UP)
+    {
+        cur.dhcp = now;
+        if (!cur.assoc)
+            cur.assoc = now;
+    }
+    if (poll_client && !cur.tcp && poll_client->conn_state >= LWIP_MQTT_STATE_MQTT_CONNECTING)
+        cur.tcp = now;
+
+    // TCP まで取れたら残りはコールバックで拾えるので止める
+    poll_timer_running = attempt_active && !cur.tcp;
+    return poll_timer_running;
+}
+
+void conn_stats_attempt_begin(void)
+{
+    if (poll_timer_running)
+        cancel_repeating_timer(&poll_timer);
+    poll_client = NULL;
+    memset((void *)&cur, 0, sizeof(cur));
+    cur.start = time_us_64();
+    attempt_active = true;
+    poll_timer_running = add_repeating_timer_ms(-CONN_STATS_POLL_MS, poll_cb, NULL, &poll_timer);
+}
+
+void conn_stats_mqtt_connect_sent(mqtt_client_t *client)
+{
+    if (!attempt_active || cur.connect_sent)
+        return;
+    poll_client = client;
+    cur.connect_sent = time_us_64();
+}
+
+void conn_stats_connack(bool accepted)
+{
+    if (!attempt_active || cur.connack)
+        return;
+    if (!accepted)
+    {
+        // 失敗した試行はヒストグラムに入れない（次の attempt_begin で作り直し）
+        attempt_active = false;
+        return;
+    }
+    cur.connack = time_us_64();
+    if (!cur.tcp)
+        cur.tcp = cur.connack;
+}
+
+void conn_stats_publish_acked(void)
+{
+    if (!attempt_active || !cur.connack)
+        return;
+    uint64_t now = time_us_64();
+    hist_add_span(CONN_PHASE_ASSOC, cur.start, cur.assoc);
+    hist_add_span(CONN_PHASE_DHCP, cur.assoc, cur.dhcp);
+    hist_add_span(CONN_PHASE_TCP, cur.connect_sent, cur.tcp);
+    hist_add_span(CONN_PHASE_CONNACK, cur.tcp, cur.connack);
+    hist_add_span(CONN_PHASE_FIRST_ACK, cur.connack, now);
+    hist_add_span(CONN_PHASE_TOTAL, cur.start, now);
+    attempt_active = false;
+    attempt_completed = true;
+}
+
+bool conn_stats_publish_due(void)
+{
+    if (attempt_completed)
+        return true;
+    return absolute_time_diff_us(last_publish, get_absolute_time()) / 1000 > CONN_STATS_PUBLISH_MS;
+}
+
+size_t conn_stats_format(char *buf, size_t len)
+{
+    size_t n = (size_t)snprintf(buf, len, "{\"fw\":\"%s\",\"edges_ms\":[", PICO_PROGRAM_VERSION_STRING);
+    for (int b = 0; b < CONN_STATS_BUCKETS - 1 && n < len; b++)
+        n += (size_t)snprintf(buf + n, len - n, b ? ",%lu" : "%lu", (unsigned long)BUCKET_EDGES_MS[b]);
+    if (n < len)
+        n += (size_t)snprintf(buf + n, len - n, "]");
+
+    for (int p = 0; p < CONN_PHASE_COUNT && n < len; p++)
+    {
+        const PhaseHist *h = &hist[p];
+        n += (size_t)snprintf(buf + n, len - n, ",\"%s\":{\"n\":%lu,\"sum\":%lu,\"max\":%lu,\"h\":[",
+                              PHASE_NAMES[p], (unsigned long)h->count,
+                              (unsigned long)h->sum_ms, (unsigned long)h->max_ms);
+        for (int b = 0; b < CONN_STATS_BUCKETS && n < len; b++)
+            n += (size_t)snprintf(buf + n, len - n, b ? ",%u" : "%u", h->buckets[b]);
+        if (n < len)
+            n += (size_t)snprintf(buf + n, len - n, "]}");
+    }
+    if (n < len)
+        n += (size_t)snprintf(buf + n, len - n, "}");
+    if (n >= len)
+        return 0; // 収まらなかった
+    return n;
+}
+
+void conn_stats_published(void)
+{
+    attempt_completed = false;
+    last_publish = get_absolute_time();
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "lwip/apps/mqtt.h"
+
+// 接続ライフサイクルの各フェーズにかかった時間を固定バケットのヒストグラムに貯める
+typedef enum
+{
+    CONN_PHASE_BOOT = 0,  // 電源投入 → cyw43_arch_init 開始
+    CONN_PHASE_ARCH_INIT, // cyw43_arch_init
+    CONN_PHASE_ASSOC,     // 接続開始 → アソシエーション完了
+    CONN_PHASE_DHCP,      // アソシエーション → DHCP でアドレス取得
+    CONN_PHASE_TCP,       // mqtt_client_connect → TCP SYN/ACK
+    CONN_PHASE_CONNACK,   // TCP 確立（CONNECT 送信）→ CONNACK
+    CONN_PHASE_FIRST_ACK, // CONNACK → 最初の publish の ACK
+    CONN_PHASE_TOTAL,     // 接続開始 → 最初の publish の ACK
+    CONN_PHASE_COUNT
+} conn_phase_t;
+
+#define CONN_STATS_BUCKETS 11
+#define CONN_STATS_POLL_MS 2            // リンク状態・TCP 状態のポーリング周期
+#define CONN_STATS_PUBLISH_MS (10 * 60 * 1000) // 定期送信の周期
+
+// 起動時の 2 フェーズ（1 回だけ）
+void conn_stats_boot_arch_init_begin(void);
+void conn_stats_boot_arch_init_end(void);
+// Wi-Fi から張り直す接続試行の開始。ポーリングタイマーを起動する
+void conn_stats_attempt_begin(void);
+// mqtt_client_connect を呼んだ直後。以降 TCP の確立を client の状態から拾う
+void conn_stats_mqtt_connect_sent(mqtt_client_t *client);
+// 以下は lwIP コールバックから呼ぶ
+void conn_stats_connack(bool accepted);
+void conn_stats_publish_acked(void);
+// 前回送信から CONN_STATS_PUBLISH_MS 経過、または新しい接続試行が完了していたら true
+bool conn_stats_publish_due(void);
+// 診断トピック用の JSON を組み立てる。lwIP ロック内で呼ぶこと
+size_t conn_stats_format(char *buf, size_t len);
+// publish が通ったときだけ呼ぶ（失敗したら次の機会にまた送る）。lwIP ロック内で呼ぶこと
+void conn_stats_published(void);
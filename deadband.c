@@ -0,0 +1,21 @@
+#include "deadband.h"
+
+static int16_t abs_diff(int16_t a, int16_t b)
+{
+    return (int16_t)(a > b ? a - b : b - a);
+}
+
+bool deadband_check(Deadband *d, const AHT22Result *r, uint16_t deadband_deci, uint32_t heartbeat_ms,
+                    uint64_t now_us)
+{
+    AHT22Result v = *r;
+    // 失敗は毎回送る（受け手が気付けるように）
+    if (deadband_deci && d->primed && !is_failed(&v) && abs_diff(v.temp_deci, d->temp_deci) < deadband_deci &&
+        abs_diff(v.hum_deci, d->hum_deci) < deadband_deci && now_us - d->pub_us < heartbeat_ms * 1000ull)
+        return false;
+    d->primed = true;
+    d->temp_deci = v.temp_deci;
+    d->hum_deci = v.hum_deci;
+    d->pub_us = now_us;
+    return true;
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "aht20.h"
+
+// 変化があったときだけ送る（report-by-exception）判定。runtime_config の deadband_deci から使う。
+// 状態を呼び出し側に持たせるので、フリート負荷ツールは機器ごとに 1 つずつ持てる
+typedef struct
+{
+    bool primed;                 // 一度でも送ったか
+    int16_t temp_deci, hum_deci; // 前回送った値
+    uint64_t pub_us;             // 前回送った時刻
+} Deadband;
+
+// 送るなら true を返して「前回送った値」を更新する。失敗は毎回送り、止めていても heartbeat_ms ごとには送る
+bool deadband_check(Deadband *d, const AHT22Result *r, uint16_t deadband_deci, uint32_t heartbeat_ms,
+                    uint64_t now_us);
@@ -0,0 +1,108 @@
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/unique_id.h"
+#include "device_id.h"
+#include "applog.h"
+
+#define DEFAULT_CLIENT_ID_TEMPLATE "pico2w-{board_id}"
+#define DEFAULT_TOPIC_TEMPLATE "pico2w/{board_id}/{sensor}"
+
+static const char *const SENSOR_NAMES[DEVICE_TOPIC_COUNT] = {
+    [DEVICE_TOPIC_SAMPLE] = "aht22",
+    [DEVICE_TOPIC_BATCH] = "aht22/batch",
+    [DEVICE_TOPIC_DIAG_CONN] = "diag/conn",
+    [DEVICE_TOPIC_DIAG_BOOT] = "diag/boot",
+    [DEVICE_TOPIC_DIAG_LWIP] = "diag/lwip",
+    [DEVICE_TOPIC_CONFIG_SET] = "config/set",
+    [DEVICE_TOPIC_CONFIG] = "config",
+    [DEVICE_TOPIC_CMD] = "cmd",
+    [DEVICE_TOPIC_CMD_RESP] = "cmd/resp",
+};
+
+static char board_id[2 * PICO_UNIQUE_BOARD_ID_SIZE_BYTES + 1];
+static char client_id[DEVICE_CLIENT_ID_MAX];
+static char topics[DEVICE_TOPIC_COUNT][DEVICE_TOPIC_MAX];
+
+static bool append(char *buf, size_t len, size_t *n, const char *s, size_t slen)
+{
+    if (*n + slen >= len)
+        return false;
+    memcpy(buf + *n, s, slen);
+    *n += slen;
+    return true;
+}
+
+size_t device_expand_for(const char *board, const char *tmpl, const char *sensor, char *buf, size_t len)
+{
+    size_t n = 0;
+    bool ok = len > 0;
+    while (ok && *tmpl)
+    {
+        if (strncmp(tmpl, "{board_id}", 10) == 0)
+        {
+            ok = append(buf, len, &n, board, strlen(board));
+            tmpl += 10;
+        }
+        else if (strncmp(tmpl, "{sensor}", 8) == 0)
+        {
+            ok = append(buf, len, &n, sensor, strlen(sensor));
+            tmpl += 8;
+        }
+        else
+        {
+            ok = append(buf, len, &n, tmpl, 1);
+            tmpl++;
+        }
+    }
+    if (!ok)
+    {
+        if (len)
+            buf[0] = '\0';
+        return 0;
+    }
+    buf[n] = '\0';
+    return n;
+}
+
+size_t device_expand(const char *tmpl, const char *sensor, char *buf, size_t len)
+{
+    return device_expand_for(board_id, tmpl, sensor, buf, len);
+}
+
+const char *device_sensor_name(DeviceTopic topic)
+{
+    return SENSOR_NAMES[topic];
+}
+
+// テンプレートが長すぎるときは既定のテンプレートに戻す（どの機器とも重ならないことを優先）
+static void build(const char *tmpl, const char *fallback, const char *sensor, char *buf, size_t len)
+{
+    if (device_expand(tmpl, sensor, buf, len))
+        return;
+    LOG_ERROR(APP, "device_id: \"%s\" does not fit in %u bytes, using \"%s\"\n", tmpl, (unsigned)len, fallback);
+    device_expand(fallback, sensor, buf, len);
+}
+
+void device_id_init(void)
+{
+    pico_get_unique_board_id_string(board_id, sizeof(board_id));
+    build(MQCENSOR_CLIENT_ID_TEMPLATE, DEFAULT_CLIENT_ID_TEMPLATE, "", client_id, sizeof(client_id));
+    for (int i = 0; i < DEVICE_TOPIC_COUNT; i++)
+        build(MQCENSOR_TOPIC_TEMPLATE, DEFAULT_TOPIC_TEMPLATE, SENSOR_NAMES[i], topics[i], sizeof(topics[i]));
+    LOG_INFO(APP, "device_id: board=%s client_id=%s topic=%s\n", board_id, client_id, topics[DEVICE_TOPIC_SAMPLE]);
+}
+
+const char *device_board_id(void)
+{
+    return board_id;
+}
+
+const char *device_client_id(void)
+{
+    return client_id;
+}
+
+const char *device_topic(DeviceTopic topic)
+{
+    return topics[topic];
+}
@@ -0,0 +1,41 @@
+#pragma once
+// 機器ごとの MQTT クライアント ID とトピック。起動時に pico_get_unique_board_id() から 1 回だけ組み立て、
+// publish のたびには作り直さない（outbox はトピックのポインタを持つので静的な文字列を渡す）
+#include <stddef.h>
+
+// テンプレートの置き換え: {board_id} = 16 桁の 16 進（フラッシュの unique ID）、{sensor} = 下の各トピックの名前
+#ifndef MQCENSOR_CLIENT_ID_TEMPLATE
+#define MQCENSOR_CLIENT_ID_TEMPLATE "pico2w-{board_id}"
+#endif
+#ifndef MQCENSOR_TOPIC_TEMPLATE
+#define MQCENSOR_TOPIC_TEMPLATE "pico2w/{board_id}/{sensor}"
+#endif
+
+#define DEVICE_CLIENT_ID_MAX 48
+#define DEVICE_TOPIC_MAX 96
+
+typedef enum
+{
+    DEVICE_TOPIC_SAMPLE = 0, // "aht22"        計測値
+    DEVICE_TOPIC_BATCH,      // "aht22/batch"  低消費電力版のまとめ送信
+    DEVICE_TOPIC_DIAG_CONN,  // "diag/conn"    接続フェーズの統計
+    DEVICE_TOPIC_DIAG_BOOT,  // "diag/boot"    前回リセットの記録
+    DEVICE_TOPIC_DIAG_LWIP,  // "diag/lwip"    lwIP のメモリ統計
+    DEVICE_TOPIC_CONFIG_SET, // "config/set"   設定の変更要求（購読）
+    DEVICE_TOPIC_CONFIG,     // "config"       有効な設定（retained）
+    DEVICE_TOPIC_CMD,        // "cmd"          オンデマンド要求（購読）
+    DEVICE_TOPIC_CMD_RESP,   // "cmd/resp"     その返信
+    DEVICE_TOPIC_COUNT
+} DeviceTopic;
+
+// unique ID を読んでクライアント ID と全トピックを作る。ネットワークより前に 1 回呼ぶ
+void device_id_init(void);
+const char *device_board_id(void);
+const char *device_client_id(void);
+const char *device_topic(DeviceTopic topic);
+// {board_id} と {sensor} を置き換える。入り切らなければ 0（buf は空文字）
+size_t device_expand(const char *tmpl, const char *sensor, char *buf, size_t len);
+// 別の board ID で同じように置き換える（フリート負荷ツールが仮想の機器ごとに使う）
+size_t device_expand_for(const char *board, const char *tmpl, const char *sensor, char *buf, size_t len);
+// {sensor} に入る名前（"aht22" など）
+const char *device_sensor_name(DeviceTopic topic);
@@ -0,0 +1,115 @@
+#include <string.h>
+#include "flat_json.h"
+
+static const char *skip_ws(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+        p++;
+    return p;
+}
+
+static bool parse_int(const char **pp, const char *end, int32_t *out)
+{
+    const char *p = *pp;
+    bool neg = p < end && *p == '-';
+    if (neg)
+        p++;
+    if (p >= end || *p < '0' || *p > '9')
+        return false;
+    int64_t v = 0;
+    while (p < end && *p >= '0' && *p <= '9')
+    {
+        v = v * 10 + (*p++ - '0');
+        if (v > INT32_MAX)
+            return false;
+    }
+    *out = (int32_t)(neg ? -v : v);
+    *pp = p;
+    return true;
+}
+
+static bool parse_str(const char **pp, const char *end, const char **s, size_t *n)
+{
+    const char *p = *pp;
+    if (p >= end || *p != '"')
+        return false;
+    *s = ++p;
+    while (p < end && *p != '"' && *p != '\\')
+        p++;
+    if (p >= end || *p != '"')
+        return false; // エスケープは使わない
+    *n = (size_t)(p - *s);
+    *pp = p + 1;
+    return true;
+}
+
+void flat_json_init(FlatJson *j, const void *buf, size_t len)
+{
+    j->p = buf;
+    j->end = j->p + len;
+    j->started = false;
+    j->done = false;
+    j->error = NULL;
+}
+
+static int fail(FlatJson *j, const char *why)
+{
+    j->error = why;
+    j->done = true;
+    return -1;
+}
+
+int flat_json_next(FlatJson *j, FlatJsonField *f)
+{
+    if (j->done)
+        return j->error ? -1 : 0;
+    const char *p = skip_ws(j->p, j->end);
+    if (!j->started)
+    {
+        if (p >= j->end || *p++ != '{')
+            return fail(j, "not a JSON object");
+        p = skip_ws(p, j->end);
+        if (p < j->end && *p == '}')
+            return fail(j, "empty object");
+        j->started = true;
+    }
+    else
+    {
+        // 前のフィールドの後ろ
+        if (p < j->end && *p == '}')
+        {
+            j->done = true;
+            return 0;
+        }
+        if (p >= j->end || *p++ != ',')
+            return fail(j, "expected ',' or '}'");
+        p = skip_ws(p, j->end);
+    }
+
+    if (!parse_str(&p, j->end, &f->key, &f->key_len))
+        return fail(j, "bad key");
+    p = skip_ws(p, j->end);
+    if (p >= j->end || *p++ != ':')
+        return fail(j, "missing ':'");
+    p = skip_ws(p, j->end);
+
+    f->str = NULL;
+    f->str_len = 0;
+    f->num = 0;
+    if (p < j->end && *p == '"')
+    {
+        if (!parse_str(&p, j->end, &f->str, &f->str_len))
+            return fail(j, "bad string");
+    }
+    else if (!parse_int(&p, j->end, &f->num))
+    {
+        return fail(j, "values must be integers or strings");
+    }
+    j->p = p;
+    return 1;
+}
+
+bool flat_json_eq(const char *s, size_t n, const char *lit)
+{
+    return strlen(lit) == n && memcmp(s, lit, n) == 0;
+}
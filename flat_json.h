@@ -0,0 +1,37 @@
+#pragma once
+// 受信メッセージ用の小さな JSON リーダー。入れ子なしのオブジェクトだけを扱い、値は整数か文字列
+// （エスケープなし）。コピーもヒープも使わず、キーと文字列は元のバッファを指す
+//
+//   FlatJson j;
+//   FlatJsonField f;
+//   int r;
+//   flat_json_init(&j, payload, len);
+//   while ((r = flat_json_next(&j, &f)) > 0) { ... }
+//   if (r < 0) → j.error
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct
+{
+    const char *key;
+    size_t key_len;
+    const char *str; // 文字列値なら先頭（NULL なら整数値で num に入る）
+    size_t str_len;
+    int32_t num;
+} FlatJsonField;
+
+typedef struct
+{
+    const char *p;
+    const char *end;
+    bool started;
+    bool done;
+    const char *error; // 失敗の理由（リテラル）
+} FlatJson;
+
+void flat_json_init(FlatJson *j, const void *buf, size_t len);
+// 次のキーと値を取り出す。1 = 取り出した、0 = オブジェクトの終わり、-1 = 形式エラー（j->error）
+int flat_json_next(FlatJson *j, FlatJsonField *f);
+// 長さ付きの文字列（キーや文字列値）がリテラルと一致するか
+bool flat_json_eq(const char *s, size_t n, const char *lit);
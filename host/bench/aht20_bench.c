@@ -0,0 +1,140 @@
+// read_aht20() の取得経路をデバイスモデル相手に回して、スループット・所要時間・失敗の出方を測る
+//
+//   aht20_bench [-n reads] [-s sim-spec] [-j out.json]
+//
+// sim-spec は MQCENSOR_AHT20_SIM と同じ書式（例: "latency_ms=80,nack=0.05,corrupt=0.01,seed=7"）。
+// 乱数は seed 固定なので、同じ指定なら同じ故障列になる
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "pico/stdlib.h"
+#include "aht20.h"
+#include "aht20_sim.h"
+#include "applog.h"
+
+#define BENCH_DEFAULT_READS 100
+#define BENCH_SUSPECT_C 0.5f // 真値からこれ以上ずれたのに成功扱いになった読み値を「疑わしい」とする
+
+typedef struct
+{
+    uint32_t reads, ok, failed, suspect;
+    uint64_t elapsed_us;
+    uint32_t lat_min_us, lat_p50_us, lat_max_us;
+    double mean_abs_err_c;
+} BenchResult;
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void run(uint32_t n, const Aht20SimConfig *cfg, BenchResult *res)
+{
+    uint32_t *lat = calloc(n, sizeof(uint32_t));
+    double err_sum = 0;
+    memset(res, 0, sizeof(*res));
+    uint64_t start = time_us_64();
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint64_t t0 = time_us_64();
+        AHT22Result r = read_aht20();
+        lat[i] = (uint32_t)(time_us_64() - t0);
+        res->reads++;
+        if (is_failed(&r))
+        {
+            res->failed++;
+        }
+        else
+        {
+            float t, h;
+            aht20_sim_truth((uint32_t)(t0 / 1000) + cfg->latency_ms, &t, &h);
+            float e = fabsf(aht20_temp_c(&r) - t);
+            err_sum += e;
+            res->ok++;
+            if (e > BENCH_SUSPECT_C + cfg->noise)
+                res->suspect++;
+        }
+        applog_drain();
+    }
+    res->elapsed_us = time_us_64() - start;
+    qsort(lat, n, sizeof(uint32_t), cmp_u32);
+    res->lat_min_us = lat[0];
+    res->lat_p50_us = lat[n / 2];
+    res->lat_max_us = lat[n - 1];
+    res->mean_abs_err_c = res->ok ? err_sum / res->ok : 0;
+    free(lat);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t n = BENCH_DEFAULT_READS;
+    const char *spec = "";
+    const char *json_path = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:j:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            n = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            spec = optarg;
+            break;
+        case 'j':
+            json_path = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n reads] [-s sim-spec] [-j out.json]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (n == 0)
+        n = 1;
+
+    stdio_init_all();
+    Aht20SimConfig cfg;
+    aht20_sim_default_config(&cfg);
+    if (!aht20_sim_parse(spec, &cfg) || !aht20_sim_configure(&cfg))
+    {
+        fprintf(stderr, "bad sim spec: %s\n", spec);
+        return 2;
+    }
+    aht20_init();
+
+    BenchResult res;
+    run(n, &cfg, &res);
+    applog_flush();
+    const Aht20SimStats *st = aht20_sim_stats();
+    double rate_hz = res.elapsed_us ? res.reads * 1e6 / (double)res.elapsed_us : 0;
+
+    printf("aht20_bench: reads=%u ok=%u failed=%u suspect=%u rate_hz=%.2f lat_min_us=%u lat_p50_us=%u "
+           "lat_max_us=%u mean_abs_err_c=%.3f\n",
+           res.reads, res.ok, res.failed, res.suspect, rate_hz, res.lat_min_us, res.lat_p50_us, res.lat_max_us,
+           res.mean_abs_err_c);
+    printf("aht20_sim: triggers=%u busy_reads=%u nacks=%u timeouts=%u stuck_busy=%u corrupted=%u\n", st->triggers,
+           st->busy_reads, st->nacks, st->timeouts, st->stuck_busy, st->corrupted);
+
+    if (json_path)
+    {
+        FILE *f = fopen(json_path, "w");
+        if (!f)
+        {
+            perror(json_path);
+            return 1;
+        }
+        fprintf(f,
+                "{\"spec\":\"%s\",\"reads\":%u,\"ok\":%u,\"failed\":%u,\"suspect\":%u,\"rate_hz\":%.3f,"
+                "\"lat_min_us\":%u,\"lat_p50_us\":%u,\"lat_max_us\":%u,\"mean_abs_err_c\":%.4f,"
+                "\"sim\":{\"triggers\":%u,\"busy_reads\":%u,\"nacks\":%u,\"timeouts\":%u,\"stuck_busy\":%u,"
+                "\"corrupted\":%u}}\n",
+                spec, res.reads, res.ok, res.failed, res.suspect, rate_hz, res.lat_min_us, res.lat_p50_us,
+                res.lat_max_us, res.mean_abs_err_c, st->triggers, st->busy_reads, st->nacks, st->timeouts,
+                st->stuck_busy, st->corrupted);
+        fclose(f);
+    }
+    return 0;
+}
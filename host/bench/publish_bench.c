@@ -0,0 +1,476 @@
+// サンプリング → 整形 → mqtt_publish の経路をホストビルドでローカルブローカー相手に回すベンチマーク
+//
+//   publish_bench [-r rates_hz] [-e encodings] [-q qos_list] [-k batch_sizes] [-d seconds]
+//                 [-b broker_ip] [-t tag] [-o results.jsonl（既定 publish_bench.jsonl）]
+//
+//   例: publish_bench -r 1,10,100 -e text,json,bin -q 0,1 -k 1,10 -d 10 -t $(git describe --always) -o bench.jsonl
+//
+// 組み合わせごとに 1 行の JSON を -o に追記する（tools/compare_publish_bench.py で比較できる）。
+// ファームウェア側（lwIP、TAP 経由）が publish し、同じプロセス内の購読スレッドがカーネルの TCP で
+// 同じブローカーから受け取る。時計は同じなので、サンプル取得から受信までを遅延として測れる。
+// ブローカーは 1 コネクション内の順序を保つので、受信の n 番目 = 送信に成功した n 番目のメッセージとして対応付ける
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "pico/stdlib.h"
+#include "pico/cyw43_arch.h"
+#include "wifi_config.h"
+#include "aht20.h"
+#include "aht20_sim.h"
+#include "net.h"
+#include "applog.h"
+#include "host_shim.h"
+
+#define BENCH_TOPIC "pico2w/bench"
+#define BENCH_MAX_PAYLOAD 1024 // MQTT_OUTPUT_RINGBUF_SIZE に収まる大きさ
+#define BENCH_MAX_LIST 8
+#define BENCH_DRAIN_MS 2000 // 計測終了後、受信が追いつくのを待つ上限
+#define BENCH_CONNECT_TIMEOUT_MS 15000
+
+typedef enum
+{
+    ENC_TEXT = 0, // ファームウェアと同じ "Temp=..°C Hum=..%"
+    ENC_JSON,
+    ENC_BIN, // 温湿度を 0.01 単位の int16/uint16 で 4 バイト
+} Encoding;
+static const char *const ENC_NAMES[] = {"text", "json", "bin"};
+
+typedef struct
+{
+    uint32_t rate_hz;
+    Encoding enc;
+    uint8_t qos;
+    uint32_t batch;
+    uint32_t duration_s;
+} BenchCase;
+
+typedef struct
+{
+    uint32_t samples, messages, enqueue_err, received, acked;
+    uint64_t tx_bytes, rx_bytes;
+    uint64_t cpu_ns;
+    uint64_t elapsed_us;
+    uint32_t lat_p50_us, lat_p99_us, lat_p999_us, lat_max_us;
+} BenchResult;
+
+// ---- 購読側（カーネルの TCP で直接 MQTT 3.1.1 を話す最小クライアント） ----
+static int sub_fd = -1;
+static uint64_t *recv_us;
+static size_t recv_cap;
+static atomic_size_t recv_count;
+static atomic_bool sub_stop;
+
+static bool read_full(int fd, void *buf, size_t len)
+{
+    uint8_t *p = buf;
+    while (len)
+    {
+        ssize_t n = read(fd, p, len);
+        if (n <= 0)
+            return false;
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+// 固定ヘッダを読んで、パケット種別と残りの長さを返す
+static bool read_packet_header(int fd, uint8_t *type, uint32_t *remaining)
+{
+    uint8_t b;
+    if (!read_full(fd, &b, 1))
+        return false;
+    *type = b >> 4;
+    uint32_t len = 0;
+    for (int shift = 0; shift < 28; shift += 7)
+    {
+        if (!read_full(fd, &b, 1))
+            return false;
+        len |= (uint32_t)(b & 0x7f) << shift;
+        if (!(b & 0x80))
+            break;
+    }
+    *remaining = len;
+    return true;
+}
+
+static bool skip(int fd, uint32_t len)
+{
+    uint8_t buf[512];
+    while (len)
+    {
+        uint32_t n = len < sizeof(buf) ? len : sizeof(buf);
+        if (!read_full(fd, buf, n))
+            return false;
+        len -= n;
+    }
+    return true;
+}
+
+static bool sub_connect(const char *ip, uint16_t port)
+{
+    sub_fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in sa = {.sin_family = AF_INET, .sin_port = htons(port)};
+    inet_pton(AF_INET, ip, &sa.sin_addr);
+    if (connect(sub_fd, (struct sockaddr *)&sa, sizeof(sa)) < 0)
+        return false;
+    int one = 1;
+    setsockopt(sub_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    static const uint8_t connect_pkt[] = {
+        0x10, 21, 0, 4, 'M', 'Q', 'T', 'T', 4, 0x02, 0, 60, // clean session, keep alive 60s
+        0, 9, 'b', 'e', 'n', 'c', 'h', '-', 's', 'u', 'b'};
+    uint8_t sub_pkt[64];
+    size_t tlen = strlen(BENCH_TOPIC);
+    size_t n = 0;
+    sub_pkt[n++] = 0x82;
+    sub_pkt[n++] = (uint8_t)(2 + 2 + tlen + 1);
+    sub_pkt[n++] = 0;
+    sub_pkt[n++] = 1; // packet id
+    sub_pkt[n++] = 0;
+    sub_pkt[n++] = (uint8_t)tlen;
+    memcpy(sub_pkt + n, BENCH_TOPIC, tlen);
+    n += tlen;
+    sub_pkt[n++] = 0; // QoS 0 で受ける（ブローカー → 購読側の ACK を計測に混ぜない）
+
+    uint8_t type;
+    uint32_t rem;
+    if (write(sub_fd, connect_pkt, sizeof(connect_pkt)) != (ssize_t)sizeof(connect_pkt) ||
+        !read_packet_header(sub_fd, &type, &rem) || type != 2 || !skip(sub_fd, rem))
+        return false;
+    if (write(sub_fd, sub_pkt, n) != (ssize_t)n || !read_packet_header(sub_fd, &type, &rem) || type != 9 ||
+        !skip(sub_fd, rem))
+        return false;
+    return true;
+}
+
+static void *sub_thread(void *arg)
+{
+    (void)arg;
+    while (!atomic_load(&sub_stop))
+    {
+        struct pollfd pfd = {.fd = sub_fd, .events = POLLIN};
+        if (poll(&pfd, 1, 100) <= 0)
+            continue;
+        uint8_t type;
+        uint32_t rem;
+        if (!read_packet_header(sub_fd, &type, &rem))
+            break;
+        uint64_t now = time_us_64();
+        if (type == 3)
+        {
+            size_t i = atomic_load(&recv_count);
+            if (i < recv_cap)
+                recv_us[i] = now;
+            atomic_store(&recv_count, i + 1);
+        }
+        if (!skip(sub_fd, rem))
+            break;
+    }
+    return NULL;
+}
+
+// ---- 送信側 ----
+static volatile uint32_t acked;
+
+static void on_puback(void *arg, err_t result)
+{
+    (void)arg;
+    if (result == ERR_OK)
+        acked++;
+}
+
+static uint64_t thread_cpu_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static size_t encode(Encoding enc, const AHT22Result *r, uint8_t *out, size_t cap, bool first)
+{
+    int n = 0;
+    switch (enc)
+    {
+    case ENC_TEXT:
+        n = first ? 0 : snprintf((char *)out, cap, ";");
+        n += aht20_format(r, (char *)out + n, cap - (size_t)n);
+        break;
+    case ENC_JSON:
+        n = snprintf((char *)out, cap, "%s{\"t\":%.1f,\"h\":%.1f}", first ? "" : ",", aht20_temp_c(r), aht20_hum_pct(r));
+        break;
+    case ENC_BIN:
+        if (cap < 4)
+            return 0;
+        {
+            int16_t t = r->temp_centi;
+            uint16_t h = (uint16_t)r->hum_centi;
+            memcpy(out, &t, 2);
+            memcpy(out + 2, &h, 2);
+        }
+        n = 4;
+        break;
+    }
+    return n > 0 && (size_t)n < cap ? (size_t)n : 0;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void wait_ms(uint32_t ms)
+{
+    sleep_ms(ms);
+    applog_drain();
+}
+
+static bool run_case(const BenchCase *bc, BenchResult *res)
+{
+    uint32_t max_samples = bc->rate_hz * bc->duration_s + 1;
+    uint32_t max_msgs = max_samples / bc->batch + 1;
+    uint64_t *sample_us = calloc(max_samples, sizeof(uint64_t));
+    uint32_t *msg_first = calloc(max_msgs + 1, sizeof(uint32_t)); // 送信に成功した n 番目のメッセージの先頭サンプル
+    uint32_t *lat = calloc(max_samples, sizeof(uint32_t));
+    memset(res, 0, sizeof(*res));
+
+    // 前のケースの残りが届ききってから数え始める
+    wait_ms(200);
+    size_t recv_base = atomic_load(&recv_count);
+    host_net_reset_stats();
+    acked = 0;
+
+    uint8_t payload[BENCH_MAX_PAYLOAD + 1];
+    size_t len = 0;
+    uint32_t in_batch = 0, batch_first = 0;
+    uint64_t period_us = 1000000ull / bc->rate_hz;
+    uint64_t cpu0 = thread_cpu_ns();
+    absolute_time_t start = get_absolute_time();
+    absolute_time_t end = delayed_by_ms(start, bc->duration_s * 1000);
+    absolute_time_t next = start;
+
+    while (!time_reached(end) && res->samples < max_samples)
+    {
+        if (!time_reached(next))
+        {
+            host_loop_run_once(next);
+            continue;
+        }
+        next = delayed_by_us(next, period_us);
+
+        uint32_t idx = res->samples++;
+        sample_us[idx] = time_us_64();
+        aht20_trigger();
+        AHT22Result r = aht20_read_result();
+        if (in_batch == 0)
+            batch_first = idx;
+        len += encode(bc->enc, &r, payload + len, sizeof(payload) - len, in_batch == 0);
+        if (++in_batch < bc->batch)
+            continue;
+
+        err_t err = net_publish_direct(BENCH_TOPIC, payload, (uint16_t)len, bc->qos, bc->qos ? on_puback : NULL, NULL);
+        if (err == ERR_OK)
+            msg_first[res->messages++] = batch_first;
+        else
+            res->enqueue_err++;
+        len = 0;
+        in_batch = 0;
+        applog_drain();
+    }
+    res->elapsed_us = absolute_time_diff_us(start, get_absolute_time());
+    res->cpu_ns = thread_cpu_ns() - cpu0;
+    msg_first[res->messages] = res->samples;
+
+    absolute_time_t drain_until = make_timeout_time_ms(BENCH_DRAIN_MS);
+    while (atomic_load(&recv_count) - recv_base < res->messages && !time_reached(drain_until))
+        host_loop_run_once(delayed_by_ms(get_absolute_time(), 5));
+    res->received = (uint32_t)(atomic_load(&recv_count) - recv_base);
+    res->acked = acked;
+    res->tx_bytes = host_net_stats()->tx_bytes;
+    res->rx_bytes = host_net_stats()->rx_bytes;
+
+    uint32_t nlat = 0;
+    for (uint32_t m = 0; m < res->received && m < res->messages && recv_base + m < recv_cap; m++)
+    {
+        uint64_t t = recv_us[recv_base + m];
+        uint32_t last = m + 1 < res->messages ? msg_first[m + 1] : res->samples;
+        for (uint32_t s = msg_first[m]; s < last && s < msg_first[m] + bc->batch; s++)
+            lat[nlat++] = (uint32_t)(t - sample_us[s]);
+    }
+    if (nlat)
+    {
+        qsort(lat, nlat, sizeof(uint32_t), cmp_u32);
+        res->lat_p50_us = lat[nlat / 2];
+        res->lat_p99_us = lat[(uint32_t)((uint64_t)nlat * 99 / 100)];
+        res->lat_p999_us = lat[(uint32_t)((uint64_t)nlat * 999 / 1000)];
+        res->lat_max_us = lat[nlat - 1];
+    }
+    free(sample_us);
+    free(msg_first);
+    free(lat);
+    return true;
+}
+
+static void write_result(FILE *f, const char *tag, const BenchCase *bc, const BenchResult *r)
+{
+    double secs = r->elapsed_us / 1e6;
+    double per = r->samples ? 1.0 / r->samples : 0;
+    fprintf(f,
+            "{\"tag\":\"%s\",\"rate_hz\":%u,\"encoding\":\"%s\",\"qos\":%u,\"batch\":%u,\"duration_s\":%.3f,"
+            "\"samples\":%u,\"messages\":%u,\"enqueue_err\":%u,\"received\":%u,\"acked\":%u,"
+            "\"msgs_per_s\":%.2f,\"tx_bytes_per_sample\":%.1f,\"rx_bytes_per_sample\":%.1f,"
+            "\"lat_p50_us\":%u,\"lat_p99_us\":%u,\"lat_p999_us\":%u,\"lat_max_us\":%u,\"cpu_us_per_sample\":%.2f}\n",
+            tag, bc->rate_hz, ENC_NAMES[bc->enc], bc->qos, bc->batch, secs, r->samples, r->messages, r->enqueue_err,
+            r->received, r->acked, secs > 0 ? r->received / secs : 0, r->tx_bytes * per, r->rx_bytes * per,
+            r->lat_p50_us, r->lat_p99_us, r->lat_p999_us, r->lat_max_us, r->cpu_ns * per / 1000.0);
+}
+
+static size_t parse_list(const char *s, uint32_t *out, size_t cap, const char *const *names, size_t nnames)
+{
+    char buf[128];
+    size_t n = 0;
+    snprintf(buf, sizeof(buf), "%s", s);
+    for (char *save = NULL, *tok = strtok_r(buf, ",", &save); tok && n < cap; tok = strtok_r(NULL, ",", &save))
+    {
+        if (names)
+        {
+            for (size_t i = 0; i < nnames; i++)
+                if (strcmp(tok, names[i]) == 0)
+                    out[n++] = (uint32_t)i;
+        }
+        else
+        {
+            out[n++] = (uint32_t)strtoul(tok, NULL, 0);
+        }
+    }
+    return n;
+}
+
+static bool connect_firmware(void)
+{
+    if (cyw43_arch_init() || !net_mqtt_init())
+        return false;
+    absolute_time_t until = make_timeout_time_ms(BENCH_CONNECT_TIMEOUT_MS);
+    while (!mqtt_connected && !time_reached(until))
+    {
+        uint32_t next_ms = net_conn_step();
+        sleep_ms(next_ms < 20 ? next_ms : 20);
+        applog_drain();
+    }
+    return mqtt_connected;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t rates[BENCH_MAX_LIST] = {10}, encs[BENCH_MAX_LIST] = {ENC_TEXT}, qoss[BENCH_MAX_LIST] = {0},
+             batches[BENCH_MAX_LIST] = {1};
+    size_t n_rates = 1, n_encs = 1, n_qos = 1, n_batches = 1;
+    uint32_t duration_s = 10;
+    const char *broker = MQTT_BROKER_IP;
+    const char *tag = "";
+    const char *out_path = "publish_bench.jsonl";
+    int opt;
+    while ((opt = getopt(argc, argv, "r:e:q:k:d:b:t:o:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'r':
+            n_rates = parse_list(optarg, rates, BENCH_MAX_LIST, NULL, 0);
+            break;
+        case 'e':
+            n_encs = parse_list(optarg, encs, BENCH_MAX_LIST, ENC_NAMES, count_of(ENC_NAMES));
+            break;
+        case 'q':
+            n_qos = parse_list(optarg, qoss, BENCH_MAX_LIST, NULL, 0);
+            break;
+        case 'k':
+            n_batches = parse_list(optarg, batches, BENCH_MAX_LIST, NULL, 0);
+            break;
+        case 'd':
+            duration_s = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'b':
+            broker = optarg;
+            break;
+        case 't':
+            tag = optarg;
+            break;
+        case 'o':
+            out_path = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-r rates] [-e text,json,bin] [-q 0,1] [-k batches] [-d s] [-b broker] "
+                            "[-t tag] [-o out.jsonl]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+
+    stdio_init_all();
+    // 変換待ちは測らない（I2C の転送時間は i2c シムが実時間で乗せる）
+    Aht20SimConfig sim;
+    aht20_sim_default_config(&sim);
+    aht20_sim_parse("latency_ms=0,wave=sine,temp_amp=2,hum_amp=5", &sim);
+    aht20_sim_configure(&sim);
+    aht20_init();
+
+    uint32_t max_rate = 0, max_dur_msgs;
+    for (size_t i = 0; i < n_rates; i++)
+        if (rates[i] > max_rate)
+            max_rate = rates[i];
+    max_dur_msgs = max_rate * duration_s + 1;
+    recv_cap = max_dur_msgs * (n_rates * n_encs * n_qos * n_batches) + 1024;
+    recv_us = calloc(recv_cap, sizeof(uint64_t));
+
+    if (!sub_connect(broker, MQTT_BROKER_PORT))
+    {
+        fprintf(stderr, "subscriber cannot connect to %s:%d\n", broker, MQTT_BROKER_PORT);
+        return 1;
+    }
+    pthread_t th;
+    pthread_create(&th, NULL, sub_thread, NULL);
+    if (!connect_firmware())
+    {
+        fprintf(stderr, "firmware side cannot connect (TAP / broker)\n");
+        return 1;
+    }
+
+    FILE *out = fopen(out_path, "a");
+    if (!out)
+    {
+        perror(out_path);
+        return 1;
+    }
+    printf("%-6s %-5s %-3s %-5s %9s %8s %8s %10s %10s %10s %9s\n", "rate", "enc", "qos", "batch", "msgs/s", "B/sample",
+           "enq_err", "p50_us", "p99_us", "p999_us", "cpu_us");
+    for (size_t ri = 0; ri < n_rates; ri++)
+        for (size_t ei = 0; ei < n_encs; ei++)
+            for (size_t qi = 0; qi < n_qos; qi++)
+                for (size_t bi = 0; bi < n_batches; bi++)
+                {
+                    BenchCase bc = {rates[ri] ? rates[ri] : 1, (Encoding)encs[ei], (uint8_t)qoss[qi],
+                                    batches[bi] ? batches[bi] : 1, duration_s ? duration_s : 1};
+                    BenchResult r;
+                    run_case(&bc, &r);
+                    double per = r.samples ? 1.0 / r.samples : 0;
+                    printf("%-6u %-5s %-3u %-5u %9.1f %8.1f %8u %10u %10u %10u %9.2f\n", bc.rate_hz, ENC_NAMES[bc.enc],
+                           bc.qos, bc.batch, r.received / (r.elapsed_us / 1e6), r.tx_bytes * per, r.enqueue_err,
+                           r.lat_p50_us, r.lat_p99_us, r.lat_p999_us, r.cpu_ns * per / 1000.0);
+                    write_result(out, tag, &bc, &r);
+                }
+    fclose(out);
+    atomic_store(&sub_stop, true);
+    pthread_join(th, NULL);
+    return 0;
+}
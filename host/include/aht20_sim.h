@@ -0,0 +1,65 @@
+#pragma once
+// ホストビルド用の AHT20 デバイスモデル（I2C 0x38）
+//   - 0xAC トリガ → 変換中は status の busy ビット（bit7）、latency_ms 後に新しい値
+//   - 応答は status + 湿度/温度 20bit ずつ + CRC8（6/7 バイト）
+//   - 温湿度は波形（一定・正弦・のこぎり・ステップ・CSV スクリプト・連番）+ ノイズ
+//   - 故障注入：NACK・タイムアウト・busy 張り付き・データ化け（乱数は seed で再現可能）
+// 起動時に環境変数 MQCENSOR_AHT20_SIM（"key=value,..."、キーは aht20_sim_parse 参照）で設定できる
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum
+{
+    AHT20_SIM_WAVE_CONST = 0,
+    AHT20_SIM_WAVE_SINE,
+    AHT20_SIM_WAVE_RAMP, // 周期ごとに -amp → +amp を繰り返すのこぎり波
+    AHT20_SIM_WAVE_STEP, // 半周期ごとに -amp / +amp
+    AHT20_SIM_WAVE_SCRIPT,
+    AHT20_SIM_WAVE_COUNT, // 変換ごとに 1 ずつ進む連番（欠損・重複の検出用。aht20_sim_count_value 参照）
+} Aht20SimWave;
+
+typedef struct
+{
+    Aht20SimWave wave;
+    float temp_c; // 中心値
+    float hum;
+    float temp_amp; // 振幅
+    float hum_amp;
+    uint32_t period_ms;
+    float noise; // 一様ノイズの幅（±）
+    // "t_ms,temp,hum" の CSV。行間は線形補間、最後まで行ったら先頭へ
+    const char *script_path;
+    uint32_t latency_ms; // 変換時間
+    uint32_t seed;
+    // トランザクションごとの発生確率（0..1）
+    float p_nack;
+    float p_timeout;
+    float p_stuck_busy;
+    float p_corrupt;
+    uint32_t stuck_busy_ms; // busy 張り付きが続く時間（0xBA ソフトリセットでも解ける）
+} Aht20SimConfig;
+
+typedef struct
+{
+    uint32_t writes;
+    uint32_t reads;
+    uint32_t triggers;
+    uint32_t busy_reads; // busy ビットが立った状態で読まれた回数
+    uint32_t nacks;
+    uint32_t timeouts;
+    uint32_t stuck_busy;
+    uint32_t corrupted;
+} Aht20SimStats;
+
+void aht20_sim_default_config(Aht20SimConfig *c);
+// "wave=sine,temp=22.5,temp_amp=3,period_ms=60000,latency_ms=80,nack=0.01,seed=1" のような指定を c に重ねる
+bool aht20_sim_parse(const char *spec, Aht20SimConfig *c);
+bool aht20_sim_configure(const Aht20SimConfig *c);
+const Aht20SimStats *aht20_sim_stats(void);
+void aht20_sim_reset_stats(void);
+// 時刻 t_ms（起動からの ms）での波形の真値（ノイズなし）
+void aht20_sim_truth(uint32_t t_ms, float *temp_c, float *hum);
+// 連番波形で n 番目の変換が返す値。温度 -40.0〜79.9 を 0.1 刻み、桁上がりで湿度 0.1 刻み
+// （publish の "%.1f" から seq = (temp + 40) * 10 + hum * 10 * AHT20_SIM_COUNT_TEMP_STEPS で戻せる）
+#define AHT20_SIM_COUNT_TEMP_STEPS 1200
+void aht20_sim_count_value(uint32_t n, float *temp_c, float *hum);
@@ -0,0 +1,17 @@
+#pragma once
+// lwIP のホスト（Linux / gcc）向けポート定義
+#include <stdio.h>
+#include <stdlib.h>
+
+#define LWIP_PLATFORM_DIAG(x) \
+    do                        \
+    {                         \
+        printf x;             \
+    } while (0)
+#define LWIP_PLATFORM_ASSERT(x)                                                         \
+    do                                                                                  \
+    {                                                                                   \
+        fprintf(stderr, "lwIP assertion \"%s\" failed at %s:%d\n", x, __FILE__, __LINE__); \
+        abort();                                                                        \
+    } while (0)
+#define LWIP_RAND() ((u32_t)random())
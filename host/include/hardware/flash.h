@@ -0,0 +1,17 @@
+#pragma once
+// ホストビルド用の hardware/flash 代替。フラッシュは MQCENSOR_HOST_FLASH のファイル（既定 mqcensor_flash.bin）を
+// mmap したもので、XIP_BASE からそのまま読める。再 exec（WDT リセット）をまたいで中身が残る
+#include <stddef.h>
+#include <stdint.h>
+
+#define FLASH_PAGE_SIZE (1u << 8)
+#define FLASH_SECTOR_SIZE (1u << 12)
+#ifndef PICO_FLASH_SIZE_BYTES
+#define PICO_FLASH_SIZE_BYTES (4 * 1024 * 1024)
+#endif
+
+const uint8_t *host_flash_base(void);
+#define XIP_BASE ((uintptr_t)host_flash_base())
+
+void flash_range_erase(uint32_t flash_offs, size_t count);
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count);
@@ -0,0 +1,15 @@
+#pragma once
+// ホストビルド用の hardware/i2c 代替。アドレスごとに登録したデバイスモデルへ転送する
+#include "pico/stdlib.h"
+
+typedef struct i2c_inst i2c_inst_t;
+extern i2c_inst_t *const i2c0;
+extern i2c_inst_t *const i2c1;
+
+unsigned i2c_init(i2c_inst_t *i2c, unsigned baudrate);
+int i2c_write_timeout_us(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop,
+                         unsigned timeout_us);
+int i2c_read_timeout_us(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop,
+                        unsigned timeout_us);
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop);
+int i2c_read_blocking(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop);
@@ -0,0 +1,8 @@
+#pragma once
+// ホストでは割り込みが無いので、__wfe() は「イベントループを 1 回まわす」に置き換える
+void host_loop_wfe(void);
+
+#define __wfe() host_loop_wfe()
+#define __wfi() host_loop_wfe()
+#define __sev() ((void)0)
+#define __dmb() __atomic_thread_fence(__ATOMIC_SEQ_CST)
@@ -0,0 +1,17 @@
+#pragma once
+// ホストビルド用の hardware/watchdog 代替。期限切れ（と watchdog_reboot）はプロセスを
+// 自分自身で exec し直すことで「リセット」とし、scratch レジスタは環境変数で引き継ぐ
+#include "pico/stdlib.h"
+
+typedef struct
+{
+    volatile uint32_t scratch[8];
+} watchdog_hw_t;
+extern watchdog_hw_t *const watchdog_hw;
+
+void watchdog_enable(uint32_t delay_ms, bool pause_on_debug);
+void watchdog_update(void);
+void watchdog_reboot(uint32_t pc, uint32_t sp, uint32_t delay_ms);
+bool watchdog_caused_reboot(void);
+bool watchdog_enable_caused_reboot(void);
+uint32_t watchdog_get_time_remaining_ms(void);
@@ -0,0 +1,45 @@
+#pragma once
+// シム同士（とホスト専用のデバイスモデル）が使う内部 API。ファームウェア側からは使わない
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "pico/stdlib.h"
+
+// ---- イベントループ（loop.c） ----
+// 期限の来たタイマー・ワーカーを実行し、ネットワークを見て、until か次の予定まで眠る
+void host_loop_run_once(absolute_time_t until);
+// ワーカー/タイマーの実行中か（中からの sleep はループを回さずに眠る）
+bool host_loop_in_callback(void);
+
+// cyw43_arch_async_context() の実体
+typedef struct async_context async_context_t;
+async_context_t *host_async_context(void);
+
+// 各シムが持つ「次の予定」。予定がなければ at_the_end_of_time
+absolute_time_t host_timers_run(void);
+absolute_time_t host_async_run(void);
+// ネットワーク：受信処理と lwIP のタイマー。待つべき fd（なければ -1）と次の予定を返す
+int host_net_poll(absolute_time_t *next_out);
+
+// TAP 上を流れたバイト数（Ethernet ヘッダ込み）
+typedef struct
+{
+    uint64_t tx_bytes;
+    uint64_t rx_bytes;
+    uint32_t tx_frames;
+    uint32_t rx_frames;
+} HostNetStats;
+const HostNetStats *host_net_stats(void);
+void host_net_reset_stats(void);
+
+// ---- I2C デバイスモデル（i2c.c） ----
+typedef struct
+{
+    // 戻り値は SDK と同じ：転送したバイト数、PICO_ERROR_GENERIC（NACK）、PICO_ERROR_TIMEOUT
+    // timeout_us は SDK の *_timeout_us に渡された値（blocking 版は 0 = 無制限）
+    int (*write)(void *ctx, const uint8_t *src, size_t len, unsigned timeout_us);
+    int (*read)(void *ctx, uint8_t *dst, size_t len, unsigned timeout_us);
+    void *ctx;
+} HostI2cDevice;
+
+void host_i2c_attach(uint8_t addr, const HostI2cDevice *dev);
@@ -0,0 +1,9 @@
+#pragma once
+// ホストビルド用。ファームウェアと同じ設定に、64bit・1 スレッド前提の差分だけを足す
+#include "../../lwipopts.h"
+
+// ポインタを含む構造体を pbuf/mem から取るので 64bit ではポインタ幅に揃える
+#undef MEM_ALIGNMENT
+#define MEM_ALIGNMENT 8
+// lwIP を触るのはイベントループのスレッドだけ
+#define SYS_LIGHTWEIGHT_PROT 0
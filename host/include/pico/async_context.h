@@ -0,0 +1,21 @@
+#pragma once
+// ホストビルド用の pico/async_context 代替。at-time ワーカーだけを 1 スレッドのループで回す
+#include "pico/stdlib.h"
+
+typedef struct async_context async_context_t;
+
+typedef struct async_work_on_timeout
+{
+    struct async_work_on_timeout *next;
+    void (*do_work)(async_context_t *context, struct async_work_on_timeout *timeout);
+    absolute_time_t next_time;
+    void *user_data;
+} async_at_time_worker_t;
+
+bool async_context_add_at_time_worker_at(async_context_t *context, async_at_time_worker_t *worker,
+                                         absolute_time_t at);
+bool async_context_add_at_time_worker_in_ms(async_context_t *context, async_at_time_worker_t *worker,
+                                            uint32_t ms);
+bool async_context_remove_at_time_worker(async_context_t *context, async_at_time_worker_t *worker);
+static inline void async_context_acquire_lock_blocking(async_context_t *context) { (void)context; }
+static inline void async_context_release_lock(async_context_t *context) { (void)context; }
@@ -0,0 +1,53 @@
+#pragma once
+// ホストビルド用の pico/cyw43_arch 代替。Wi-Fi の代わりに TAP デバイスを lwIP の netif にする
+// （アソシエーション = TAP を開いてリンク UP、DHCP = 静的 IP の設定）
+#include "pico/stdlib.h"
+#include "pico/async_context.h"
+#include "lwip/netif.h"
+
+typedef struct
+{
+    struct netif netif[2];
+} cyw43_t;
+extern cyw43_t cyw43_state;
+
+#define CYW43_ITF_STA 0
+#define CYW43_ITF_AP 1
+
+#define CYW43_LINK_DOWN 0
+#define CYW43_LINK_JOIN 1
+#define CYW43_LINK_NOIP 2
+#define CYW43_LINK_UP 3
+#define CYW43_LINK_FAIL -1
+#define CYW43_LINK_NONET -2
+#define CYW43_LINK_BADAUTH -3
+
+#define CYW43_AUTH_OPEN 0
+#define CYW43_AUTH_WPA2_AES_PSK 0x00400004
+
+#define CYW43_WL_GPIO_LED_PIN 0
+
+// 省電力モードの値は SDK と同じ（ホストでは覚えておくだけ）
+#define CYW43_DEFAULT_PM 0xa11142
+#define CYW43_AGGRESSIVE_PM 0xa11c82
+#define CYW43_PERFORMANCE_PM 0x111022
+#define CYW43_NONE_PM 0x10
+
+int cyw43_arch_init(void);
+void cyw43_arch_deinit(void);
+void cyw43_arch_enable_sta_mode(void);
+void cyw43_arch_disable_sta_mode(void);
+int cyw43_arch_wifi_connect_async(const char *ssid, const char *pw, uint32_t auth);
+int cyw43_arch_wifi_connect_timeout_ms(const char *ssid, const char *pw, uint32_t auth, uint32_t timeout_ms);
+void cyw43_arch_gpio_put(unsigned wl_gpio, bool value);
+void cyw43_arch_poll(void);
+async_context_t *cyw43_arch_async_context(void);
+// 1 スレッドで動くのでロックは不要
+static inline void cyw43_arch_lwip_begin(void) {}
+static inline void cyw43_arch_lwip_end(void) {}
+
+int cyw43_wifi_link_status(cyw43_t *self, int itf);
+int cyw43_tcpip_link_status(cyw43_t *self, int itf);
+int cyw43_wifi_pm(cyw43_t *self, uint32_t pm);
+int cyw43_wifi_get_pm(cyw43_t *self, uint32_t *pm);
+int cyw43_wifi_set_up(cyw43_t *self, int itf, bool up, uint32_t country);
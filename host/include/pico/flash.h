@@ -0,0 +1,5 @@
+#pragma once
+// ホストビルド用の pico/flash 代替。止めるべき他のコアも割り込みも無いので、その場で呼ぶだけ
+#include <stdint.h>
+
+int flash_safe_execute(void (*func)(void *), void *param, uint32_t enter_exit_timeout_ms);
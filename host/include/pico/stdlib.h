@@ -0,0 +1,83 @@
+#pragma once
+// ホストビルド用の pico/stdlib 代替。ファームウェアが使う分だけを Linux 上で実装する
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "hardware/sync.h"
+
+#define PICO_OK 0
+#define PICO_ERROR_GENERIC -1
+#define PICO_ERROR_TIMEOUT -2
+
+// 時刻は CLOCK_MONOTONIC をプロセス起動時刻からの µs にしたもの
+typedef uint64_t absolute_time_t;
+#define at_the_end_of_time ((absolute_time_t)INT64_MAX)
+#define nil_time ((absolute_time_t)0)
+
+uint64_t time_us_64(void);
+static inline uint32_t time_us_32(void) { return (uint32_t)time_us_64(); }
+static inline absolute_time_t get_absolute_time(void) { return time_us_64(); }
+static inline uint64_t to_us_since_boot(absolute_time_t t) { return t; }
+static inline uint32_t to_ms_since_boot(absolute_time_t t) { return (uint32_t)(t / 1000); }
+static inline absolute_time_t from_us_since_boot(uint64_t us) { return us; }
+static inline absolute_time_t delayed_by_us(absolute_time_t t, uint64_t us) { return t + us; }
+static inline absolute_time_t delayed_by_ms(absolute_time_t t, uint32_t ms) { return t + ms * 1000ull; }
+static inline absolute_time_t make_timeout_time_us(uint64_t us) { return time_us_64() + us; }
+static inline absolute_time_t make_timeout_time_ms(uint32_t ms) { return time_us_64() + ms * 1000ull; }
+static inline int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to) { return (int64_t)(to - from); }
+static inline bool time_reached(absolute_time_t t) { return time_us_64() >= t; }
+static inline bool is_nil_time(absolute_time_t t) { return t == nil_time; }
+
+// ワーカーの外から呼ばれたときは、待つ間もイベントループ（ネットワーク・ワーカー）を回す
+// （threadsafe_background で sleep 中も IRQ 側が動くのと同じ見え方にする）
+void sleep_until(absolute_time_t t);
+void sleep_us(uint64_t us);
+void sleep_ms(uint32_t ms);
+void busy_wait_us(uint64_t us);
+void busy_wait_ms(uint32_t ms);
+static inline void tight_loop_contents(void) {}
+
+typedef struct repeating_timer repeating_timer_t;
+typedef bool (*repeating_timer_callback_t)(repeating_timer_t *rt);
+struct repeating_timer
+{
+    int64_t delay_us; // 負なら開始時刻基準の周期
+    void *user_data;
+    repeating_timer_callback_t callback;
+    absolute_time_t next_time;
+    repeating_timer_t *next;
+};
+bool add_repeating_timer_us(int64_t delay_us, repeating_timer_callback_t callback, void *user_data,
+                            repeating_timer_t *out);
+static inline bool add_repeating_timer_ms(int32_t delay_ms, repeating_timer_callback_t callback, void *user_data,
+                                          repeating_timer_t *out)
+{
+    return add_repeating_timer_us(delay_ms * 1000ll, callback, user_data, out);
+}
+bool cancel_repeating_timer(repeating_timer_t *timer);
+
+// GPIO はホストでは何もしない
+enum gpio_function
+{
+    GPIO_FUNC_I2C = 3,
+    GPIO_FUNC_SIO = 5,
+};
+#define GPIO_OUT 1
+#define GPIO_IN 0
+static inline void gpio_init(unsigned gpio) { (void)gpio; }
+static inline void gpio_set_function(unsigned gpio, enum gpio_function fn) { (void)gpio; (void)fn; }
+static inline void gpio_pull_up(unsigned gpio) { (void)gpio; }
+static inline void gpio_set_dir(unsigned gpio, bool out) { (void)gpio; (void)out; }
+static inline void gpio_put(unsigned gpio, bool value) { (void)gpio; (void)value; }
+static inline bool gpio_get(unsigned gpio) { (void)gpio; return false; }
+
+bool stdio_init_all(void);
+void stdio_flush(void);
+
+#define count_of(a) (sizeof(a) / sizeof((a)[0]))
+#define __not_in_flash_func(f) f
+#define __no_inline_not_in_flash_func(f) __attribute__((noinline)) f
+#define __time_critical_func(f) f
+#define __uninitialized_ram(v) v
+#define hard_assert(x) ((void)0)
@@ -0,0 +1,14 @@
+#pragma once
+// ホストビルド用の pico/unique_id 代替。ID は MQCENSOR_BOARD_ID（16 桁の 16 進）か、ホスト名と TAP 名から作る
+#include <stdint.h>
+
+#define PICO_UNIQUE_BOARD_ID_SIZE_BYTES 8
+
+typedef struct
+{
+    uint8_t id[PICO_UNIQUE_BOARD_ID_SIZE_BYTES];
+} pico_unique_board_id_t;
+
+void pico_get_unique_board_id(pico_unique_board_id_t *id_out);
+// SDK と同じく大文字の 16 進。len は 2 * PICO_UNIQUE_BOARD_ID_SIZE_BYTES + 1 以上
+void pico_get_unique_board_id_string(char *id_out, unsigned len);
@@ -0,0 +1,7 @@
+#pragma once
+// ホストビルドでは SSID/パスワードは使わない。ブローカーは TAP の向こう側（ホスト）で動かす
+#define WIFI_SSID "host-tap"
+#define WIFI_PASS ""
+#ifndef MQTT_BROKER_IP
+#define MQTT_BROKER_IP "192.168.7.1"
+#endif
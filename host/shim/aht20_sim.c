@@ -0,0 +1,398 @@
+// ホストビルド用の AHT20（I2C 0x38）デバイスモデル。仕様は aht20_sim.h
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "pico/stdlib.h"
+#include "aht20_sim.h"
+#include "host_shim.h"
+
+#define AHT20_SIM_ADDR 0x38
+#define AHT20_SIM_ENV "MQCENSOR_AHT20_SIM"
+#define AHT20_SIM_SCRIPT_MAX 1024
+
+#define AHT20_STATUS_BUSY 0x80
+#define AHT20_STATUS_CAL 0x08
+#define AHT20_STATUS_IDLE 0x18 // 初期化済みの通常値
+
+typedef struct
+{
+    uint32_t t_ms;
+    float temp_c;
+    float hum;
+} ScriptPoint;
+
+typedef struct
+{
+    Aht20SimConfig cfg;
+    Aht20SimStats stats;
+    uint32_t rng;
+    uint8_t status;
+    bool converting;
+    absolute_time_t ready_at;
+    absolute_time_t stuck_until;
+    uint32_t raw_h, raw_t; // 最後に変換が終わった値
+    uint32_t count;        // 連番波形の次の値（トリガごとに進む）
+    uint32_t count_now;    // 変換中の連番
+    ScriptPoint script[AHT20_SIM_SCRIPT_MAX];
+    size_t script_len;
+} Aht20Sim;
+
+static Aht20Sim sim;
+
+// xorshift32。seed が同じなら故障の出方も同じになる
+static uint32_t rng_next(void)
+{
+    uint32_t x = sim.rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return sim.rng = x;
+}
+
+static float rng_unit(void)
+{
+    return (rng_next() >> 8) * (1.0f / 16777216.0f);
+}
+
+static bool roll(float p)
+{
+    return p > 0 && rng_unit() < p;
+}
+
+static uint8_t crc8(const uint8_t *p, size_t len)
+{
+    uint8_t crc = 0xFF;
+    for (size_t i = 0; i < len; i++)
+    {
+        crc ^= p[i];
+        for (int b = 0; b < 8; b++)
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1);
+    }
+    return crc;
+}
+
+static bool load_script(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return false;
+    char line[128];
+    sim.script_len = 0;
+    while (fgets(line, sizeof(line), f) && sim.script_len < AHT20_SIM_SCRIPT_MAX)
+    {
+        ScriptPoint p;
+        unsigned long t;
+        if (sscanf(line, "%lu,%f,%f", &t, &p.temp_c, &p.hum) == 3)
+        {
+            p.t_ms = (uint32_t)t;
+            sim.script[sim.script_len++] = p;
+        }
+    }
+    fclose(f);
+    return sim.script_len > 0;
+}
+
+static void script_at(uint32_t t_ms, float *temp_c, float *hum)
+{
+    const ScriptPoint *s = sim.script;
+    size_t n = sim.script_len;
+    uint32_t span = s[n - 1].t_ms;
+    uint32_t t = span ? t_ms % span : 0;
+    size_t i = 0;
+    while (i + 1 < n && s[i + 1].t_ms <= t)
+        i++;
+    if (i + 1 >= n || s[i + 1].t_ms == s[i].t_ms)
+    {
+        *temp_c = s[i].temp_c;
+        *hum = s[i].hum;
+        return;
+    }
+    float k = (float)(t - s[i].t_ms) / (float)(s[i + 1].t_ms - s[i].t_ms);
+    *temp_c = s[i].temp_c + (s[i + 1].temp_c - s[i].temp_c) * k;
+    *hum = s[i].hum + (s[i + 1].hum - s[i].hum) * k;
+}
+
+void aht20_sim_truth(uint32_t t_ms, float *temp_c, float *hum)
+{
+    const Aht20SimConfig *c = &sim.cfg;
+    if (c->wave == AHT20_SIM_WAVE_SCRIPT && sim.script_len)
+    {
+        script_at(t_ms, temp_c, hum);
+        return;
+    }
+    float phase = c->period_ms ? (float)(t_ms % c->period_ms) / (float)c->period_ms : 0.0f;
+    float shape = 0.0f;
+    switch (c->wave)
+    {
+    case AHT20_SIM_WAVE_SINE:
+        shape = sinf(2.0f * (float)M_PI * phase);
+        break;
+    case AHT20_SIM_WAVE_RAMP:
+        shape = 2.0f * phase - 1.0f;
+        break;
+    case AHT20_SIM_WAVE_STEP:
+        shape = phase < 0.5f ? -1.0f : 1.0f;
+        break;
+    default:
+        break;
+    }
+    *temp_c = c->temp_c + c->temp_amp * shape;
+    *hum = c->hum + c->hum_amp * shape;
+}
+
+void aht20_sim_count_value(uint32_t n, float *temp_c, float *hum)
+{
+    *temp_c = -40.0f + 0.1f * (float)(n % AHT20_SIM_COUNT_TEMP_STEPS);
+    *hum = 0.1f * (float)((n / AHT20_SIM_COUNT_TEMP_STEPS) % 1000);
+}
+
+static uint32_t to_raw(float v)
+{
+    if (v < 0.0f)
+        return 0;
+    uint32_t raw = (uint32_t)(v * 1048576.0f);
+    return raw > 0xFFFFF ? 0xFFFFF : raw;
+}
+
+// 変換が終わっていれば測定値を確定させる
+static void update_conversion(void)
+{
+    absolute_time_t now = get_absolute_time();
+    if (!sim.converting || now < sim.ready_at || now < sim.stuck_until)
+        return;
+    float t, h;
+    if (sim.cfg.wave == AHT20_SIM_WAVE_COUNT)
+        aht20_sim_count_value(sim.count_now, &t, &h);
+    else
+        aht20_sim_truth(to_ms_since_boot(sim.ready_at), &t, &h);
+    t += sim.cfg.noise * (2.0f * rng_unit() - 1.0f);
+    h += sim.cfg.noise * (2.0f * rng_unit() - 1.0f);
+    sim.raw_t = to_raw((t + 50.0f) / 200.0f);
+    sim.raw_h = to_raw(h / 100.0f);
+    sim.converting = false;
+}
+
+static bool busy(void)
+{
+    update_conversion();
+    return sim.converting;
+}
+
+// NACK / タイムアウトを注入したら SDK と同じ戻り値を返す（0 なら通常処理）
+static int inject_bus_fault(unsigned timeout_us)
+{
+    if (roll(sim.cfg.p_nack))
+    {
+        sim.stats.nacks++;
+        return PICO_ERROR_GENERIC;
+    }
+    if (roll(sim.cfg.p_timeout))
+    {
+        sim.stats.timeouts++;
+        // SCL ストレッチで待たされた分だけ実時間も使う
+        if (timeout_us)
+            busy_wait_us(timeout_us);
+        return PICO_ERROR_TIMEOUT;
+    }
+    return 0;
+}
+
+static int sim_write(void *ctx, const uint8_t *src, size_t len, unsigned timeout_us)
+{
+    (void)ctx;
+    sim.stats.writes++;
+    int fault = inject_bus_fault(timeout_us);
+    if (fault)
+        return fault;
+    if (len == 0)
+        return 0;
+
+    switch (src[0])
+    {
+    case 0xAC: // 測定トリガ（0xAC 0x33 0x00）
+        if (len == 3 && src[1] == 0x33 && src[2] == 0x00 && !busy())
+        {
+            sim.stats.triggers++;
+            sim.count_now = sim.count++;
+            sim.converting = true;
+            sim.ready_at = make_timeout_time_ms(sim.cfg.latency_ms);
+            if (roll(sim.cfg.p_stuck_busy))
+            {
+                sim.stats.stuck_busy++;
+                sim.stuck_until = make_timeout_time_ms(sim.cfg.stuck_busy_ms);
+            }
+        }
+        break;
+    case 0xBE: // 初期化（キャリブレーション有効）
+        sim.status |= AHT20_STATUS_CAL;
+        break;
+    case 0xBA: // ソフトリセット
+        sim.converting = false;
+        sim.stuck_until = nil_time;
+        sim.status = AHT20_STATUS_IDLE;
+        break;
+    default:
+        break;
+    }
+    return (int)len;
+}
+
+static int sim_read(void *ctx, uint8_t *dst, size_t len, unsigned timeout_us)
+{
+    (void)ctx;
+    sim.stats.reads++;
+    int fault = inject_bus_fault(timeout_us);
+    if (fault)
+        return fault;
+
+    // 変換中は busy を立てて前回の値を返す（実機と同じ）
+    uint8_t frame[7] = {
+        (uint8_t)(sim.status | (busy() ? AHT20_STATUS_BUSY : 0)),
+        (uint8_t)(sim.raw_h >> 12),
+        (uint8_t)(sim.raw_h >> 4),
+        (uint8_t)(((sim.raw_h & 0x0f) << 4) | ((sim.raw_t >> 16) & 0x0f)),
+        (uint8_t)(sim.raw_t >> 8),
+        (uint8_t)sim.raw_t,
+        0,
+    };
+    frame[6] = crc8(frame, 6);
+    if (frame[0] & AHT20_STATUS_BUSY)
+        sim.stats.busy_reads++;
+    if (roll(sim.cfg.p_corrupt))
+    {
+        // データ部のどこか 1 ビットを反転（CRC は元のまま）
+        sim.stats.corrupted++;
+        frame[1 + rng_next() % 5] ^= (uint8_t)(1u << (rng_next() % 8));
+    }
+    size_t n = len < sizeof(frame) ? len : sizeof(frame);
+    memcpy(dst, frame, n);
+    return (int)n;
+}
+
+void aht20_sim_default_config(Aht20SimConfig *c)
+{
+    memset(c, 0, sizeof(*c));
+    c->wave = AHT20_SIM_WAVE_CONST;
+    c->temp_c = 22.5f;
+    c->hum = 50.0f;
+    c->period_ms = 60000;
+    c->latency_ms = 80;
+    c->seed = 1;
+    c->stuck_busy_ms = 5000;
+}
+
+static bool parse_wave(const char *v, Aht20SimWave *out)
+{
+    static const char *const names[] = {"const", "sine", "ramp", "step", "script", "count"};
+    for (size_t i = 0; i < count_of(names); i++)
+    {
+        if (strcmp(v, names[i]) == 0)
+        {
+            *out = (Aht20SimWave)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool aht20_sim_parse(const char *spec, Aht20SimConfig *c)
+{
+    static char buf[512]; // script_path がここを指すので static
+    snprintf(buf, sizeof(buf), "%s", spec);
+    for (char *save = NULL, *kv = strtok_r(buf, ",", &save); kv; kv = strtok_r(NULL, ",", &save))
+    {
+        char *v = strchr(kv, '=');
+        if (!v)
+            return false;
+        *v++ = '\0';
+        if (strcmp(kv, "wave") == 0)
+        {
+            if (!parse_wave(v, &c->wave))
+                return false;
+        }
+        else if (strcmp(kv, "script") == 0)
+        {
+            c->wave = AHT20_SIM_WAVE_SCRIPT;
+            c->script_path = v;
+        }
+        else if (strcmp(kv, "temp") == 0)
+            c->temp_c = strtof(v, NULL);
+        else if (strcmp(kv, "hum") == 0)
+            c->hum = strtof(v, NULL);
+        else if (strcmp(kv, "temp_amp") == 0)
+            c->temp_amp = strtof(v, NULL);
+        else if (strcmp(kv, "hum_amp") == 0)
+            c->hum_amp = strtof(v, NULL);
+        else if (strcmp(kv, "period_ms") == 0)
+            c->period_ms = (uint32_t)strtoul(v, NULL, 0);
+        else if (strcmp(kv, "noise") == 0)
+            c->noise = strtof(v, NULL);
+        else if (strcmp(kv, "latency_ms") == 0)
+            c->latency_ms = (uint32_t)strtoul(v, NULL, 0);
+        else if (strcmp(kv, "seed") == 0)
+            c->seed = (uint32_t)strtoul(v, NULL, 0);
+        else if (strcmp(kv, "nack") == 0)
+            c->p_nack = strtof(v, NULL);
+        else if (strcmp(kv, "timeout") == 0)
+            c->p_timeout = strtof(v, NULL);
+        else if (strcmp(kv, "stuck_busy") == 0)
+            c->p_stuck_busy = strtof(v, NULL);
+        else if (strcmp(kv, "stuck_busy_ms") == 0)
+            c->stuck_busy_ms = (uint32_t)strtoul(v, NULL, 0);
+        else if (strcmp(kv, "corrupt") == 0)
+            c->p_corrupt = strtof(v, NULL);
+        else
+            return false;
+    }
+    return true;
+}
+
+bool aht20_sim_configure(const Aht20SimConfig *c)
+{
+    sim.cfg = *c;
+    sim.rng = c->seed ? c->seed : 1;
+    sim.status = AHT20_STATUS_IDLE;
+    sim.converting = false;
+    sim.stuck_until = nil_time;
+    sim.script_len = 0;
+    sim.count = 0;
+    if (c->wave == AHT20_SIM_WAVE_SCRIPT && (!c->script_path || !load_script(c->script_path)))
+    {
+        sim.cfg.wave = AHT20_SIM_WAVE_CONST;
+        return false;
+    }
+    // 電源投入直後でも読めるよう、最初の値を入れておく
+    float t, h;
+    aht20_sim_truth(0, &t, &h);
+    sim.raw_t = to_raw((t + 50.0f) / 200.0f);
+    sim.raw_h = to_raw(h / 100.0f);
+    aht20_sim_reset_stats();
+    return true;
+}
+
+const Aht20SimStats *aht20_sim_stats(void)
+{
+    return &sim.stats;
+}
+
+void aht20_sim_reset_stats(void)
+{
+    memset(&sim.stats, 0, sizeof(sim.stats));
+}
+
+__attribute__((constructor)) static void aht20_sim_attach(void)
+{
+    Aht20SimConfig c;
+    aht20_sim_default_config(&c);
+    const char *spec = getenv(AHT20_SIM_ENV);
+    if (spec && !aht20_sim_parse(spec, &c))
+    {
+        fprintf(stderr, "[host] bad %s=\"%s\", using defaults\n", AHT20_SIM_ENV, spec);
+        aht20_sim_default_config(&c);
+    }
+    if (!aht20_sim_configure(&c))
+        fprintf(stderr, "[host] cannot load AHT20 script %s\n", c.script_path);
+
+    HostI2cDevice dev = {.write = sim_write, .read = sim_read, .ctx = &sim};
+    host_i2c_attach(AHT20_SIM_ADDR, &dev);
+}
@@ -0,0 +1,63 @@
+// pico/async_context の at-time ワーカー。cyw43_arch_async_context() が返すのはこの 1 つだけ
+#include "pico/async_context.h"
+#include "host_shim.h"
+
+struct async_context
+{
+    async_at_time_worker_t *at_time_list; // next_time 順
+};
+
+static async_context_t host_context;
+
+async_context_t *host_async_context(void)
+{
+    return &host_context;
+}
+
+bool async_context_remove_at_time_worker(async_context_t *context, async_at_time_worker_t *worker)
+{
+    for (async_at_time_worker_t **p = &context->at_time_list; *p; p = &(*p)->next)
+    {
+        if (*p == worker)
+        {
+            *p = worker->next;
+            worker->next = NULL;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool async_context_add_at_time_worker_at(async_context_t *context, async_at_time_worker_t *worker,
+                                         absolute_time_t at)
+{
+    async_context_remove_at_time_worker(context, worker);
+    worker->next_time = at;
+    async_at_time_worker_t **p = &context->at_time_list;
+    while (*p && (*p)->next_time <= at)
+        p = &(*p)->next;
+    worker->next = *p;
+    *p = worker;
+    return true;
+}
+
+bool async_context_add_at_time_worker_in_ms(async_context_t *context, async_at_time_worker_t *worker,
+                                            uint32_t ms)
+{
+    return async_context_add_at_time_worker_at(context, worker, make_timeout_time_ms(ms));
+}
+
+absolute_time_t host_async_run(void)
+{
+    async_context_t *context = &host_context;
+    // 実行中に 0ms 後へ積み直すワーカーがいても 1 周で抜けるよう、時刻は最初に固定する
+    absolute_time_t now = get_absolute_time();
+    while (context->at_time_list && context->at_time_list->next_time <= now)
+    {
+        async_at_time_worker_t *w = context->at_time_list;
+        context->at_time_list = w->next;
+        w->next = NULL;
+        w->do_work(context, w);
+    }
+    return context->at_time_list ? context->at_time_list->next_time : at_the_end_of_time;
+}
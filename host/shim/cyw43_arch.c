@@ -0,0 +1,254 @@
+// pico/cyw43_arch。Wi-Fi の代わりに TAP デバイスを lwIP の netif にする（NO_SYS=1）
+//   アソシエーション : TAP を開いてリンク UP
+//   DHCP             : MQCENSOR_HOST_IP / _NETMASK / _GW の静的設定（既定 192.168.7.2/24, gw .1）
+// TAP は事前に作っておく（名前は MQCENSOR_HOST_TAP、既定 tap0）
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <net/if.h>
+#include <linux/if_tun.h>
+#include "pico/cyw43_arch.h"
+#include "lwip/init.h"
+#include "lwip/etharp.h"
+#include "lwip/pbuf.h"
+#include "lwip/timeouts.h"
+#include "netif/ethernet.h"
+#include "host_shim.h"
+
+#define HOST_TAP_FRAME_MAX 1536
+
+cyw43_t cyw43_state;
+
+static int tap_fd = -1;
+static bool netif_added = false;
+static bool join_failed = false;
+static uint32_t pm_mode = CYW43_DEFAULT_PM;
+static HostNetStats net_stats;
+
+static const char *env_or(const char *name, const char *def)
+{
+    const char *v = getenv(name);
+    return v && *v ? v : def;
+}
+
+static err_t tap_linkoutput(struct netif *netif, struct pbuf *p)
+{
+    (void)netif;
+    uint8_t frame[HOST_TAP_FRAME_MAX];
+    u16_t len = pbuf_copy_partial(p, frame, sizeof(frame), 0);
+    if (write(tap_fd, frame, len) != (ssize_t)len)
+        return ERR_IF;
+    net_stats.tx_bytes += len;
+    net_stats.tx_frames++;
+    return ERR_OK;
+}
+
+static err_t tap_netif_init(struct netif *netif)
+{
+    // ローカル管理アドレス
+    static const uint8_t mac[ETH_HWADDR_LEN] = {0x02, 0x00, 0x00, 0x50, 0x1c, 0x02};
+    netif->name[0] = 't';
+    netif->name[1] = 'p';
+    netif->output = etharp_output;
+    netif->linkoutput = tap_linkoutput;
+    netif->mtu = 1500;
+    netif->hwaddr_len = ETH_HWADDR_LEN;
+    memcpy(netif->hwaddr, mac, ETH_HWADDR_LEN);
+    netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_ETHERNET;
+    return ERR_OK;
+}
+
+static int tap_open(const char *name)
+{
+    int fd = open("/dev/net/tun", O_RDWR | O_NONBLOCK);
+    if (fd < 0)
+        return -1;
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+    strncpy(ifr.ifr_name, name, IFNAMSIZ - 1);
+    if (ioctl(fd, TUNSETIFF, &ifr) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+u32_t sys_now(void)
+{
+    return to_ms_since_boot(get_absolute_time());
+}
+
+int cyw43_arch_init(void)
+{
+    lwip_init();
+    return 0;
+}
+
+void cyw43_arch_deinit(void)
+{
+    if (netif_added)
+        netif_remove(&cyw43_state.netif[CYW43_ITF_STA]);
+    netif_added = false;
+    if (tap_fd >= 0)
+        close(tap_fd);
+    tap_fd = -1;
+}
+
+void cyw43_arch_enable_sta_mode(void)
+{
+}
+
+void cyw43_arch_disable_sta_mode(void)
+{
+    cyw43_wifi_set_up(&cyw43_state, CYW43_ITF_STA, false, 0);
+}
+
+int cyw43_arch_wifi_connect_async(const char *ssid, const char *pw, uint32_t auth)
+{
+    (void)ssid;
+    (void)pw;
+    (void)auth;
+    struct netif *n = &cyw43_state.netif[CYW43_ITF_STA];
+    if (tap_fd < 0)
+    {
+        const char *name = env_or("MQCENSOR_HOST_TAP", "tap0");
+        tap_fd = tap_open(name);
+        if (tap_fd < 0)
+        {
+            printf("[host] cannot open TAP %s: %s\n", name, strerror(errno));
+            join_failed = true;
+            return PICO_ERROR_GENERIC;
+        }
+    }
+    if (!netif_added)
+    {
+        ip4_addr_t ip, mask, gw;
+        ip4addr_aton(env_or("MQCENSOR_HOST_IP", "192.168.7.2"), &ip);
+        ip4addr_aton(env_or("MQCENSOR_HOST_NETMASK", "255.255.255.0"), &mask);
+        ip4addr_aton(env_or("MQCENSOR_HOST_GW", "192.168.7.1"), &gw);
+        netif_add(n, &ip, &mask, &gw, NULL, tap_netif_init, ethernet_input);
+        netif_set_default(n);
+        netif_set_up(n);
+        netif_added = true;
+    }
+    join_failed = false;
+    netif_set_link_up(n);
+    return 0;
+}
+
+int cyw43_arch_wifi_connect_timeout_ms(const char *ssid, const char *pw, uint32_t auth, uint32_t timeout_ms)
+{
+    int err = cyw43_arch_wifi_connect_async(ssid, pw, auth);
+    if (err)
+        return err;
+    absolute_time_t until = make_timeout_time_ms(timeout_ms);
+    while (!time_reached(until))
+    {
+        if (cyw43_tcpip_link_status(&cyw43_state, CYW43_ITF_STA) == CYW43_LINK_UP)
+            return 0;
+        host_loop_run_once(delayed_by_ms(get_absolute_time(), 10));
+    }
+    return PICO_ERROR_TIMEOUT;
+}
+
+void cyw43_arch_gpio_put(unsigned wl_gpio, bool value)
+{
+    (void)wl_gpio;
+    (void)value;
+}
+
+void cyw43_arch_poll(void)
+{
+    host_loop_run_once(get_absolute_time());
+}
+
+async_context_t *cyw43_arch_async_context(void)
+{
+    return host_async_context();
+}
+
+int cyw43_wifi_link_status(cyw43_t *self, int itf)
+{
+    if (join_failed)
+        return CYW43_LINK_FAIL;
+    return netif_added && netif_is_link_up(&self->netif[itf]) ? CYW43_LINK_JOIN : CYW43_LINK_DOWN;
+}
+
+int cyw43_tcpip_link_status(cyw43_t *self, int itf)
+{
+    int st = cyw43_wifi_link_status(self, itf);
+    if (st != CYW43_LINK_JOIN)
+        return st;
+    struct netif *n = &self->netif[itf];
+    if (!netif_is_up(n) || ip4_addr_isany_val(*netif_ip4_addr(n)))
+        return CYW43_LINK_NOIP;
+    return CYW43_LINK_UP;
+}
+
+int cyw43_wifi_pm(cyw43_t *self, uint32_t pm)
+{
+    (void)self;
+    pm_mode = pm;
+    return 0;
+}
+
+int cyw43_wifi_get_pm(cyw43_t *self, uint32_t *pm)
+{
+    (void)self;
+    *pm = pm_mode;
+    return 0;
+}
+
+int cyw43_wifi_set_up(cyw43_t *self, int itf, bool up, uint32_t country)
+{
+    (void)country;
+    if (netif_added && !up)
+        netif_set_link_down(&self->netif[itf]);
+    return 0;
+}
+
+// TAP からの受信を全部 lwIP に渡し、lwIP のタイマーを進める
+int host_net_poll(absolute_time_t *next_out)
+{
+    struct netif *n = &cyw43_state.netif[CYW43_ITF_STA];
+    if (tap_fd >= 0)
+    {
+        uint8_t frame[HOST_TAP_FRAME_MAX];
+        ssize_t len;
+        while ((len = read(tap_fd, frame, sizeof(frame))) > 0)
+        {
+            if (!netif_added || !netif_is_link_up(n))
+                continue; // リンクを落としている間は届かなかったことにする
+            net_stats.rx_bytes += (uint64_t)len;
+            net_stats.rx_frames++;
+            struct pbuf *p = pbuf_alloc(PBUF_RAW, (u16_t)len, PBUF_POOL);
+            if (!p)
+                continue;
+            pbuf_take(p, frame, (u16_t)len);
+            if (n->input(p, n) != ERR_OK)
+                pbuf_free(p);
+        }
+    }
+    sys_check_timeouts();
+    u32_t sleep_ms = sys_timeouts_sleeptime();
+    if (sleep_ms != SYS_TIMEOUTS_SLEEPTIME_INFINITE)
+        *next_out = make_timeout_time_ms(sleep_ms);
+    return tap_fd;
+}
+
+const HostNetStats *host_net_stats(void)
+{
+    return &net_stats;
+}
+
+void host_net_reset_stats(void)
+{
+    memset(&net_stats, 0, sizeof(net_stats));
+}
@@ -0,0 +1,83 @@
+// hardware/flash と pico/flash。実機と同じく消去は 0xFF、書き込みは AND（1 → 0 にしかできない）
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "pico/stdlib.h"
+#include "pico/flash.h"
+#include "hardware/flash.h"
+
+static uint8_t *image;
+
+static uint8_t *flash_image(void)
+{
+    if (image)
+        return image;
+    const char *path = getenv("MQCENSOR_HOST_FLASH");
+    if (!path || !*path)
+        path = "mqcensor_flash.bin";
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0)
+    {
+        perror(path);
+        exit(1);
+    }
+    bool fresh = st.st_size < PICO_FLASH_SIZE_BYTES;
+    if (fresh && ftruncate(fd, PICO_FLASH_SIZE_BYTES) != 0)
+    {
+        perror(path);
+        exit(1);
+    }
+    image = mmap(NULL, PICO_FLASH_SIZE_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED)
+    {
+        perror("mmap");
+        exit(1);
+    }
+    // 新しいファイルは消去済みの状態から
+    if (fresh)
+        memset(image + st.st_size, 0xFF, PICO_FLASH_SIZE_BYTES - (size_t)st.st_size);
+    return image;
+}
+
+const uint8_t *host_flash_base(void)
+{
+    return flash_image();
+}
+
+void flash_range_erase(uint32_t flash_offs, size_t count)
+{
+    if (flash_offs % FLASH_SECTOR_SIZE || count % FLASH_SECTOR_SIZE || flash_offs + count > PICO_FLASH_SIZE_BYTES)
+    {
+        fprintf(stderr, "flash_range_erase: bad range %#x+%zu\n", flash_offs, count);
+        abort();
+    }
+    memset(flash_image() + flash_offs, 0xFF, count);
+    msync(flash_image(), PICO_FLASH_SIZE_BYTES, MS_SYNC);
+}
+
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count)
+{
+    if (flash_offs % FLASH_PAGE_SIZE || count % FLASH_PAGE_SIZE || flash_offs + count > PICO_FLASH_SIZE_BYTES)
+    {
+        fprintf(stderr, "flash_range_program: bad range %#x+%zu\n", flash_offs, count);
+        abort();
+    }
+    uint8_t *p = flash_image() + flash_offs;
+    for (size_t i = 0; i < count; i++)
+        p[i] &= data[i];
+    msync(flash_image(), PICO_FLASH_SIZE_BYTES, MS_SYNC);
+}
+
+int flash_safe_execute(void (*func)(void *), void *param, uint32_t enter_exit_timeout_ms)
+{
+    (void)enter_exit_timeout_ms;
+    func(param);
+    return PICO_OK;
+}
@@ -0,0 +1,68 @@
+// hardware/i2c。転送はアドレスごとに登録したデバイスモデル（host_i2c_attach）へそのまま渡す。
+// 何も登録されていないアドレスは NACK（PICO_ERROR_GENERIC）。
+// 成功した転送はバス上の時間（(アドレス + データ) × 9bit / baudrate）だけ待つ
+// （MQCENSOR_HOST_I2C_REALTIME=0 で無効）
+#include <stdlib.h>
+#include "hardware/i2c.h"
+#include "host_shim.h"
+
+struct i2c_inst
+{
+    unsigned baudrate;
+};
+
+static struct i2c_inst insts[2];
+i2c_inst_t *const i2c0 = &insts[0];
+i2c_inst_t *const i2c1 = &insts[1];
+
+static HostI2cDevice devices[128];
+static int realtime = -1;
+
+static int bus_time(i2c_inst_t *i2c, int result)
+{
+    if (realtime < 0)
+    {
+        const char *v = getenv("MQCENSOR_HOST_I2C_REALTIME");
+        realtime = !(v && strcmp(v, "0") == 0);
+    }
+    if (realtime && result > 0 && i2c->baudrate)
+        busy_wait_us((result + 1) * 9 * 1000000ull / i2c->baudrate);
+    return result;
+}
+
+void host_i2c_attach(uint8_t addr, const HostI2cDevice *dev)
+{
+    devices[addr & 0x7f] = *dev;
+}
+
+unsigned i2c_init(i2c_inst_t *i2c, unsigned baudrate)
+{
+    i2c->baudrate = baudrate;
+    return baudrate;
+}
+
+int i2c_write_timeout_us(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop,
+                         unsigned timeout_us)
+{
+    (void)nostop;
+    const HostI2cDevice *dev = &devices[addr & 0x7f];
+    return dev->write ? bus_time(i2c, dev->write(dev->ctx, src, len, timeout_us)) : PICO_ERROR_GENERIC;
+}
+
+int i2c_read_timeout_us(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop,
+                        unsigned timeout_us)
+{
+    (void)nostop;
+    const HostI2cDevice *dev = &devices[addr & 0x7f];
+    return dev->read ? bus_time(i2c, dev->read(dev->ctx, dst, len, timeout_us)) : PICO_ERROR_GENERIC;
+}
+
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop)
+{
+    return i2c_write_timeout_us(i2c, addr, src, len, nostop, 0);
+}
+
+int i2c_read_blocking(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop)
+{
+    return i2c_read_timeout_us(i2c, addr, dst, len, nostop, 0);
+}
@@ -0,0 +1,42 @@
+// ホストのイベントループ。threadsafe_background で IRQ 側が行う仕事
+// （タイマー・async_context のワーカー・CYW43/lwIP の処理）をここで順に回す
+#include <poll.h>
+#include "pico/stdlib.h"
+#include "host_shim.h"
+
+#define HOST_LOOP_MAX_WAIT_MS 1000
+
+static int callback_depth = 0;
+
+bool host_loop_in_callback(void)
+{
+    return callback_depth > 0;
+}
+
+void host_loop_run_once(absolute_time_t until)
+{
+    callback_depth++;
+    absolute_time_t next = host_timers_run();
+    absolute_time_t w = host_async_run();
+    if (w < next)
+        next = w;
+    absolute_time_t n = at_the_end_of_time;
+    int fd = host_net_poll(&n);
+    if (n < next)
+        next = n;
+    callback_depth--;
+
+    if (until < next)
+        next = until;
+    int64_t wait_us = absolute_time_diff_us(get_absolute_time(), next);
+    if (wait_us <= 0)
+        return;
+    int timeout_ms = wait_us > HOST_LOOP_MAX_WAIT_MS * 1000ll ? HOST_LOOP_MAX_WAIT_MS : (int)((wait_us + 999) / 1000);
+    struct pollfd pfd = {.fd = fd, .events = POLLIN};
+    poll(&pfd, fd >= 0 ? 1 : 0, timeout_ms);
+}
+
+void host_loop_wfe(void)
+{
+    host_loop_run_once(at_the_end_of_time);
+}
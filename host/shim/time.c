@@ -0,0 +1,137 @@
+// pico/stdlib の時刻・スリープ・repeating timer・stdio
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <time.h>
+#include "pico/stdlib.h"
+#include "host_shim.h"
+
+static uint64_t boot_ns;
+static repeating_timer_t *timers; // next_time 順
+
+static uint64_t monotonic_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+__attribute__((constructor)) static void time_init(void)
+{
+    boot_ns = monotonic_ns();
+}
+
+uint64_t time_us_64(void)
+{
+    return (monotonic_ns() - boot_ns) / 1000;
+}
+
+static void nanosleep_until(absolute_time_t t)
+{
+    uint64_t ns = (boot_ns + t * 1000ull);
+    struct timespec ts = {.tv_sec = (time_t)(ns / 1000000000ull), .tv_nsec = (long)(ns % 1000000000ull)};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+}
+
+void sleep_until(absolute_time_t t)
+{
+    if (host_loop_in_callback())
+    {
+        nanosleep_until(t);
+        return;
+    }
+    while (!time_reached(t))
+        host_loop_run_once(t);
+}
+
+void sleep_us(uint64_t us)
+{
+    sleep_until(make_timeout_time_us(us));
+}
+
+void sleep_ms(uint32_t ms)
+{
+    sleep_until(make_timeout_time_ms(ms));
+}
+
+void busy_wait_us(uint64_t us)
+{
+    nanosleep_until(make_timeout_time_us(us));
+}
+
+void busy_wait_ms(uint32_t ms)
+{
+    busy_wait_us(ms * 1000ull);
+}
+
+static void timer_insert(repeating_timer_t *t)
+{
+    repeating_timer_t **p = &timers;
+    while (*p && (*p)->next_time <= t->next_time)
+        p = &(*p)->next;
+    t->next = *p;
+    *p = t;
+}
+
+static bool timer_unlink(repeating_timer_t *t)
+{
+    for (repeating_timer_t **p = &timers; *p; p = &(*p)->next)
+    {
+        if (*p == t)
+        {
+            *p = t->next;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool add_repeating_timer_us(int64_t delay_us, repeating_timer_callback_t callback, void *user_data,
+                            repeating_timer_t *out)
+{
+    out->delay_us = delay_us;
+    out->user_data = user_data;
+    out->callback = callback;
+    out->next_time = make_timeout_time_us((uint64_t)(delay_us < 0 ? -delay_us : delay_us));
+    timer_insert(out);
+    return true;
+}
+
+bool cancel_repeating_timer(repeating_timer_t *timer)
+{
+    return timer_unlink(timer);
+}
+
+// SDK と同じく、delay_us < 0 なら前回の予定時刻から、> 0 ならコールバック終了から次を数える
+absolute_time_t host_timers_run(void)
+{
+    absolute_time_t now = get_absolute_time();
+    while (timers && timers->next_time <= now)
+    {
+        repeating_timer_t *t = timers;
+        timers = t->next;
+        absolute_time_t due = t->next_time;
+        if (!t->callback(t) || t->delay_us == 0)
+            continue;
+        t->next_time = t->delay_us < 0 ? delayed_by_us(due, (uint64_t)-t->delay_us)
+                                       : make_timeout_time_us((uint64_t)t->delay_us);
+        // 大きく遅れたら追いつこうとせず今から数え直す
+        if (t->next_time < now)
+            t->next_time = delayed_by_us(now, (uint64_t)(t->delay_us < 0 ? -t->delay_us : t->delay_us));
+        timer_insert(t);
+    }
+    return timers ? timers->next_time : at_the_end_of_time;
+}
+
+bool stdio_init_all(void)
+{
+    // UART と同じく 1 行ずつ出す
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    return true;
+}
+
+void stdio_flush(void)
+{
+    fflush(stdout);
+}
@@ -0,0 +1,47 @@
+// pico/unique_id。同じホストで TAP を分けて複数動かしても ID が重ならないよう、TAP 名も混ぜる
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "pico/unique_id.h"
+
+static uint64_t fnv1a(uint64_t h, const char *s)
+{
+    for (; *s; s++)
+    {
+        h ^= (uint8_t)*s;
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+void pico_get_unique_board_id(pico_unique_board_id_t *id_out)
+{
+    const char *env = getenv("MQCENSOR_BOARD_ID");
+    uint64_t v;
+    if (env && *env)
+    {
+        v = strtoull(env, NULL, 16);
+    }
+    else
+    {
+        char host[256] = "";
+        gethostname(host, sizeof(host) - 1);
+        const char *tap = getenv("MQCENSOR_HOST_TAP");
+        v = fnv1a(fnv1a(0xcbf29ce484222325ull, host), tap && *tap ? tap : "tap0");
+    }
+    for (int i = 0; i < PICO_UNIQUE_BOARD_ID_SIZE_BYTES; i++)
+        id_out->id[i] = (uint8_t)(v >> (8 * (PICO_UNIQUE_BOARD_ID_SIZE_BYTES - 1 - i)));
+}
+
+void pico_get_unique_board_id_string(char *id_out, unsigned len)
+{
+    pico_unique_board_id_t id;
+    pico_get_unique_board_id(&id);
+    unsigned n = 0;
+    for (int i = 0; i < PICO_UNIQUE_BOARD_ID_SIZE_BYTES && n + 2 < len; i++, n += 2)
+        snprintf(id_out + n, 3, "%02X", id.id[i]);
+    if (len)
+        id_out[n < len ? n : len - 1] = '\0';
+}
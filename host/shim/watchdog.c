@@ -0,0 +1,146 @@
+// hardware/watchdog。期限は SIGALRM で見張るので、ワーカーが無限ループしてもリセットできる。
+// リセットは /proc/self/exe の再 exec で、scratch レジスタは MQCENSOR_HOST_WDT で次のプロセスへ渡す
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "hardware/watchdog.h"
+
+#define WDT_ENV "MQCENSOR_HOST_WDT"
+#define WDT_SCRATCH_N 8
+
+extern char **environ;
+
+static watchdog_hw_t hw;
+watchdog_hw_t *const watchdog_hw = &hw;
+
+static bool caused_reboot = false;
+static uint32_t load_ms = 0;
+
+// シグナルハンドラからも exec できるよう、引数と環境は起動時に作っておく
+static char cmdline[4096];
+static char *reset_argv[64];
+static char **reset_envp;
+static char env_slot[sizeof(WDT_ENV "=") + WDT_SCRATCH_N * 9];
+
+__attribute__((constructor)) static void watchdog_restore(void)
+{
+    const char *s = getenv(WDT_ENV);
+    if (s)
+    {
+        char *end;
+        for (int i = 0; i < WDT_SCRATCH_N && *s; i++, s = *end ? end + 1 : end)
+            hw.scratch[i] = (uint32_t)strtoul(s, &end, 16);
+        caused_reboot = true;
+    }
+
+    int fd = open("/proc/self/cmdline", O_RDONLY);
+    ssize_t n = fd >= 0 ? read(fd, cmdline, sizeof(cmdline) - 1) : -1;
+    if (fd >= 0)
+        close(fd);
+    int argc = 0;
+    for (ssize_t i = 0; i < n && argc < (int)count_of(reset_argv) - 1; i += (ssize_t)strlen(cmdline + i) + 1)
+        reset_argv[argc++] = cmdline + i;
+    reset_argv[argc] = NULL;
+
+    size_t envc = 0;
+    while (environ[envc])
+        envc++;
+    reset_envp = calloc(envc + 2, sizeof(char *));
+    size_t k = 0;
+    reset_envp[k++] = env_slot;
+    for (size_t i = 0; i < envc; i++)
+    {
+        if (strncmp(environ[i], WDT_ENV "=", sizeof(WDT_ENV)) != 0)
+            reset_envp[k++] = environ[i];
+    }
+    reset_envp[k] = NULL;
+}
+
+// async-signal-safe な処理だけで作る
+static void host_reset(void)
+{
+    static const char hex[] = "0123456789abcdef";
+    char *p = env_slot;
+    memcpy(p, WDT_ENV "=", sizeof(WDT_ENV));
+    p += sizeof(WDT_ENV);
+    for (int i = 0; i < WDT_SCRATCH_N; i++)
+    {
+        for (int shift = 28; shift >= 0; shift -= 4)
+            *p++ = hex[(hw.scratch[i] >> shift) & 0xf];
+        *p++ = i + 1 < WDT_SCRATCH_N ? ',' : '\0';
+    }
+    // ハンドラの中では SIGALRM がブロックされていて、そのマスクは execve 後も残る
+    sigset_t alarm;
+    sigemptyset(&alarm);
+    sigaddset(&alarm, SIGALRM);
+    sigprocmask(SIG_UNBLOCK, &alarm, NULL);
+    execve("/proc/self/exe", reset_argv, reset_envp);
+    _exit(EXIT_FAILURE);
+}
+
+static void on_alarm(int sig)
+{
+    (void)sig;
+    static const char msg[] = "[host] watchdog timeout, resetting\n";
+    (void)!write(STDERR_FILENO, msg, sizeof(msg) - 1);
+    host_reset();
+}
+
+void watchdog_enable(uint32_t delay_ms, bool pause_on_debug)
+{
+    (void)pause_on_debug;
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_alarm;
+    sigaction(SIGALRM, &sa, NULL);
+    // 古いバイナリがハンドラ内から exec してきた場合など、ブロックされたまま引き継いでいることがある
+    sigset_t alarm;
+    sigemptyset(&alarm);
+    sigaddset(&alarm, SIGALRM);
+    sigprocmask(SIG_UNBLOCK, &alarm, NULL);
+    load_ms = delay_ms;
+    watchdog_update();
+}
+
+void watchdog_update(void)
+{
+    if (!load_ms)
+        return;
+    struct itimerval it = {
+        .it_value = {.tv_sec = load_ms / 1000, .tv_usec = (load_ms % 1000) * 1000},
+    };
+    setitimer(ITIMER_REAL, &it, NULL);
+}
+
+void watchdog_reboot(uint32_t pc, uint32_t sp, uint32_t delay_ms)
+{
+    (void)pc;
+    (void)sp;
+    if (delay_ms)
+        busy_wait_ms(delay_ms);
+    fflush(stdout);
+    fprintf(stderr, "[host] watchdog_reboot\n");
+    host_reset();
+}
+
+bool watchdog_caused_reboot(void)
+{
+    return caused_reboot;
+}
+
+bool watchdog_enable_caused_reboot(void)
+{
+    return caused_reboot;
+}
+
+uint32_t watchdog_get_time_remaining_ms(void)
+{
+    struct itimerval it;
+    getitimer(ITIMER_REAL, &it);
+    return (uint32_t)(it.it_value.tv_sec * 1000 + it.it_value.tv_usec / 1000);
+}
@@ -0,0 +1,1028 @@
+// mqcensor を 1 プロセスで何千台も動かし、ブローカーとコレクターがどこまで耐えるかを見る負荷ツール
+//
+//   fleet_sim [-b broker_ip:port（既定 127.0.0.1:1883）] [-n devices（既定 1000）] [-d seconds（既定 60）]
+//             [-p period_ms] [-D deadband_deci] [-q 0|1] [-B boot_window_ms] [-j join_ms]
+//             [-R at_ms[:down_ms],...] [-s stats_interval_s] [-S seed]
+//
+//   例: fleet_sim -n 5000 -R 30000:5000 -d 90     # 一斉起動（ブートストーム）、30 秒後にブローカー再起動（5 秒停止）
+//       fleet_sim -n 2000 -B 60000 -D 2 -d 300    # 1 分かけて順に起動、デッドバンド 0.2 で変化時だけ送る
+//
+// 1 台ぶんの振る舞いはファームウェアのコードをそのまま使う:
+//   値      aht20_decode → aht20_format（実機と同じテキスト）。AHT20 の生データは機器ごとのゆっくりした波形から作る
+//   ID      device_expand_for（MQCENSOR_CLIENT_ID_TEMPLATE / MQCENSOR_TOPIC_TEMPLATE）
+//   再接続  net_conn_step と同じ流れ（起動時だけ Wi-Fi 接続 -j、CONNACK 待ち NET_CONNACK_TIMEOUT_MS、
+//           切断の検出は NET_STEP_IDLE_MS ごとの見回り）と、失敗後の待ち backoff.h
+//   送信    deadband.h の判定、mqtt_session と同じ outbox（MQTT_OUTBOX_LEN 個、同時 MQTT_OUTBOX_INFLIGHT_MAX 個、
+//           溢れたら古いものから捨てる、切断で ACK 待ちを再送待ちに戻す）
+// MQTT は lwIP ではなくカーネルの TCP で話す（永続セッション・keepalive 30 秒、config/set と cmd を QoS1 で購読）。
+// 全機器を epoll 1 つと時刻順のヒープで 1 スレッドで回す
+//
+// -R はブローカーの再起動を機器側から見た形で起こす。全コネクションを RST で切り、down_ms の間は接続を
+// 拒否されたものとして扱う。本物のブローカーを再起動して試すなら -R は使わず、外から
+// systemctl restart mosquitto などを打てばよい（機器側の動きは同じ）
+//
+// 統計は 1 行 1 JSON で stdout に出す（状態ごとの台数、接続・publish のレート、接続にかかった時間）。
+// 起動・再起動のあと 99% / 全台がつながった時点も出す。SIGINT/SIGTERM か -d で集計を出して終わる
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "aht20.h"
+#include "backoff.h"
+#include "deadband.h"
+#include "device_id.h"
+#include "mqtt_session.h"
+#include "net.h"
+#include "runtime_config.h"
+
+#define FLEET_KEEP_ALIVE_S 30 // net.c の create_mqtt_client と同じ
+#define FLEET_RX_MAX (NET_RX_PAYLOAD_MAX + DEVICE_TOPIC_MAX + 8)
+#define FLEET_TX_MAX 512
+#define FLEET_MAX_RESTARTS 16
+#define FLEET_EPOLL_BATCH 1024
+#define FLEET_HIST_MS 60000 // 接続時間のヒストグラム（1 ms 刻み、これ以上は最後に入れる）
+
+typedef enum
+{
+    DEV_OFF = 0,    // 起動前
+    DEV_JOINING,    // Wi-Fi 接続中（起動直後だけ）
+    DEV_CONNECTING, // TCP 接続 → CONNACK 待ち（失敗しても期限までは待つ。net_conn_step と同じ）
+    DEV_UP,
+    DEV_LOST,  // 切れたが、まだ見回りで気付いていない
+    DEV_RETRY, // バックオフ中
+    DEV_STATE_COUNT
+} DevState;
+
+typedef enum
+{
+    SLOT_FREE = 0,
+    SLOT_QUEUED,
+    SLOT_INFLIGHT,
+} SlotState;
+
+typedef struct
+{
+    uint8_t state;
+    bool sent;
+    uint16_t len;
+    uint16_t packet_id;
+    uint32_t seq;
+    char payload[MQTT_OUTBOX_PAYLOAD_MAX];
+} Slot;
+
+typedef struct
+{
+    DevState state;
+    int fd;
+    bool tcp_open; // CONNECT を送った
+    uint64_t state_us;       // 状態ごとの次の予定（起動・Wi-Fi 完了・CONNACK 期限・見回り・再試行）
+    uint64_t next_sample_us; // 0 = 起動前
+    uint64_t attempt_us;     // 接続試行の開始
+    uint64_t last_tx_us;
+    uint64_t wake_us; // ヒープのキー
+    uint16_t next_packet_id;
+    uint32_t next_seq;
+    char board[2 * 8 + 1];
+    char client_id[DEVICE_CLIENT_ID_MAX];
+    char topic[DEVICE_TOPIC_MAX];
+    Backoff backoff;
+    Deadband deadband;
+    float temp_base, hum_base, wave_phase; // 波形
+    Slot outbox[MQTT_OUTBOX_LEN];
+    uint16_t rx_len, tx_len;
+    uint8_t rx[FLEET_RX_MAX];
+    uint8_t tx[FLEET_TX_MAX];
+} Device;
+
+typedef struct
+{
+    uint64_t attempts, connacks, refused, timeouts, lost;
+    uint64_t samples, suppressed, queued, published, acked, resent, dropped, rx_msgs;
+    uint64_t tx_bytes;
+} FleetStats;
+
+typedef struct
+{
+    uint32_t at_ms, down_ms;
+} Restart;
+
+static Device *devs;
+static uint32_t dev_count = 1000;
+static uint32_t *heap, *heap_pos; // wake_us の最小ヒープ（機器の添字）
+static uint32_t heap_len;
+static int ep = -1;
+static struct sockaddr_in broker;
+static uint32_t period_ms = PUBLISH_PERIOD_MS;
+static uint16_t deadband_deci = 0;
+static uint8_t qos = MQTT_PUB_QOS;
+static uint32_t boot_window_ms = 0;
+static uint32_t join_ms = 3000;
+static Restart restarts[FLEET_MAX_RESTARTS];
+static uint32_t restart_count, next_restart;
+static uint64_t down_until_us;
+static uint64_t start_us;
+static uint32_t rng = 1;
+static uint32_t state_count[DEV_STATE_COUNT];
+static FleetStats stats, prev;
+static uint32_t hist_total[FLEET_HIST_MS + 1], hist_window[FLEET_HIST_MS + 1];
+static const char *recover_what = "boot";
+static uint64_t recover_from_us;
+static bool recovered_99, recovered_all;
+static volatile sig_atomic_t stop;
+
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static uint32_t rng_next(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+static float rng_unit(void)
+{
+    return (rng_next() >> 8) * (1.0f / 16777216.0f);
+}
+
+static void event(const char *ev, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void event(const char *ev, const char *fmt, ...)
+{
+    uint64_t t = now_us();
+    printf("{\"t_ms\":%llu,\"ev\":\"%s\"", (unsigned long long)((t - start_us) / 1000), ev);
+    if (fmt)
+    {
+        va_list ap;
+        va_start(ap, fmt);
+        putchar(',');
+        vprintf(fmt, ap);
+        va_end(ap);
+    }
+    printf("}\n");
+    fflush(stdout);
+}
+
+// ---- 時刻順のヒープ ----
+
+static bool heap_less(uint32_t a, uint32_t b)
+{
+    return devs[heap[a]].wake_us < devs[heap[b]].wake_us;
+}
+
+static void heap_swap(uint32_t a, uint32_t b)
+{
+    uint32_t t = heap[a];
+    heap[a] = heap[b];
+    heap[b] = t;
+    heap_pos[heap[a]] = a;
+    heap_pos[heap[b]] = b;
+}
+
+static void heap_fix(uint32_t i)
+{
+    while (i && heap_less(i, (i - 1) / 2))
+    {
+        heap_swap(i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+    while (true)
+    {
+        uint32_t l = 2 * i + 1, r = l + 1, m = i;
+        if (l < heap_len && heap_less(l, m))
+            m = l;
+        if (r < heap_len && heap_less(r, m))
+            m = r;
+        if (m == i)
+            return;
+        heap_swap(i, m);
+        i = m;
+    }
+}
+
+// ---- 機器 ----
+
+static void set_state(Device *d, DevState s)
+{
+    state_count[d->state]--;
+    state_count[s]++;
+    d->state = s;
+}
+
+static uint32_t dev_index(const Device *d)
+{
+    return (uint32_t)(d - devs);
+}
+
+// 状態・サンプリング・keepalive のうち一番近い予定でヒープを並べ直す
+static void schedule(Device *d)
+{
+    uint64_t w = d->state == DEV_UP ? UINT64_MAX : d->state_us;
+    if (d->next_sample_us && d->next_sample_us < w)
+        w = d->next_sample_us;
+    // 書き残しがあるあいだの keepalive は EPOLLOUT 側に任せる
+    if (d->state == DEV_UP && !d->tx_len && d->last_tx_us + FLEET_KEEP_ALIVE_S * 1000000ull < w)
+        w = d->last_tx_us + FLEET_KEEP_ALIVE_S * 1000000ull;
+    d->wake_us = w;
+    heap_fix(heap_pos[dev_index(d)]);
+}
+
+static void set_events(Device *d, uint32_t events)
+{
+    struct epoll_event ev = {.events = events, .data.u32 = dev_index(d)};
+    epoll_ctl(ep, EPOLL_CTL_MOD, d->fd, &ev);
+}
+
+static void close_fd(Device *d, bool rst)
+{
+    if (d->fd < 0)
+        return;
+    if (rst)
+    {
+        struct linger lg = {.l_onoff = 1, .l_linger = 0};
+        setsockopt(d->fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+    }
+    close(d->fd); // epoll からも外れる
+    d->fd = -1;
+    d->tcp_open = false;
+    d->rx_len = d->tx_len = 0;
+    // lwIP は切断で ACK 待ちを捨てるので、mqtt_session と同じく再送待ちに戻す
+    for (int i = 0; i < MQTT_OUTBOX_LEN; i++)
+        if (d->outbox[i].state == SLOT_INFLIGHT)
+            d->outbox[i].state = SLOT_QUEUED;
+}
+
+// 書けなかった残りは tx に溜めて EPOLLOUT を待つ。溜めきれなければ false
+static bool dev_send(Device *d, const uint8_t *p, size_t n, uint64_t now)
+{
+    if (d->tx_len == 0)
+    {
+        ssize_t w = send(d->fd, p, n, MSG_NOSIGNAL);
+        if (w < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+            return false;
+        if (w > 0)
+        {
+            p += w;
+            n -= (size_t)w;
+            stats.tx_bytes += (uint64_t)w;
+        }
+        if (n == 0)
+        {
+            d->last_tx_us = now;
+            return true;
+        }
+        set_events(d, EPOLLIN | EPOLLOUT);
+    }
+    if (d->tx_len + n > FLEET_TX_MAX)
+        return false;
+    memcpy(d->tx + d->tx_len, p, n);
+    d->tx_len += (uint16_t)n;
+    d->last_tx_us = now;
+    return true;
+}
+
+static size_t put_header(uint8_t *buf, uint8_t type, size_t rem)
+{
+    size_t n = 0;
+    buf[n++] = type;
+    do
+    {
+        uint8_t b = rem & 0x7F;
+        rem >>= 7;
+        buf[n++] = rem ? (uint8_t)(b | 0x80) : b;
+    } while (rem);
+    return n;
+}
+
+static size_t put_str(uint8_t *buf, const char *s, size_t len)
+{
+    buf[0] = (uint8_t)(len >> 8);
+    buf[1] = (uint8_t)len;
+    memcpy(buf + 2, s, len);
+    return 2 + len;
+}
+
+static uint16_t packet_id(Device *d)
+{
+    if (++d->next_packet_id == 0)
+        d->next_packet_id = 1;
+    return d->next_packet_id;
+}
+
+static void dev_lost(Device *d, uint64_t now);
+
+// mqtt_session_pump と同じ: seq の若い順に、同時 MQTT_OUTBOX_INFLIGHT_MAX 個まで
+static void pump(Device *d, uint64_t now)
+{
+    if (d->state != DEV_UP || d->tx_len)
+        return;
+    int inflight = 0;
+    for (int i = 0; i < MQTT_OUTBOX_LEN; i++)
+        if (d->outbox[i].state == SLOT_INFLIGHT)
+            inflight++;
+    size_t tlen = strlen(d->topic);
+    while (inflight < MQTT_OUTBOX_INFLIGHT_MAX)
+    {
+        Slot *next = NULL;
+        for (int i = 0; i < MQTT_OUTBOX_LEN; i++)
+            if (d->outbox[i].state == SLOT_QUEUED && (!next || d->outbox[i].seq < next->seq))
+                next = &d->outbox[i];
+        if (!next)
+            return;
+        uint8_t pkt[8 + DEVICE_TOPIC_MAX + MQTT_OUTBOX_PAYLOAD_MAX];
+        size_t n = put_header(pkt, (uint8_t)(0x30 | qos << 1), 2 + tlen + (qos ? 2 : 0) + next->len);
+        n += put_str(pkt + n, d->topic, tlen);
+        if (qos)
+        {
+            next->packet_id = packet_id(d);
+            pkt[n++] = (uint8_t)(next->packet_id >> 8);
+            pkt[n++] = (uint8_t)next->packet_id;
+        }
+        memcpy(pkt + n, next->payload, next->len);
+        n += next->len;
+        if (!dev_send(d, pkt, n, now))
+        {
+            dev_lost(d, now);
+            return;
+        }
+        stats.published++;
+        if (next->sent)
+            stats.resent++;
+        next->sent = true;
+        if (qos)
+        {
+            next->state = SLOT_INFLIGHT;
+            inflight++;
+        }
+        else
+        {
+            // QoS0 は送信完了で ACK 扱い（lwIP と同じ）
+            next->state = SLOT_FREE;
+            stats.acked++;
+        }
+        if (d->tx_len)
+            return;
+    }
+}
+
+// mqtt_session_publish と同じ: 空きが無ければ一番古い送信待ちを捨てる
+static void enqueue(Device *d, const char *payload, uint16_t len, uint64_t now)
+{
+    Slot *slot = NULL, *oldest = NULL;
+    for (int i = 0; i < MQTT_OUTBOX_LEN && !slot; i++)
+    {
+        if (d->outbox[i].state == SLOT_FREE)
+            slot = &d->outbox[i];
+        else if (d->outbox[i].state == SLOT_QUEUED && (!oldest || d->outbox[i].seq < oldest->seq))
+            oldest = &d->outbox[i];
+    }
+    if (!slot && oldest)
+    {
+        slot = oldest;
+        stats.dropped++;
+    }
+    if (!slot)
+        return; // 全部 ACK 待ち（ERR_MEM）
+    slot->state = SLOT_QUEUED;
+    slot->sent = false;
+    slot->seq = d->next_seq++;
+    memcpy(slot->payload, payload, len);
+    slot->len = len;
+#if MQTT_PERSISTENT_SESSION
+    slot->len += (uint16_t)snprintf(slot->payload + len, sizeof(slot->payload) - len, MQTT_SESSION_SEQ_FMT,
+                                    (unsigned long)slot->seq);
+#endif
+    stats.queued++;
+    pump(d, now);
+}
+
+// 機器ごとの波形から AHT20 の 6 バイトを作り、ファームウェアと同じ decode → デッドバンド → format を通す
+static void sample(Device *d, uint64_t now)
+{
+    float t_s = (float)(now - start_us) * 1e-6f;
+    float w = sinf(d->wave_phase + t_s * (2.0f * 3.14159265f / 600.0f)); // 10 分周期
+    float temp = d->temp_base + 1.5f * w + 0.05f * (rng_unit() - 0.5f);
+    float hum = d->hum_base - 5.0f * w + 0.2f * (rng_unit() - 0.5f);
+    uint32_t raw_t = (uint32_t)((temp + 50.0f) / 200.0f * 1048576.0f);
+    uint32_t raw_h = (uint32_t)(hum / 100.0f * 1048576.0f);
+    uint8_t buf[6] = {0x1C, (uint8_t)(raw_h >> 12), (uint8_t)(raw_h >> 4),
+                      (uint8_t)((raw_h & 0x0F) << 4 | (raw_t >> 16 & 0x0F)), (uint8_t)(raw_t >> 8), (uint8_t)raw_t};
+    AHT22Result r = aht20_decode(buf);
+    stats.samples++;
+    if (!deadband_check(&d->deadband, &r, deadband_deci, RUNTIME_CONFIG_HEARTBEAT_MS, now))
+    {
+        stats.suppressed++;
+        return;
+    }
+    char payload[MQTT_OUTBOX_PAYLOAD_MAX];
+    int n = aht20_format(&r, payload, sizeof(payload));
+    // 通し番号（最大 " seq=4294967295"）の分を残す
+    if (n > 0 && n + 15 <= (int)sizeof(payload))
+        enqueue(d, payload, (uint16_t)n, now);
+}
+
+static void note_recovery(uint64_t now)
+{
+    uint32_t up = state_count[DEV_UP];
+    if (!recovered_99 && up * 100ull >= dev_count * 99ull)
+    {
+        recovered_99 = true;
+        event("recovered", "\"after\":\"%s\",\"pct\":99,\"ms\":%llu", recover_what,
+              (unsigned long long)((now - recover_from_us) / 1000));
+    }
+    if (!recovered_all && up == dev_count)
+    {
+        recovered_all = true;
+        event("recovered", "\"after\":\"%s\",\"pct\":100,\"ms\":%llu", recover_what,
+              (unsigned long long)((now - recover_from_us) / 1000));
+    }
+}
+
+// 接続試行を打ち切ってバックオフに入る（net_conn_step の CONNACK timeout と同じ）
+static void dev_retry(Device *d, uint64_t now)
+{
+    close_fd(d, false);
+    set_state(d, DEV_RETRY);
+    d->state_us = now + backoff_next_ms(&d->backoff) * 1000ull;
+}
+
+// TCP で接続を始める。失敗しても CONNACK の期限までは待つ
+static void dev_connect(Device *d, uint64_t now)
+{
+    stats.attempts++;
+    set_state(d, DEV_CONNECTING);
+    d->attempt_us = now;
+    d->state_us = now + NET_CONNACK_TIMEOUT_MS * 1000ull;
+    if (now < down_until_us)
+    {
+        stats.refused++;
+        return;
+    }
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        stats.refused++;
+        return;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(fd, (const struct sockaddr *)&broker, sizeof(broker)) != 0 && errno != EINPROGRESS)
+    {
+        close(fd);
+        stats.refused++;
+        return;
+    }
+    d->fd = fd;
+    struct epoll_event ev = {.events = EPOLLOUT, .data.u32 = dev_index(d)};
+    epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev);
+}
+
+// つながっていたものが切れた。次の見回り（NET_STEP_IDLE_MS ごと）で気付く
+static void dev_lost(Device *d, uint64_t now)
+{
+    close_fd(d, false);
+    if (d->state == DEV_UP)
+    {
+        stats.lost++;
+        set_state(d, DEV_LOST);
+        d->state_us = now + (uint64_t)(rng_unit() * NET_STEP_IDLE_MS * 1000.0f);
+    }
+    else if (d->state == DEV_CONNECTING)
+    {
+        stats.refused++; // 期限まではそのまま
+    }
+}
+
+static void send_connect(Device *d, uint64_t now)
+{
+    uint8_t pkt[16 + DEVICE_CLIENT_ID_MAX];
+    size_t cid = strlen(d->client_id);
+    size_t n = put_header(pkt, 0x10, 10 + 2 + cid);
+    static const uint8_t proto[] = {0x00, 0x04, 'M', 'Q', 'T', 'T', 0x04};
+    memcpy(pkt + n, proto, sizeof(proto));
+    n += sizeof(proto);
+    pkt[n++] = MQTT_PERSISTENT_SESSION ? 0x00 : 0x02;
+    pkt[n++] = 0;
+    pkt[n++] = FLEET_KEEP_ALIVE_S;
+    n += put_str(pkt + n, d->client_id, cid);
+    d->tcp_open = true;
+    if (!dev_send(d, pkt, n, now))
+        dev_lost(d, now);
+}
+
+static void subscribe(Device *d, DeviceTopic t, uint64_t now)
+{
+    char topic[DEVICE_TOPIC_MAX];
+    size_t tlen = device_expand_for(d->board, MQCENSOR_TOPIC_TEMPLATE, device_sensor_name(t), topic, sizeof(topic));
+    uint8_t pkt[8 + DEVICE_TOPIC_MAX];
+    size_t n = put_header(pkt, 0x82, 2 + 2 + tlen + 1);
+    uint16_t id = packet_id(d);
+    pkt[n++] = (uint8_t)(id >> 8);
+    pkt[n++] = (uint8_t)id;
+    n += put_str(pkt + n, topic, tlen);
+    pkt[n++] = 1;
+    if (!dev_send(d, pkt, n, now))
+        dev_lost(d, now);
+}
+
+static void on_connack(Device *d, const uint8_t *body, size_t len, uint64_t now)
+{
+    if (d->state != DEV_CONNECTING || len < 2 || body[1] != 0)
+    {
+        dev_lost(d, now);
+        return;
+    }
+    uint64_t ms = (now - d->attempt_us) / 1000;
+    ms = ms > FLEET_HIST_MS ? FLEET_HIST_MS : ms;
+    hist_total[ms]++;
+    hist_window[ms]++;
+    stats.connacks++;
+    set_state(d, DEV_UP);
+    backoff_reset(&d->backoff);
+    // net.c の subscribe_all と同じ購読
+    subscribe(d, DEVICE_TOPIC_CONFIG_SET, now);
+    if (d->fd >= 0)
+        subscribe(d, DEVICE_TOPIC_CMD, now);
+    pump(d, now);
+    note_recovery(now);
+}
+
+static void on_packet(Device *d, uint8_t hdr, const uint8_t *body, size_t len, uint64_t now)
+{
+    switch (hdr >> 4)
+    {
+    case 2: // CONNACK
+        on_connack(d, body, len, now);
+        break;
+    case 4: // PUBACK
+        if (len >= 2)
+        {
+            uint16_t id = (uint16_t)(body[0] << 8 | body[1]);
+            for (int i = 0; i < MQTT_OUTBOX_LEN; i++)
+            {
+                if (d->outbox[i].state == SLOT_INFLIGHT && d->outbox[i].packet_id == id)
+                {
+                    d->outbox[i].state = SLOT_FREE;
+                    stats.acked++;
+                    pump(d, now);
+                    break;
+                }
+            }
+        }
+        break;
+    case 3: // 購読しているトピックへの PUBLISH（中身は見ない）
+        stats.rx_msgs++;
+        if ((hdr >> 1 & 3) == 1 && len >= 2)
+        {
+            size_t tl = (size_t)(body[0] << 8 | body[1]);
+            if (len >= 4 + tl)
+            {
+                uint8_t ack[4] = {0x40, 2, body[2 + tl], body[3 + tl]};
+                if (!dev_send(d, ack, sizeof(ack), now))
+                    dev_lost(d, now);
+            }
+        }
+        break;
+    default: // SUBACK、PINGRESP
+        break;
+    }
+}
+
+static void on_readable(Device *d, uint64_t now)
+{
+    while (d->fd >= 0)
+    {
+        ssize_t r = recv(d->fd, d->rx + d->rx_len, FLEET_RX_MAX - d->rx_len, 0);
+        if (r == 0 || (r < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+        {
+            dev_lost(d, now);
+            return;
+        }
+        if (r < 0)
+            return;
+        d->rx_len += (uint16_t)r;
+        size_t pos = 0;
+        while (d->fd >= 0 && pos + 2 <= d->rx_len)
+        {
+            size_t rem = 0, i = pos + 1;
+            int shift = 0;
+            bool complete = false;
+            while (i < d->rx_len && shift <= 21)
+            {
+                uint8_t b = d->rx[i++];
+                rem |= (size_t)(b & 0x7F) << shift;
+                shift += 7;
+                if (!(b & 0x80))
+                {
+                    complete = true;
+                    break;
+                }
+            }
+            if (!complete || d->rx_len - i < rem)
+            {
+                if (shift > 21 || i - pos + rem > FLEET_RX_MAX)
+                {
+                    dev_lost(d, now); // 受けきれない大きさ
+                    return;
+                }
+                break;
+            }
+            on_packet(d, d->rx[pos], d->rx + i, rem, now);
+            pos = i + rem;
+        }
+        if (d->fd < 0)
+            return;
+        memmove(d->rx, d->rx + pos, d->rx_len - pos);
+        d->rx_len -= (uint16_t)pos;
+    }
+}
+
+static void on_writable(Device *d, uint64_t now)
+{
+    if (!d->tcp_open)
+    {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(d->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        if (err)
+        {
+            dev_lost(d, now);
+            return;
+        }
+        set_events(d, EPOLLIN);
+        send_connect(d, now);
+        return;
+    }
+    if (d->tx_len)
+    {
+        ssize_t w = send(d->fd, d->tx, d->tx_len, MSG_NOSIGNAL);
+        if (w < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+        {
+            dev_lost(d, now);
+            return;
+        }
+        if (w > 0)
+        {
+            stats.tx_bytes += (uint64_t)w;
+            memmove(d->tx, d->tx + w, d->tx_len - (size_t)w);
+            d->tx_len -= (uint16_t)w;
+        }
+    }
+    if (!d->tx_len)
+    {
+        set_events(d, EPOLLIN);
+        pump(d, now);
+    }
+}
+
+static void on_timer(Device *d, uint64_t now)
+{
+    if (d->next_sample_us && now >= d->next_sample_us)
+    {
+        sample(d, now);
+        d->next_sample_us += period_ms * 1000ull;
+        if (d->next_sample_us <= now)
+            d->next_sample_us = now + period_ms * 1000ull; // 追いつけないときは飛ばす
+    }
+    if (d->state == DEV_UP)
+    {
+        if (d->fd >= 0 && !d->tx_len && now >= d->last_tx_us + FLEET_KEEP_ALIVE_S * 1000000ull)
+        {
+            static const uint8_t ping[2] = {0xC0, 0x00};
+            if (!dev_send(d, ping, sizeof(ping), now))
+                dev_lost(d, now);
+        }
+        return;
+    }
+    if (now < d->state_us)
+        return;
+    switch (d->state)
+    {
+    case DEV_OFF:
+        // 電源投入: サンプリングを始めて Wi-Fi へ（-j の半分〜1.5 倍）
+        d->next_sample_us = now + period_ms * 1000ull;
+        set_state(d, DEV_JOINING);
+        d->state_us = now + (uint64_t)((0.5f + rng_unit()) * join_ms * 1000.0f);
+        break;
+    case DEV_JOINING:
+    case DEV_LOST:
+    case DEV_RETRY:
+        dev_connect(d, now);
+        break;
+    case DEV_CONNECTING:
+        stats.timeouts++;
+        dev_retry(d, now);
+        break;
+    default:
+        break;
+    }
+}
+
+// ---- ブローカー再起動 ----
+
+static void broker_restart(const Restart *r, uint64_t now)
+{
+    uint32_t dropped = 0;
+    for (uint32_t i = 0; i < dev_count; i++)
+    {
+        Device *d = &devs[i];
+        if (d->fd < 0)
+            continue;
+        close_fd(d, true);
+        dropped++;
+        if (d->state == DEV_UP)
+        {
+            stats.lost++;
+            set_state(d, DEV_LOST);
+            d->state_us = now + (uint64_t)(rng_unit() * NET_STEP_IDLE_MS * 1000.0f);
+        }
+        schedule(d);
+    }
+    down_until_us = now + r->down_ms * 1000ull;
+    recover_what = "restart";
+    recover_from_us = now;
+    recovered_99 = recovered_all = false;
+    event("restart", "\"dropped\":%u,\"down_ms\":%u", dropped, r->down_ms);
+}
+
+// ---- 統計 ----
+
+static uint32_t percentile(const uint32_t *hist, uint64_t total, double p)
+{
+    if (!total)
+        return 0;
+    uint64_t want = (uint64_t)ceil((double)total * p), acc = 0;
+    for (uint32_t ms = 0; ms <= FLEET_HIST_MS; ms++)
+    {
+        acc += hist[ms];
+        if (acc >= want)
+            return ms;
+    }
+    return FLEET_HIST_MS;
+}
+
+static void report(const char *ev, const FleetStats *s, const FleetStats *base, double secs, const uint32_t *hist)
+{
+    uint64_t n = s->connacks - base->connacks;
+    event(ev,
+          "\"up\":%u,\"connecting\":%u,\"retry\":%u,\"lost\":%u,\"joining\":%u,\"off\":%u,"
+          "\"attempts\":%llu,\"connacks\":%llu,\"connect_rate\":%.1f,\"refused\":%llu,\"timeouts\":%llu,"
+          "\"disconnects\":%llu,\"connect_p50_ms\":%u,\"connect_p99_ms\":%u,\"connect_max_ms\":%u,"
+          "\"samples\":%llu,\"suppressed\":%llu,\"published\":%llu,\"publish_rate\":%.1f,\"acked\":%llu,"
+          "\"ack_rate\":%.1f,\"resent\":%llu,\"dropped\":%llu,\"rx_msgs\":%llu,\"tx_kbps\":%.1f",
+          state_count[DEV_UP], state_count[DEV_CONNECTING], state_count[DEV_RETRY], state_count[DEV_LOST],
+          state_count[DEV_JOINING], state_count[DEV_OFF], (unsigned long long)(s->attempts - base->attempts),
+          (unsigned long long)n, (double)n / secs, (unsigned long long)(s->refused - base->refused),
+          (unsigned long long)(s->timeouts - base->timeouts), (unsigned long long)(s->lost - base->lost),
+          percentile(hist, n, 0.50), percentile(hist, n, 0.99), percentile(hist, n, 1.0),
+          (unsigned long long)(s->samples - base->samples), (unsigned long long)(s->suppressed - base->suppressed),
+          (unsigned long long)(s->published - base->published), (double)(s->published - base->published) / secs,
+          (unsigned long long)(s->acked - base->acked), (double)(s->acked - base->acked) / secs,
+          (unsigned long long)(s->resent - base->resent), (unsigned long long)(s->dropped - base->dropped),
+          (unsigned long long)(s->rx_msgs - base->rx_msgs), (double)(s->tx_bytes - base->tx_bytes) * 8 / 1000 / secs);
+}
+
+// ---- 起動 ----
+
+static bool parse_addr(const char *s, struct sockaddr_in *out)
+{
+    char host[64];
+    const char *colon = strrchr(s, ':');
+    if (!colon || (size_t)(colon - s) >= sizeof(host))
+        return false;
+    memcpy(host, s, colon - s);
+    host[colon - s] = '\0';
+    memset(out, 0, sizeof(*out));
+    out->sin_family = AF_INET;
+    out->sin_port = htons((uint16_t)atoi(colon + 1));
+    return inet_pton(AF_INET, host, &out->sin_addr) == 1;
+}
+
+static bool parse_restarts(char *s)
+{
+    char *save = NULL;
+    for (char *tok = strtok_r(s, ",", &save); tok; tok = strtok_r(NULL, ",", &save))
+    {
+        if (restart_count >= FLEET_MAX_RESTARTS)
+            return false;
+        char *end;
+        Restart *r = &restarts[restart_count];
+        r->at_ms = (uint32_t)strtoul(tok, &end, 0);
+        r->down_ms = *end == ':' ? (uint32_t)strtoul(end + 1, &end, 0) : 0;
+        if (*end || (restart_count && r->at_ms < restarts[restart_count - 1].at_ms))
+            return false;
+        restart_count++;
+    }
+    return true;
+}
+
+static void init_device(Device *d, uint32_t i, uint32_t seed)
+{
+    memset(d, 0, sizeof(*d));
+    d->fd = -1;
+    // board ID は実機と重ならないよう先頭を FEE7 に
+    snprintf(d->board, sizeof(d->board), "FEE7%04X%08X", seed & 0xFFFF, i);
+    device_expand_for(d->board, MQCENSOR_CLIENT_ID_TEMPLATE, "", d->client_id, sizeof(d->client_id));
+    device_expand_for(d->board, MQCENSOR_TOPIC_TEMPLATE, device_sensor_name(DEVICE_TOPIC_SAMPLE), d->topic,
+                      sizeof(d->topic));
+    backoff_init(&d->backoff, NET_STEP_RETRY_MS, NET_RETRY_MAX_MS, rng_next());
+    d->temp_base = 18.0f + 10.0f * rng_unit();
+    d->hum_base = 40.0f + 20.0f * rng_unit();
+    d->wave_phase = 6.2831853f * rng_unit();
+    d->next_seq = 1;
+    d->state = DEV_OFF;
+    d->state_us = start_us + (uint64_t)(rng_unit() * boot_window_ms * 1000.0f);
+    d->wake_us = d->state_us;
+}
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    stop = 1;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [-b broker_ip:port] [-n devices] [-d seconds] [-p period_ms] [-D deadband_deci] [-q 0|1]\n"
+            "          [-B boot_window_ms] [-j join_ms] [-R at_ms[:down_ms],...] [-s stats_interval_s] [-S seed]\n",
+            argv0);
+}
+
+int main(int argc, char **argv)
+{
+    const char *broker_s = "127.0.0.1:1883";
+    uint32_t duration_s = 60, stats_s = 5;
+    int opt;
+    while ((opt = getopt(argc, argv, "b:n:d:p:D:q:B:j:R:s:S:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'b':
+            broker_s = optarg;
+            break;
+        case 'n':
+            dev_count = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'd':
+            duration_s = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'p':
+            period_ms = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'D':
+            deadband_deci = (uint16_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'q':
+            qos = atoi(optarg) ? 1 : 0;
+            break;
+        case 'B':
+            boot_window_ms = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'j':
+            join_ms = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'R':
+            if (!parse_restarts(optarg))
+            {
+                fprintf(stderr, "bad -R (at_ms[:down_ms],... in time order, at most %d)\n", FLEET_MAX_RESTARTS);
+                return 2;
+            }
+            break;
+        case 's':
+            stats_s = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'S':
+            rng = (uint32_t)strtoul(optarg, NULL, 0);
+            if (!rng)
+                rng = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (!parse_addr(broker_s, &broker) || dev_count == 0 || period_ms < RUNTIME_CONFIG_PERIOD_MIN_MS || !stats_s)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    // 1 台 1 fd
+    struct rlimit rl;
+    getrlimit(RLIMIT_NOFILE, &rl);
+    if (rl.rlim_cur < dev_count + 64)
+    {
+        rl.rlim_cur = rl.rlim_max < dev_count + 64 ? rl.rlim_max : dev_count + 64;
+        setrlimit(RLIMIT_NOFILE, &rl);
+        if (rl.rlim_cur < dev_count + 64)
+            fprintf(stderr, "warning: RLIMIT_NOFILE %lu is below %u devices\n", (unsigned long)rl.rlim_cur, dev_count);
+    }
+
+    devs = calloc(dev_count, sizeof(Device));
+    heap = calloc(dev_count, sizeof(uint32_t));
+    heap_pos = calloc(dev_count, sizeof(uint32_t));
+    ep = epoll_create1(EPOLL_CLOEXEC);
+    if (!devs || !heap || !heap_pos || ep < 0)
+    {
+        perror("init");
+        return 1;
+    }
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    start_us = now_us();
+    recover_from_us = start_us;
+    uint32_t seed = rng;
+    for (uint32_t i = 0; i < dev_count; i++)
+    {
+        init_device(&devs[i], i, seed);
+        heap[i] = i;
+        heap_pos[i] = i;
+        heap_len = i + 1;
+        heap_fix(i);
+    }
+    state_count[DEV_OFF] = dev_count;
+    event("start",
+          "\"broker\":\"%s\",\"devices\":%u,\"period_ms\":%u,\"deadband_deci\":%u,\"qos\":%u,\"boot_window_ms\":%u,"
+          "\"join_ms\":%u,\"restarts\":%u,\"topic\":\"%s\"",
+          broker_s, dev_count, period_ms, deadband_deci, qos, boot_window_ms, join_ms, restart_count, devs[0].topic);
+
+    uint64_t end_us = start_us + duration_s * 1000000ull;
+    uint64_t next_stats = start_us + stats_s * 1000000ull, last_stats = start_us;
+    struct epoll_event evs[FLEET_EPOLL_BATCH];
+    while (!stop)
+    {
+        uint64_t now = now_us();
+        if (now >= end_us)
+            break;
+        uint64_t wake = devs[heap[0]].wake_us;
+        if (next_stats < wake)
+            wake = next_stats;
+        if (next_restart < restart_count && start_us + restarts[next_restart].at_ms * 1000ull < wake)
+            wake = start_us + restarts[next_restart].at_ms * 1000ull;
+        int timeout_ms = wake > now ? (int)((wake - now + 999) / 1000) : 0;
+        int n = epoll_wait(ep, evs, FLEET_EPOLL_BATCH, timeout_ms);
+        if (n < 0 && errno != EINTR)
+        {
+            perror("epoll_wait");
+            break;
+        }
+
+        now = now_us();
+        for (int i = 0; i < n; i++)
+        {
+            Device *d = &devs[evs[i].data.u32];
+            if (d->fd < 0)
+                continue;
+            if (evs[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+                on_readable(d, now);
+            if (d->fd >= 0 && (evs[i].events & EPOLLOUT))
+                on_writable(d, now);
+            schedule(d);
+        }
+        while (devs[heap[0]].wake_us <= now)
+        {
+            Device *d = &devs[heap[0]];
+            on_timer(d, now);
+            schedule(d);
+        }
+        if (next_restart < restart_count && now >= start_us + restarts[next_restart].at_ms * 1000ull)
+            broker_restart(&restarts[next_restart++], now);
+        if (now >= next_stats)
+        {
+            report("stats", &stats, &prev, (double)(now - last_stats) * 1e-6, hist_window);
+            prev = stats;
+            memset(hist_window, 0, sizeof(hist_window));
+            last_stats = now;
+            next_stats += stats_s * 1000000ull;
+        }
+    }
+
+    FleetStats zero = {0};
+    report("summary", &stats, &zero, (double)(now_us() - start_us) * 1e-6, hist_total);
+    for (uint32_t i = 0; i < dev_count; i++)
+        close_fd(&devs[i], false);
+    close(ep);
+    return 0;
+}
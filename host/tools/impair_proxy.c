@@ -0,0 +1,585 @@
+// ホストビルドのファームウェアとブローカーの間に入る TCP プロキシ。悪い Wi-Fi を RF なしで再現する
+//
+//   impair_proxy [-l listen_ip:port（既定 192.168.7.1:1883）] [-u broker_ip:port（既定 127.0.0.1:1883）]
+//                [-s schedule.txt] [-S seed]
+//
+// スケジュールは 1 行 1 フェーズで "<開始 ms> key=value,..."（プロキシ起動からの時刻、# 以降はコメント）
+//   delay=ms jitter=ms   片道の遅延と一様ジッタ（±）。TCP なので順序は保つ
+//   rate=kbps            片方向ごとの帯域（0 で無制限）
+//   loss=0..1 rto=ms     チャンクごとの損失確率。TCP の上にいるので「再送までの停止」として rto 分遅らせる
+//   down=rst|stall for=ms  切断。rst は全コネクションを RST で切り、期間中の新規接続も即 RST。
+//                        stall は転送も accept も止める（keepalive での検出を試す）
+// 値を書かなかった項目は前のフェーズのまま
+//
+//   0      delay=20,jitter=5
+//   30000  down=rst,for=10000
+//   60000  delay=300,jitter=200,rate=64,loss=0.02
+//
+// イベントは 1 行 1 JSON で stdout に出す（mono_ms は CLOCK_MONOTONIC。tools/impair_scenarios.py が
+// 購読側の受信時刻と突き合わせる）。SIGINT/SIGTERM で集計を出して終わる
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PROXY_MAX_CONNS 8
+#define PROXY_MAX_PHASES 64
+#define PROXY_CHUNK 1460 // 1 回の read の上限（おおよそ 1 セグメント）
+#define PROXY_QUEUE_LEN 64
+#define PROXY_IDLE_POLL_MS 1000
+
+typedef struct
+{
+    uint32_t delay_ms;
+    uint32_t jitter_ms;
+    uint32_t rate_kbps;
+    float loss;
+    uint32_t rto_ms;
+} Impair;
+
+typedef enum
+{
+    DOWN_NONE = 0,
+    DOWN_RST,
+    DOWN_STALL,
+} DownMode;
+
+typedef struct
+{
+    uint32_t at_ms;
+    char spec[128]; // イベントログ用
+    // 指定されたものだけ上書きする
+    bool set_delay, set_jitter, set_rate, set_loss, set_rto;
+    Impair im;
+    DownMode down;
+    uint32_t down_ms;
+} Phase;
+
+typedef struct
+{
+    uint64_t release_us;
+    uint16_t len;
+    uint16_t off;
+    uint8_t data[PROXY_CHUNK];
+} Chunk;
+
+// 片方向（src → dst）の待ち行列
+typedef struct
+{
+    Chunk q[PROXY_QUEUE_LEN];
+    uint32_t head, count;
+    uint64_t last_release_us; // 順序を保つため、これより前には出さない
+    uint64_t link_free_us;    // 帯域制限で次のチャンクを送り始められる時刻
+    uint64_t bytes;
+} Dir;
+
+typedef struct
+{
+    bool used;
+    uint32_t id;
+    int cfd, ufd;
+    Dir up;   // ファームウェア → ブローカー
+    Dir down; // ブローカー → ファームウェア
+} Conn;
+
+typedef struct
+{
+    uint64_t accepted, refused, closed_rst;
+    uint64_t chunks, lost;
+    uint64_t up_bytes, down_bytes;
+} ProxyStats;
+
+static Conn conns[PROXY_MAX_CONNS];
+static Phase phases[PROXY_MAX_PHASES];
+static size_t phase_count, next_phase;
+static Impair cur; // 現在の回線状態
+static DownMode down_mode = DOWN_NONE;
+static uint64_t down_until_us;
+static uint64_t start_us;
+static uint32_t next_conn_id = 1;
+static uint32_t rng = 1;
+static ProxyStats stats;
+static volatile sig_atomic_t stop;
+
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+// xorshift32。seed が同じならジッタと損失の出方も同じ
+static uint32_t rng_next(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+static float rng_unit(void)
+{
+    return (rng_next() >> 8) * (1.0f / 16777216.0f);
+}
+
+static void event(const char *ev, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void event(const char *ev, const char *fmt, ...)
+{
+    uint64_t t = now_us();
+    printf("{\"t_ms\":%llu,\"mono_ms\":%llu,\"ev\":\"%s\"", (unsigned long long)((t - start_us) / 1000),
+           (unsigned long long)(t / 1000), ev);
+    if (fmt)
+    {
+        va_list ap;
+        va_start(ap, fmt);
+        putchar(',');
+        vprintf(fmt, ap);
+        va_end(ap);
+    }
+    printf("}\n");
+    fflush(stdout);
+}
+
+static bool parse_addr(const char *s, struct sockaddr_in *out)
+{
+    char host[64];
+    const char *colon = strrchr(s, ':');
+    if (!colon || (size_t)(colon - s) >= sizeof(host))
+        return false;
+    memcpy(host, s, colon - s);
+    host[colon - s] = '\0';
+    memset(out, 0, sizeof(*out));
+    out->sin_family = AF_INET;
+    out->sin_port = htons((uint16_t)atoi(colon + 1));
+    return inet_pton(AF_INET, host, &out->sin_addr) == 1;
+}
+
+static bool parse_phase(char *line, Phase *p)
+{
+    memset(p, 0, sizeof(*p));
+    char *save = NULL;
+    char *at = strtok_r(line, " \t", &save);
+    char *spec = strtok_r(NULL, " \t\r\n", &save);
+    if (!at || !spec)
+        return false;
+    p->at_ms = (uint32_t)strtoul(at, NULL, 0);
+    snprintf(p->spec, sizeof(p->spec), "%s", spec);
+    for (char *kv = strtok_r(spec, ",", &save); kv; kv = strtok_r(NULL, ",", &save))
+    {
+        char *v = strchr(kv, '=');
+        if (!v)
+            return false;
+        *v++ = '\0';
+        if (strcmp(kv, "delay") == 0)
+            p->set_delay = true, p->im.delay_ms = (uint32_t)strtoul(v, NULL, 0);
+        else if (strcmp(kv, "jitter") == 0)
+            p->set_jitter = true, p->im.jitter_ms = (uint32_t)strtoul(v, NULL, 0);
+        else if (strcmp(kv, "rate") == 0)
+            p->set_rate = true, p->im.rate_kbps = (uint32_t)strtoul(v, NULL, 0);
+        else if (strcmp(kv, "loss") == 0)
+            p->set_loss = true, p->im.loss = strtof(v, NULL);
+        else if (strcmp(kv, "rto") == 0)
+            p->set_rto = true, p->im.rto_ms = (uint32_t)strtoul(v, NULL, 0);
+        else if (strcmp(kv, "down") == 0)
+        {
+            if (strcmp(v, "rst") == 0)
+                p->down = DOWN_RST;
+            else if (strcmp(v, "stall") == 0)
+                p->down = DOWN_STALL;
+            else
+                return false;
+        }
+        else if (strcmp(kv, "for") == 0)
+            p->down_ms = (uint32_t)strtoul(v, NULL, 0);
+        else
+            return false;
+    }
+    return p->down == DOWN_NONE || p->down_ms > 0;
+}
+
+static bool load_schedule(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return false;
+    char line[256];
+    int lineno = 0;
+    while (fgets(line, sizeof(line), f))
+    {
+        lineno++;
+        char *hash = strchr(line, '#');
+        if (hash)
+            *hash = '\0';
+        if (strspn(line, " \t\r\n") == strlen(line))
+            continue;
+        if (phase_count >= PROXY_MAX_PHASES || !parse_phase(line, &phases[phase_count]))
+        {
+            fprintf(stderr, "%s:%d: bad phase\n", path, lineno);
+            fclose(f);
+            return false;
+        }
+        if (phase_count && phases[phase_count].at_ms < phases[phase_count - 1].at_ms)
+        {
+            fprintf(stderr, "%s:%d: phases must be in time order\n", path, lineno);
+            fclose(f);
+            return false;
+        }
+        phase_count++;
+    }
+    fclose(f);
+    return true;
+}
+
+static void dir_reset(Dir *d)
+{
+    d->head = d->count = 0;
+    d->last_release_us = d->link_free_us = 0;
+    d->bytes = 0;
+}
+
+static void conn_close(Conn *c, const char *reason, bool rst)
+{
+    if (rst)
+    {
+        // SO_LINGER 0 で close すると RST になる（Wi-Fi 断でピアが消えたのに近い）
+        struct linger lg = {.l_onoff = 1, .l_linger = 0};
+        setsockopt(c->cfd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+        setsockopt(c->ufd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+        stats.closed_rst++;
+    }
+    close(c->cfd);
+    close(c->ufd);
+    stats.up_bytes += c->up.bytes;
+    stats.down_bytes += c->down.bytes;
+    event("close", "\"conn\":%u,\"reason\":\"%s\",\"up_bytes\":%llu,\"down_bytes\":%llu", c->id, reason,
+          (unsigned long long)c->up.bytes, (unsigned long long)c->down.bytes);
+    c->used = false;
+}
+
+static void refuse(int fd)
+{
+    struct linger lg = {.l_onoff = 1, .l_linger = 0};
+    setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+    close(fd);
+    stats.refused++;
+    event("refuse", NULL);
+}
+
+static void accept_one(int lfd, const struct sockaddr_in *upstream)
+{
+    int cfd = accept4(lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (cfd < 0)
+        return;
+    if (down_mode == DOWN_RST)
+    {
+        refuse(cfd);
+        return;
+    }
+    Conn *c = NULL;
+    for (size_t i = 0; i < PROXY_MAX_CONNS && !c; i++)
+        if (!conns[i].used)
+            c = &conns[i];
+    // ブローカーはローカルなので connect はブロッキングで済ませる
+    int ufd = c ? socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0) : -1;
+    if (ufd < 0 || connect(ufd, (const struct sockaddr *)upstream, sizeof(*upstream)) != 0)
+    {
+        if (ufd >= 0)
+            close(ufd);
+        refuse(cfd);
+        return;
+    }
+    fcntl(ufd, F_SETFL, fcntl(ufd, F_GETFL) | O_NONBLOCK);
+    int one = 1;
+    setsockopt(cfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    setsockopt(ufd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    c->used = true;
+    c->id = next_conn_id++;
+    c->cfd = cfd;
+    c->ufd = ufd;
+    dir_reset(&c->up);
+    dir_reset(&c->down);
+    stats.accepted++;
+    event("accept", "\"conn\":%u", c->id);
+}
+
+// 読んだチャンクをいつ相手に渡すかを決める
+static uint64_t release_time(Dir *d, uint16_t len, uint64_t now)
+{
+    int64_t jitter = cur.jitter_ms ? (int64_t)((2.0f * rng_unit() - 1.0f) * cur.jitter_ms * 1000.0f) : 0;
+    int64_t t = (int64_t)now + (int64_t)cur.delay_ms * 1000 + jitter;
+    if (t < (int64_t)now)
+        t = (int64_t)now;
+    if (cur.loss > 0 && rng_unit() < cur.loss)
+    {
+        t += (int64_t)cur.rto_ms * 1000;
+        stats.lost++;
+    }
+    uint64_t rel = (uint64_t)t > d->last_release_us ? (uint64_t)t : d->last_release_us;
+    if (cur.rate_kbps)
+    {
+        uint64_t start = d->link_free_us > now ? d->link_free_us : now;
+        d->link_free_us = start + (uint64_t)len * 8000u / cur.rate_kbps;
+        if (d->link_free_us > rel)
+            rel = d->link_free_us;
+    }
+    d->last_release_us = rel;
+    return rel;
+}
+
+// src から読めるだけ読んで積む。相手が閉じたら false
+static bool dir_fill(Dir *d, int src, uint64_t now)
+{
+    while (d->count < PROXY_QUEUE_LEN)
+    {
+        Chunk *ch = &d->q[(d->head + d->count) % PROXY_QUEUE_LEN];
+        ssize_t n = read(src, ch->data, sizeof(ch->data));
+        if (n == 0)
+            return false;
+        if (n < 0)
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        ch->len = (uint16_t)n;
+        ch->off = 0;
+        ch->release_us = release_time(d, ch->len, now);
+        d->count++;
+        d->bytes += (uint64_t)n;
+        stats.chunks++;
+    }
+    return true;
+}
+
+// 時刻が来たチャンクを dst へ書く。エラーなら false
+static bool dir_flush(Dir *d, int dst, uint64_t now)
+{
+    while (d->count)
+    {
+        Chunk *ch = &d->q[d->head];
+        if (ch->release_us > now)
+            return true;
+        ssize_t n = write(dst, ch->data + ch->off, ch->len - ch->off);
+        if (n < 0)
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        ch->off += (uint16_t)n;
+        if (ch->off < ch->len)
+            return true;
+        d->head = (d->head + 1) % PROXY_QUEUE_LEN;
+        d->count--;
+    }
+    return true;
+}
+
+static uint64_t dir_next_release(const Dir *d)
+{
+    return d->count ? d->q[d->head].release_us : UINT64_MAX;
+}
+
+static void apply_phase(const Phase *p, uint64_t now)
+{
+    if (p->set_delay)
+        cur.delay_ms = p->im.delay_ms;
+    if (p->set_jitter)
+        cur.jitter_ms = p->im.jitter_ms;
+    if (p->set_rate)
+        cur.rate_kbps = p->im.rate_kbps;
+    if (p->set_loss)
+        cur.loss = p->im.loss;
+    if (p->set_rto)
+        cur.rto_ms = p->im.rto_ms;
+    event("phase", "\"spec\":\"%s\",\"delay_ms\":%u,\"jitter_ms\":%u,\"rate_kbps\":%u,\"loss\":%.3f,\"rto_ms\":%u",
+          p->spec, cur.delay_ms, cur.jitter_ms, cur.rate_kbps, cur.loss, cur.rto_ms);
+    if (p->down == DOWN_NONE)
+        return;
+    down_mode = p->down;
+    down_until_us = now + (uint64_t)p->down_ms * 1000u;
+    event("down", "\"mode\":\"%s\",\"for_ms\":%u", p->down == DOWN_RST ? "rst" : "stall", p->down_ms);
+    if (p->down == DOWN_RST)
+    {
+        for (size_t i = 0; i < PROXY_MAX_CONNS; i++)
+            if (conns[i].used)
+                conn_close(&conns[i], "down", true);
+    }
+}
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    stop = 1;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [-l listen_ip:port] [-u broker_ip:port] [-s schedule.txt] [-S seed]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    const char *listen_s = "192.168.7.1:1883";
+    const char *upstream_s = "127.0.0.1:1883";
+    const char *schedule = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "l:u:s:S:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'l':
+            listen_s = optarg;
+            break;
+        case 'u':
+            upstream_s = optarg;
+            break;
+        case 's':
+            schedule = optarg;
+            break;
+        case 'S':
+            rng = (uint32_t)strtoul(optarg, NULL, 0);
+            if (!rng)
+                rng = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    struct sockaddr_in laddr, uaddr;
+    if (!parse_addr(listen_s, &laddr) || !parse_addr(upstream_s, &uaddr))
+    {
+        usage(argv[0]);
+        return 2;
+    }
+    if (schedule && !load_schedule(schedule))
+    {
+        fprintf(stderr, "cannot load schedule %s\n", schedule);
+        return 2;
+    }
+    cur.rto_ms = 1000; // lwIP の初期 RTO 程度
+
+    int lfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int one = 1;
+    setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (lfd < 0 || bind(lfd, (struct sockaddr *)&laddr, sizeof(laddr)) != 0 || listen(lfd, 4) != 0)
+    {
+        perror("listen");
+        return 1;
+    }
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    start_us = now_us();
+    event("start", "\"listen\":\"%s\",\"upstream\":\"%s\",\"phases\":%zu", listen_s, upstream_s, phase_count);
+
+    struct pollfd pfd[1 + 2 * PROXY_MAX_CONNS];
+    while (!stop)
+    {
+        uint64_t now = now_us();
+        while (next_phase < phase_count && now >= start_us + phases[next_phase].at_ms * 1000ull)
+            apply_phase(&phases[next_phase++], now);
+        if (down_mode != DOWN_NONE && now >= down_until_us)
+        {
+            down_mode = DOWN_NONE;
+            event("up", NULL);
+        }
+        bool stalled = down_mode == DOWN_STALL;
+
+        // 次に起きるべき時刻（リリース・フェーズ切り替え・復旧）まで待つ
+        uint64_t wake = now + PROXY_IDLE_POLL_MS * 1000ull;
+        if (next_phase < phase_count && start_us + phases[next_phase].at_ms * 1000ull < wake)
+            wake = start_us + phases[next_phase].at_ms * 1000ull;
+        if (down_mode != DOWN_NONE && down_until_us < wake)
+            wake = down_until_us;
+
+        nfds_t n = 0;
+        pfd[n++] = (struct pollfd){.fd = lfd, .events = stalled ? 0 : POLLIN};
+        for (size_t i = 0; i < PROXY_MAX_CONNS; i++)
+        {
+            Conn *c = &conns[i];
+            if (!c->used)
+            {
+                pfd[n++] = (struct pollfd){.fd = -1};
+                pfd[n++] = (struct pollfd){.fd = -1};
+                continue;
+            }
+            short cev = 0, uev = 0;
+            if (!stalled)
+            {
+                if (c->up.count < PROXY_QUEUE_LEN)
+                    cev |= POLLIN;
+                if (c->down.count < PROXY_QUEUE_LEN)
+                    uev |= POLLIN;
+                if (c->up.count && c->up.q[c->up.head].release_us <= now)
+                    uev |= POLLOUT;
+                if (c->down.count && c->down.q[c->down.head].release_us <= now)
+                    cev |= POLLOUT;
+                uint64_t r = dir_next_release(&c->up);
+                if (r > now && r < wake)
+                    wake = r;
+                r = dir_next_release(&c->down);
+                if (r > now && r < wake)
+                    wake = r;
+            }
+            pfd[n++] = (struct pollfd){.fd = c->cfd, .events = cev};
+            pfd[n++] = (struct pollfd){.fd = c->ufd, .events = uev};
+        }
+        int timeout_ms = wake > now ? (int)((wake - now + 999) / 1000) : 0;
+        if (poll(pfd, n, timeout_ms) < 0 && errno != EINTR)
+        {
+            perror("poll");
+            break;
+        }
+
+        now = now_us();
+        if (pfd[0].revents & POLLIN)
+            accept_one(lfd, &uaddr);
+        if (stalled)
+            continue;
+        for (size_t i = 0; i < PROXY_MAX_CONNS; i++)
+        {
+            Conn *c = &conns[i];
+            if (!c->used)
+                continue;
+            short cr = pfd[1 + 2 * i].revents, ur = pfd[2 + 2 * i].revents;
+            if ((cr & (POLLIN | POLLHUP | POLLERR)) && !dir_fill(&c->up, c->cfd, now))
+            {
+                conn_close(c, "client_eof", false);
+                continue;
+            }
+            if ((ur & (POLLIN | POLLHUP | POLLERR)) && !dir_fill(&c->down, c->ufd, now))
+            {
+                conn_close(c, "broker_eof", false);
+                continue;
+            }
+            if (!dir_flush(&c->up, c->ufd, now))
+            {
+                conn_close(c, "broker_error", false);
+                continue;
+            }
+            if (!dir_flush(&c->down, c->cfd, now))
+                conn_close(c, "client_error", false);
+        }
+    }
+
+    for (size_t i = 0; i < PROXY_MAX_CONNS; i++)
+        if (conns[i].used)
+            conn_close(&conns[i], "exit", false);
+    close(lfd);
+    event("summary",
+          "\"accepted\":%llu,\"refused\":%llu,\"closed_rst\":%llu,\"chunks\":%llu,\"lost\":%llu,"
+          "\"up_bytes\":%llu,\"down_bytes\":%llu",
+          (unsigned long long)stats.accepted, (unsigned long long)stats.refused,
+          (unsigned long long)stats.closed_rst, (unsigned long long)stats.chunks, (unsigned long long)stats.lost,
+          (unsigned long long)stats.up_bytes, (unsigned long long)stats.down_bytes);
+    return 0;
+}
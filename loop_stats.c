@@ -0,0 +1,49 @@
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "loop_stats.h"
+#include "applog.h"
+
+void loop_stats_init(LoopStats *s, const char *tag, uint32_t period_ms)
+{
+    *s = (LoopStats){0};
+    s->tag = tag;
+    s->period_us = period_ms * 1000;
+    s->window_start_us = time_us_64();
+}
+
+void loop_stats_sample(LoopStats *s)
+{
+    uint64_t now = time_us_64();
+    if (s->last_sample_us)
+    {
+        int64_t d = (int64_t)(now - s->last_sample_us) - s->period_us;
+        uint32_t j = (uint32_t)(d < 0 ? -d : d);
+        s->jitter_sum_us += j;
+        if (j > s->jitter_max_us)
+            s->jitter_max_us = j;
+    }
+    s->last_sample_us = now;
+    s->samples++;
+}
+
+void loop_stats_published(LoopStats *s)
+{
+    s->published++;
+}
+
+void loop_stats_report(LoopStats *s)
+{
+    uint64_t elapsed_us = time_us_64() - s->window_start_us;
+    uint32_t intervals = s->samples > 1 ? s->samples - 1 : 1;
+    // tools/compare_loop_stats.py が読む形式なので変えるときは合わせること
+    LOG_INFO(APP, "loop_stats[%s]: samples=%lu published=%lu elapsed_ms=%lu jitter_avg_us=%lu jitter_max_us=%lu rate_mHz=%lu\n",
+           s->tag, (unsigned long)s->samples, (unsigned long)s->published,
+           (unsigned long)(elapsed_us / 1000),
+           (unsigned long)(s->jitter_sum_us / intervals), (unsigned long)s->jitter_max_us,
+           (unsigned long)(elapsed_us ? (uint64_t)s->published * 1000000000ull / elapsed_us : 0));
+    (void)elapsed_us; // ログが無効なビルド用
+    (void)intervals;
+    const char *tag = s->tag;
+    uint32_t period_ms = s->period_us / 1000;
+    loop_stats_init(s, tag, period_ms);
+}
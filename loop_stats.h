@@ -0,0 +1,22 @@
+#pragma once
+#include <stdint.h>
+
+// サンプリング周期のジッタとスループットの計測（super-loop と FreeRTOS 版の比較用）
+typedef struct
+{
+    const char *tag;
+    uint32_t period_us;
+    uint64_t window_start_us;
+    uint64_t last_sample_us;
+    uint32_t samples;
+    uint32_t published;
+    uint64_t jitter_sum_us;
+    uint32_t jitter_max_us;
+} LoopStats;
+
+void loop_stats_init(LoopStats *s, const char *tag, uint32_t period_ms);
+// サンプリング開始時に呼ぶ。前回との間隔と周期のずれをジッタとして数える
+void loop_stats_sample(LoopStats *s);
+void loop_stats_published(LoopStats *s);
+// 1 行で出して窓をリセット
+void loop_stats_report(LoopStats *s);
@@ -18,28 +18,58 @@
 // MEM_LIBC_MALLOC is incompatible with non polling versions
 #define MEM_LIBC_MALLOC 0
 #endif
+#if !NO_SYS
+// pico_cyw43_arch_lwip_sys_freertos（mqcensor_freertos）用
+#define TCPIP_THREAD_STACKSIZE 1024
+#define DEFAULT_THREAD_STACKSIZE 1024
+#define DEFAULT_RAW_RECVMBOX_SIZE 8
+#define TCPIP_MBOX_SIZE 8
+#define LWIP_TCPIP_CORE_LOCKING_INPUT 1
+#endif
 #define MEM_ALIGNMENT 4
+#define TCP_MSS 1460
+#if MQCENSOR_LWIP_PROFILE_MINIMAL
+// sensor-minimal：送るのは 1 秒あたり数十バイトと、ときどき ~1KB の診断 JSON だけ。
+// 値はこの通信パターンからの見積もりで、まだ実機では測っていない。
+// MQCENSOR_LWIP_STATS ビルドで各プールの max と err（0 のままか）を見て詰め直すこと
+//   PBUF_POOL 24 → 8 だけで ~25KB、MEM_SIZE と TCP_SEG で数 KB 空く
+#ifndef MEM_SIZE
+#define MEM_SIZE 5000
+#endif
+#define MEMP_NUM_TCP_SEG 12
+#define MEMP_NUM_ARP_QUEUE 4
+#define PBUF_POOL_SIZE 8
+#define TCP_WND (2 * TCP_MSS)     // 受信は CONNACK/PUBACK 程度
+#define TCP_SND_BUF (2 * TCP_MSS) // lwIP の sanity check の下限
+#else
 #ifndef MEM_SIZE
 #define MEM_SIZE 8000
 #endif
 #define MEMP_NUM_TCP_SEG 32
 #define MEMP_NUM_ARP_QUEUE 10
 #define PBUF_POOL_SIZE 24
+#define TCP_WND (8 * TCP_MSS)
+#define TCP_SND_BUF (8 * TCP_MSS)
+#endif
 #define LWIP_ARP 1
 #define LWIP_ETHERNET 1
 #define LWIP_ICMP 1
 #define LWIP_RAW 1
-#define TCP_WND (8 * TCP_MSS)
-#define TCP_MSS 1460
-#define TCP_SND_BUF (8 * TCP_MSS)
 #define TCP_SND_QUEUELEN ((4 * (TCP_SND_BUF) + (TCP_MSS - 1)) / (TCP_MSS))
 #define LWIP_NETIF_STATUS_CALLBACK 1
 #define LWIP_NETIF_LINK_CALLBACK 1
 #define LWIP_NETIF_HOSTNAME 1
 #define LWIP_NETCONN 0
+#if MQCENSOR_LWIP_STATS
+// 計測ビルド：ヒープと各 memp プールの used/max/err を数えて診断トピックへ出す（mem_stats.c）
+#define LWIP_STATS 1
+#define MEM_STATS 1
+#define MEMP_STATS 1
+#else
 #define MEM_STATS 0
-#define SYS_STATS 0
 #define MEMP_STATS 0
+#endif
+#define SYS_STATS 0
 #define LINK_STATS 0
 // #define ETH_PAD_SIZE                2
 #define LWIP_CHKSUM_ALGORITHM 3
@@ -55,7 +85,9 @@
 
 #ifndef NDEBUG
 #define LWIP_DEBUG 1
+#ifndef LWIP_STATS
 #define LWIP_STATS 1
+#endif
 #define LWIP_STATS_DISPLAY 1
 #endif
 
@@ -87,6 +119,11 @@
 #define PPP_DEBUG LWIP_DBG_OFF
 #define SLIP_DEBUG LWIP_DBG_OFF
 #define DHCP_DEBUG LWIP_DBG_OFF
+// 接続診断の JSON（最大 ~1KB）を 1 メッセージで送れるように既定の 256 から拡張。
+// publish は 1 メッセージ丸ごとここに入らないと ERR_MEM。低消費電力版の JSON バッチは CMake で広げる
+#ifndef MQTT_OUTPUT_RINGBUF_SIZE
+#define MQTT_OUTPUT_RINGBUF_SIZE 1536
+#endif
 #define MEMP_NUM_SYS_TIMEOUT (LWIP_NUM_SYS_TIMEOUT_INTERNAL + 1)
 
 #endif /* __LWIPOPTS_H__ */
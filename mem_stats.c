@@ -0,0 +1,63 @@
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "lwip/stats.h"
+#include "lwip/memp.h"
+#include "mem_stats.h"
+
+#if MQCENSOR_LWIP_STATS
+
+#ifndef PICO_PROGRAM_VERSION_STRING
+#define PICO_PROGRAM_VERSION_STRING "dev"
+#endif
+
+#if !MEM_STATS || !MEMP_STATS
+#error "MQCENSOR_LWIP_STATS needs MEM_STATS and MEMP_STATS (lwipopts.h)"
+#endif
+
+// memp_t と同じ順番のプール名（stats_mem.name は LWIP_DEBUG ビルドにしか無い）
+static const char *const POOL_NAMES[MEMP_MAX] = {
+#define LWIP_MEMPOOL(name, num, size, desc) #name,
+#include "lwip/priv/memp_std.h"
+};
+
+static bool published = false;
+static absolute_time_t last_publish;
+
+bool mem_stats_publish_due(void)
+{
+    if (!published)
+        return true;
+    return absolute_time_diff_us(last_publish, get_absolute_time()) / 1000 > MEM_STATS_PUBLISH_MS;
+}
+
+static size_t format_pool(char *buf, size_t len, const char *name, const struct stats_mem *s)
+{
+    return (size_t)snprintf(buf, len, ",\"%s\":{\"used\":%lu,\"max\":%lu,\"avail\":%lu,\"err\":%lu}", name,
+                            (unsigned long)s->used, (unsigned long)s->max, (unsigned long)s->avail,
+                            (unsigned long)s->err);
+}
+
+size_t mem_stats_format(char *buf, size_t len)
+{
+    size_t n = (size_t)snprintf(buf, len, "{\"fw\":\"%s\"", PICO_PROGRAM_VERSION_STRING);
+    if (n < len)
+        n += format_pool(buf + n, len - n, "HEAP", &lwip_stats.mem);
+    for (int i = 0; i < MEMP_MAX && n < len; i++)
+    {
+        if (lwip_stats.memp[i])
+            n += format_pool(buf + n, len - n, POOL_NAMES[i], lwip_stats.memp[i]);
+    }
+    if (n < len)
+        n += (size_t)snprintf(buf + n, len - n, "}");
+    if (n >= len)
+        return 0; // 切れた JSON は送らない
+    return n;
+}
+
+void mem_stats_published(void)
+{
+    published = true;
+    last_publish = get_absolute_time();
+}
+
+#endif
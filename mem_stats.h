@@ -0,0 +1,25 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+
+// lwIP のヒープと memp プールの使用状況（MQCENSOR_LWIP_STATS の計測ビルドのみ）。
+// 各プールの used/max/avail/err を診断トピックへ出し、lwipopts.h の sensor-minimal プロファイルを決める材料にする
+#define MEM_STATS_PUBLISH_MS (10 * 60 * 1000) // 定期送信の周期
+
+#if MQCENSOR_LWIP_STATS
+// 起動後の初回、または前回送信から MEM_STATS_PUBLISH_MS 経過したら true
+bool mem_stats_publish_due(void);
+// 診断トピック用の JSON を組み立てる。lwIP ロック内で呼ぶこと
+size_t mem_stats_format(char *buf, size_t len);
+// publish が通ったときだけ呼ぶ（失敗したら次の機会にまた送る）
+void mem_stats_published(void);
+#else
+static inline bool mem_stats_publish_due(void) { return false; }
+static inline size_t mem_stats_format(char *buf, size_t len)
+{
+    (void)buf;
+    (void)len;
+    return 0;
+}
+static inline void mem_stats_published(void) {}
+#endif
@@ -1,224 +1,288 @@
 #include <stdio.h>
 #include "pico/stdlib.h"
+#include "pico/async_context.h"
 #include "pico/cyw43_arch.h"
-#include "hardware/i2c.h"
-#include "hardware/watchdog.h"
-#include "lwip/sockets.h"
-#include "lwip/netdb.h"
-#include "lwip/apps/mqtt.h"
-#include "lwip/netif.h"
-#include "lwip/ip4_addr.h"
 #include "wifi_config.h"
-
-#define MQTT_BROKER_PORT 1883
-#define MQTT_CLIENT_ID "pico2w"
-#define MQTT_TOPIC "pico2w/aht22"
-#define DHT_PIN 17
-
+#include "aht20.h"
+#include "wd.h"
+#include "net.h"
+#include "wifi_pm.h"
+#include "conn_stats.h"
+#include "mem_stats.h"
+#include "loop_stats.h"
+#include "applog.h"
+#include "supervisor.h"
+#include "runtime_config.h"
+#include "command.h"
+#include "placement.h"
+
+#define WIFI_PM_REPORT_EVERY 60 // 何回の publish ごとに省電力統計を出すか
+#define WIFI_PM_ACK_POLL_MS 5   // publish 後、ACK を待つ間のポーリング間隔
+#define WD_FEED_MS (WD_TIMEOUT_MS / 4)
+#define SV_SAMPLER_DEADLINE_MS 30000   // サンプリング自体が止まったらリセット（センサー故障では止めない）
+#define SV_PUBLISHER_DEADLINE_MS 60000 // 接続中なのに ACK が返らない状態の上限
+// conn ワーカーはブロックしないが、失敗後は backoff で最大 NET_RETRY_MAX_MS 空くので、それより長く
+#define SV_CONN_DEADLINE_MS (NET_RETRY_MAX_MS + 10000)
+
+// アプリはすべて cyw43_arch の async_context 上のワーカーとして動く
+// （threadsafe_background なので低優先度 IRQ で実行される）。どのワーカーもブロックせず、
+// 最長でも I2C のタイムアウト（3ms）程度で戻る。待ちはすべて at-time ワーカーの再登録で表す
+//
+//   sample  : 周期ごとに AHT20 をトリガして read を AHT20_CONVERSION_MS 後に登録
+//   cmd     : cmd トピックの "read" 要求で周期外にトリガする（変換中なら相乗りするだけ）
+//   read    : 読み出し → cmd の返信 → 整形 → outbox へ publish（デッドバンド内なら送らない）。
+//             リモート設定の反映もここ。cmd だけのための変換なら返信して終わり
+//   pm_wake : 次の flush の WIFI_PM_LEAD_MS 前に radio を performance に上げる
+//   pm_settle : publish の ACK（最大 WIFI_PM_ACK_WAIT_MS）を待って省電力へ戻す
+//   conn    : net_conn_step() で再接続の状態機械を進める。DEADLINE_MS で最終手段
+//   wd      : supervisor 経由で WDT を餌やり。ワーカーが詰まる・各サブシステムの
+//             ハートビートが途絶えると餌が止まるのでハングを検出できる
+static async_context_t *ctx;
+static LoopStats ls;
+static bool safe_mode = false;
+static bool pm_started = false;
+static bool boot_reported = false; // 前回リセットの記録を送ったか
 static absolute_time_t last_ok; // 直近で「正常」だった時刻（リンク or MQTT OK）
-#define WD_TIMEOUT_MS 8000      // WDT 8秒
-#define DEADLINE_MS 300000      // 5分復帰しなければ最終手段
-#define SAFE_REBOOTS 5          // 5連続再起動でセーフモード突入
-
-static inline bool ms_passed(absolute_time_t t, uint32_t ms)
+static absolute_time_t next_sample;
+static absolute_time_t settle_deadline;
+static uint32_t pub_count = 0;
+static bool converting = false;   // トリガ済みで read 待ち
+static bool periodic_due = false; // 次の read で周期の publish をする
+static absolute_time_t conv_triggered;
+
+static void sample_work(async_context_t *context, async_at_time_worker_t *worker);
+static void read_work(async_context_t *context, async_at_time_worker_t *worker);
+static void cmd_work(async_context_t *context, async_at_time_worker_t *worker);
+static void pm_wake_work(async_context_t *context, async_at_time_worker_t *worker);
+static void pm_settle_work(async_context_t *context, async_at_time_worker_t *worker);
+static void conn_work(async_context_t *context, async_at_time_worker_t *worker);
+static void wd_work(async_context_t *context, async_at_time_worker_t *worker);
+
+static async_at_time_worker_t sample_worker = {.do_work = sample_work};
+static async_at_time_worker_t read_worker = {.do_work = read_work};
+static async_at_time_worker_t cmd_worker = {.do_work = cmd_work};
+static async_at_time_worker_t pm_wake_worker = {.do_work = pm_wake_work};
+static async_at_time_worker_t pm_settle_worker = {.do_work = pm_settle_work};
+static async_at_time_worker_t conn_worker = {.do_work = conn_work};
+static async_at_time_worker_t wd_worker = {.do_work = wd_work};
+
+// 登録済みなら一度外してから入れ直す
+static void schedule_at(async_at_time_worker_t *worker, absolute_time_t t)
 {
-    return absolute_time_diff_us(t, get_absolute_time()) / 1000 > ms;
+    async_context_remove_at_time_worker(ctx, worker);
+    async_context_add_at_time_worker_at(ctx, worker, t);
 }
 
-static void wd_init_and_bootloop_guard(bool *safe_mode_out)
+static void schedule_in_ms(async_at_time_worker_t *worker, uint32_t ms)
 {
-    // 連続再起動回数を scratch レジスタに保存
-    uint32_t cnt = watchdog_hw->scratch[0];
-    if (watchdog_caused_reboot())
-        cnt++;
-    else
-        cnt = 0;
-    watchdog_hw->scratch[0] = cnt;
-
-    *safe_mode_out = (cnt >= SAFE_REBOOTS);
-
-    // 有効化（デバッガ接続時は一時停止 true）
-    watchdog_enable(WD_TIMEOUT_MS, true);
+    schedule_at(worker, make_timeout_time_ms(ms));
 }
 
-static void wd_feed(void)
+static void start_conversion(void)
 {
-    watchdog_update();
+    aht20_trigger();
+    conv_triggered = get_absolute_time();
+    converting = true;
+    schedule_in_ms(&read_worker, AHT20_CONVERSION_MS);
 }
 
-static void request_reboot_now(const char *reason)
+static void HOT_FUNC(sample_work)(async_context_t *context, async_at_time_worker_t *worker)
 {
-    printf("WDT reboot requested: %s\n", reason);
-    sleep_ms(50);
-    watchdog_reboot(0, 0, 0);
-    while (1)
-        tight_loop_contents();
+    loop_stats_sample(&ls);
+    // cmd の変換中なら再トリガせず、その結果を周期の分にも使う
+    periodic_due = true;
+    if (!converting)
+        start_conversion();
+
+    // 次の周期は絶対時刻で積む（処理時間でドリフトしない）。大きく遅れたら追いつかずに捨てる
+    uint32_t period_ms = runtime_config()->period_ms;
+    next_sample = delayed_by_ms(next_sample, period_ms);
+    if (time_reached(next_sample))
+        next_sample = make_timeout_time_ms(period_ms);
+    schedule_at(&sample_worker, next_sample);
+
+    if (pm_started)
+    {
+        uint64_t flush_us = to_us_since_boot(next_sample) + AHT20_CONVERSION_MS * 1000ull;
+        schedule_at(&pm_wake_worker, from_us_since_boot(flush_us - WIFI_PM_LEAD_MS * 1000ull));
+    }
 }
 
-typedef struct
+// 周期に合わせて監視の期限を付け直す（周期は次のサンプルから変わる）
+static void register_deadlines(void)
 {
-    float temp;
-    float hum;
-} AHT22Result;
-
-static const AHT22Result FAILRESULT = {-100.0f, -100.0f};
-
-static AHT22Result new_aht22result(float temperature, float humidity)
-{
-    AHT22Result r = {temperature, humidity};
-    return r;
+    // セーフモードはリセットを重ねないのが目的なので、どちらも監視しない
+    if (safe_mode)
+        return;
+    sv_register(SV_SAMPLER, runtime_config_deadline_ms(SV_SAMPLER_DEADLINE_MS));
+    sv_register(SV_PUBLISHER, runtime_config_deadline_ms(SV_PUBLISHER_DEADLINE_MS));
 }
 
-static bool is_failed(AHT22Result *result)
+static void apply_runtime_config(void)
 {
-    return result->hum == -100.0f || result->temp <= -100.0f;
+    if (!runtime_config_commit())
+        return;
+    ls.period_us = runtime_config()->period_ms * 1000;
+    register_deadlines();
 }
 
-static bool link_is_up(void)
+// cmd の要求が積まれた（lwIP コールバック = 同じ async_context 内）
+static void on_command(void)
 {
-    int st = cyw43_tcpip_link_status(&cyw43_state, CYW43_ITF_STA);
-    return st == CYW43_LINK_UP;
+    schedule_in_ms(&cmd_worker, 0);
 }
 
-static bool wifi_connect(void)
+static void cmd_work(async_context_t *context, async_at_time_worker_t *worker)
 {
-    int r = cyw43_arch_wifi_connect_timeout_ms(
-        WIFI_SSID, WIFI_PASS, CYW43_AUTH_WPA2_AES_PSK, 30000);
-
-    return r == 0;
+    publish_command_replies(NULL, conv_triggered, conv_triggered);
+    if (!command_read_pending() || converting)
+        return;
+    // 返信までの間 radio を performance にしておく（落とすのは read 後の pm_settle）
+    if (pm_started)
+        wifi_pm_prepare_publish();
+    start_conversion();
 }
 
-static void print_ip(void)
+static void HOT_FUNC(read_work)(async_context_t *context, async_at_time_worker_t *worker)
 {
-    struct netif *n = &cyw43_state.netif[0];
-    const ip4_addr_t *ip = netif_ip4_addr(n);
-    const ip4_addr_t *gw = netif_ip4_gw(n);
-    const ip4_addr_t *msk = netif_ip4_netmask(n);
-
-    // IPアドレスを文字列形式に変換して表示
-    char ip_str[16];
-    char gw_str[16];
-    char mask_str[16];
-
-    // IPアドレスを文字列に変換
-    ip4addr_ntoa_r(ip, ip_str, sizeof(ip_str));
-    ip4addr_ntoa_r(gw, gw_str, sizeof(gw_str));
-    ip4addr_ntoa_r(msk, mask_str, sizeof(mask_str));
-    printf("Pico STA IP=%s GW=%s MASK=%s\n",
-           ip_str, gw_str, mask_str);
-}
-
-static mqtt_client_t *client;
-static volatile bool mqtt_connected = false;
-const int SUCCESS = 6;
+    char payload[64];
+    AHT22Result r = aht20_read_result();
+    absolute_time_t converted = get_absolute_time();
+    converting = false;
+    // 読めなくてもチェックインする。センサーの故障はリセットでは直らないので、"failed" を publish して知らせる
+    sv_checkin(SV_SAMPLER);
+    // 切断中に来た分も溜めずに返す（送れなければ捨てる。要求側はタイムアウトで再送する）
+    if (command_read_pending())
+        publish_command_replies(&r, conv_triggered, converted);
+    if (!periodic_due)
+    {
+        if (pm_started)
+        {
+            settle_deadline = make_timeout_time_ms(WIFI_PM_ACK_WAIT_MS);
+            schedule_in_ms(&pm_settle_worker, WIFI_PM_ACK_POLL_MS);
+        }
+        return;
+    }
+    periodic_due = false;
+    aht20_format(&r, payload, sizeof(payload));
+
+    if (mqtt_connected && conn_stats_publish_due())
+        publish_conn_stats();
+    if (mqtt_connected && mem_stats_publish_due())
+        publish_mem_stats();
+    if (runtime_config_commit_due())
+        apply_runtime_config();
+    if (mqtt_connected && runtime_config_publish_due())
+        publish_runtime_config();
+    // 切断中でも outbox に積んでおき、再接続後に順番通り送る
+    err_t pe = ERR_OK;
+    if (runtime_config_should_publish(&r))
+    {
+        pe = net_publish_sample(payload);
+        if (pe == ERR_OK)
+            loop_stats_published(&ls);
+    }
+    // 切断中の publisher は責めない（復旧は conn と DEADLINE_MS の担当）。接続中は ACK でのみチェックイン
+    if (!mqtt_connected)
+        sv_checkin(SV_PUBLISHER);
+    LOG_DEBUG(MQTT, "publish: Temp=%d Hum=%d (x0.1, err=%d)\n", r.temp_deci, r.hum_deci, pe);
+    if (++pub_count % WIFI_PM_REPORT_EVERY == 0)
+    {
+        net_report();
+        loop_stats_report(&ls);
+    }
 
-static void mqtt_pub_request_cb(void *arg, err_t result)
-{
-    printf("MQTT publish result: %d\n", result);
+    if (pm_started)
+    {
+        settle_deadline = make_timeout_time_ms(WIFI_PM_ACK_WAIT_MS);
+        schedule_in_ms(&pm_settle_worker, WIFI_PM_ACK_POLL_MS);
+    }
 }
 
-static void mqtt_connection_cb(mqtt_client_t *client, void *arg, mqtt_connection_status_t status)
+static void pm_wake_work(async_context_t *context, async_at_time_worker_t *worker)
 {
-    printf("MQTT connection status: %d\n", status);
-    if (status == MQTT_CONNECT_ACCEPTED)
-        mqtt_connected = true;
-    else
-        mqtt_connected = false; // エラーを検知
+    wifi_pm_prepare_publish();
 }
 
-static AHT22Result read_aht20(void)
+static void pm_settle_work(async_context_t *context, async_at_time_worker_t *worker)
 {
-    uint8_t cmd[3] = {0xAC, 0x33, 0x00};
-    i2c_write_timeout_us(i2c0, 0x38, cmd, 3, false, 3000);
-    sleep_ms(80);
-
-    uint8_t buf[6];
-    int r = i2c_read_timeout_us(i2c0, 0x38, buf, 6, false, 3000);
-    if (r == SUCCESS)
-    {
-        uint32_t raw_h = ((uint32_t)(buf[1]) << 12) | ((uint32_t)buf[2] << 4) | (buf[3] >> 4);
-        uint32_t raw_t = (((uint32_t)buf[3] & 0x0F) << 16) | ((uint32_t)buf[4] << 8) | buf[5];
-        float hum = (raw_h * 100.0f) / 1048576.0f;
-        float tmp = (raw_t * 200.0f) / 1048576.0f - 50.0f;
-        // printf("AHT20: Temp=%.1f°C  Hum=%.1f%%\n", tmp, hum);
-        return new_aht22result(tmp, hum);
-    }
-    else
+    if (wifi_pm_publish_pending() && !time_reached(settle_deadline))
     {
-        // printf("AHT20 read failed (r=%d)\n", r);
+        schedule_in_ms(&pm_settle_worker, WIFI_PM_ACK_POLL_MS);
+        return;
     }
-    // 取得失敗
-    // -1度以下になることを考慮していない。埼玉だから問題なしか、、、
-    return FAILRESULT;
+    wifi_pm_publish_settled();
 }
 
-static bool wifi_mqtt_conn_init(ip_addr_t broker_addr, struct mqtt_connect_client_info_t ci)
+static void conn_work(async_context_t *context, async_at_time_worker_t *worker)
 {
-    bool ok = wifi_connect(); // 既存の関数
-    if (!ok)
+    uint32_t next_ms = net_conn_step();
+    sv_checkin(SV_CONN);
+    net_note_state();
+    if (link_is_up() && mqtt_connected)
     {
-        printf("Wi-Fi connect failed at boot\n");
-        return false;
+        last_ok = get_absolute_time();
+        if (!boot_reported)
+            boot_reported = publish_reboot_record();
+        if (!pm_started)
+        {
+            // 接続後は publish の合間を省電力にする
+            wifi_pm_init();
+            pm_started = true;
+        }
     }
-    cyw43_arch_lwip_begin();
-    err_t err = mqtt_client_connect(client, &broker_addr, MQTT_BROKER_PORT, mqtt_connection_cb, NULL, &ci);
-    cyw43_arch_lwip_end();
-    if (err != ERR_OK)
+    // 5分以上「リンクUP && MQTT接続」の状態に戻れない → 最終手段
+    if (ms_passed(last_ok, DEADLINE_MS))
     {
-        printf("mqtt_client_connect err=%d\n", err);
-        return false;
+        request_reboot_now(WD_REASON_NO_RECOVERY, "no recovery >5min");
     }
-
-    cyw43_arch_gpio_put(CYW43_WL_GPIO_LED_PIN, 1);
-    return true;
+    schedule_in_ms(&conn_worker, next_ms);
 }
 
-static struct mqtt_connect_client_info_t create_mqtt_client(void)
+static void wd_work(async_context_t *context, async_at_time_worker_t *worker)
 {
-    struct mqtt_connect_client_info_t ci = {0};
-    ci.client_id = MQTT_CLIENT_ID;
-    ci.will_msg = "offline";
-    ci.keep_alive = 30;
-    ci.will_qos = 1;
-    ci.will_retain = 1;
-    ci.client_user = NULL;
-    ci.client_pass = NULL;
-
-    return ci;
+    sv_poll();
+    schedule_in_ms(&wd_worker, WD_FEED_MS);
 }
 
 int main()
 {
     stdio_init_all();
-    i2c_init(i2c0, 100 * 1000);
-    gpio_set_function(17, GPIO_FUNC_I2C);
-    gpio_set_function(16, GPIO_FUNC_I2C);
-    gpio_pull_up(17);
-    gpio_pull_up(16);
+    runtime_config_init();
+    aht20_init();
     printf("I2C scan start\n");
     sleep_ms(1500);
     printf("Pico2W MQTT publisher start\n");
 
-    bool safe_mode = false;
     wd_init_and_bootloop_guard(&safe_mode);
+    const WdRebootRecord *rr = wd_last_reboot();
+    printf("Boot #%lu, previous reset: %s (subsystem=%s, uptime=%lus)\n", (unsigned long)rr->boot_count,
+           wd_reason_name(rr->reason), sv_name(rr->subsystem), (unsigned long)rr->uptime_s);
     // Wi-Fi/LwIP 初期化（BG スレッドで動く）
+    conn_stats_boot_arch_init_begin();
     if (cyw43_arch_init())
     {
         printf("cyw43_arch_init failed\n");
         return -1;
     }
+    conn_stats_boot_arch_init_end();
     // 省電力/LED初期化などは内部にお任せ
     cyw43_arch_enable_sta_mode();
 
-    printf("Connecting to Wi-Fi SSID: %s\n", WIFI_SSID);
+    if (!net_mqtt_init())
+        return -1;
+
+    ctx = cyw43_arch_async_context();
+    command_set_listener(on_command);
+    net_subscribe(device_topic(DEVICE_TOPIC_CMD), command_handle);
+    loop_stats_init(&ls, "async", runtime_config()->period_ms);
+    last_ok = get_absolute_time();
+
     if (!safe_mode)
     {
-        // wifiがつながるまで無限ループ
-        while (!wifi_connect())
-        {
-            sleep_ms(2000);
-        }
-        cyw43_arch_gpio_put(CYW43_WL_GPIO_LED_PIN, 1);
+        printf("Connecting to Wi-Fi SSID: %s\n", WIFI_SSID);
+        sv_register(SV_CONN, SV_CONN_DEADLINE_MS);
+        schedule_in_ms(&conn_worker, 0);
     }
     else
     {
@@ -227,76 +291,18 @@ int main()
         printf("SAFE MODE: Wi-Fi disabled due to repeated reboots\n");
         cyw43_arch_gpio_put(CYW43_WL_GPIO_LED_PIN, 0);
     }
+    register_deadlines();
+    schedule_in_ms(&wd_worker, 0);
+    next_sample = get_absolute_time();
+    schedule_at(&sample_worker, next_sample);
 
-    printf("Wi-Fi connected.\n");
-
-    client = mqtt_client_new();
-    if (!client)
-    {
-        printf("mqtt client new failed\n");
-        return -1;
-    }
-
-    ip_addr_t broker_addr;
-    ipaddr_aton(MQTT_BROKER_IP, &broker_addr);
-
-    struct mqtt_connect_client_info_t ci = create_mqtt_client();
-
-    cyw43_arch_lwip_begin();
-    err_t err = mqtt_client_connect(client, &broker_addr, MQTT_BROKER_PORT, mqtt_connection_cb, NULL, &ci);
-    cyw43_arch_lwip_end();
-    if (err != ERR_OK)
-    {
-        printf("mqtt_client_connect err=%d\n", err);
-        return -1;
-    }
-
-    // ★ コールバックで接続完了を待つ（sleep固定はやめる）
-    while (!mqtt_connected)
-    {
-        sleep_ms(10);
-    }
-
-    last_ok = get_absolute_time();
     while (true)
     {
-        wd_feed();
-        if (link_is_up() && mqtt_connected)
-        {
-            last_ok = get_absolute_time();
-        }
-        else
-        {
-            bool is_success = wifi_mqtt_conn_init(broker_addr, ci);
-            if (!is_success)
-            {
-                sleep_ms(1000);
-                continue;
-            }
-        }
-        // 5分以上「リンクUP && MQTT接続」の状態に戻れない → 最終手段
-        if (!safe_mode && ms_passed(last_ok, DEADLINE_MS))
-        {
-            request_reboot_now("no recovery >5min");
-        }
-        char payload[64];
-        AHT22Result r = read_aht20();
-        if (is_failed(&r))
-        {
-            snprintf(payload, sizeof(payload), "failed");
-        }
-        else
-        {
-            snprintf(payload, sizeof(payload), "Temp=%.1f°C Hum=%.1f%%", r.temp, r.hum);
-        }
-        cyw43_arch_lwip_begin();
-        err_t pe = mqtt_publish(client, MQTT_TOPIC, payload, strlen(payload), 0, 0, mqtt_pub_request_cb, NULL);
-        cyw43_arch_lwip_end();
-        printf("publish: %s (err=%d)\n", payload, pe);
-        sleep_ms(1000);
+        // 仕事はすべてワーカー側。ここは溜まったログを UART に出して、次の割り込みまで眠るだけ
+        if (!applog_drain())
+            __wfe();
     }
 
-    mqtt_client_free(client);
     cyw43_arch_deinit();
     return 0;
 }
@@ -0,0 +1,266 @@
+// 実機専用のマイクロベンチマーク。ホットな処理をサイクルカウンタで繰り返し計測し、
+// min/median/max サイクルを UART に出す。コンパイラフラグ、XIP と hot_ram / copy_to_ram、
+// RP2350 の Arm / RISC-V コアの比較に使う（tools/compare_arch_variants.py）
+//
+//   bench_env: arch=... placement=... clk_hz=... build=... hot_path=fixed|float
+//   bench[<名前>]: iters=N min=... median=... max=... cycles median_ns=...
+//   <名前>_cold は毎回 XIP キャッシュを無効化してから測った値（フラッシュからのフェッチ込み）
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/cyw43_arch.h"
+#include "hardware/clocks.h"
+#include "hardware/sync.h"
+#include "hardware/xip_cache.h"
+#if defined(__riscv)
+// Hazard3 の mcycle CSR
+#elif PICO_RP2040
+#include "hardware/structs/systick.h"
+#else
+#include "hardware/structs/m33.h"
+#endif
+#include "wifi_config.h"
+#include "aht20.h"
+#include "net.h"
+#include "applog.h"
+
+#define BENCH_ITERS 1000
+#define BENCH_PUBLISH_ITERS 200
+#define BENCH_PUBLISH_GAP_MS 5 // 送信バッファが空くまでの間隔（計測外）
+#define BENCH_CONNECT_TIMEOUT_MS 20000
+#define BENCH_TOPIC "pico2w/bench"
+
+#ifndef MQCENSOR_BENCH_BUILD
+#define MQCENSOR_BENCH_BUILD "unknown"
+#endif
+
+typedef void (*BenchFn)(void *arg);
+
+static uint32_t samples[BENCH_ITERS];
+static uint32_t overhead = 0; // 空の計測区間のサイクル（各結果から引く）
+
+// ---- サイクルカウンタ（アーキテクチャごと） ----
+#if defined(__riscv)
+static void cycles_init(void)
+{
+    __asm volatile("csrci 0x320, 1"); // mcountinhibit.CY = 0
+}
+
+static inline uint32_t cycles_now(void)
+{
+    uint32_t c;
+    __asm volatile("csrr %0, mcycle" : "=r"(c));
+    return c;
+}
+
+static inline uint32_t cycles_diff(uint32_t start, uint32_t end)
+{
+    return end - start;
+}
+#define BENCH_ARCH "riscv"
+#elif PICO_RP2040
+// M0+ には DWT が無いので SysTick（24bit ダウンカウンタ、プロセッサクロック）
+static void cycles_init(void)
+{
+    systick_hw->rvr = 0x00FFFFFF;
+    systick_hw->cvr = 0;
+    systick_hw->csr = 0x5; // ENABLE | CLKSOURCE=processor
+}
+
+static inline uint32_t cycles_now(void)
+{
+    return systick_hw->cvr;
+}
+
+static inline uint32_t cycles_diff(uint32_t start, uint32_t end)
+{
+    return (start - end) & 0x00FFFFFF;
+}
+#define BENCH_ARCH "arm-m0plus"
+#else
+static void cycles_init(void)
+{
+    m33_hw->demcr |= M33_DEMCR_TRCENA_BITS;
+    m33_hw->dwt_cyccnt = 0;
+    m33_hw->dwt_ctrl |= M33_DWT_CTRL_CYCCNTENA_BITS;
+}
+
+static inline uint32_t cycles_now(void)
+{
+    return m33_hw->dwt_cyccnt;
+}
+
+static inline uint32_t cycles_diff(uint32_t start, uint32_t end)
+{
+    return end - start;
+}
+#define BENCH_ARCH "arm"
+#endif
+
+#if PICO_COPY_TO_RAM
+#define BENCH_PLACEMENT "copy_to_ram"
+#elif MQCENSOR_HOT_IN_RAM
+#define BENCH_PLACEMENT "hot_ram"
+#elif PICO_NO_FLASH
+#define BENCH_PLACEMENT "no_flash"
+#else
+#define BENCH_PLACEMENT "xip"
+#endif
+
+#if AHT20_FIXED_POINT
+#define BENCH_HOT_PATH "fixed"
+#else
+#define BENCH_HOT_PATH "float"
+#endif
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+// 1 回ずつ割り込みを止めて計測する（gap は毎回の計測の前に計測外で呼ぶ。NULL 可）
+static uint32_t bench_measure(BenchFn fn, void *arg, uint32_t iters, void (*gap)(void))
+{
+    for (uint32_t i = 0; i < iters; i++)
+    {
+        if (gap)
+            gap();
+        uint32_t irq = save_and_disable_interrupts();
+        uint32_t t0 = cycles_now();
+        fn(arg);
+        uint32_t t1 = cycles_now();
+        restore_interrupts(irq);
+        uint32_t c = cycles_diff(t0, t1);
+        samples[i] = c > overhead ? c - overhead : 0;
+    }
+    qsort(samples, iters, sizeof(uint32_t), cmp_u32);
+    return iters;
+}
+
+static void bench_report(const char *name, uint32_t iters)
+{
+    uint32_t mhz = clock_get_hz(clk_sys) / 1000000;
+    uint32_t median = samples[iters / 2];
+    printf("bench[%s]: iters=%lu min=%lu median=%lu max=%lu cycles median_ns=%lu\n", name, (unsigned long)iters,
+           (unsigned long)samples[0], (unsigned long)median, (unsigned long)samples[iters - 1],
+           (unsigned long)(mhz ? median * 1000 / mhz : 0));
+}
+
+static void bench_run(const char *name, BenchFn fn, void *arg, uint32_t iters, void (*gap)(void))
+{
+    bench_report(name, bench_measure(fn, arg, iters, gap));
+}
+
+// ---- 計測対象 ----
+static void fn_empty(void *arg)
+{
+    (void)arg;
+}
+
+static volatile AHT22Result sink_result;
+static volatile int sink_len;
+
+static void fn_decode(void *arg)
+{
+    AHT22Result r = aht20_decode(arg);
+    sink_result.temp_centi = r.temp_centi;
+    sink_result.hum_centi = r.hum_centi;
+}
+
+static void fn_format(void *arg)
+{
+    char payload[64];
+    sink_len = aht20_format(arg, payload, sizeof(payload));
+}
+
+// 1 サンプル分の CPU 処理（読み出し値 → publish するテキスト）
+static void fn_sample_path(void *arg)
+{
+    char payload[64];
+    AHT22Result r = aht20_decode(arg);
+    sink_len = aht20_format(&r, payload, sizeof(payload));
+}
+
+static void fn_lwip_begin_end(void *arg)
+{
+    (void)arg;
+    cyw43_arch_lwip_begin();
+    cyw43_arch_lwip_end();
+}
+
+static void fn_publish(void *arg)
+{
+    const char *payload = arg;
+    sink_len = net_publish_direct(BENCH_TOPIC, payload, (uint16_t)strlen(payload), 0, NULL, NULL);
+}
+
+// XIP キャッシュを空にして、フラッシュからのフェッチ込み（サンプリング周期ごとに起きる状態）で測る
+static void cold_gap(void)
+{
+    xip_cache_invalidate_all();
+}
+
+static void publish_gap(void)
+{
+    sleep_ms(BENCH_PUBLISH_GAP_MS);
+}
+
+static bool connect_broker(void)
+{
+    if (!net_mqtt_init() || !wifi_mqtt_conn_init())
+        return false;
+    absolute_time_t until = make_timeout_time_ms(BENCH_CONNECT_TIMEOUT_MS);
+    while (!mqtt_connected && !time_reached(until))
+        sleep_ms(10);
+    return mqtt_connected;
+}
+
+int main()
+{
+    stdio_init_all();
+    sleep_ms(2000);
+    if (cyw43_arch_init())
+    {
+        printf("cyw43_arch_init failed\n");
+        return -1;
+    }
+    cyw43_arch_enable_sta_mode();
+    cycles_init();
+
+    printf("bench_env: arch=%s placement=%s clk_hz=%lu build=%s hot_path=%s\n", BENCH_ARCH, BENCH_PLACEMENT,
+           (unsigned long)clock_get_hz(clk_sys), MQCENSOR_BENCH_BUILD, BENCH_HOT_PATH);
+
+    bench_measure(fn_empty, NULL, BENCH_ITERS, NULL);
+    overhead = samples[0];
+    printf("bench_env: timer_overhead_cycles=%lu\n", (unsigned long)overhead);
+
+    // 22.5°C / 50% 相当の読み出し値
+    static const uint8_t frame[6] = {0x18, 0x80, 0x00, 0x05, 0xCC, 0xCD};
+    AHT22Result r = aht20_decode(frame);
+    bench_run("aht20_decode", fn_decode, (void *)frame, BENCH_ITERS, NULL);
+    bench_run("aht20_decode_cold", fn_decode, (void *)frame, BENCH_ITERS, cold_gap);
+    bench_run("aht20_format", fn_format, &r, BENCH_ITERS, NULL);
+    bench_run("aht20_format_cold", fn_format, &r, BENCH_ITERS, cold_gap);
+    bench_run("sample_path", fn_sample_path, (void *)frame, BENCH_ITERS, NULL);
+    bench_run("sample_path_cold", fn_sample_path, (void *)frame, BENCH_ITERS, cold_gap);
+    bench_run("lwip_begin_end", fn_lwip_begin_end, NULL, BENCH_ITERS, NULL);
+    bench_run("lwip_begin_end_cold", fn_lwip_begin_end, NULL, BENCH_ITERS, cold_gap);
+
+    if (connect_broker())
+    {
+        char payload[64];
+        aht20_format(&r, payload, sizeof(payload));
+        bench_run("mqtt_publish_enqueue", fn_publish, payload, BENCH_PUBLISH_ITERS, publish_gap);
+    }
+    else
+    {
+        printf("bench[mqtt_publish_enqueue]: skipped (no broker connection)\n");
+    }
+    applog_flush();
+    printf("bench_done\n");
+
+    while (true)
+        __wfe();
+}
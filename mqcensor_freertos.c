@@ -0,0 +1,287 @@
+// FreeRTOS SMP 版。センサー・publish・接続管理・WDT をタスクに分け、キューでつなぐ
+// 再接続（Wi-Fi 接続は最大 30 秒ブロック）がサンプリングを止めないようにするのが目的
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "pico/cyw43_arch.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "wifi_config.h"
+#include "aht20.h"
+#include "wd.h"
+#include "net.h"
+#include "conn_stats.h"
+#include "mem_stats.h"
+#include "loop_stats.h"
+#include "applog.h"
+#include "supervisor.h"
+#include "runtime_config.h"
+#include "command.h"
+
+#define WIFI_PM_REPORT_EVERY 60 // 何回の publish ごとに統計を出すか
+#define SAMPLE_QUEUE_LEN 16     // センサー → publish の待ち行列
+#define CONN_QUEUE_LEN 4
+
+// 優先度は WDT > センサー > publish > 接続管理
+#define SUPERVISOR_TASK_PRIORITY (tskIDLE_PRIORITY + 4)
+#define SENSOR_TASK_PRIORITY (tskIDLE_PRIORITY + 3)
+#define PUBLISH_TASK_PRIORITY (tskIDLE_PRIORITY + 2)
+#define CONN_TASK_PRIORITY (tskIDLE_PRIORITY + 1)
+#define LOG_TASK_PRIORITY tskIDLE_PRIORITY
+
+#define SUPERVISOR_TASK_STACK 512
+#define SENSOR_TASK_STACK 1024
+#define PUBLISH_TASK_STACK 1536
+#define CONN_TASK_STACK 2048
+#define LOG_TASK_STACK 1024
+#define LOG_DRAIN_IDLE_MS 10
+#define SV_SAMPLER_DEADLINE_MS 30000   // サンプリング自体が止まったらリセット（センサー故障では止めない）
+#define SV_PUBLISHER_DEADLINE_MS 60000 // 接続中なのに ACK が返らない状態の上限
+// conn タスクは wifi_connect で最大 NET_JOIN_TIMEOUT_MS ブロックする（backoff の待ちはチェックインしながら待つ）
+#define SV_CONN_DEADLINE_MS (NET_JOIN_TIMEOUT_MS + 15000)
+
+typedef struct
+{
+    AHT22Result r;
+    uint64_t t_us;    // 計測開始時刻
+    uint64_t done_us; // 読み出し完了時刻
+    bool on_demand;   // cmd の要求で周期外に読んだもの（publish はせず返信だけ）
+} Sample;
+
+static QueueHandle_t sample_q;
+static QueueHandle_t conn_q;
+static volatile absolute_time_t last_ok; // 直近で「正常」だった時刻（リンク or MQTT OK）
+static volatile uint32_t samples_dropped = 0;
+static bool safe_mode = false;
+// conn タスクが cyw43_arch と MQTT クライアントを初期化し終えた。それまで（失敗・セーフモードなら
+// ずっと）publish タスクは lwIP/cyw43 に触らない（lwip_begin は初期化前の arch では使えない）
+static volatile bool net_ready = false;
+static TaskHandle_t sensor_handle;
+
+// lwIP（tcpip スレッド）から呼ばれるので待たずに積むだけ
+static void on_conn_status(mqtt_connection_status_t status)
+{
+    xQueueSend(conn_q, &status, 0);
+}
+
+// cmd の要求が積まれた（tcpip スレッド）。センサータスクの周期待ちを起こす
+static void on_command(void)
+{
+    xTaskNotifyGive(sensor_handle);
+}
+
+static void sensor_task(void *param)
+{
+    LoopStats *ls = (LoopStats *)param;
+    TickType_t next = xTaskGetTickCount();
+    while (true)
+    {
+        // 次の周期までは cmd の要求を待つ。来たら周期をずらさずに 1 回だけ読む
+        bool on_demand = false;
+        TickType_t wait = next - xTaskGetTickCount();
+        if ((int32_t)wait > 0)
+            on_demand = ulTaskNotifyTake(pdTRUE, wait) > 0;
+        if (!on_demand)
+        {
+            loop_stats_sample(ls);
+            next += pdMS_TO_TICKS(runtime_config()->period_ms);
+        }
+        Sample s = {.t_us = time_us_64(), .on_demand = on_demand};
+        s.r = read_aht20();
+        s.done_us = time_us_64();
+        // 読めなくてもチェックインする。センサーの故障はリセットでは直らないので、"failed" を publish して知らせる
+        sv_checkin(SV_SAMPLER);
+        // publish 側が詰まっていても待たない（捨てて数える）。要求への返信は先に回す
+        BaseType_t queued = on_demand ? xQueueSendToFront(sample_q, &s, 0) : xQueueSend(sample_q, &s, 0);
+        if (queued != pdTRUE)
+            samples_dropped++;
+    }
+}
+
+// 周期に合わせて監視の期限を付け直す
+static void register_deadlines(void)
+{
+    // セーフモードはリセットを重ねないのが目的なので、どちらも監視しない
+    if (safe_mode)
+        return;
+    sv_register(SV_SAMPLER, runtime_config_deadline_ms(SV_SAMPLER_DEADLINE_MS));
+    sv_register(SV_PUBLISHER, runtime_config_deadline_ms(SV_PUBLISHER_DEADLINE_MS));
+}
+
+static void publish_task(void *param)
+{
+    LoopStats *ls = (LoopStats *)param;
+    uint32_t pub_count = 0;
+    Sample s;
+    while (true)
+    {
+        if (xQueueReceive(sample_q, &s, portMAX_DELAY) != pdTRUE)
+            continue;
+        // 周期の計測でも、待っている要求があればその値で答える
+        if (net_ready && (s.on_demand || command_read_pending()))
+            publish_command_replies(&s.r, from_us_since_boot(s.t_us), from_us_since_boot(s.done_us));
+        if (s.on_demand)
+            continue;
+        if (net_ready && runtime_config_commit_due() && runtime_config_commit())
+        {
+            ls->period_us = runtime_config()->period_ms * 1000;
+            register_deadlines();
+        }
+        if (mqtt_connected && runtime_config_publish_due())
+            publish_runtime_config();
+        char payload[64];
+        aht20_format(&s.r, payload, sizeof(payload));
+        err_t pe = ERR_OK;
+        if (net_ready && runtime_config_should_publish(&s.r))
+        {
+            pe = net_publish_sample(payload);
+            if (pe == ERR_OK)
+                loop_stats_published(ls);
+        }
+        // 切断中の publisher は責めない。接続中は ACK（mqtt_pub_request_cb）でのみチェックイン
+        if (!mqtt_connected)
+            sv_checkin(SV_PUBLISHER);
+        LOG_DEBUG(MQTT, "publish: Temp=%d Hum=%d (x0.1, err=%d)\n", s.r.temp_deci, s.r.hum_deci, pe);
+        if (mqtt_connected && conn_stats_publish_due())
+            publish_conn_stats();
+        if (mqtt_connected && mem_stats_publish_due())
+            publish_mem_stats();
+        if (++pub_count % WIFI_PM_REPORT_EVERY == 0)
+        {
+            net_report();
+            LOG_INFO(APP, "freertos: samples_dropped=%lu\n", (unsigned long)samples_dropped);
+            loop_stats_report(ls);
+        }
+    }
+}
+
+// 張り直しまでの backoff（最大 NET_RETRY_MAX_MS）。待っている間も NET_STEP_IDLE_MS ごとにチェックインする
+static void retry_wait(uint32_t ms)
+{
+    while (ms)
+    {
+        uint32_t step = ms < NET_STEP_IDLE_MS ? ms : NET_STEP_IDLE_MS;
+        vTaskDelay(pdMS_TO_TICKS(step));
+        ms -= step;
+        sv_checkin(SV_CONN);
+    }
+}
+
+static void conn_task(void *param)
+{
+    (void)param;
+    // sys_freertos ではスケジューラ起動後に初期化する必要がある
+    conn_stats_boot_arch_init_begin();
+    if (cyw43_arch_init())
+    {
+        LOG_ERROR(WIFI, "cyw43_arch_init failed\n");
+        vTaskDelete(NULL);
+    }
+    conn_stats_boot_arch_init_end();
+    cyw43_arch_enable_sta_mode();
+
+    if (safe_mode)
+    {
+        // セーフモード：Wi-Fiを明示的に下げる（人が触れる状態を優先）
+        cyw43_wifi_set_up(&cyw43_state, CYW43_ITF_STA, false, 0);
+        LOG_WARN(WD, "SAFE MODE: Wi-Fi disabled due to repeated reboots\n");
+        cyw43_arch_gpio_put(CYW43_WL_GPIO_LED_PIN, 0);
+        vTaskDelete(NULL);
+    }
+
+    if (!net_mqtt_init())
+        vTaskDelete(NULL);
+    net_ready = true;
+    net_set_status_listener(on_conn_status);
+    command_set_listener(on_command);
+    net_subscribe(device_topic(DEVICE_TOPIC_CMD), command_handle);
+    LOG_INFO(WIFI, "Connecting to Wi-Fi SSID: %s\n", WIFI_SSID);
+
+    bool boot_reported = false; // 前回リセットの記録を送ったか
+    // publish がサンプリング周期と非同期なので wifi_pm のスケジュールは使わず DEFAULT_PM のまま
+    while (true)
+    {
+        sv_checkin(SV_CONN);
+        net_note_state();
+        if (link_is_up() && mqtt_connected)
+        {
+            last_ok = get_absolute_time();
+            net_retry_reset();
+            if (!boot_reported)
+                boot_reported = publish_reboot_record();
+        }
+        else if (!wifi_mqtt_conn_init())
+        {
+            retry_wait(net_retry_delay_ms());
+            continue;
+        }
+        // 状態変化か 1 秒経過で見直す
+        mqtt_connection_status_t status;
+        xQueueReceive(conn_q, &status, pdMS_TO_TICKS(1000));
+    }
+}
+
+// UART への出力はここだけ。一番低い優先度で溜まったログを吐き出す
+static void log_task(void *param)
+{
+    (void)param;
+    while (true)
+    {
+        if (!applog_drain())
+            vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_IDLE_MS));
+    }
+}
+
+static void supervisor_task(void *param)
+{
+    (void)param;
+    while (true)
+    {
+        // 全タスクのハートビートが期限内のときだけ餌をやる
+        sv_poll();
+        // 5分以上「リンクUP && MQTT接続」の状態に戻れない → 最終手段
+        if (!safe_mode && ms_passed(last_ok, DEADLINE_MS))
+            request_reboot_now(WD_REASON_NO_RECOVERY, "no recovery >5min");
+        vTaskDelay(pdMS_TO_TICKS(WD_TIMEOUT_MS / 4));
+    }
+}
+
+int main()
+{
+    stdio_init_all();
+    runtime_config_init();
+    aht20_init();
+    printf("Pico2W MQTT publisher start (FreeRTOS SMP)\n");
+
+    wd_init_and_bootloop_guard(&safe_mode);
+    const WdRebootRecord *rr = wd_last_reboot();
+    printf("Boot #%lu, previous reset: %s (subsystem=%s, uptime=%lus)\n", (unsigned long)rr->boot_count,
+           wd_reason_name(rr->reason), sv_name(rr->subsystem), (unsigned long)rr->uptime_s);
+    // セーフモードでは conn タスクが終了するので publisher と conn は監視しない
+    register_deadlines();
+    if (!safe_mode)
+        sv_register(SV_CONN, SV_CONN_DEADLINE_MS);
+    last_ok = get_absolute_time();
+
+    sample_q = xQueueCreate(SAMPLE_QUEUE_LEN, sizeof(Sample));
+    conn_q = xQueueCreate(CONN_QUEUE_LEN, sizeof(mqtt_connection_status_t));
+
+    static LoopStats ls;
+    loop_stats_init(&ls, "freertos", runtime_config()->period_ms);
+
+    TaskHandle_t publisher, conn, supervisor;
+    xTaskCreate(supervisor_task, "wdt", SUPERVISOR_TASK_STACK, NULL, SUPERVISOR_TASK_PRIORITY, &supervisor);
+    xTaskCreate(sensor_task, "sensor", SENSOR_TASK_STACK, &ls, SENSOR_TASK_PRIORITY, &sensor_handle);
+    xTaskCreate(publish_task, "publish", PUBLISH_TASK_STACK, &ls, PUBLISH_TASK_PRIORITY, &publisher);
+    xTaskCreate(conn_task, "conn", CONN_TASK_STACK, NULL, CONN_TASK_PRIORITY, &conn);
+    xTaskCreate(log_task, "log", LOG_TASK_STACK, NULL, LOG_TASK_PRIORITY, NULL);
+
+    // サンプリングは core1 に固定して、ネットワーク側（core0 の cyw43/lwIP）の影響を受けないようにする
+    vTaskCoreAffinitySet(sensor_handle, 1 << 1);
+    vTaskCoreAffinitySet(supervisor, 1 << 1);
+    vTaskCoreAffinitySet(publisher, 1 << 0);
+    vTaskCoreAffinitySet(conn, 1 << 0);
+
+    vTaskStartScheduler();
+    return 0;
+}
@@ -0,0 +1,393 @@
+// 低消費電力版（電池運用向け）。サンプルの合間は powman でスイッチドコアごと電源を落とし、
+// AON タイマーのアラームで起きる。起きるたびにコールドブートになるので、サンプルは
+// 電源を残した SRAM（__uninitialized_ram）に貯め、LOWPOWER_BATCH_N 個たまった時だけ
+// CYW43 を起こしてまとめて 1 メッセージで送る
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/cyw43_arch.h"
+#include "hardware/powman.h"
+#include "lwip/apps/mqtt_opts.h" // MQTT_OUTPUT_RINGBUF_SIZE
+#include "wifi_config.h"
+#include "aht20.h"
+#include "wd.h"
+#include "net.h"
+#include "applog.h"
+#include "runtime_config.h"
+#include "device_id.h"
+#include "backoff.h"
+#include "tspack.h"
+
+// 周期（PUBLISH_PERIOD_MS）と何サンプルごとに送るか（LOWPOWER_BATCH_N）は既定値。実際の値は runtime_config()
+#define LOWPOWER_BATCH_MAX RUNTIME_CONFIG_BATCH_MAX // 送信失敗時に貯めておける上限（古いものから捨てる）
+#define LOWPOWER_CONNECT_TIMEOUT_MS 15000
+#define LOWPOWER_ACK_TIMEOUT_MS 5000
+#define LOWPOWER_CONFIG_WINDOW_MS 300 // 送信後、切断中に溜まっていた config/set を受け取る時間
+#define LOWPOWER_PROBE_PIN 15 // 起きている間 High（電源解析器のトリガ用）
+// 送れなかったら、次に無線を起こすまでこの間で倍々に空ける（届かないブローカーに毎回 15 秒払わない）
+#define LOWPOWER_UPLINK_RETRY_MIN_MS 30000
+#define LOWPOWER_UPLINK_RETRY_MAX_MS (30 * 60 * 1000)
+// JSON 形式のバッチの最大長: 固定部 + 1 サンプルあたり ",4294967295" ",-32768" ",-32768"
+#define LOWPOWER_JSON_MAX (256 + LOWPOWER_BATCH_MAX * (11 + 7 + 7))
+// 圧縮形式の最大長: マジック + メタ数 + メタ 7 個（LEB128 で各 5 バイトまで）+ ストリーム
+#define LOWPOWER_PACKED_MAX (2 + 7 * 5 + TSPACK_MAX_BYTES(LOWPOWER_BATCH_MAX))
+// バッチを tspack の圧縮形式で送る（0 なら JSON）。60 サンプルで 1KB 近い JSON が数十バイトになる
+#ifndef LOWPOWER_BATCH_PACKED
+#define LOWPOWER_BATCH_PACKED 1
+#endif
+#define LOWPOWER_PAYLOAD_MAX (LOWPOWER_BATCH_PACKED ? LOWPOWER_PACKED_MAX : LOWPOWER_JSON_MAX)
+// PUBLISH 1 通の最大長: 固定ヘッダ（1 + 残り長 2）+ トピック（長さ 2 + 本体）+ パケット ID 2 + ペイロード
+#define LOWPOWER_PUBLISH_MAX (1 + 2 + 2 + DEVICE_TOPIC_MAX + 2 + LOWPOWER_PAYLOAD_MAX)
+// 貯めきった最大のバッチでも lwIP の送信リングに 1 通で入らないと、何度送り直しても ERR_MEM になる
+_Static_assert(LOWPOWER_PUBLISH_MAX <= MQTT_OUTPUT_RINGBUF_SIZE,
+               "low-power batch does not fit MQTT_OUTPUT_RINGBUF_SIZE (see CMakeLists.txt)");
+
+// 消費エネルギーの見積もりに使う電流 [uA]（実測値で上書きすること）
+#ifndef LOWPOWER_I_ACTIVE_UA
+#define LOWPOWER_I_ACTIVE_UA 25000 // CPU 動作・無線オフ
+#endif
+#ifndef LOWPOWER_I_RADIO_UA
+#define LOWPOWER_I_RADIO_UA 70000 // CYW43 起動〜publish
+#endif
+#ifndef LOWPOWER_I_SLEEP_UA
+#define LOWPOWER_I_SLEEP_UA 200 // P1 状態（SRAM 保持）
+#endif
+#define LOWPOWER_SUPPLY_MV 3300
+
+#define LOWPOWER_MAGIC 0x4c505732 // "LPW2"（LowPowerState の並びを変えたら上げる）
+
+typedef struct
+{
+    uint32_t t_ms;  // powman タイマー [ms]
+    int16_t temp_c; // 0.01℃ 単位（失敗は INT16_MIN）
+    int16_t hum;    // 0.01% 単位
+} LpSample;
+
+// 電源断をまたいで保持する状態
+typedef struct
+{
+    uint32_t magic;
+    uint32_t batch_seq;
+    uint32_t count;
+    LpSample samples[LOWPOWER_BATCH_MAX];
+    uint64_t next_wake_ms;
+    uint64_t last_sleep_ms; // 直前に電源を落とした時刻
+    uint64_t next_uplink_ms; // 送信に失敗したあと、これより前は無線を起こさない（0 = いつでも）
+    Backoff uplink_retry;
+    // 今のバッチ区間のエネルギー計測
+    uint32_t active_ms; // 起きていて無線は使っていない時間
+    uint32_t radio_ms;  // CYW43 を起こしていた時間
+    uint32_t sleep_ms;
+    uint32_t wakes;
+    // wake → PUBACK の遅延
+    uint32_t uplinks;
+    uint32_t w2p_last_ms;
+    uint32_t w2p_max_ms;
+    uint64_t w2p_sum_ms;
+    uint32_t checksum;
+} LowPowerState;
+
+static LowPowerState __uninitialized_ram(lp);
+
+static volatile bool batch_acked = false;
+
+static uint32_t lp_checksum(void)
+{
+    const uint32_t *w = (const uint32_t *)&lp;
+    uint32_t sum = 0x811c9dc5;
+    for (size_t i = 0; i < offsetof(LowPowerState, checksum) / 4; i++)
+        sum = (sum ^ w[i]) * 0x01000193;
+    return sum;
+}
+
+static void lp_reset(void)
+{
+    memset(&lp, 0, sizeof(lp));
+    lp.magic = LOWPOWER_MAGIC;
+    // 同じブローカーが落ちても機器ごとの再試行がばらけるよう、乱数は board ID から
+    device_id_init();
+    uint32_t seed = 0x811c9dc5;
+    for (const char *p = device_board_id(); *p; p++)
+        seed = (seed ^ (uint8_t)*p) * 0x01000193;
+    backoff_init(&lp.uplink_retry, LOWPOWER_UPLINK_RETRY_MIN_MS, LOWPOWER_UPLINK_RETRY_MAX_MS, seed);
+}
+
+static uint64_t wake_time_ms(void)
+{
+    // main に来るまでのブート時間も起きている時間に含める
+    return powman_timer_get_ms() - to_ms_since_boot(get_absolute_time());
+}
+
+static void take_sample(void)
+{
+    if (lp.count == LOWPOWER_BATCH_MAX)
+    {
+        memmove(&lp.samples[0], &lp.samples[1], sizeof(LpSample) * (LOWPOWER_BATCH_MAX - 1));
+        lp.count--;
+    }
+    AHT22Result r = read_aht20();
+    LpSample *s = &lp.samples[lp.count++];
+    s->t_ms = (uint32_t)powman_timer_get_ms();
+    if (is_failed(&r))
+    {
+        s->temp_c = INT16_MIN;
+        s->hum = INT16_MIN;
+    }
+    else
+    {
+        s->temp_c = r.temp_centi;
+        s->hum = r.hum_centi;
+    }
+}
+
+static void batch_pub_cb(void *arg, err_t result)
+{
+    if (result == ERR_OK)
+        batch_acked = true;
+}
+
+// 1 サンプルあたりの推定エネルギー [uJ]
+static uint32_t energy_per_sample_uj(void)
+{
+    uint64_t ua_ms = (uint64_t)lp.active_ms * LOWPOWER_I_ACTIVE_UA +
+                     (uint64_t)lp.radio_ms * LOWPOWER_I_RADIO_UA +
+                     (uint64_t)lp.sleep_ms * LOWPOWER_I_SLEEP_UA;
+    uint64_t uj = ua_ms * LOWPOWER_SUPPLY_MV / 1000000;
+    return lp.count ? (uint32_t)(uj / lp.count) : 0;
+}
+
+static size_t format_batch(char *buf, size_t len)
+{
+    size_t n = (size_t)snprintf(buf, len,
+                                "{\"seq\":%lu,\"period_ms\":%u,\"t0_ms\":%lu,\"uj_per_sample\":%lu,"
+                                "\"wake_ms\":%lu,\"radio_ms\":%lu,\"w2p_last_ms\":%lu,\"w2p_max_ms\":%lu,\"t\":[",
+                                (unsigned long)lp.batch_seq, (unsigned)runtime_config()->period_ms,
+                                (unsigned long)lp.samples[0].t_ms,
+                                (unsigned long)energy_per_sample_uj(), (unsigned long)lp.active_ms,
+                                (unsigned long)lp.radio_ms, (unsigned long)lp.w2p_last_ms, (unsigned long)lp.w2p_max_ms);
+    // 温湿度は 0.01 単位の整数、時刻は先頭からの差分 [ms]
+    for (uint32_t i = 0; i < lp.count && n < len; i++)
+        n += (size_t)snprintf(buf + n, len - n, i ? ",%lu" : "%lu",
+                              (unsigned long)(lp.samples[i].t_ms - lp.samples[0].t_ms));
+    if (n < len)
+        n += (size_t)snprintf(buf + n, len - n, "],\"temp_c\":[");
+    for (uint32_t i = 0; i < lp.count && n < len; i++)
+        n += (size_t)snprintf(buf + n, len - n, i ? ",%d" : "%d", lp.samples[i].temp_c);
+    if (n < len)
+        n += (size_t)snprintf(buf + n, len - n, "],\"hum\":[");
+    for (uint32_t i = 0; i < lp.count && n < len; i++)
+        n += (size_t)snprintf(buf + n, len - n, i ? ",%d" : "%d", lp.samples[i].hum);
+    if (n < len)
+        n += (size_t)snprintf(buf + n, len - n, "]}");
+    return n < len ? n : 0;
+}
+
+// 圧縮形式（tspack.h）。メタは JSON 形式と同じ項目を同じ順に
+static size_t format_batch_packed(uint8_t *buf, size_t len)
+{
+    const uint32_t meta[] = {lp.batch_seq, runtime_config()->period_ms, energy_per_sample_uj(), lp.active_ms,
+                             lp.radio_ms, lp.w2p_last_ms, lp.w2p_max_ms};
+    if (len < 2)
+        return 0;
+    buf[0] = TSPACK_BATCH_MAGIC;
+    buf[1] = (uint8_t)(sizeof(meta) / sizeof(meta[0]));
+    size_t n = 2;
+    for (size_t i = 0; i < sizeof(meta) / sizeof(meta[0]); i++)
+    {
+        size_t w = tspack_put_uvarint(buf + n, len - n, meta[i]);
+        if (!w)
+            return 0;
+        n += w;
+    }
+    TsPack pack;
+    tspack_init(&pack, buf + n, len - n);
+    for (uint32_t i = 0; i < lp.count; i++)
+        tspack_add(&pack, lp.samples[i].t_ms, lp.samples[i].temp_c, lp.samples[i].hum);
+    size_t w = tspack_finish(&pack);
+    return w ? n + w : 0;
+}
+
+static void wait_feeding_ms(uint32_t ms)
+{
+    absolute_time_t until = make_timeout_time_ms(ms);
+    while (!time_reached(until))
+    {
+        wd_feed();
+        sleep_ms(5);
+    }
+}
+
+// CYW43 を起こしてバッチを送る。成功したら true。無線を起こしていた時間を *radio_ms に
+static bool uplink_batch(uint64_t woke_ms, uint32_t *radio_ms)
+{
+    uint64_t radio_start = powman_timer_get_ms();
+    bool ok = false;
+    *radio_ms = 0;
+    if (cyw43_arch_init())
+    {
+        printf("cyw43_arch_init failed\n");
+        return false;
+    }
+    cyw43_arch_enable_sta_mode();
+
+    // WDT（8秒）を餌やりしながら待つので、ブロッキングの wifi_connect は使わない
+    absolute_time_t deadline = make_timeout_time_ms(LOWPOWER_CONNECT_TIMEOUT_MS);
+    cyw43_arch_wifi_connect_async(WIFI_SSID, WIFI_PASS, CYW43_AUTH_WPA2_AES_PSK);
+    while (!link_is_up() && !time_reached(deadline))
+    {
+        wd_feed();
+        sleep_ms(10);
+    }
+
+    if (link_is_up() && net_mqtt_init() && net_mqtt_connect())
+    {
+        while (!mqtt_connected && !time_reached(deadline))
+        {
+            wd_feed();
+            sleep_ms(10);
+        }
+
+        static char payload[LOWPOWER_PAYLOAD_MAX];
+        size_t n = LOWPOWER_BATCH_PACKED ? format_batch_packed((uint8_t *)payload, sizeof(payload))
+                                         : format_batch(payload, sizeof(payload));
+        batch_acked = false;
+        if (mqtt_connected && n &&
+            net_publish_direct(device_topic(DEVICE_TOPIC_BATCH), payload, (uint16_t)n, 1, batch_pub_cb, NULL) == ERR_OK)
+        {
+            deadline = make_timeout_time_ms(LOWPOWER_ACK_TIMEOUT_MS);
+            while (!batch_acked && !time_reached(deadline))
+            {
+                wd_feed();
+                sleep_ms(5);
+            }
+            ok = batch_acked;
+        }
+        // 永続セッションでブローカーが持っていた設定変更を受け取り、結果を返してから落とす
+        if (mqtt_connected)
+        {
+            wait_feeding_ms(LOWPOWER_CONFIG_WINDOW_MS);
+            if (runtime_config_commit_due())
+                runtime_config_commit();
+            if (runtime_config_publish_due() && publish_runtime_config())
+                wait_feeding_ms(LOWPOWER_CONFIG_WINDOW_MS);
+        }
+    }
+
+    if (ok)
+    {
+        uint32_t w2p = (uint32_t)(powman_timer_get_ms() - woke_ms);
+        lp.uplinks++;
+        lp.w2p_last_ms = w2p;
+        lp.w2p_sum_ms += w2p;
+        if (w2p > lp.w2p_max_ms)
+            lp.w2p_max_ms = w2p;
+        LOG_INFO(MQTT, "batch %lu sent: %lu samples, wake->puback %lums\n",
+               (unsigned long)lp.batch_seq, (unsigned long)lp.count, (unsigned long)w2p);
+    }
+    else
+    {
+        LOG_WARN(MQTT, "batch %lu uplink failed, keeping %lu samples\n",
+               (unsigned long)lp.batch_seq, (unsigned long)lp.count);
+    }
+    cyw43_arch_deinit();
+    *radio_ms = (uint32_t)(powman_timer_get_ms() - radio_start);
+    lp.radio_ms += *radio_ms;
+    return ok;
+}
+
+// 次の起床時刻まで電源を落とす。戻ってこない（起床はコールドブート）
+static void power_off_until(uint64_t wake_ms)
+{
+    // SRAM だけ残して他は全部落とす（P1 状態）。起きたら通常ブート
+    powman_power_state off_state = POWMAN_POWER_STATE_NONE;
+    off_state = powman_power_state_with_domain_on(off_state, POWMAN_POWER_DOMAIN_SRAM_BANK0);
+    off_state = powman_power_state_with_domain_on(off_state, POWMAN_POWER_DOMAIN_SRAM_BANK1);
+    powman_power_state on_state = POWMAN_POWER_STATE_NONE;
+    on_state = powman_power_state_with_domain_on(on_state, POWMAN_POWER_DOMAIN_SWITCHED_CORE);
+    on_state = powman_power_state_with_domain_on(on_state, POWMAN_POWER_DOMAIN_XIP_CACHE);
+    on_state = powman_power_state_with_domain_on(on_state, POWMAN_POWER_DOMAIN_SRAM_BANK0);
+    on_state = powman_power_state_with_domain_on(on_state, POWMAN_POWER_DOMAIN_SRAM_BANK1);
+
+    lp.last_sleep_ms = powman_timer_get_ms();
+    lp.checksum = lp_checksum();
+    applog_flush();
+    gpio_put(LOWPOWER_PROBE_PIN, 0);
+
+    powman_set_debug_power_request_ignored(true);
+    if (!powman_configure_wakeup_state(off_state, on_state))
+        request_reboot_now(WD_REASON_FATAL, "powman wakeup state");
+    powman_hw->boot[0] = 0;
+    powman_hw->boot[1] = 0;
+    powman_hw->boot[2] = 0;
+    powman_hw->boot[3] = 0;
+    powman_enable_alarm_wakeup_at_ms(wake_ms);
+    if (!powman_set_power_state(off_state))
+        request_reboot_now(WD_REASON_FATAL, "powman power state");
+    while (true)
+        __wfi();
+}
+
+int main()
+{
+    gpio_init(LOWPOWER_PROBE_PIN);
+    gpio_set_dir(LOWPOWER_PROBE_PIN, GPIO_OUT);
+    gpio_put(LOWPOWER_PROBE_PIN, 1);
+    stdio_init_all();
+    runtime_config_init();
+    aht20_init();
+
+    if (!powman_timer_is_running())
+    {
+        // 電源投入直後だけ。以降 AON タイマーは電源断中も動き続ける
+        powman_timer_set_1khz_tick_source_lposc();
+        powman_timer_set_ms(0);
+        powman_timer_start();
+    }
+    if (lp.magic != LOWPOWER_MAGIC || lp.checksum != lp_checksum())
+    {
+        printf("low power mode: fresh state\n");
+        lp_reset();
+        lp.next_wake_ms = powman_timer_get_ms();
+    }
+
+    uint64_t woke_ms = wake_time_ms();
+    if (lp.last_sleep_ms && woke_ms > lp.last_sleep_ms)
+        lp.sleep_ms += (uint32_t)(woke_ms - lp.last_sleep_ms);
+    lp.wakes++;
+
+    bool safe_mode = false;
+    wd_init_and_bootloop_guard(&safe_mode);
+    take_sample();
+
+    uint32_t radio_ms = 0;
+    if (lp.count >= runtime_config()->batch_n && !safe_mode && powman_timer_get_ms() >= lp.next_uplink_ms)
+    {
+        lp.batch_seq++;
+        if (uplink_batch(woke_ms, &radio_ms))
+        {
+            // 次のバッチ区間へ。遅延統計は累積のまま残す
+            lp.count = 0;
+            lp.active_ms = lp.radio_ms = lp.sleep_ms = lp.wakes = 0;
+            lp.next_uplink_ms = 0;
+            backoff_reset(&lp.uplink_retry);
+        }
+        else
+        {
+            // サンプルは貯め続け（溢れたら古いものから）、間を空けてから送り直す
+            uint32_t wait_ms = backoff_next_ms(&lp.uplink_retry);
+            lp.next_uplink_ms = powman_timer_get_ms() + wait_ms;
+            LOG_INFO(MQTT, "next uplink attempt in %lus\n", (unsigned long)(wait_ms / 1000));
+        }
+    }
+
+    // 周期は絶対時刻で積む。大きく遅れていたら次の周期に合わせる
+    uint64_t now = powman_timer_get_ms();
+    lp.active_ms += (uint32_t)(now - woke_ms) - radio_ms;
+    uint32_t period_ms = runtime_config()->period_ms;
+    lp.next_wake_ms += period_ms;
+    if (lp.next_wake_ms <= now)
+        lp.next_wake_ms = now + period_ms;
+    power_off_until(lp.next_wake_ms);
+    return 0;
+}
@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <string.h>
+#include "lwip/apps/mqtt.h"
+#include "lwip/apps/mqtt_priv.h"
+#include "mqtt_session.h"
+#include "applog.h"
+#include "placement.h"
+
+#define CONNECT_FLAG_CLEAN_SESSION 0x02
+
+typedef enum
+{
+    SLOT_FREE = 0,
+    SLOT_QUEUED,   // 未送信 or 再送待ち
+    SLOT_INFLIGHT, // lwIP に渡して ACK 待ち
+} SlotState;
+
+typedef struct
+{
+    SlotState state;
+    uint32_t seq;
+    bool sent; // 一度でも lwIP に渡したか（再送の計数用）
+    const char *topic;
+    uint16_t len;
+    char payload[MQTT_OUTBOX_PAYLOAD_MAX];
+} OutboxSlot;
+
+static mqtt_client_t *sess_client;
+static mqtt_request_cb_t sess_done_cb;
+static OutboxSlot outbox[MQTT_OUTBOX_LEN];
+static uint32_t next_seq = 1;
+static uint8_t pub_qos = MQTT_PUB_QOS;
+static MqttSessionStats stats;
+
+void mqtt_session_init(mqtt_client_t *client, mqtt_request_cb_t done_cb)
+{
+    sess_client = client;
+    sess_done_cb = done_cb;
+    memset(outbox, 0, sizeof(outbox));
+}
+
+#if MQTT_PERSISTENT_SESSION
+// lwIP の mqtt_client_connect は CONNECT の clean-session フラグを固定で立てる。
+// CONNECT は接続時にリングバッファへ組み立てられ、TCP 接続完了まで送られないので
+// その間に Connect Flags の bit1 を落とす。
+static void clear_clean_session_flag(void)
+{
+    static const uint8_t proto[] = {0x00, 0x04, 'M', 'Q', 'T', 'T'};
+    uint8_t *buf = sess_client->output.buf;
+    uint16_t n = sess_client->output.put;
+    for (uint16_t i = 0; i + sizeof(proto) + 1 < n; i++)
+    {
+        if (memcmp(&buf[i], proto, sizeof(proto)) == 0)
+        {
+            // proto name の次が protocol level、その次が connect flags
+            buf[i + sizeof(proto) + 1] &= (uint8_t)~CONNECT_FLAG_CLEAN_SESSION;
+            return;
+        }
+    }
+    LOG_WARN(MQTT, "mqtt_session: CONNECT frame not found, clean session stays on\n");
+}
+#endif
+
+err_t mqtt_session_connect(const ip_addr_t *broker, uint16_t port,
+                           mqtt_connection_cb_t cb, void *arg,
+                           const struct mqtt_connect_client_info_t *ci)
+{
+    err_t err = mqtt_client_connect(sess_client, broker, port, cb, arg, ci);
+#if MQTT_PERSISTENT_SESSION
+    if (err == ERR_OK)
+        clear_clean_session_flag();
+#endif
+    return err;
+}
+
+bool mqtt_session_on_connection(mqtt_connection_status_t status)
+{
+    if (status != MQTT_CONNECT_ACCEPTED)
+    {
+        // lwIP は切断時に pend_req_queue をコールバック無しで捨てるので
+        // ACK 待ちだったものは全部再送待ちに戻す
+        for (int i = 0; i < MQTT_OUTBOX_LEN; i++)
+        {
+            if (outbox[i].state == SLOT_INFLIGHT)
+                outbox[i].state = SLOT_QUEUED;
+        }
+        return false;
+    }
+
+    // CONNACK 受信中はまだ rx_buffer に [0x20, 0x02, ack flags, return code] が残っている。
+    // session-present は統計とログだけに使う（再送を減らす手がかりにはならない。mqtt_session.h）
+    bool session_present = (sess_client->rx_buffer[2] & 0x01) != 0;
+#if MQTT_PERSISTENT_SESSION
+    if (session_present)
+        stats.sessions_resumed++;
+#endif
+    // 切断中に溜まった分と、ACK 待ちから戻した分を次のサンプルを待たずに送り始める
+    mqtt_session_pump();
+    return session_present;
+}
+
+static OutboxSlot *HOT_FUNC(find_slot)(uint32_t seq)
+{
+    for (int i = 0; i < MQTT_OUTBOX_LEN; i++)
+    {
+        if (outbox[i].state != SLOT_FREE && outbox[i].seq == seq)
+            return &outbox[i];
+    }
+    return NULL;
+}
+
+static void HOT_FUNC(outbox_pub_cb)(void *arg, err_t result)
+{
+    OutboxSlot *slot = find_slot((uint32_t)(uintptr_t)arg);
+    if (slot && slot->state == SLOT_INFLIGHT)
+    {
+        if (result == ERR_OK)
+        {
+            slot->state = SLOT_FREE;
+            stats.acked++;
+        }
+        else
+        {
+            // PUBACK タイムアウト等。下の pump で送り直す
+            slot->state = SLOT_QUEUED;
+        }
+    }
+    if (sess_done_cb)
+        sess_done_cb(NULL, result);
+    // ACK で空いた枠・戻した分をすぐ埋める（デッドバンド中は次のサンプルが来るまで長く空くことがある）
+    mqtt_session_pump();
+}
+
+static OutboxSlot *HOT_FUNC(alloc_slot)(void)
+{
+    OutboxSlot *oldest = NULL;
+    for (int i = 0; i < MQTT_OUTBOX_LEN; i++)
+    {
+        if (outbox[i].state == SLOT_FREE)
+            return &outbox[i];
+        if (outbox[i].state == SLOT_QUEUED && (!oldest || outbox[i].seq < oldest->seq))
+            oldest = &outbox[i];
+    }
+    // 満杯なら一番古い送信待ちを捨てる（ACK 待ちは lwIP が参照中なので触らない）
+    if (oldest)
+    {
+        oldest->state = SLOT_FREE;
+        stats.dropped++;
+    }
+    return oldest;
+}
+
+void HOT_FUNC(mqtt_session_pump)(void)
+{
+    if (!sess_client || !mqtt_client_is_connected(sess_client))
+        return;
+
+    int inflight = 0;
+    for (int i = 0; i < MQTT_OUTBOX_LEN; i++)
+    {
+        if (outbox[i].state == SLOT_INFLIGHT)
+            inflight++;
+    }
+
+    // seq の若い順に送って、届く順序を保つ
+    while (inflight < MQTT_OUTBOX_INFLIGHT_MAX)
+    {
+        OutboxSlot *next = NULL;
+        for (int i = 0; i < MQTT_OUTBOX_LEN; i++)
+        {
+            if (outbox[i].state == SLOT_QUEUED && (!next || outbox[i].seq < next->seq))
+                next = &outbox[i];
+        }
+        if (!next)
+            return;
+
+        err_t err = mqtt_publish(sess_client, next->topic, next->payload, next->len,
+                                 pub_qos, 0, outbox_pub_cb, (void *)(uintptr_t)next->seq);
+        if (err != ERR_OK)
+            return; // ERR_MEM 等。次の pump で再挑戦
+        if (next->sent)
+            stats.resent++;
+        next->sent = true;
+        next->state = SLOT_INFLIGHT;
+        inflight++;
+    }
+}
+
+err_t HOT_FUNC(mqtt_session_publish)(const char *topic, const char *payload, uint16_t len)
+{
+    // 再送で重複したときに受け手が見分けられるよう、通し番号を付ける（mqtt_session.h）
+    char tag[16] = "";
+    int tag_len = 0;
+#if MQTT_PERSISTENT_SESSION
+    tag_len = snprintf(tag, sizeof(tag), MQTT_SESSION_SEQ_FMT, (unsigned long)next_seq);
+#endif
+    if (tag_len < 0 || len + (size_t)tag_len > MQTT_OUTBOX_PAYLOAD_MAX)
+        return ERR_VAL;
+
+    OutboxSlot *slot = alloc_slot();
+    if (!slot)
+        return ERR_MEM; // 全部 ACK 待ち
+    slot->state = SLOT_QUEUED;
+    slot->seq = next_seq++;
+    slot->sent = false;
+    slot->topic = topic;
+    slot->len = (uint16_t)(len + tag_len);
+    memcpy(slot->payload, payload, len);
+    memcpy(slot->payload + len, tag, (size_t)tag_len);
+    stats.queued++;
+
+    mqtt_session_pump();
+    return ERR_OK;
+}
+
+void mqtt_session_set_qos(uint8_t qos)
+{
+    pub_qos = qos ? 1 : 0;
+}
+
+const MqttSessionStats *mqtt_session_stats(void)
+{
+    return &stats;
+}
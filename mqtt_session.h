@@ -0,0 +1,54 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "lwip/apps/mqtt.h"
+
+// 永続セッションモード
+//   1: clean-session を落として接続し、QoS1 の未 ACK メッセージを TCP 切断後も保持して再送する
+//   0: 従来通り clean-session / QoS0 の投げっぱなし
+//
+// 配送は at-least-once で、重複がありうる。切断時に ACK 待ちだったものは、ブローカーに届いていても
+// PUBACK が失われただけかもしれない。session-present でもどれが届いたかは分からないし、lwIP は同じ
+// packet id（DUP）での再送ができないので、再接続後に新しい packet id で全部送り直す。
+// そのため永続セッションでは各ペイロードの末尾に outbox の通し番号（MQTT_SESSION_SEQ_FMT）を付ける。
+// 受け手は「機器ごと・起動ごと」にこれで重複を落とせる（起動ごとに 1 から。collector/ingest.cpp 参照）
+#ifndef MQTT_PERSISTENT_SESSION
+#define MQTT_PERSISTENT_SESSION 1
+#endif
+
+#if MQTT_PERSISTENT_SESSION
+#define MQTT_PUB_QOS 1
+#else
+#define MQTT_PUB_QOS 0
+#endif
+
+#define MQTT_OUTBOX_LEN 16         // 未 ACK メッセージを保持する数
+#define MQTT_OUTBOX_PAYLOAD_MAX 64 // 1 メッセージの最大長
+#define MQTT_OUTBOX_INFLIGHT_MAX 4 // lwIP の MQTT_REQ_MAX_IN_FLIGHT 以下にする
+#define MQTT_SESSION_SEQ_FMT " seq=%lu" // 永続セッションでペイロードの末尾に付ける通し番号
+
+typedef struct
+{
+    uint32_t queued;   // 送信待ちに積んだ数
+    uint32_t acked;    // PUBACK（QoS0 は TCP 送信完了）まで届いた数
+    uint32_t resent;   // 切断・タイムアウトで再送した数
+    uint32_t dropped;  // outbox が溢れて捨てた数
+    uint32_t sessions_resumed; // CONNACK session-present=1 で再接続できた回数
+} MqttSessionStats;
+
+// done_cb は publish 結果ごとに呼ばれる（lwIP コールバックのコンテキスト）
+void mqtt_session_init(mqtt_client_t *client, mqtt_request_cb_t done_cb);
+// mqtt_client_connect の代わり。呼び出し側で cyw43_arch_lwip_begin/end すること
+err_t mqtt_session_connect(const ip_addr_t *broker, uint16_t port,
+                           mqtt_connection_cb_t cb, void *arg,
+                           const struct mqtt_connect_client_info_t *ci);
+// 接続コールバックの先頭で呼ぶ。戻り値は CONNACK の session-present
+bool mqtt_session_on_connection(mqtt_connection_status_t status);
+// outbox に積んで送れる分だけ送る。永続セッションでは末尾に通し番号を足すので、len はその分短くする。
+// 呼び出し側で cyw43_arch_lwip_begin/end すること
+err_t mqtt_session_publish(const char *topic, const char *payload, uint16_t len);
+// 送信待ちを吐き出す（publish・CONNACK・PUBACK/タイムアウトのたびに中で呼ぶ）。lwIP ロック内で呼ぶこと
+void mqtt_session_pump(void);
+// 計測値の publish QoS（0/1）を実行時に変える。既定は MQTT_PUB_QOS。次に lwIP へ渡す分から効く
+void mqtt_session_set_qos(uint8_t qos);
+const MqttSessionStats *mqtt_session_stats(void);
@@ -0,0 +1,439 @@
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/cyw43_arch.h"
+#include "lwip/apps/mqtt.h"
+#include "lwip/netif.h"
+#include "lwip/ip4_addr.h"
+#include "wifi_config.h"
+#include "wifi_pm.h"
+#include "mqtt_session.h"
+#include "conn_stats.h"
+#include "mem_stats.h"
+#include "runtime_config.h"
+#include "command.h"
+#include "net.h"
+#include "applog.h"
+#include "supervisor.h"
+#include "wd.h"
+#include "backoff.h"
+#include "placement.h"
+
+static mqtt_client_t *client;
+static ip_addr_t broker_addr;
+static struct mqtt_connect_client_info_t ci;
+static void (*status_listener)(mqtt_connection_status_t status);
+static Backoff retry;
+volatile bool mqtt_connected = false;
+
+typedef struct
+{
+    const char *topic;
+    net_message_cb_t cb;
+} NetSubscription;
+
+static NetSubscription subs[NET_SUB_MAX];
+static int sub_count = 0;
+static int rx_sub = -1; // 受信中のメッセージの宛先（-1 = 捨てる）
+static uint16_t rx_len;
+static uint8_t rx_buf[NET_RX_PAYLOAD_MAX];
+
+bool link_is_up(void)
+{
+    int st = cyw43_tcpip_link_status(&cyw43_state, CYW43_ITF_STA);
+    return st == CYW43_LINK_UP;
+}
+
+bool wifi_connect(void)
+{
+    int r = cyw43_arch_wifi_connect_timeout_ms(
+        WIFI_SSID, WIFI_PASS, CYW43_AUTH_WPA2_AES_PSK, NET_JOIN_TIMEOUT_MS);
+
+    return r == 0;
+}
+
+void print_ip(void)
+{
+    struct netif *n = &cyw43_state.netif[0];
+    const ip4_addr_t *ip = netif_ip4_addr(n);
+    const ip4_addr_t *gw = netif_ip4_gw(n);
+    const ip4_addr_t *msk = netif_ip4_netmask(n);
+
+    // IPアドレスを文字列形式に変換して表示
+    char ip_str[16];
+    char gw_str[16];
+    char mask_str[16];
+
+    // IPアドレスを文字列に変換
+    ip4addr_ntoa_r(ip, ip_str, sizeof(ip_str));
+    ip4addr_ntoa_r(gw, gw_str, sizeof(gw_str));
+    ip4addr_ntoa_r(msk, mask_str, sizeof(mask_str));
+    printf("Pico STA IP=%s GW=%s MASK=%s\n",
+           ip_str, gw_str, mask_str);
+}
+
+static void HOT_FUNC(mqtt_pub_request_cb)(void *arg, err_t result)
+{
+    wifi_pm_publish_done();
+    if (result == ERR_OK)
+    {
+        conn_stats_publish_acked();
+        sv_checkin(SV_PUBLISHER);
+    }
+    LOG_DEBUG(MQTT, "MQTT publish result: %d\n", result);
+}
+
+static void sub_request_cb(void *arg, err_t result)
+{
+    if (result != ERR_OK)
+        LOG_WARN(MQTT, "subscribe %s failed: %d\n", ((const NetSubscription *)arg)->topic, result);
+}
+
+static void incoming_publish_cb(void *arg, const char *topic, u32_t tot_len)
+{
+    rx_sub = -1;
+    rx_len = 0;
+    for (int i = 0; i < sub_count; i++)
+    {
+        if (strcmp(topic, subs[i].topic) == 0)
+        {
+            if (tot_len <= NET_RX_PAYLOAD_MAX)
+                rx_sub = i;
+            else
+                LOG_WARN(MQTT, "incoming message too long (%lu bytes)\n", (unsigned long)tot_len);
+            return;
+        }
+    }
+}
+
+static void incoming_data_cb(void *arg, const u8_t *data, u16_t len, u8_t flags)
+{
+    if (rx_sub < 0)
+        return;
+    if (rx_len + len > NET_RX_PAYLOAD_MAX)
+    {
+        rx_sub = -1;
+        return;
+    }
+    memcpy(rx_buf + rx_len, data, len);
+    rx_len += len;
+    if (flags & MQTT_DATA_FLAG_LAST)
+    {
+        subs[rx_sub].cb(rx_buf, rx_len);
+        rx_sub = -1;
+    }
+}
+
+// 接続コールバック（lwIP のロック内）から呼ぶ
+static void subscribe_all(mqtt_client_t *c)
+{
+    for (int i = 0; i < sub_count; i++)
+    {
+        // QoS1 で購読して、切断中に来た要求も永続セッションでブローカーに残してもらう
+        err_t err = mqtt_subscribe(c, subs[i].topic, 1, sub_request_cb, &subs[i]);
+        if (err != ERR_OK)
+            LOG_WARN(MQTT, "subscribe %s err=%d\n", subs[i].topic, err);
+    }
+}
+
+bool net_subscribe(const char *topic, net_message_cb_t cb)
+{
+    if (sub_count >= NET_SUB_MAX)
+        return false;
+    cyw43_arch_lwip_begin();
+    subs[sub_count].topic = topic;
+    subs[sub_count].cb = cb;
+    sub_count++;
+    if (mqtt_connected)
+        mqtt_subscribe(client, topic, 1, sub_request_cb, &subs[sub_count - 1]);
+    cyw43_arch_lwip_end();
+    return true;
+}
+
+static void mqtt_connection_cb(mqtt_client_t *client, void *arg, mqtt_connection_status_t status)
+{
+    bool session_present = mqtt_session_on_connection(status);
+    (void)session_present; // ログが無効なビルド用
+    conn_stats_connack(status == MQTT_CONNECT_ACCEPTED);
+    LOG_INFO(MQTT, "MQTT connection status: %d (session present=%d)\n", status, session_present);
+    if (status == MQTT_CONNECT_ACCEPTED)
+    {
+        mqtt_connected = true;
+        subscribe_all(client);
+    }
+    else
+        mqtt_connected = false; // エラーを検知
+    if (status_listener)
+        status_listener(status);
+}
+
+static struct mqtt_connect_client_info_t create_mqtt_client(void)
+{
+    struct mqtt_connect_client_info_t ci = {0};
+    // 永続セッションはブローカー側で client_id に紐づくので、機器ごとに一意で再起動しても変わらない値にする
+    ci.client_id = device_client_id();
+    ci.will_msg = "offline";
+    ci.keep_alive = 30;
+    ci.will_qos = 1;
+    ci.will_retain = 1;
+    ci.client_user = NULL;
+    ci.client_pass = NULL;
+
+    return ci;
+}
+
+bool net_mqtt_init(void)
+{
+    client = mqtt_client_new();
+    if (!client)
+    {
+        printf("mqtt client new failed\n");
+        return false;
+    }
+    device_id_init();
+    // 同じ版の機器が同時に切れても張り直しが揃わないよう、待ち時間の乱数は board ID から
+    uint32_t seed = 0x811c9dc5;
+    for (const char *p = device_board_id(); *p; p++)
+        seed = (seed ^ (uint8_t)*p) * 0x01000193;
+    backoff_init(&retry, NET_STEP_RETRY_MS, NET_RETRY_MAX_MS, seed);
+    mqtt_session_init(client, mqtt_pub_request_cb);
+    mqtt_set_inpub_callback(client, incoming_publish_cb, incoming_data_cb, NULL);
+    ipaddr_aton(MQTT_BROKER_IP, &broker_addr);
+    ci = create_mqtt_client();
+    net_subscribe(device_topic(DEVICE_TOPIC_CONFIG_SET), runtime_config_handle);
+    return true;
+}
+
+void net_set_status_listener(void (*listener)(mqtt_connection_status_t status))
+{
+    status_listener = listener;
+}
+
+bool net_mqtt_connect(void)
+{
+    cyw43_arch_lwip_begin();
+    err_t err = mqtt_session_connect(&broker_addr, MQTT_BROKER_PORT, mqtt_connection_cb, NULL, &ci);
+    cyw43_arch_lwip_end();
+    if (err != ERR_OK)
+    {
+        LOG_WARN(MQTT, "mqtt_client_connect err=%d\n", err);
+        return false;
+    }
+    conn_stats_mqtt_connect_sent(client);
+    return true;
+}
+
+bool wifi_mqtt_conn_init(void)
+{
+    conn_stats_attempt_begin();
+    bool ok = wifi_connect(); // 既存の関数
+    if (!ok)
+    {
+        LOG_WARN(WIFI, "Wi-Fi connect failed at boot\n");
+        return false;
+    }
+    if (!net_mqtt_connect())
+        return false;
+
+    cyw43_arch_gpio_put(CYW43_WL_GPIO_LED_PIN, 1);
+    return true;
+}
+
+// 非ブロッキング版の接続管理の状態
+typedef enum
+{
+    NET_IDLE = 0,        // 未接続（次の step で接続を始める）
+    NET_WIFI_JOINING,    // cyw43_arch_wifi_connect_async の完了待ち
+    NET_MQTT_CONNECTING, // CONNACK 待ち
+    NET_UP,
+} NetState;
+
+static NetState net_state = NET_IDLE;
+static absolute_time_t net_deadline;
+
+uint32_t net_retry_delay_ms(void)
+{
+    uint32_t ms = backoff_next_ms(&retry);
+    LOG_DEBUG(WIFI, "retry in %lums (failure %lu)\n", (unsigned long)ms, (unsigned long)retry.failures);
+    return ms;
+}
+
+void net_retry_reset(void)
+{
+    backoff_reset(&retry);
+}
+
+uint32_t net_conn_step(void)
+{
+    switch (net_state)
+    {
+    case NET_UP:
+        if (link_is_up() && mqtt_connected)
+            return NET_STEP_IDLE_MS;
+        LOG_WARN(WIFI, "connection lost (link=%d mqtt=%d)\n", link_is_up(), mqtt_connected);
+        net_state = NET_IDLE;
+        // fallthrough
+    case NET_IDLE:
+        conn_stats_attempt_begin();
+        if (!link_is_up())
+        {
+            if (cyw43_arch_wifi_connect_async(WIFI_SSID, WIFI_PASS, CYW43_AUTH_WPA2_AES_PSK) != 0)
+                return net_retry_delay_ms();
+            net_state = NET_WIFI_JOINING;
+            net_deadline = make_timeout_time_ms(NET_JOIN_TIMEOUT_MS);
+            return NET_STEP_BUSY_MS;
+        }
+        // fallthrough（リンクは生きていて MQTT だけ落ちている）
+    case NET_WIFI_JOINING:
+    {
+        int st = cyw43_tcpip_link_status(&cyw43_state, CYW43_ITF_STA);
+        if (st != CYW43_LINK_UP)
+        {
+            if (st < 0 || time_reached(net_deadline))
+            {
+                LOG_WARN(WIFI, "Wi-Fi connect failed (status=%d)\n", st);
+                net_state = NET_IDLE;
+                return net_retry_delay_ms();
+            }
+            return NET_STEP_BUSY_MS;
+        }
+        if (!net_mqtt_connect())
+        {
+            net_state = NET_IDLE;
+            return net_retry_delay_ms();
+        }
+        net_state = NET_MQTT_CONNECTING;
+        net_deadline = make_timeout_time_ms(NET_CONNACK_TIMEOUT_MS);
+        return NET_STEP_BUSY_MS;
+    }
+    case NET_MQTT_CONNECTING:
+        if (mqtt_connected)
+        {
+            cyw43_arch_gpio_put(CYW43_WL_GPIO_LED_PIN, 1);
+            net_state = NET_UP;
+            net_retry_reset();
+            return NET_STEP_IDLE_MS;
+        }
+        if (time_reached(net_deadline))
+        {
+            // lwIP 側の接続待ちを打ち切ってから張り直す
+            LOG_WARN(MQTT, "CONNACK timeout\n");
+            cyw43_arch_lwip_begin();
+            mqtt_disconnect(client);
+            cyw43_arch_lwip_end();
+            net_state = NET_IDLE;
+            return net_retry_delay_ms();
+        }
+        return NET_STEP_BUSY_MS;
+    }
+    return NET_STEP_RETRY_MS;
+}
+
+err_t HOT_FUNC(net_publish_sample)(const char *payload)
+{
+    cyw43_arch_lwip_begin();
+    wifi_pm_publish_begin();
+    // 切断中でも outbox に積んでおき、再接続後に順番通り送る
+    err_t pe = mqtt_session_publish(device_topic(DEVICE_TOPIC_SAMPLE), payload, strlen(payload));
+    cyw43_arch_lwip_end();
+    return pe;
+}
+
+err_t net_publish_direct(const char *topic, const void *payload, uint16_t len, uint8_t qos,
+                         mqtt_request_cb_t cb, void *arg)
+{
+    cyw43_arch_lwip_begin();
+    err_t err = mqtt_publish(client, topic, payload, len, qos, 0, cb, arg);
+    cyw43_arch_lwip_end();
+    return err;
+}
+
+// 接続フェーズのヒストグラムを診断トピックへ（取りこぼしても良いので QoS0 直送）
+void publish_conn_stats(void)
+{
+    static char diag[1024];
+    cyw43_arch_lwip_begin();
+    size_t n = conn_stats_format(diag, sizeof(diag));
+    cyw43_arch_lwip_end();
+    err_t err = n ? net_publish_direct(device_topic(DEVICE_TOPIC_DIAG_CONN), diag, (uint16_t)n, 0, NULL, NULL) : ERR_VAL;
+    if (err != ERR_OK)
+    {
+        LOG_WARN(MQTT, "conn stats publish err=%d\n", err);
+        return;
+    }
+    cyw43_arch_lwip_begin();
+    conn_stats_published();
+    cyw43_arch_lwip_end();
+}
+
+void publish_mem_stats(void)
+{
+    static char diag[1024];
+    cyw43_arch_lwip_begin();
+    size_t n = mem_stats_format(diag, sizeof(diag));
+    cyw43_arch_lwip_end();
+    err_t err = n ? net_publish_direct(device_topic(DEVICE_TOPIC_DIAG_LWIP), diag, (uint16_t)n, 0, NULL, NULL) : ERR_VAL;
+    if (err != ERR_OK)
+    {
+        LOG_WARN(MQTT, "lwip stats publish err=%d\n", err);
+        return;
+    }
+    mem_stats_published();
+}
+
+// 受け付けた/弾いた結果と有効な設定。後から購読した管理側にも見えるよう retained
+bool publish_runtime_config(void)
+{
+    char cfg[256];
+    size_t n = runtime_config_format(cfg, sizeof(cfg));
+    cyw43_arch_lwip_begin();
+    err_t err = n ? mqtt_publish(client, device_topic(DEVICE_TOPIC_CONFIG), cfg, (uint16_t)n, 1, 1, NULL, NULL)
+                  : ERR_VAL;
+    cyw43_arch_lwip_end();
+    if (err != ERR_OK)
+    {
+        LOG_WARN(MQTT, "config publish err=%d\n", err);
+        return false;
+    }
+    runtime_config_published();
+    return true;
+}
+
+// 要求側が待っているので outbox を通さず直送する。QoS1 でも送出は待たない（PUBACK を待つのは lwIP）
+void publish_command_replies(const AHT22Result *r, absolute_time_t triggered, absolute_time_t converted)
+{
+    char reply[COMMAND_REPLY_MAX];
+    size_t n;
+    while ((n = command_next_reply(r, triggered, converted, reply, sizeof(reply))) > 0)
+    {
+        err_t err = net_publish_direct(device_topic(DEVICE_TOPIC_CMD_RESP), reply, (uint16_t)n, 1, NULL, NULL);
+        if (err != ERR_OK)
+            LOG_WARN(MQTT, "cmd reply publish err=%d\n", err);
+    }
+}
+
+// フリート側でレイテンシの跳ねやデータ欠損とリセットを突き合わせるため QoS1 で送る
+bool publish_reboot_record(void)
+{
+    char rec[160];
+    size_t n = wd_format_reboot_record(rec, sizeof(rec));
+    err_t err = n ? net_publish_direct(device_topic(DEVICE_TOPIC_DIAG_BOOT), rec, (uint16_t)n, 1, NULL, NULL) : ERR_VAL;
+    if (err != ERR_OK)
+        LOG_WARN(MQTT, "reboot record publish err=%d\n", err);
+    return err == ERR_OK;
+}
+
+void net_note_state(void)
+{
+    wd_note_net_state((link_is_up() ? WD_NET_LINK : 0) | (mqtt_connected ? WD_NET_MQTT : 0));
+}
+
+void net_report(void)
+{
+    wifi_pm_report();
+    const MqttSessionStats *ss = mqtt_session_stats();
+    LOG_INFO(MQTT, "mqtt_session: queued=%lu acked=%lu resent=%lu dropped=%lu resumed=%lu\n",
+           (unsigned long)ss->queued, (unsigned long)ss->acked, (unsigned long)ss->resent,
+           (unsigned long)ss->dropped, (unsigned long)ss->sessions_resumed);
+    (void)ss; // ログが無効なビルド用
+}
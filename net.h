@@ -0,0 +1,65 @@
+#pragma once
+#include <stdbool.h>
+#include "pico/stdlib.h"
+#include "lwip/apps/mqtt.h"
+
+#include "aht20.h"
+#include "device_id.h"
+
+#define MQTT_BROKER_PORT 1883
+// クライアント ID とトピックは機器ごと（device_id.h のテンプレートから net_mqtt_init で作る）
+
+extern volatile bool mqtt_connected;
+
+bool link_is_up(void);
+bool wifi_connect(void);
+void print_ip(void);
+
+// 機器 ID・トピックの組み立て、MQTT クライアント生成とブローカー設定。cyw43_arch_init の後に 1 回だけ呼ぶ
+bool net_mqtt_init(void);
+// ブローカーへ接続要求を出す（完了は mqtt_connected で分かる）
+bool net_mqtt_connect(void);
+// Wi-Fi から張り直して MQTT 接続要求を出す
+bool wifi_mqtt_conn_init(void);
+// 非ブロッキング版の接続管理。呼ぶたびに状態を 1 歩進め、次に呼ぶまでの間隔[ms]を返す
+// （Wi-Fi 接続も CONNACK 待ちもブロックしないので async_context のワーカーから呼べる）
+#define NET_STEP_IDLE_MS 1000      // 接続中の見回り間隔
+#define NET_STEP_BUSY_MS 20        // 接続処理中のポーリング間隔
+#define NET_STEP_RETRY_MS 1000     // 失敗後に張り直すまで（初回。続けて失敗すると倍々で延ばす）
+#define NET_RETRY_MAX_MS 30000     // 張り直し間隔の上限
+#define NET_JOIN_TIMEOUT_MS 30000  // Wi-Fi 接続（アソシエーション + DHCP）の上限
+#define NET_CONNACK_TIMEOUT_MS 10000
+uint32_t net_conn_step(void);
+// 接続に失敗したときの待ち時間[ms]（backoff.h。NET_STEP_RETRY_MS から NET_RETRY_MAX_MS まで、ばらつき付き）
+uint32_t net_retry_delay_ms(void);
+// つながったら呼ぶ（net_conn_step は自分で呼ぶ）
+void net_retry_reset(void);
+// 接続状態が変わるたびに呼ばれる（lwIP コールバックのコンテキスト）
+void net_set_status_listener(void (*listener)(mqtt_connection_status_t status));
+
+// 購読。トピックが完全一致したメッセージを 1 つにまとめて cb に渡す（lwIP コールバックのコンテキスト）
+// 接続（CONNACK）のたびに全部購読し直す。topic は静的な文字列であること
+#define NET_SUB_MAX 4
+#define NET_RX_PAYLOAD_MAX 256 // これより大きいメッセージは捨てる
+typedef void (*net_message_cb_t)(const uint8_t *payload, size_t len);
+bool net_subscribe(const char *topic, net_message_cb_t cb);
+
+// 計測値を outbox 経由で送る
+err_t net_publish_sample(const char *payload);
+// outbox を通さずに直接 publish する（診断やバッチなど 64 バイトを超えるもの）
+err_t net_publish_direct(const char *topic, const void *payload, uint16_t len, uint8_t qos,
+                         mqtt_request_cb_t cb, void *arg);
+// 接続フェーズのヒストグラムを診断トピックへ
+void publish_conn_stats(void);
+// lwIP のヒープ/プール使用状況を診断トピックへ（MQCENSOR_LWIP_STATS ビルドのみ中身がある）
+void publish_mem_stats(void);
+// 有効な設定を config トピックへ retained で（runtime_config.h）。送れたら true
+bool publish_runtime_config(void);
+// 答えられる cmd の返信をすべて cmd/resp へ（command.h）。r が NULL ならエラーの返信だけ
+void publish_command_replies(const AHT22Result *r, absolute_time_t triggered, absolute_time_t converted);
+// 前回リセットの記録を診断トピックへ（起動後の初回接続で 1 回）。送れたら true
+bool publish_reboot_record(void);
+// 現在のリンク/MQTT 状態をリセット記録に残す
+void net_note_state(void);
+// 省電力・セッションの統計を表示
+void net_report(void);
@@ -0,0 +1,9 @@
+#pragma once
+// コード配置。MQCENSOR_CODE_PLACEMENT=hot_ram のビルドでは、サンプリング → デコード → 整形 → outbox → publish の
+// 経路の関数だけを SRAM に置き、XIP キャッシュミスの待ちを避ける（copy_to_ram は全体を RAM で実行する）
+#if MQCENSOR_HOT_IN_RAM
+#include "pico/platform.h"
+#define HOT_FUNC(func) __not_in_flash_func(func)
+#else
+#define HOT_FUNC(func) func
+#endif
@@ -0,0 +1,298 @@
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/cyw43_arch.h"
+#include "pico/flash.h"
+#include "hardware/flash.h"
+#include "runtime_config.h"
+#include "mqtt_session.h"
+#include "applog.h"
+#include "flat_json.h"
+#include "deadband.h"
+
+// フラッシュ末尾の 2 セクタを 1 ページ 1 レコードのリングとして追記していく。一番 seq の大きい正しいレコードが有効。
+// 消すのは次に書くセクタだけで、最新のレコードはもう一方のセクタに残っている（消去中に電源が落ちても失わない）
+#define CONFIG_SECTORS 2
+#define CONFIG_FLASH_OFFSET (PICO_FLASH_SIZE_BYTES - CONFIG_SECTORS * FLASH_SECTOR_SIZE)
+#define CONFIG_SLOTS_PER_SECTOR ((int)(FLASH_SECTOR_SIZE / FLASH_PAGE_SIZE))
+#define CONFIG_SLOTS (CONFIG_SECTORS * CONFIG_SLOTS_PER_SECTOR)
+#define CONFIG_MAGIC 0x3147434d // "MCG1"
+#define CONFIG_ERASED 0xFFFFFFFFu
+#define FLASH_SAFE_TIMEOUT_MS 100
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t seq;
+    RuntimeConfig cfg;
+    uint32_t checksum;
+} ConfigRecord;
+
+_Static_assert(sizeof(ConfigRecord) <= FLASH_PAGE_SIZE, "ConfigRecord must fit in a flash page");
+
+static const RuntimeConfig DEFAULTS = {
+    .period_ms = PUBLISH_PERIOD_MS,
+    .batch_n = LOWPOWER_BATCH_N,
+    .deadband_deci = 0,
+    .qos = MQTT_PUB_QOS,
+    .log_level = APPLOG_LEVEL,
+};
+
+static const char *const LEVEL_NAMES[] = {"none", "error", "warn", "info", "debug"};
+
+static RuntimeConfig active;
+static RuntimeConfig staged;
+static volatile bool staged_due = false;
+static volatile bool publish_due = true;
+static const char *last_result = "boot"; // 直近の受信の結果（リテラルだけを入れる）
+static uint32_t rev = 0;                 // 保存したレコードの seq
+static int next_slot = 0;
+
+static Deadband deadband;
+
+static uint32_t record_checksum(const ConfigRecord *rec)
+{
+    const uint8_t *p = (const uint8_t *)rec;
+    uint32_t sum = 0x811c9dc5;
+    for (size_t i = 0; i < offsetof(ConfigRecord, checksum); i++)
+        sum = (sum ^ p[i]) * 0x01000193;
+    return sum;
+}
+
+static const ConfigRecord *slot_ptr(int slot)
+{
+    return (const ConfigRecord *)(XIP_BASE + CONFIG_FLASH_OFFSET + (uint32_t)slot * FLASH_PAGE_SIZE);
+}
+
+static bool slot_erased(int slot)
+{
+    const uint32_t *w = (const uint32_t *)slot_ptr(slot);
+    for (size_t i = 0; i < FLASH_PAGE_SIZE / sizeof(uint32_t); i++)
+    {
+        if (w[i] != CONFIG_ERASED)
+            return false;
+    }
+    return true;
+}
+
+static bool valid(const RuntimeConfig *c)
+{
+    return c->period_ms >= RUNTIME_CONFIG_PERIOD_MIN_MS && c->period_ms <= RUNTIME_CONFIG_PERIOD_MAX_MS &&
+           c->batch_n >= 1 && c->batch_n <= RUNTIME_CONFIG_BATCH_MAX &&
+           c->deadband_deci <= RUNTIME_CONFIG_DEADBAND_MAX && c->qos <= 1 && c->log_level <= APPLOG_LEVEL_DEBUG;
+}
+
+static void apply(const RuntimeConfig *c)
+{
+    active = *c;
+    applog_set_level(c->log_level);
+    mqtt_session_set_qos(c->qos);
+}
+
+void runtime_config_init(void)
+{
+    // リングは回っているので途中の空きでは止めず、全スロットから最新を探す。次はその直後に書く
+    const ConfigRecord *best = NULL;
+    next_slot = 0;
+    for (int i = 0; i < CONFIG_SLOTS; i++)
+    {
+        const ConfigRecord *rec = slot_ptr(i);
+        if (rec->magic == CONFIG_MAGIC && rec->checksum == record_checksum(rec) && valid(&rec->cfg) &&
+            (!best || rec->seq > best->seq))
+        {
+            best = rec;
+            next_slot = (i + 1) % CONFIG_SLOTS;
+        }
+    }
+    if (best)
+    {
+        rev = best->seq;
+        apply(&best->cfg);
+        LOG_INFO(APP, "config: loaded rev %lu from flash (period=%lums)\n", (unsigned long)rev,
+                 (unsigned long)active.period_ms);
+    }
+    else
+    {
+        apply(&DEFAULTS);
+    }
+}
+
+const RuntimeConfig *runtime_config(void)
+{
+    return &active;
+}
+
+// ---- config/set の解析 ----
+static int level_from_name(const char *s, size_t n)
+{
+    for (int i = 0; i < (int)(sizeof(LEVEL_NAMES) / sizeof(LEVEL_NAMES[0])); i++)
+    {
+        if (flat_json_eq(s, n, LEVEL_NAMES[i]))
+            return i;
+    }
+    return -1;
+}
+
+// 成功なら NULL、失敗なら理由（リテラル）
+static const char *parse(const uint8_t *payload, size_t len, RuntimeConfig *c)
+{
+    FlatJson j;
+    FlatJsonField f;
+    int r;
+    flat_json_init(&j, payload, len);
+    while ((r = flat_json_next(&j, &f)) > 0)
+    {
+        int32_t v = f.num;
+        const char *s = f.str;
+        if (flat_json_eq(f.key, f.key_len, "period_ms"))
+        {
+            if (s || v < RUNTIME_CONFIG_PERIOD_MIN_MS || v > RUNTIME_CONFIG_PERIOD_MAX_MS)
+                return "period_ms out of range";
+            c->period_ms = (uint32_t)v;
+        }
+        else if (flat_json_eq(f.key, f.key_len, "batch_n"))
+        {
+            if (s || v < 1 || v > RUNTIME_CONFIG_BATCH_MAX)
+                return "batch_n out of range";
+            c->batch_n = (uint16_t)v;
+        }
+        else if (flat_json_eq(f.key, f.key_len, "deadband_deci"))
+        {
+            if (s || v < 0 || v > RUNTIME_CONFIG_DEADBAND_MAX)
+                return "deadband_deci out of range";
+            c->deadband_deci = (uint16_t)v;
+        }
+        else if (flat_json_eq(f.key, f.key_len, "qos"))
+        {
+            if (s || v < 0 || v > 1)
+                return "qos must be 0 or 1";
+            c->qos = (uint8_t)v;
+        }
+        else if (flat_json_eq(f.key, f.key_len, "log_level"))
+        {
+            int lvl = s ? level_from_name(s, f.str_len) : v;
+            if (lvl < 0 || lvl > APPLOG_LEVEL_DEBUG)
+                return "unknown log_level";
+            if (lvl > APPLOG_LEVEL)
+                return "log_level above the build level";
+            c->log_level = (uint8_t)lvl;
+        }
+        else
+        {
+            return "unknown key";
+        }
+    }
+    return r < 0 ? j.error : NULL;
+}
+
+void runtime_config_handle(const uint8_t *payload, size_t len)
+{
+    // まだ反映していない変更があれば、その上に重ねる
+    RuntimeConfig c = staged_due ? staged : active;
+    const char *err = parse(payload, len, &c);
+    if (err)
+    {
+        last_result = err;
+        LOG_WARN(APP, "config: rejected (%s)\n", err);
+    }
+    else
+    {
+        staged = c;
+        staged_due = true;
+        last_result = "applied";
+    }
+    publish_due = true;
+}
+
+bool runtime_config_commit_due(void)
+{
+    return staged_due;
+}
+
+static void flash_write_slot(void *param)
+{
+    const uint8_t *page = param;
+    if (next_slot % CONFIG_SLOTS_PER_SECTOR == 0)
+        flash_range_erase(CONFIG_FLASH_OFFSET + (uint32_t)(next_slot / CONFIG_SLOTS_PER_SECTOR) * FLASH_SECTOR_SIZE,
+                          FLASH_SECTOR_SIZE);
+    flash_range_program(CONFIG_FLASH_OFFSET + (uint32_t)next_slot * FLASH_PAGE_SIZE, page, FLASH_PAGE_SIZE);
+}
+
+static bool save(const RuntimeConfig *c)
+{
+    static uint8_t page[FLASH_PAGE_SIZE];
+    ConfigRecord rec;
+    memset(&rec, 0, sizeof(rec)); // パディングも checksum に入るので埋めておく
+    rec.magic = CONFIG_MAGIC;
+    rec.seq = rev + 1;
+    rec.cfg = *c;
+    rec.checksum = record_checksum(&rec);
+    memset(page, 0xFF, sizeof(page));
+    memcpy(page, &rec, sizeof(rec));
+
+    if (next_slot >= CONFIG_SLOTS)
+        next_slot = 0;
+    // 書きかけで切れたページ（消去済みでない）は飛ばす。セクタの頭まで来たらそこは消してから書く
+    while (next_slot % CONFIG_SLOTS_PER_SECTOR != 0 && !slot_erased(next_slot))
+        next_slot = (next_slot + 1) % CONFIG_SLOTS;
+    // もう一方のコアと割り込みを止めてから書く（XIP が止まるので）
+    int r = flash_safe_execute(flash_write_slot, page, FLASH_SAFE_TIMEOUT_MS);
+    if (r != PICO_OK)
+    {
+        LOG_ERROR(APP, "config: flash write failed (%d)\n", r);
+        return false;
+    }
+    next_slot++;
+    rev = rec.seq;
+    return true;
+}
+
+bool runtime_config_commit(void)
+{
+    cyw43_arch_lwip_begin();
+    RuntimeConfig c = staged;
+    staged_due = false;
+    cyw43_arch_lwip_end();
+
+    if (memcmp(&c, &active, sizeof(c)) == 0)
+        return false;
+    apply(&c);
+    if (!save(&c))
+        last_result = "applied, not saved";
+    publish_due = true;
+    LOG_INFO(APP, "config: rev %lu period=%lums batch=%u deadband=%u qos=%u log=%s\n", (unsigned long)rev,
+             (unsigned long)c.period_ms, c.batch_n, c.deadband_deci, c.qos, LEVEL_NAMES[c.log_level]);
+    return true;
+}
+
+bool runtime_config_publish_due(void)
+{
+    return publish_due;
+}
+
+void runtime_config_published(void)
+{
+    publish_due = false;
+}
+
+size_t runtime_config_format(char *buf, size_t len)
+{
+    int n = snprintf(buf, len,
+                     "{\"period_ms\":%lu,\"batch_n\":%u,\"deadband_deci\":%u,\"qos\":%u,\"log_level\":\"%s\","
+                     "\"rev\":%lu,\"result\":\"%s\",\"pending\":%s}",
+                     (unsigned long)active.period_ms, active.batch_n, active.deadband_deci, active.qos,
+                     LEVEL_NAMES[active.log_level], (unsigned long)rev, last_result, staged_due ? "true" : "false");
+    return n > 0 && (size_t)n < len ? (size_t)n : 0;
+}
+
+uint32_t runtime_config_deadline_ms(uint32_t base_ms)
+{
+    uint32_t two_periods = 2 * active.period_ms;
+    return two_periods > base_ms ? two_periods : base_ms;
+}
+
+bool runtime_config_should_publish(const AHT22Result *r)
+{
+    return deadband_check(&deadband, r, active.deadband_deci, RUNTIME_CONFIG_HEARTBEAT_MS,
+                          to_us_since_boot(get_absolute_time()));
+}
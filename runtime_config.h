@@ -0,0 +1,52 @@
+#pragma once
+// 実行時に変えられる設定。MQTT の config/set で受けて検証し、フラッシュ末尾の 2 セクタに交互に保存する。
+// 有効な設定は config トピックへ retained で返す（受け付けた/弾いた結果付き）
+//
+//   {"period_ms":2000,"batch_n":20,"deadband_deci":2,"qos":0,"log_level":"warn"}
+//
+// 書いたキーだけ変わる。知らないキー・範囲外の値が 1 つでもあれば全体を弾く
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "aht20.h"
+
+#ifndef PUBLISH_PERIOD_MS
+#define PUBLISH_PERIOD_MS 1000
+#endif
+#ifndef LOWPOWER_BATCH_N
+#define LOWPOWER_BATCH_N 10
+#endif
+
+#define RUNTIME_CONFIG_PERIOD_MIN_MS 100 // AHT20 の変換待ち（80ms）より長く
+#define RUNTIME_CONFIG_PERIOD_MAX_MS (10 * 60 * 1000)
+#define RUNTIME_CONFIG_BATCH_MAX 60     // 低消費電力版が電源断をまたいで貯められる数
+#define RUNTIME_CONFIG_DEADBAND_MAX 500 // 50.0
+#define RUNTIME_CONFIG_HEARTBEAT_MS 30000 // デッドバンドで止めていても、これ以上は黙らない
+#define RUNTIME_CONFIG_MSG_MAX 256
+
+typedef struct
+{
+    uint32_t period_ms;     // サンプリング・publish の周期
+    uint16_t batch_n;       // 低消費電力版: 何サンプルごとに送るか
+    uint16_t deadband_deci; // 前回送った値からの変化が温度・湿度ともにこれ未満なら送らない（0.1 単位、0 = 毎回）
+    uint8_t qos;            // 計測値の QoS（0/1）
+    uint8_t log_level;      // APPLOG_LEVEL_*（ビルド時のレベルより詳しくはできない）
+} RuntimeConfig;
+
+// フラッシュから読み出して適用する（無い・壊れていればビルド時の既定値）。起動直後に 1 回
+void runtime_config_init(void);
+const RuntimeConfig *runtime_config(void);
+// config/set の受信。検証して次の runtime_config_commit() で反映する分を積む（lwIP コールバックから）
+void runtime_config_handle(const uint8_t *payload, size_t len);
+// 受け付けた変更があるか。あればアプリ側のコンテキストで runtime_config_commit() を呼ぶ
+bool runtime_config_commit_due(void);
+// 積んだ変更を有効にしてフラッシュに保存する（ログレベル・QoS はここで反映）。変わったら true
+bool runtime_config_commit(void);
+// 結果の retained publish が必要か（起動後の初回と、受信のたび）
+bool runtime_config_publish_due(void);
+void runtime_config_published(void);
+size_t runtime_config_format(char *buf, size_t len);
+// 周期が長くなったときの監視期限（supervisor）。base_ms と 2 周期の長い方
+uint32_t runtime_config_deadline_ms(uint32_t base_ms);
+// デッドバンド判定。送るなら true を返して「前回送った値」を更新する
+bool runtime_config_should_publish(const AHT22Result *r);
@@ -0,0 +1,63 @@
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "wd.h"
+#include "supervisor.h"
+#include "applog.h"
+
+typedef struct
+{
+    uint32_t deadline_ms; // 0 = 未登録
+    volatile uint32_t last_ms;
+} Heartbeat;
+
+static Heartbeat beats[SV_COUNT];
+static bool tripped = false;
+
+static const char *const SV_NAMES[SV_COUNT] = {"sampler", "publisher", "conn"};
+
+static uint32_t now_ms(void)
+{
+    return to_ms_since_boot(get_absolute_time());
+}
+
+void sv_register(sv_id_t id, uint32_t deadline_ms)
+{
+    beats[id].last_ms = now_ms();
+    beats[id].deadline_ms = deadline_ms;
+}
+
+void sv_checkin(sv_id_t id)
+{
+    beats[id].last_ms = now_ms();
+}
+
+bool sv_poll(void)
+{
+    if (tripped)
+        return false;
+
+    uint32_t now = now_ms();
+    for (int i = 0; i < SV_COUNT; i++)
+    {
+        const Heartbeat *b = &beats[i];
+        if (!b->deadline_ms)
+            continue;
+        uint32_t age = now - b->last_ms;
+        if (age > b->deadline_ms)
+        {
+            // 犯人を残して以降は餌をやらない（WDT に任せてリセット）
+            wd_record_reset(WD_REASON_SUPERVISOR, (uint8_t)i);
+            tripped = true;
+            LOG_ERROR(WD, "supervisor: %s missed its deadline (%lums > %lums), letting WDT reset\n",
+                      SV_NAMES[i], (unsigned long)age, (unsigned long)b->deadline_ms);
+            return false;
+        }
+    }
+    wd_feed();
+    return true;
+}
+
+const char *sv_name(uint8_t id)
+{
+    return id < SV_COUNT ? SV_NAMES[id] : "none";
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+// サブシステムごとのハートビートを見て、全員が期限内にチェックインしているときだけ
+// ハードウェア WDT に餌をやる。誰かが期限切れになったら犯人をリセット記録（wd.h）に
+// 書いて餌やりを止める（WD_TIMEOUT_MS 後に WDT がリセットする）
+typedef enum
+{
+    SV_SAMPLER = 0, // サンプリングが周期どおり回っている（読めたかは問わない）
+    SV_PUBLISHER,   // 接続中なら publish が ACK されている（ERR_MEM 続き・死んだセッションを検出）
+    SV_CONN,        // 接続管理が回っている
+    SV_COUNT
+} sv_id_t;
+
+// deadline_ms 以内に sv_checkin が無ければ不健全とみなす。登録した時点を初回チェックインとする
+void sv_register(sv_id_t id, uint32_t deadline_ms);
+void sv_checkin(sv_id_t id);
+// wd_feed の代わりに定期的に呼ぶ。健全なら true（餌をやった）
+bool sv_poll(void);
+const char *sv_name(uint8_t id);
@@ -0,0 +1,185 @@
+#!/usr/bin/env python3
+"""Measure the latency of on-demand reads: publish "read" requests on <prefix>/cmd and time the replies.
+
+    tools/cmd_read_latency.py --broker 192.168.1.10:1883 --board-id E6614C311B4A8F2D [--count 50] [--interval 0.5]
+
+The prefix is the topic template without "/{sensor}" (default pico2w/{board_id}). Each reply carries
+the device-side split, all relative to the moment the device received the request:
+  trigger_us  AHT20 trigger (negative when the read shared a periodic conversion already in flight)
+  conv_us     conversion read back
+  reply_us    reply handed to lwIP
+The client measures the full round trip; rtt - reply_us is the broker and network share.
+"""
+import argparse
+import json
+import os
+import socket
+import struct
+import sys
+import time
+
+
+class Client:
+    """Minimal MQTT 3.1.1 client: one subscription, QoS0/1 publish, blocking reads."""
+
+    def __init__(self, broker):
+        host, port = broker.rsplit(":", 1)
+        self.sock = socket.create_connection((host, int(port)), timeout=5)
+        self.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)  # don't let Nagle pad the RTT
+        self.packet_id = 0
+
+    def _send(self, ptype, body):
+        n, rl = len(body), b""
+        while True:
+            b = n % 128
+            n //= 128
+            rl += bytes([b | (0x80 if n else 0)])
+            if not n:
+                break
+        self.sock.sendall(bytes([ptype]) + rl + body)
+
+    def _read_exact(self, n):
+        buf = b""
+        while len(buf) < n:
+            d = self.sock.recv(n - len(buf))
+            if not d:
+                raise ConnectionError("broker closed the connection")
+            buf += d
+        return buf
+
+    def read_packet(self):
+        hdr = self._read_exact(1)[0]
+        mult, n = 1, 0
+        while True:
+            b = self._read_exact(1)[0]
+            n += (b & 0x7F) * mult
+            mult *= 128
+            if not b & 0x80:
+                break
+        return hdr, self._read_exact(n) if n else b""
+
+    def connect(self, topic):
+        cid = f"cmd-latency-{os.getpid()}".encode()
+        body = b"\x00\x04MQTT\x04\x02" + struct.pack(">H", 60) + struct.pack(">H", len(cid)) + cid
+        self._send(0x10, body)
+        hdr, body = self.read_packet()
+        if hdr >> 4 != 2 or body[1] != 0:
+            raise ConnectionError(f"CONNACK refused: {body!r}")
+        t = topic.encode()
+        self._send(0x82, struct.pack(">H", 1) + struct.pack(">H", len(t)) + t + b"\x01")
+        hdr, _ = self.read_packet()
+        if hdr >> 4 != 9:
+            raise ConnectionError("no SUBACK")
+
+    def publish(self, topic, payload, qos):
+        t = topic.encode()
+        body = struct.pack(">H", len(t)) + t
+        if qos:
+            self.packet_id = self.packet_id % 0xFFFF + 1
+            body += struct.pack(">H", self.packet_id)
+        self._send(0x30 | (qos << 1), body + payload)
+
+    def next_publish(self, deadline):
+        """Next PUBLISH as (topic, payload), or None at the deadline; acks QoS1 on the way."""
+        while True:
+            left = deadline - time.monotonic()
+            if left <= 0:
+                return None
+            self.sock.settimeout(left)
+            try:
+                hdr, body = self.read_packet()
+            except socket.timeout:
+                return None
+            if hdr >> 4 != 3:
+                continue  # PUBACK of our requests
+            qos = (hdr >> 1) & 3
+            tlen = struct.unpack(">H", body[:2])[0]
+            topic = body[2 : 2 + tlen].decode()
+            pos = 2 + tlen
+            if qos:
+                self._send(0x40, body[pos : pos + 2])
+                pos += 2
+            return topic, body[pos:]
+
+    def close(self):
+        try:
+            self._send(0xE0, b"")
+        except OSError:
+            pass
+        self.sock.close()
+
+
+def percentile(values, p):
+    if not values:
+        return None
+    s = sorted(values)
+    return s[min(len(s) - 1, int(round(p / 100.0 * (len(s) - 1))))]
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--broker", default="127.0.0.1:1883")
+    ap.add_argument("--board-id", help="16 hex digits, as in the device's client ID")
+    ap.add_argument("--prefix", help="topic prefix (default pico2w/<board-id>)")
+    ap.add_argument("--count", type=int, default=20)
+    ap.add_argument("--interval", type=float, default=0.5, help="seconds between requests")
+    ap.add_argument("--timeout", type=float, default=2.0, help="seconds to wait for each reply")
+    ap.add_argument("--qos", type=int, choices=(0, 1), default=1, help="QoS of the requests")
+    ap.add_argument("--json", help="also write per-request results here")
+    args = ap.parse_args()
+    if not args.prefix and not args.board_id:
+        sys.exit("need --board-id or --prefix")
+    prefix = args.prefix or f"pico2w/{args.board_id}"
+
+    client = Client(args.broker)
+    client.connect(prefix + "/cmd/resp")
+    results = []
+    for i in range(args.count):
+        req_id = f"lat-{os.getpid()}-{i}"
+        sent = time.monotonic()
+        client.publish(prefix + "/cmd", json.dumps({"cmd": "read", "id": req_id}).encode(), args.qos)
+        reply = None
+        deadline = sent + args.timeout
+        while reply is None:
+            msg = client.next_publish(deadline)
+            if msg is None:
+                break
+            try:
+                doc = json.loads(msg[1])
+            except ValueError:
+                continue
+            if doc.get("id") == req_id:
+                reply = doc
+        rtt_us = round((time.monotonic() - sent) * 1e6)
+        if reply is None:
+            results.append({"id": req_id, "result": "timeout"})
+        else:
+            reply["rtt_us"] = rtt_us
+            results.append(reply)
+        time.sleep(max(0.0, args.interval - (time.monotonic() - sent)))
+    client.close()
+
+    ok = [r for r in results if r.get("result") == "ok"]
+    print(f"requests={len(results)} ok={len(ok)} "
+          f"failed={sum(r.get('result') == 'failed' for r in results)} "
+          f"timeout={sum(r.get('result') == 'timeout' for r in results)}")
+    cols = [
+        ("rtt", lambda r: r["rtt_us"]),
+        ("trigger", lambda r: r["trigger_us"]),
+        ("conv", lambda r: r["conv_us"]),
+        ("reply", lambda r: r["reply_us"]),
+        ("network", lambda r: r["rtt_us"] - r["reply_us"]),
+    ]
+    print(f"{'us':<10}{'p50':>10}{'p90':>10}{'p99':>10}{'max':>10}")
+    for name, get in cols:
+        v = [get(r) for r in ok]
+        cells = [percentile(v, p) for p in (50, 90, 99)] + [max(v) if v else None]
+        print(f"{name:<10}" + "".join(f"{'-' if c is None else c:>10}" for c in cells))
+
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(results, f, indent=1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,140 @@
+#!/usr/bin/env python3
+"""Compare the Arm Cortex-M33 and Hazard3 RISC-V builds: cycles per sample, code size, power.
+
+Build both presets (see CMakeLists.txt), then for each variant flash mqcensor_bench and capture
+its UART output, and flash mqcensor and measure the average supply power with an external meter
+(the RP2350 cannot measure its own consumption):
+
+    cmake --preset pico2w-arm && cmake --build --preset pico2w-arm --target mqcensor_bench_footprint mqcensor_footprint
+    cmake --preset pico2w-riscv && cmake --build --preset pico2w-riscv --target mqcensor_bench_footprint mqcensor_footprint
+    tools/compare_arch_variants.py \\
+        arm:arm_bench.log:build-arm/mqcensor_footprint.json:arm_power.csv \\
+        riscv:riscv_bench.log:build-riscv/mqcensor_footprint.json:41.5 [--json out.json]
+
+Each variant is NAME:BENCH_LOG:FOOTPRINT_JSON[:POWER]. POWER is either the average in mW or a
+CSV of current samples in mA (last column of each numeric row, e.g. a PPK2 or INA219 export),
+converted with --supply-v. The first variant is the baseline.
+
+Cycles per sample is the `sample_path` case of mqcensor_bench (decode + format of one reading);
+the time column uses each run's clk_hz. Code size comes from footprint_report.py.
+"""
+import argparse
+import json
+import os
+import re
+import sys
+
+ENV_RE = re.compile(r"bench_env: arch=(?P<arch>\S+) placement=\S+ clk_hz=(?P<clk_hz>\d+) build=\S+(?: hot_path=(?P<hot_path>\S+))?")
+BENCH_RE = re.compile(r"bench\[(?P<name>[^\]]+)\]: iters=\d+ min=(?P<min>\d+) median=(?P<median>\d+) max=\d+ cycles")
+SAMPLE_CASE = "sample_path"
+
+
+def load_bench(path):
+    env, cases = {}, {}
+    with open(path, errors="replace") as f:
+        for line in f:
+            m = ENV_RE.search(line)
+            if m:
+                env = m.groupdict()
+                continue
+            m = BENCH_RE.search(line)
+            if m:
+                cases[m.group("name")] = {"min": int(m.group("min")), "median": int(m.group("median"))}
+    if SAMPLE_CASE not in cases:
+        sys.exit(f"{path}: no bench[{SAMPLE_CASE}] line (mqcensor_bench too old?)")
+    return env, cases
+
+
+def load_power_mw(spec, supply_v):
+    if spec is None:
+        return None
+    if not os.path.exists(spec):
+        return float(spec)
+    values = []
+    with open(spec, errors="replace") as f:
+        for line in f:
+            cols = [c for c in re.split(r"[,;\t ]+", line.strip()) if c]
+            try:
+                values.append(float(cols[-1]))
+            except (IndexError, ValueError):
+                continue  # header or blank line
+    if not values:
+        sys.exit(f"{spec}: no current samples")
+    return sum(values) / len(values) * supply_v
+
+
+def load_variant(spec, supply_v):
+    parts = spec.split(":")
+    if len(parts) not in (3, 4):
+        sys.exit(f"bad variant '{spec}': expected NAME:BENCH_LOG:FOOTPRINT_JSON[:POWER]")
+    name, log, footprint = parts[:3]
+    env, cases = load_bench(log)
+    with open(footprint) as f:
+        fp = json.load(f)
+    sample = cases[SAMPLE_CASE]
+    clk = int(env.get("clk_hz") or 0)
+    components = fp.get("components", {})
+    return {
+        "name": name,
+        "arch": env.get("arch", "?"),
+        "hot_path": env.get("hot_path") or "?",
+        "clk_hz": clk,
+        "cycles_per_sample": sample["median"],
+        "cycles_per_sample_min": sample["min"],
+        "cycles_per_sample_cold": cases.get(SAMPLE_CASE + "_cold", {}).get("median"),
+        "ns_per_sample": round(sample["median"] * 1e9 / clk) if clk else None,
+        "flash_bytes": fp["flash_bytes"],
+        "ram_bytes": fp["ram_bytes"],
+        "app_flash_bytes": components.get("app", {}).get("flash"),
+        "libgcc_flash_bytes": components.get("libgcc", {}).get("flash"),
+        "power_mw": load_power_mw(parts[3] if len(parts) == 4 else None, supply_v),
+    }
+
+
+def delta(value, base):
+    if value is None or base is None:
+        return ""
+    if not base:
+        return f" ({value - base:+g})"
+    return f" ({100.0 * (value - base) / base:+.0f}%)"
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("variants", nargs="+", help="NAME:BENCH_LOG:FOOTPRINT_JSON[:POWER]; the first is the baseline")
+    ap.add_argument("--supply-v", type=float, default=5.0, help="supply voltage for current CSVs (default VSYS 5.0)")
+    ap.add_argument("--json", help="also write the comparison here")
+    args = ap.parse_args()
+
+    runs = [load_variant(v, args.supply_v) for v in args.variants]
+    base = runs[0]
+    rows = [
+        ("arch / hot path", lambda r: f"{r['arch']}/{r['hot_path']}", None),
+        ("clk MHz", lambda r: f"{r['clk_hz'] / 1e6:g}", None),
+        ("cycles/sample", lambda r: r["cycles_per_sample"], "cycles_per_sample"),
+        ("cycles/sample cold", lambda r: r["cycles_per_sample_cold"], "cycles_per_sample_cold"),
+        ("ns/sample", lambda r: r["ns_per_sample"], "ns_per_sample"),
+        ("flash bytes", lambda r: r["flash_bytes"], "flash_bytes"),
+        ("ram bytes", lambda r: r["ram_bytes"], "ram_bytes"),
+        ("app flash bytes", lambda r: r["app_flash_bytes"], "app_flash_bytes"),
+        ("libgcc flash bytes", lambda r: r["libgcc_flash_bytes"], "libgcc_flash_bytes"),
+        ("power mW", lambda r: None if r["power_mw"] is None else round(r["power_mw"], 1), "power_mw"),
+    ]
+    print(f"{'':<20}" + "".join(f"{r['name']:>24}" for r in runs))
+    for label, get, key in rows:
+        line = f"{label:<20}"
+        for r in runs:
+            v = get(r)
+            cell = "-" if v is None else str(v)
+            if key and r is not base:
+                cell += delta(r[key], base[key])
+            line += f"{cell:>24}"
+        print(line)
+
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump({"baseline": base["name"], "variants": runs}, f, indent=1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,74 @@
+#!/usr/bin/env python3
+"""Compare mqcensor_bench runs (e.g. XIP vs hot_ram vs copy_to_ram) and report cycles saved.
+
+Flash mqcensor_bench built with each MQCENSOR_CODE_PLACEMENT (or flags, or core), capture the
+UART output of each run, then:
+
+    tools/compare_bench_cycles.py xip.log hot_ram.log [copy_to_ram.log ...] [--json out.json]
+
+The first log is the baseline. Every `bench[name]: iters=.. min=.. median=.. max=.. cycles` line
+is matched by name; the table shows median (and min) cycles per run and the saving against the
+baseline. The `bench_env:` line of each log labels the column.
+"""
+import argparse
+import json
+import re
+import sys
+
+ENV_RE = re.compile(r"bench_env: arch=(?P<arch>\S+) placement=(?P<placement>\S+) clk_hz=(?P<clk_hz>\d+) build=(?P<build>\S+)(?: hot_path=(?P<hot_path>\S+))?")
+BENCH_RE = re.compile(
+    r"bench\[(?P<name>[^\]]+)\]: iters=(?P<iters>\d+) min=(?P<min>\d+) median=(?P<median>\d+) max=(?P<max>\d+) cycles"
+)
+
+
+def load(path):
+    env, cases = {}, {}
+    with open(path, errors="replace") as f:
+        for line in f:
+            m = ENV_RE.search(line)
+            if m:
+                env = m.groupdict()
+                continue
+            m = BENCH_RE.search(line)
+            if m:
+                cases[m.group("name")] = {k: int(m.group(k)) for k in ("iters", "min", "median", "max")}
+    if not cases:
+        sys.exit(f"{path}: no bench[...] lines")
+    label = f"{env.get('placement', '?')}/{env.get('arch', '?')}" if env else path
+    return {"path": path, "label": label, "env": env, "cases": cases}
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("logs", nargs="+", help="UART captures; the first one is the baseline")
+    ap.add_argument("--json", help="also write the comparison here")
+    args = ap.parse_args()
+
+    runs = [load(p) for p in args.logs]
+    base = runs[0]
+    names = [n for n in base["cases"] if all(n in r["cases"] for r in runs[1:])]
+
+    header = f"{'case':<24}" + "".join(f"{r['label']:>22}" for r in runs)
+    print(header)
+    result = []
+    for name in names:
+        b = base["cases"][name]["median"]
+        row = f"{name:<24}"
+        entry = {"case": name, "runs": []}
+        for r in runs:
+            c = r["cases"][name]
+            saved = b - c["median"]
+            pct = 100.0 * saved / b if b else 0.0
+            cell = f"{c['median']}" if r is base else f"{c['median']} ({saved:+d}, {pct:+.0f}%)"
+            row += f"{cell:>22}"
+            entry["runs"].append({"label": r["label"], **c, "saved_median": saved, "saved_pct": round(pct, 1)})
+        print(row)
+        result.append(entry)
+
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump({"baseline": base["label"], "envs": [r["env"] for r in runs], "cases": result}, f, indent=1)
+
+
+if __name__ == "__main__":
+    main()
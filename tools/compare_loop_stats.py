@@ -0,0 +1,70 @@
+#!/usr/bin/env python3
+"""Compare sampling jitter and publish throughput between firmware variants.
+
+Capture the UART output of each build (e.g. mqcensor and mqcensor_freertos,
+optionally with -DMQCENSOR_PUBLISH_PERIOD_MS=100 to stress the loop) and pass
+the log files here:
+
+    tools/compare_loop_stats.py superloop.log freertos.log [--json out.json]
+
+Every `loop_stats[...]` line printed by loop_stats_report() is aggregated per tag.
+"""
+import argparse
+import json
+import re
+import sys
+
+LINE_RE = re.compile(
+    r"loop_stats\[(?P<tag>[^\]]+)\]: samples=(?P<samples>\d+) published=(?P<published>\d+) "
+    r"elapsed_ms=(?P<elapsed_ms>\d+) jitter_avg_us=(?P<jitter_avg_us>\d+) "
+    r"jitter_max_us=(?P<jitter_max_us>\d+) rate_mHz=(?P<rate_mhz>\d+)"
+)
+
+
+def aggregate(paths):
+    result = {}
+    for path in paths:
+        with open(path, errors="replace") as f:
+            for line in f:
+                m = LINE_RE.search(line)
+                if not m:
+                    continue
+                v = {k: (m[k] if k == "tag" else int(m[k])) for k in LINE_RE.groupindex}
+                a = result.setdefault(v["tag"], {
+                    "windows": 0, "samples": 0, "published": 0, "elapsed_ms": 0,
+                    "jitter_weighted_us": 0, "jitter_max_us": 0,
+                })
+                a["windows"] += 1
+                a["samples"] += v["samples"]
+                a["published"] += v["published"]
+                a["elapsed_ms"] += v["elapsed_ms"]
+                a["jitter_weighted_us"] += v["jitter_avg_us"] * max(v["samples"] - 1, 1)
+                a["jitter_max_us"] = max(a["jitter_max_us"], v["jitter_max_us"])
+    for a in result.values():
+        a["jitter_avg_us"] = a.pop("jitter_weighted_us") / max(a["samples"] - a["windows"], 1)
+        a["publish_rate_hz"] = a["published"] * 1000.0 / a["elapsed_ms"] if a["elapsed_ms"] else 0.0
+    return result
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("logs", nargs="+", help="UART logs captured from each variant")
+    ap.add_argument("--json", help="write the aggregated numbers to this file")
+    args = ap.parse_args()
+
+    result = aggregate(args.logs)
+    if not result:
+        sys.exit("no loop_stats lines found")
+
+    print(f"{'variant':<12} {'samples':>8} {'rate[Hz]':>9} {'jitter avg[us]':>15} {'jitter max[us]':>15}")
+    for tag, a in sorted(result.items()):
+        print(f"{tag:<12} {a['samples']:>8} {a['publish_rate_hz']:>9.3f} "
+              f"{a['jitter_avg_us']:>15.1f} {a['jitter_max_us']:>15}")
+
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(result, f, indent=2, sort_keys=True)
+
+
+if __name__ == "__main__":
+    main()
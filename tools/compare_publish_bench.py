@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+"""Compare two publish_bench result files and flag regressions.
+
+Each line of a result file is one JSON object written by host/bench/publish_bench
+(one per rate/encoding/QoS/batch combination). Run the bench on two commits, then:
+
+    tools/compare_publish_bench.py base.jsonl new.jsonl [--tag-base v1 --tag-new v2] [--threshold 10]
+
+Cases are matched on (rate_hz, encoding, qos, batch). The latest line wins when a file
+holds several runs of the same case. The exit status is 1 when any metric got worse
+by more than the threshold (percent).
+"""
+import argparse
+import json
+import sys
+
+KEY = ("rate_hz", "encoding", "qos", "batch")
+# metric -> True when larger is better
+METRICS = {
+    "msgs_per_s": True,
+    "tx_bytes_per_sample": False,
+    "lat_p50_us": False,
+    "lat_p99_us": False,
+    "lat_p999_us": False,
+    "cpu_us_per_sample": False,
+}
+
+
+def load(path, tag):
+    cases = {}
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if not line:
+                continue
+            r = json.loads(line)
+            if tag is not None and r.get("tag") != tag:
+                continue
+            cases[tuple(r[k] for k in KEY)] = r
+    return cases
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("base")
+    ap.add_argument("new")
+    ap.add_argument("--tag-base", help="only use lines with this tag from the base file")
+    ap.add_argument("--tag-new", help="only use lines with this tag from the new file")
+    ap.add_argument("--threshold", type=float, default=10.0, help="regression threshold in percent")
+    args = ap.parse_args()
+
+    base = load(args.base, args.tag_base)
+    new = load(args.new, args.tag_new)
+    common = sorted(set(base) & set(new))
+    if not common:
+        sys.exit("no common cases")
+
+    regressions = 0
+    print(f"{'case':<22} {'metric':<20} {'base':>12} {'new':>12} {'delta':>8}")
+    for key in common:
+        name = "{}Hz/{}/q{}/k{}".format(*key)
+        for metric, higher_better in METRICS.items():
+            b, n = base[key][metric], new[key][metric]
+            delta = (n - b) * 100.0 / b if b else 0.0
+            worse = -delta if higher_better else delta
+            flag = ""
+            if worse > args.threshold:
+                flag = "  REGRESSION"
+                regressions += 1
+            print(f"{name:<22} {metric:<20} {b:>12.2f} {n:>12.2f} {delta:>+7.1f}%{flag}")
+    sys.exit(1 if regressions else 0)
+
+
+if __name__ == "__main__":
+    main()
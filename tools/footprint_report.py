@@ -0,0 +1,312 @@
+#!/usr/bin/env python3
+"""Flash/RAM footprint and stack-usage report for a firmware ELF, with an optional regression gate.
+
+Run through the <target>_footprint CMake targets (after pico_add_extra_outputs), or by hand:
+
+    tools/footprint_report.py --elf build/mqcensor.elf --map build/mqcensor.elf.map \\
+        --objdir build/CMakeFiles/mqcensor.dir --out mqcensor_footprint.json [--baseline old.json]
+
+The JSON summary holds:
+  sections         every allocated ELF section with address, size and whether it costs flash and/or RAM
+  components       flash/RAM per component (app, lwip, cyw43_driver, cyw43_firmware, newlib_printf, ...)
+  objects          flash/RAM per object file / archive member from the link map
+  watch_symbols    size of symbols we never want to see appear silently (float printf, malloc, ...)
+  largest_symbols  the biggest functions/objects
+  stack            -fstack-usage frames of every function, and of the publish path
+
+With --baseline, flash/RAM totals, per-component sizes and the publish-path stack sum are compared
+against an earlier summary; growth above --threshold-bytes, or a watch symbol that was not
+there before, prints the offenders and exits 1.
+"""
+import argparse
+import glob
+import json
+import os
+import re
+import struct
+import sys
+
+RAM_BASE = 0x20000000  # SRAM (and scratch X/Y) on RP2040 / RP2350
+SHT_PROGBITS, SHT_SYMTAB, SHT_NOBITS = 1, 2, 8
+SHF_ALLOC = 0x2
+
+# object path -> component; first match wins
+COMPONENTS = [
+    ("cyw43_firmware", re.compile(r"cyw43_resource|w43439|cyw43[^/]*/firmware/", re.I)),
+    ("cyw43_driver", re.compile(r"cyw43", re.I)),
+    ("lwip", re.compile(r"lwip", re.I)),
+    ("freertos", re.compile(r"freertos", re.I)),
+    ("pico_printf", re.compile(r"pico_printf")),
+    ("newlib_printf", re.compile(r"lib(c|g)(_nano)?\.a\(.*(printf|dtoa|ldtoa|mprec|fvwrite).*\)")),
+    ("newlib", re.compile(r"lib(c|g|m)(_nano)?\.a|libnosys\.a")),
+    ("libgcc", re.compile(r"libgcc\.a|crt[^/]*\.o")),
+    ("pico_sdk", re.compile(r"pico[-_]sdk|/src/(rp2_common|common|rp2040|rp2350|host)/|boot_stage2|bs2_default")),
+    ("app", re.compile(r"CMakeFiles/[^/]+\.dir/")),
+]
+
+# symbols that mean "someone pulled in something heavy"
+WATCH_SYMBOLS = [
+    "_printf_float",  # newlib float printf
+    "_dtoa_r",
+    "_vfprintf_r",
+    "_svfprintf_r",
+    "_ftoa",  # pico_printf float support
+    "_etoa",
+    "malloc",
+    "_malloc_r",
+    "__aeabi_ddiv",  # double-precision soft float
+    "__aeabi_dmul",
+    "__divdf3",
+    "__muldf3",
+]
+
+# sampling -> format -> outbox -> MQTT -> TCP/IP -> driver
+PUBLISH_PATH = [
+    "read_work",
+    "publish_task",
+    "aht20_read_result",
+    "aht20_decode",
+    "aht20_format",
+    "net_publish_sample",
+    "mqtt_session_publish",
+    "net_publish_direct",
+    "mqtt_publish",
+    "mqtt_output_send",
+    "tcp_write",
+    "tcp_output",
+    "tcp_output_segment",
+    "ip4_output_if",
+    "ip4_output_if_src",
+    "etharp_output",
+    "ethernet_output",
+    "cyw43_netif_output",
+    "cyw43_send_ethernet",
+]
+
+
+def read_elf(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:4] != b"\x7fELF" or data[4] != 1 or data[5] != 1:
+        sys.exit(f"{path}: not a 32-bit little-endian ELF")
+    shoff, = struct.unpack_from("<I", data, 0x20)
+    shentsize, shnum, shstrndx = struct.unpack_from("<HHH", data, 0x2E)
+    raw = []
+    for i in range(shnum):
+        name, stype, flags, addr, off, size, link, _, _, entsize = struct.unpack_from(
+            "<IIIIIIIIII", data, shoff + i * shentsize
+        )
+        raw.append((name, stype, flags, addr, off, size, link, entsize))
+    stroff = raw[shstrndx][4]
+
+    def cstr(base, idx):
+        end = data.index(b"\0", base + idx)
+        return data[base + idx : end].decode(errors="replace")
+
+    sections = {}
+    for name, stype, flags, addr, off, size, _, _ in raw:
+        if not flags & SHF_ALLOC or not size:
+            continue
+        in_ram = addr >= RAM_BASE
+        sections[cstr(stroff, name)] = {
+            "addr": addr,
+            "size": size,
+            # every PROGBITS section is stored in the image (.data and copy_to_ram code are copied out)
+            "flash": stype != SHT_NOBITS,
+            "ram": in_ram,
+        }
+
+    symbols = {}
+    for _, stype, _, _, off, size, link, entsize in raw:
+        if stype != SHT_SYMTAB:
+            continue
+        strtab = raw[link][4]
+        for i in range(size // entsize):
+            st_name, value, st_size, info, _, shndx = struct.unpack_from("<IIIBBH", data, off + i * entsize)
+            kind = info & 0xF
+            if st_name and st_size and kind in (1, 2) and shndx:  # OBJECT / FUNC
+                n = cstr(strtab, st_name)
+                symbols[n] = {"size": st_size, "ram": value >= RAM_BASE, "func": kind == 2}
+    return sections, symbols
+
+
+MAP_OUT_RE = re.compile(r"^(\.\S+|COMMON)(?:\s+0x([0-9a-f]+)\s+0x([0-9a-f]+))?\s*$")
+MAP_IN_RE = re.compile(r"^ (\.\S+|COMMON|\*fill\*)(?:\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)(?:\s+(\S.*))?)?\s*$")
+MAP_CONT_RE = re.compile(r"^\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S.*)$")
+
+
+def read_map(path):
+    """(output section, object, size) for every input section in a GNU ld map."""
+    out, current, pending = [], None, None
+    in_layout = False
+    with open(path, errors="replace") as f:
+        for line in f:
+            line = line.rstrip("\n")
+            if not in_layout:
+                in_layout = line.startswith("Linker script and memory map")
+                continue
+            m = MAP_OUT_RE.match(line)
+            if m and not line.startswith(" "):
+                current, pending = m.group(1), None
+                continue
+            if line.startswith("/DISCARD/"):
+                current, pending = None, None
+                continue
+            if current is None:
+                continue
+            m = MAP_IN_RE.match(line)
+            if m:
+                pending = None
+                if m.group(2) is None:
+                    pending = m.group(1)  # name too long, address/size/object on the next line
+                    continue
+                size, obj = int(m.group(3), 16), m.group(4) or "*fill*"
+                if size:
+                    out.append((current, obj.strip(), size))
+                continue
+            if pending:
+                m = MAP_CONT_RE.match(line)
+                if m and int(m.group(2), 16):
+                    out.append((current, m.group(3).strip(), int(m.group(2), 16)))
+                pending = None
+    return out
+
+
+def component_of(obj):
+    for name, rx in COMPONENTS:
+        if rx.search(obj):
+            return name
+    return "other"
+
+
+def short_obj(obj):
+    # CMakeFiles/<target>.dir/<path>.obj -> <path>; archive members keep "lib.a(member)"
+    m = re.search(r"CMakeFiles/[^/]+\.dir/(.*)$", obj)
+    if m:
+        return m.group(1)
+    return os.path.basename(obj.split("(")[0]) + ("(" + obj.split("(", 1)[1] if "(" in obj else "")
+
+
+def read_stack_usage(objdir):
+    funcs = {}
+    for su in glob.glob(os.path.join(objdir, "**", "*.su"), recursive=True):
+        with open(su, errors="replace") as f:
+            for line in f:
+                parts = line.rstrip("\n").split("\t")
+                if len(parts) != 3:
+                    continue
+                where, size, kind = parts
+                name = where.rsplit(":", 1)[-1]
+                prev = funcs.get(name)
+                # keep the larger frame when static functions share a name
+                if not prev or int(size) > prev["bytes"]:
+                    funcs[name] = {"bytes": int(size), "kind": kind, "file": where.rsplit(":", 3)[0]}
+    return funcs
+
+
+def build_summary(args):
+    sections, symbols = read_elf(args.elf)
+    summary = {
+        "target": args.target or os.path.splitext(os.path.basename(args.elf))[0],
+        "flash_bytes": sum(s["size"] for s in sections.values() if s["flash"]),
+        "ram_bytes": sum(s["size"] for s in sections.values() if s["ram"]),
+        "sections": sections,
+    }
+
+    components, objects = {}, {}
+    if args.map and os.path.exists(args.map):
+        for out_sec, obj, size in read_map(args.map):
+            sec = sections.get(out_sec)
+            if not sec:
+                continue
+            comp = "fill" if obj == "*fill*" else component_of(obj)
+            key = "*fill*" if obj == "*fill*" else short_obj(obj)
+            for d, k in ((components, comp), (objects, key)):
+                e = d.setdefault(k, {"flash": 0, "ram": 0})
+                if sec["flash"]:
+                    e["flash"] += size
+                if sec["ram"]:
+                    e["ram"] += size
+            objects[key]["component"] = comp
+    summary["components"] = dict(sorted(components.items(), key=lambda kv: -kv[1]["flash"]))
+    summary["objects"] = dict(sorted(objects.items(), key=lambda kv: -(kv[1]["flash"] + kv[1]["ram"])))
+    summary["watch_symbols"] = {s: symbols[s]["size"] for s in WATCH_SYMBOLS if s in symbols}
+    largest = sorted(symbols.items(), key=lambda kv: -kv[1]["size"])[: args.top]
+    summary["largest_symbols"] = [
+        {"name": n, "size": s["size"], "ram": s["ram"], "func": s["func"]} for n, s in largest
+    ]
+
+    stack = {"functions": {}, "publish_path": {}, "publish_path_sum": 0, "dynamic": []}
+    if args.objdir and os.path.isdir(args.objdir):
+        funcs = read_stack_usage(args.objdir)
+        stack["functions"] = dict(sorted(funcs.items()))
+        stack["dynamic"] = sorted(n for n, f in funcs.items() if "dynamic" in f["kind"])
+        for name in PUBLISH_PATH:
+            f = funcs.get(name)
+            stack["publish_path"][name] = f["bytes"] if f else None
+        # not a call-tree depth, just the frames on the path added up: a stable number to gate on
+        stack["publish_path_sum"] = sum(v for v in stack["publish_path"].values() if v)
+    summary["stack"] = stack
+    return summary
+
+
+def gate(summary, base, threshold):
+    problems = []
+
+    def check(label, new, old):
+        if old is not None and new - old > threshold:
+            problems.append(f"{label}: {old} -> {new} (+{new - old})")
+
+    check("flash_bytes", summary["flash_bytes"], base.get("flash_bytes"))
+    check("ram_bytes", summary["ram_bytes"], base.get("ram_bytes"))
+    for comp, v in summary["components"].items():
+        old = base.get("components", {}).get(comp, {"flash": 0, "ram": 0})
+        check(f"{comp}.flash", v["flash"], old["flash"])
+        check(f"{comp}.ram", v["ram"], old["ram"])
+    check("stack.publish_path_sum", summary["stack"]["publish_path_sum"], base.get("stack", {}).get("publish_path_sum"))
+    for sym, size in summary["watch_symbols"].items():
+        if sym not in base.get("watch_symbols", {}):
+            problems.append(f"new symbol {sym} ({size} bytes)")
+    return problems
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--elf", required=True)
+    ap.add_argument("--map", help="GNU ld map (pico_add_extra_outputs writes <target>.elf.map)")
+    ap.add_argument("--objdir", help="CMakeFiles/<target>.dir holding the -fstack-usage .su files")
+    ap.add_argument("--target", help="name stored in the summary (default: ELF basename)")
+    ap.add_argument("--out", help="write the JSON summary here (default: stdout)")
+    ap.add_argument("--top", type=int, default=25, help="how many of the largest symbols to list")
+    ap.add_argument("--baseline", help="earlier summary to gate against (skipped when the file is missing)")
+    ap.add_argument("--threshold-bytes", type=int, default=256, help="allowed growth per metric")
+    args = ap.parse_args()
+
+    summary = build_summary(args)
+    text = json.dumps(summary, indent=1)
+    if args.out:
+        with open(args.out, "w") as f:
+            f.write(text + "\n")
+    else:
+        print(text)
+
+    out = sys.stderr if not args.out else sys.stdout
+    print(f"{summary['target']}: flash={summary['flash_bytes']} ram={summary['ram_bytes']}", file=out)
+    for comp, v in summary["components"].items():
+        print(f"  {comp:<16} flash={v['flash']:>8} ram={v['ram']:>8}", file=out)
+    if summary["stack"]["functions"]:
+        print(f"  publish path stack (sum of frames) = {summary['stack']['publish_path_sum']}", file=out)
+    if summary["watch_symbols"]:
+        print("  watch symbols: " + ", ".join(f"{k}={v}" for k, v in summary["watch_symbols"].items()), file=out)
+
+    if args.baseline and os.path.exists(args.baseline):
+        with open(args.baseline) as f:
+            base = json.load(f)
+        problems = gate(summary, base, args.threshold_bytes)
+        for p in problems:
+            print(f"FOOTPRINT REGRESSION: {p}", file=sys.stderr)
+        sys.exit(1 if problems else 0)
+
+
+if __name__ == "__main__":
+    main()
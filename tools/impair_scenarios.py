@@ -0,0 +1,294 @@
+#!/usr/bin/env python3
+"""Run the host-built firmware through impaired-network scenarios and score the recovery.
+
+For each scenario this starts host/tools/impair_proxy with a schedule, an MQTT
+subscriber talking straight to the broker, and build-host/mqcensor_host, whose
+broker address is the proxy. The AHT20 model runs in its "count" waveform, so
+every sample carries a sequence number and the subscriber can count what was
+lost or delivered twice.
+
+    # broker on loopback only ("listener 1883 127.0.0.1"), proxy takes 192.168.7.1:1883
+    sudo tools/impair_scenarios.py [--only outage_rst_20s,lossy] [--scenarios my.json] [--tag $(git describe --always)]
+
+A scenario file is a JSON list of {"name", "duration_s", "schedule": ["<at_ms> key=value,...", ...]};
+see impair_proxy.c for the schedule keys. Without one the built-in set below is used.
+
+Per scenario, one JSON line goes to --out (default impair_results.jsonl):
+  lost / duplicates  sequence gaps and repeats seen at the broker (per firmware boot)
+  ttr_ms             per outage, from the link coming back to the first sample at the broker
+  reconnect_ms       per outage, from the link coming back to the firmware's next TCP connection
+  max_gap_ms         longest silence at the subscriber
+  reboots            watchdog resets seen during the run (extra boot records)
+"""
+import argparse
+import json
+import os
+import re
+import signal
+import socket
+import struct
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+# subscription filters for the default MQCENSOR_TOPIC_TEMPLATE ("pico2w/{board_id}/{sensor}")
+SAMPLE_TOPIC = "pico2w/+/aht22"
+BOOT_TOPIC = "pico2w/+/diag/boot"
+COUNT_TEMP_STEPS = 1200  # AHT20_SIM_COUNT_TEMP_STEPS
+SIM_SPEC = "wave=count,latency_ms=20"  # shorter than AHT20_CONVERSION_MS so no stale reads
+# a sequence that drops back near zero after this many samples means the firmware rebooted
+REBOOT_GAP = 64
+DRAIN_S = 3.0
+PAYLOAD_RE = re.compile(r"Temp=(-?\d+\.\d)°C Hum=(\d+\.\d)%")
+
+SCENARIOS = [
+    {"name": "baseline", "duration_s": 60, "schedule": ["0 delay=2"]},
+    {"name": "slow_link", "duration_s": 90, "schedule": ["0 delay=150,jitter=50,rate=32"]},
+    {"name": "lossy", "duration_s": 90, "schedule": ["0 delay=30,jitter=10,loss=0.05,rto=1000"]},
+    {"name": "outage_rst_20s", "duration_s": 90, "schedule": ["0 delay=5", "20000 down=rst,for=20000"]},
+    # longer than keep_alive * 1.5 so the client has to notice the dead connection itself
+    {"name": "outage_stall_60s", "duration_s": 150, "schedule": ["0 delay=5", "20000 down=stall,for=60000"]},
+    {
+        "name": "flapping",
+        "duration_s": 120,
+        "schedule": ["0 delay=5"] + [f"{t} down=rst,for=3000" for t in range(20000, 100000, 10000)],
+    },
+]
+
+
+class Subscriber(threading.Thread):
+    """Minimal MQTT 3.1.1 subscriber (QoS1) that timestamps every PUBLISH."""
+
+    def __init__(self, broker):
+        super().__init__(daemon=True)
+        host, port = broker.rsplit(":", 1)
+        self.sock = socket.create_connection((host, int(port)), timeout=5)
+        self.messages = []  # (monotonic_ms, topic, payload)
+        self.stop = threading.Event()
+        self._connect()
+
+    def _send(self, ptype, body):
+        n, rl = len(body), b""
+        while True:
+            b = n % 128
+            n //= 128
+            rl += bytes([b | (0x80 if n else 0)])
+            if not n:
+                break
+        self.sock.sendall(bytes([ptype]) + rl + body)
+
+    def _read_exact(self, n):
+        buf = b""
+        while len(buf) < n:
+            d = self.sock.recv(n - len(buf))
+            if not d:
+                raise ConnectionError("broker closed the connection")
+            buf += d
+        return buf
+
+    def _read_packet(self):
+        hdr = self._read_exact(1)[0]
+        mult, n = 1, 0
+        while True:
+            b = self._read_exact(1)[0]
+            n += (b & 0x7F) * mult
+            mult *= 128
+            if not b & 0x80:
+                break
+        return hdr, self._read_exact(n) if n else b""
+
+    def _connect(self):
+        cid = f"impair-sub-{os.getpid()}".encode()
+        body = b"\x00\x04MQTT\x04\x02" + struct.pack(">H", 60) + struct.pack(">H", len(cid)) + cid
+        self._send(0x10, body)
+        hdr, body = self._read_packet()
+        if hdr >> 4 != 2 or body[1] != 0:
+            raise ConnectionError(f"CONNACK refused: {body!r}")
+        sub = struct.pack(">H", 1)
+        for topic in (SAMPLE_TOPIC, BOOT_TOPIC):
+            t = topic.encode()
+            sub += struct.pack(">H", len(t)) + t + b"\x01"
+        self._send(0x82, sub)
+        hdr, _ = self._read_packet()
+        if hdr >> 4 != 9:
+            raise ConnectionError("no SUBACK")
+        self.sock.settimeout(1.0)
+
+    def run(self):
+        last_ping = time.monotonic()
+        while not self.stop.is_set():
+            if time.monotonic() - last_ping > 30:
+                self._send(0xC0, b"")
+                last_ping = time.monotonic()
+            try:
+                hdr, body = self._read_packet()
+            except socket.timeout:
+                continue
+            except (ConnectionError, OSError):
+                break
+            if hdr >> 4 != 3:
+                continue
+            qos = (hdr >> 1) & 3
+            tlen = struct.unpack(">H", body[:2])[0]
+            topic = body[2 : 2 + tlen].decode()
+            pos = 2 + tlen
+            if qos:
+                self._send(0x40, body[pos : pos + 2])
+                pos += 2
+            self.messages.append((time.monotonic() * 1000.0, topic, body[pos:]))
+
+    def close(self):
+        self.stop.set()
+        self.join(timeout=3)
+        try:
+            self._send(0xE0, b"")
+        except OSError:
+            pass
+        self.sock.close()
+
+
+def topic_matches(filt, topic):
+    f, t = filt.split("/"), topic.split("/")
+    if "#" in f:
+        i = f.index("#")
+        f, t = f[:i], t[:i]
+    return len(f) == len(t) and all(a in ("+", b) for a, b in zip(f, t))
+
+
+def sample_seq(payload):
+    m = PAYLOAD_RE.search(payload.decode("utf-8", "replace"))
+    if not m:
+        return None
+    t, h = float(m.group(1)), float(m.group(2))
+    return round((t + 40.0) * 10) + round(h * 10) * COUNT_TEMP_STEPS
+
+
+def analyze(messages, events, duration_s):
+    samples = [(t, sample_seq(p)) for t, topic, p in messages if topic_matches(SAMPLE_TOPIC, topic)]
+    samples = [(t, s) for t, s in samples if s is not None]
+    boots = sum(1 for _, topic, _ in messages if topic_matches(BOOT_TOPIC, topic))
+
+    # count per boot: the sequence restarts from zero after a watchdog reset
+    epochs, seen, top = [], set(), -1
+    dups = 0
+    for _, s in samples:
+        if top > REBOOT_GAP and s < REBOOT_GAP:
+            epochs.append((seen, top))
+            seen, top = set(), -1
+        if s in seen:
+            dups += 1
+        seen.add(s)
+        top = max(top, s)
+    epochs.append((seen, top))
+    unique = sum(len(e) for e, _ in epochs)
+    expected = sum(t + 1 for _, t in epochs if t >= 0)
+
+    downs = [e for e in events if e["ev"] == "down"]
+    ups = [e for e in events if e["ev"] == "up"]
+    accepts = [e["mono_ms"] for e in events if e["ev"] == "accept"]
+    ttr, reconnect = [], []
+    for up in ups:
+        rx = [t for t, _ in samples if t >= up["mono_ms"]]
+        ttr.append(round(rx[0] - up["mono_ms"]) if rx else None)
+        acc = [a for a in accepts if a >= up["mono_ms"]]
+        reconnect.append(acc[0] - up["mono_ms"] if acc else None)
+
+    times = [t for t, _ in samples]
+    max_gap = max((b - a for a, b in zip(times, times[1:])), default=0.0)
+    summary = next((e for e in events if e["ev"] == "summary"), {})
+    done_ttr = [t for t in ttr if t is not None]
+    return {
+        "duration_s": duration_s,
+        "received": len(samples),
+        "unique": unique,
+        "duplicates": dups,
+        "lost": max(expected - unique, 0),
+        "lost_pct": round(100.0 * (expected - unique) / expected, 2) if expected else 0.0,
+        "reboots": max(boots - 1, 0),
+        "outages": len(downs),
+        "unrecovered": sum(1 for t in ttr if t is None),
+        "ttr_ms": ttr,
+        "ttr_ms_max": max(done_ttr) if done_ttr else None,
+        "reconnect_ms": reconnect,
+        "max_gap_ms": round(max_gap),
+        "proxy": {k: summary.get(k) for k in ("accepted", "refused", "closed_rst", "lost")},
+    }
+
+
+def run_scenario(sc, args, log_dir):
+    with tempfile.NamedTemporaryFile("w", suffix=".txt", delete=False) as f:
+        f.write("\n".join(sc["schedule"]) + "\n")
+        sched = f.name
+    sub = Subscriber(args.broker)
+    sub.start()
+    proxy = subprocess.Popen(
+        [args.proxy, "-l", args.listen, "-u", args.broker, "-s", sched, "-S", str(args.seed)],
+        stdout=subprocess.PIPE,
+        text=True,
+    )
+    env = dict(os.environ, MQCENSOR_AHT20_SIM=SIM_SPEC)
+    fw_log = open(os.path.join(log_dir, f"{sc['name']}.log"), "w")
+    fw = subprocess.Popen([args.firmware], env=env, stdout=fw_log, stderr=subprocess.STDOUT)
+    try:
+        time.sleep(sc["duration_s"])
+    finally:
+        fw.send_signal(signal.SIGTERM)
+        try:
+            fw.wait(timeout=5)
+        except subprocess.TimeoutExpired:
+            fw.kill()
+        fw_log.close()
+        time.sleep(DRAIN_S)
+        sub.close()
+        proxy.send_signal(signal.SIGTERM)
+        out, _ = proxy.communicate(timeout=5)
+        os.unlink(sched)
+    events = [json.loads(line) for line in out.splitlines() if line.startswith("{")]
+    return analyze(sub.messages, events, sc["duration_s"])
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--firmware", default="build-host/mqcensor_host")
+    ap.add_argument("--proxy", default="build-host/impair_proxy")
+    ap.add_argument("--broker", default="127.0.0.1:1883", help="where the real broker listens")
+    ap.add_argument("--listen", default="192.168.7.1:1883", help="broker address the firmware was built with")
+    ap.add_argument("--scenarios", help="JSON scenario file (default: built-in set)")
+    ap.add_argument("--only", help="comma-separated scenario names")
+    ap.add_argument("--seed", type=int, default=1, help="proxy jitter/loss seed")
+    ap.add_argument("--tag", default="", help="stored with every result line")
+    ap.add_argument("--out", default="impair_results.jsonl")
+    ap.add_argument("--log-dir", default="impair_logs", help="firmware console output per scenario")
+    args = ap.parse_args()
+
+    scenarios = SCENARIOS
+    if args.scenarios:
+        with open(args.scenarios) as f:
+            scenarios = json.load(f)
+    if args.only:
+        names = set(args.only.split(","))
+        scenarios = [s for s in scenarios if s["name"] in names]
+    if not scenarios:
+        sys.exit("no scenarios selected")
+    os.makedirs(args.log_dir, exist_ok=True)
+
+    print(f"{'scenario':<20} {'recv':>6} {'lost':>6} {'dup':>5} {'reboot':>6} {'ttr_max_ms':>10} {'max_gap_ms':>10}")
+    with open(args.out, "a") as out:
+        for sc in scenarios:
+            r = run_scenario(sc, args, args.log_dir)
+            r = {"tag": args.tag, "scenario": sc["name"], **r}
+            out.write(json.dumps(r) + "\n")
+            out.flush()
+            ttr = "-" if r["ttr_ms_max"] is None else str(r["ttr_ms_max"])
+            if r["unrecovered"]:
+                ttr += f" ({r['unrecovered']} unrecovered)"
+            print(
+                f"{sc['name']:<20} {r['received']:>6} {r['lost']:>6} {r['duplicates']:>5} "
+                f"{r['reboots']:>6} {ttr:>10} {r['max_gap_ms']:>10}"
+            )
+
+
+if __name__ == "__main__":
+    main()
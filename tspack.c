@@ -0,0 +1,112 @@
+#include <string.h>
+#include "tspack.h"
+
+static const uint8_t time_widths[4] = TSPACK_TIME_WIDTHS;
+static const uint8_t value_widths[4] = TSPACK_VALUE_WIDTHS;
+
+// 下位 n ビット（n ≤ 32）を MSB 側から書く
+static void put_bits(TsPack *p, uint32_t v, unsigned n)
+{
+    if (p->overflow)
+        return;
+    if ((p->bits + n + 7) / 8 > p->cap)
+    {
+        p->overflow = true;
+        return;
+    }
+    while (n)
+    {
+        size_t byte = p->bits / 8;
+        unsigned room = 8 - (unsigned)(p->bits % 8);
+        unsigned take = n < room ? n : room;
+        if (room == 8)
+            p->buf[byte] = 0;
+        p->buf[byte] |= (uint8_t)(((v >> (n - take)) & ((1u << take) - 1)) << (room - take));
+        p->bits += take;
+        n -= take;
+    }
+}
+
+static uint32_t zigzag(int32_t v)
+{
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+// '0' か、一番短く収まる桁の接頭辞（'10' / '110' / '1110' / '1111'）+ 値
+static void put_varbits(TsPack *p, uint32_t z, const uint8_t widths[4])
+{
+    static const uint8_t prefix[4] = {0x2, 0x6, 0xE, 0xF};
+    static const uint8_t prefix_bits[4] = {2, 3, 4, 4};
+    if (z == 0)
+    {
+        put_bits(p, 0, 1);
+        return;
+    }
+    unsigned i = 0;
+    while (i < 3 && widths[i] < 32 && z >= (1u << widths[i]))
+        i++;
+    put_bits(p, prefix[i], prefix_bits[i]);
+    put_bits(p, z, widths[i]);
+}
+
+void tspack_init(TsPack *p, uint8_t *buf, size_t cap)
+{
+    memset(p, 0, sizeof(*p));
+    p->buf = buf;
+    p->cap = cap;
+    // 件数バイトは finish で埋める
+    p->bits = 8;
+    p->overflow = cap < 1;
+}
+
+bool tspack_add(TsPack *p, uint32_t t_ms, int16_t temp_centi, int16_t hum_centi)
+{
+    if (p->count == TSPACK_MAX_SAMPLES)
+        p->overflow = true;
+    if (p->overflow)
+        return false;
+    if (p->count == 0)
+    {
+        put_bits(p, t_ms, 32);
+        put_bits(p, (uint16_t)temp_centi, 16);
+        put_bits(p, (uint16_t)hum_centi, 16);
+    }
+    else
+    {
+        // 時刻は 32 ビットで回り込んでもよい（差分は回り込みを含めて計算する）
+        int32_t dt = (int32_t)(t_ms - p->t_prev);
+        put_varbits(p, zigzag((int32_t)((uint32_t)dt - (uint32_t)p->dt_prev)), time_widths);
+        put_varbits(p, zigzag(temp_centi - p->temp_prev), value_widths);
+        put_varbits(p, zigzag(hum_centi - p->hum_prev), value_widths);
+        p->dt_prev = dt;
+    }
+    if (p->overflow)
+        return false;
+    p->t_prev = t_ms;
+    p->temp_prev = temp_centi;
+    p->hum_prev = hum_centi;
+    p->count++;
+    return true;
+}
+
+size_t tspack_finish(TsPack *p)
+{
+    if (p->overflow)
+        return 0;
+    p->buf[0] = p->count;
+    return (p->bits + 7) / 8;
+}
+
+size_t tspack_put_uvarint(uint8_t *buf, size_t len, uint32_t v)
+{
+    size_t n = 0;
+    do
+    {
+        if (n == len)
+            return 0;
+        uint8_t b = v & 0x7F;
+        v >>= 7;
+        buf[n++] = v ? (uint8_t)(b | 0x80) : b;
+    } while (v);
+    return n;
+}
@@ -0,0 +1,48 @@
+#pragma once
+// 温湿度サンプル列のビット詰め圧縮（Gorilla 方式）。1 サンプルずつ流し込み、状態は TsPack だけ（定数メモリ）。
+// SDK に依存しないので、ホストのコレクター（collector/payload.cpp が復号）とベンチも同じものを使う
+//
+//   ストリーム: 件数 u8 | ビット列（MSB から詰める。最後のバイトの余りは 0）
+//     1 件目 : 時刻 32 ビット | 温度 16 ビット | 湿度 16 ビット（0.01 単位の int16 そのまま）
+//     2 件目〜: 時刻の差分の差分 | 温度の差分 | 湿度の差分（どれも zig-zag してから可変長）
+//
+//   可変長: '0' = 0、'10' + w1、'110' + w2、'1110' + w3、'1111' + w4 ビット（幅は下の表）。
+//   周期どおりの時刻は 1 ビット、変わらない値も 1 ビットで済む
+//
+// 低消費電力版の aht22/batch（圧縮形式。JSON 形式とは先頭バイトで見分ける）:
+//   TSPACK_BATCH_MAGIC | メタ数 u8 | メタ数 個の LEB128（seq, period_ms, uj_per_sample, wake_ms,
+//   radio_ms, w2p_last_ms, w2p_max_ms の順。読み手は知らない分を読み飛ばす）| ストリーム
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TSPACK_MAX_SAMPLES 255
+// 最悪（全サンプルが最長の符号）のバイト数
+#define TSPACK_MAX_BYTES(n) (1 + (64 + 78 * ((n) - 1) + 7) / 8)
+
+#define TSPACK_TIME_WIDTHS {7, 12, 20, 32} // 時刻の差分の差分 [ms]
+#define TSPACK_VALUE_WIDTHS {3, 6, 10, 17} // 温湿度の差分 [0.01]
+
+#define TSPACK_BATCH_MAGIC 0xB1 // '{' でも印字できる文字でもない
+
+typedef struct
+{
+    uint8_t *buf;
+    size_t cap;
+    size_t bits; // 書いたビット数（先頭の件数バイトを含む）
+    uint8_t count;
+    bool overflow; // buf が足りなかった・件数が多すぎた
+    uint32_t t_prev;
+    int32_t dt_prev;
+    int16_t temp_prev, hum_prev;
+} TsPack;
+
+// buf に書き始める（cap が 1 未満なら最初の tspack_add で overflow）
+void tspack_init(TsPack *p, uint8_t *buf, size_t cap);
+// 1 サンプル足す。入りきらなければ false（以降も false のまま）
+bool tspack_add(TsPack *p, uint32_t t_ms, int16_t temp_centi, int16_t hum_centi);
+// 件数を書き込んでバイト数を返す。overflow なら 0
+size_t tspack_finish(TsPack *p);
+
+// 符号なし LEB128（バッチのメタ用）。書いたバイト数を返し、入りきらなければ 0
+size_t tspack_put_uvarint(uint8_t *buf, size_t len, uint32_t v);
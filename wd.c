@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "hardware/watchdog.h"
+#include "wd.h"
+#include "supervisor.h"
+#include "applog.h"
+
+#ifndef PICO_PROGRAM_VERSION_STRING
+#define PICO_PROGRAM_VERSION_STRING "dev"
+#endif
+
+// watchdog の scratch レジスタの割り当て（scratch[4-7] は bootrom が使うので触らない）
+//   [0] 連続再起動回数
+//   [1] magic(8) | reason(8) | subsystem(8) | net_state(8)
+//   [2] 稼働秒数（餌やりのたびに更新）
+//   [3] ブート回数
+#define WD_SCRATCH_CONSEC 0
+#define WD_SCRATCH_RECORD 1
+#define WD_SCRATCH_UPTIME 2
+#define WD_SCRATCH_BOOTS 3
+#define WD_RECORD_MAGIC 0xB5u
+
+static WdRebootRecord last_reboot;
+
+static const char *const REASON_NAMES[WD_REASON_COUNT] = {
+    "power_on", "wdt_hang", "supervisor", "no_recovery", "fatal"};
+
+static uint32_t pack_record(uint8_t reason, uint8_t subsystem, uint8_t net_state)
+{
+    return (WD_RECORD_MAGIC << 24) | ((uint32_t)reason << 16) | ((uint32_t)subsystem << 8) | net_state;
+}
+
+// 前回の記録を読んで、今回のブート用に「理由なし＝ハング扱い」で書き直す
+static void load_reboot_record(void)
+{
+    uint32_t rec = watchdog_hw->scratch[WD_SCRATCH_RECORD];
+    bool valid = (rec >> 24) == WD_RECORD_MAGIC;
+    uint32_t boots = valid ? watchdog_hw->scratch[WD_SCRATCH_BOOTS] + 1 : 1;
+
+    last_reboot.boot_count = boots;
+    last_reboot.consecutive = watchdog_hw->scratch[WD_SCRATCH_CONSEC];
+    if (valid && watchdog_caused_reboot())
+    {
+        last_reboot.reason = (uint8_t)(rec >> 16);
+        last_reboot.subsystem = (uint8_t)(rec >> 8);
+        last_reboot.net_state = (uint8_t)rec;
+        last_reboot.uptime_s = watchdog_hw->scratch[WD_SCRATCH_UPTIME];
+        if (last_reboot.reason >= WD_REASON_COUNT)
+            last_reboot.reason = WD_REASON_WDT_HANG;
+    }
+    else
+    {
+        last_reboot.reason = WD_REASON_POWER_ON;
+        last_reboot.subsystem = WD_SUBSYSTEM_NONE;
+        last_reboot.net_state = 0;
+        last_reboot.uptime_s = 0;
+    }
+
+    watchdog_hw->scratch[WD_SCRATCH_BOOTS] = boots;
+    watchdog_hw->scratch[WD_SCRATCH_UPTIME] = 0;
+    watchdog_hw->scratch[WD_SCRATCH_RECORD] = pack_record(WD_REASON_WDT_HANG, WD_SUBSYSTEM_NONE, 0);
+}
+
+void wd_init_and_bootloop_guard(bool *safe_mode_out)
+{
+    // 連続再起動回数を scratch レジスタに保存
+    uint32_t cnt = watchdog_hw->scratch[WD_SCRATCH_CONSEC];
+    if (watchdog_caused_reboot())
+        cnt++;
+    else
+        cnt = 0;
+    watchdog_hw->scratch[WD_SCRATCH_CONSEC] = cnt;
+    load_reboot_record();
+
+    *safe_mode_out = (cnt >= SAFE_REBOOTS);
+
+    // 有効化（デバッガ接続時は一時停止 true）
+    watchdog_enable(WD_TIMEOUT_MS, true);
+}
+
+void wd_feed(void)
+{
+    watchdog_update();
+    // ハングで落ちたときのために稼働時間を残しておく
+    watchdog_hw->scratch[WD_SCRATCH_UPTIME] = to_ms_since_boot(get_absolute_time()) / 1000;
+}
+
+void wd_note_net_state(uint8_t net_state)
+{
+    uint32_t rec = watchdog_hw->scratch[WD_SCRATCH_RECORD];
+    watchdog_hw->scratch[WD_SCRATCH_RECORD] = (rec & 0xffffff00u) | net_state;
+}
+
+void wd_record_reset(WdResetReason reason, uint8_t subsystem)
+{
+    uint8_t net_state = (uint8_t)watchdog_hw->scratch[WD_SCRATCH_RECORD];
+    watchdog_hw->scratch[WD_SCRATCH_RECORD] = pack_record(reason, subsystem, net_state);
+    watchdog_hw->scratch[WD_SCRATCH_UPTIME] = to_ms_since_boot(get_absolute_time()) / 1000;
+}
+
+void request_reboot_now(WdResetReason reason, const char *detail)
+{
+    LOG_ERROR(WD, "WDT reboot requested: %s (%s)\n", detail, wd_reason_name(reason));
+    wd_record_reset(reason, WD_SUBSYSTEM_NONE);
+    // 溜まっているログを全部出してから落とす（ワーカー（IRQ）からも呼ばれるので sleep は使わない）
+    applog_flush();
+    busy_wait_ms(50);
+    watchdog_reboot(0, 0, 0);
+    while (1)
+        tight_loop_contents();
+}
+
+const WdRebootRecord *wd_last_reboot(void)
+{
+    return &last_reboot;
+}
+
+const char *wd_reason_name(uint8_t reason)
+{
+    return reason < WD_REASON_COUNT ? REASON_NAMES[reason] : "unknown";
+}
+
+size_t wd_format_reboot_record(char *buf, size_t len)
+{
+    const WdRebootRecord *r = &last_reboot;
+    int n = snprintf(buf, len,
+                     "{\"fw\":\"%s\",\"boot\":%lu,\"reason\":\"%s\",\"sub\":\"%s\",\"up_s\":%lu,"
+                     "\"link\":%d,\"mqtt\":%d,\"consec\":%lu}",
+                     PICO_PROGRAM_VERSION_STRING, (unsigned long)r->boot_count, wd_reason_name(r->reason),
+                     sv_name(r->subsystem), (unsigned long)r->uptime_s, (r->net_state & WD_NET_LINK) != 0,
+                     (r->net_state & WD_NET_MQTT) != 0, (unsigned long)r->consecutive);
+    return (n > 0 && (size_t)n < len) ? (size_t)n : 0;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "pico/stdlib.h"
+
+#define WD_TIMEOUT_MS 8000 // WDT 8秒
+#define DEADLINE_MS 300000 // 5分復帰しなければ最終手段
+#define SAFE_REBOOTS 5     // 5連続再起動でセーフモード突入
+
+// リセット理由（scratch に残して次のブートで読む）
+typedef enum
+{
+    WD_REASON_POWER_ON = 0, // 記録なし（電源投入・RUN ピン・SWD など）
+    WD_REASON_WDT_HANG,     // 誰も理由を書かないまま WDT が切れた（ハング）
+    WD_REASON_SUPERVISOR,   // サブシステムがハートビートの期限を過ぎた
+    WD_REASON_NO_RECOVERY,  // DEADLINE_MS 以上つながらなかった
+    WD_REASON_FATAL,        // 続行できないエラー
+    WD_REASON_COUNT
+} WdResetReason;
+
+// wd_note_net_state に渡すビット
+#define WD_NET_LINK 0x01
+#define WD_NET_MQTT 0x02
+
+#define WD_SUBSYSTEM_NONE 0xff
+
+// 前回のリセットの記録
+typedef struct
+{
+    uint8_t reason;       // WdResetReason
+    uint8_t subsystem;    // 期限切れのサブシステム（sv_id_t）、なければ WD_SUBSYSTEM_NONE
+    uint8_t net_state;    // 最後に見たリンク/MQTT 状態（WD_NET_*）
+    uint32_t uptime_s;    // リセット時点の稼働秒数（WDT 餌やり周期の粒度）
+    uint32_t boot_count;  // 電源投入からのブート回数（1 = 電源投入直後）
+    uint32_t consecutive; // 連続 WDT 再起動回数
+} WdRebootRecord;
+
+static inline bool ms_passed(absolute_time_t t, uint32_t ms)
+{
+    return absolute_time_diff_us(t, get_absolute_time()) / 1000 > ms;
+}
+
+void wd_init_and_bootloop_guard(bool *safe_mode_out);
+void wd_feed(void);
+void wd_note_net_state(uint8_t net_state);
+// 次のリセットの理由を残す（実際のリセットは WDT か request_reboot_now）
+void wd_record_reset(WdResetReason reason, uint8_t subsystem);
+void request_reboot_now(WdResetReason reason, const char *detail);
+
+const WdRebootRecord *wd_last_reboot(void);
+const char *wd_reason_name(uint8_t reason);
+// 前回リセットの記録を JSON に整形（診断トピック用）。書いた長さを返す
+size_t wd_format_reboot_record(char *buf, size_t len);
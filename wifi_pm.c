@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include "pico/cyw43_arch.h"
+#include "wifi_pm.h"
+#include "applog.h"
+
+typedef struct
+{
+    uint32_t count;
+    uint64_t sum_us;
+    uint32_t max_us;
+} LatencyStat;
+
+static wifi_pm_mode_t cur_mode = WIFI_PM_DEFAULT;
+static LatencyStat pub_lat[WIFI_PM_MODE_COUNT];    // publish → ACK（TCP sent）の遅延
+static LatencyStat switch_lat[WIFI_PM_MODE_COUNT]; // cyw43_wifi_pm 呼び出し自体のコスト
+
+// コールバック（BG コンテキスト）と共有する
+static volatile uint64_t pub_start_us = 0;
+static volatile wifi_pm_mode_t pub_mode = WIFI_PM_DEFAULT;
+static volatile bool pub_pending = false;
+
+static const char *const MODE_NAMES[WIFI_PM_MODE_COUNT] = {"save", "perf", "default"};
+
+static uint32_t mode_to_pm(wifi_pm_mode_t mode)
+{
+    switch (mode)
+    {
+    case WIFI_PM_SAVE:
+        return CYW43_AGGRESSIVE_PM;
+    case WIFI_PM_PERF:
+        return CYW43_PERFORMANCE_PM;
+    default:
+        return CYW43_DEFAULT_PM;
+    }
+}
+
+static void stat_add(LatencyStat *s, uint32_t us)
+{
+    s->count++;
+    s->sum_us += us;
+    if (us > s->max_us)
+        s->max_us = us;
+}
+
+static void set_mode(wifi_pm_mode_t mode)
+{
+    if (mode == cur_mode)
+        return;
+    uint64_t t0 = time_us_64();
+    int r = cyw43_wifi_pm(&cyw43_state, mode_to_pm(mode));
+    if (r != 0)
+    {
+        LOG_WARN(WIFI, "cyw43_wifi_pm(%s) failed: %d\n", MODE_NAMES[mode], r);
+        return;
+    }
+    stat_add(&switch_lat[mode], (uint32_t)(time_us_64() - t0));
+    cur_mode = mode;
+}
+
+void wifi_pm_init(void)
+{
+    // cyw43_arch_init 直後は DEFAULT_PM
+    cur_mode = WIFI_PM_DEFAULT;
+#if WIFI_PM_POLICY == WIFI_PM_POLICY_FIXED_PERF
+    set_mode(WIFI_PM_PERF);
+#elif WIFI_PM_POLICY == WIFI_PM_POLICY_FIXED_SAVE || WIFI_PM_POLICY == WIFI_PM_POLICY_SCHEDULED
+    set_mode(WIFI_PM_SAVE);
+#endif
+}
+
+void wifi_pm_prepare_publish(void)
+{
+#if WIFI_PM_POLICY == WIFI_PM_POLICY_SCHEDULED
+    set_mode(WIFI_PM_PERF);
+#endif
+}
+
+bool wifi_pm_publish_pending(void)
+{
+    return pub_pending;
+}
+
+void wifi_pm_publish_settled(void)
+{
+#if WIFI_PM_POLICY == WIFI_PM_POLICY_SCHEDULED
+    set_mode(WIFI_PM_SAVE);
+#endif
+}
+
+void wifi_pm_publish_begin(void)
+{
+    pub_mode = cur_mode;
+    pub_start_us = time_us_64();
+    pub_pending = true;
+}
+
+void wifi_pm_publish_done(void)
+{
+    if (!pub_pending)
+        return;
+    stat_add(&pub_lat[pub_mode], (uint32_t)(time_us_64() - pub_start_us));
+    pub_pending = false;
+}
+
+void wifi_pm_report(void)
+{
+    for (int m = 0; m < WIFI_PM_MODE_COUNT; m++)
+    {
+        const LatencyStat *p = &pub_lat[m];
+        const LatencyStat *s = &switch_lat[m];
+        if (p->count == 0 && s->count == 0)
+            continue;
+        LOG_INFO(WIFI, "wifi_pm[%s]: publish n=%lu avg=%luus max=%luus, switch n=%lu avg=%luus max=%luus\n",
+               MODE_NAMES[m],
+               (unsigned long)p->count, (unsigned long)(p->count ? p->sum_us / p->count : 0), (unsigned long)p->max_us,
+               (unsigned long)s->count, (unsigned long)(s->count ? s->sum_us / s->count : 0), (unsigned long)s->max_us);
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+// publish の合間は省電力、flush 直前だけ performance に切り替えるスケジューラ
+//   WIFI_PM_POLICY_SCHEDULED : 通常運用（合間 aggressive / 直前 performance）
+//   WIFI_PM_POLICY_FIXED_*   : モードを固定して publish 遅延を比較する計測用
+#define WIFI_PM_POLICY_SCHEDULED 0
+#define WIFI_PM_POLICY_FIXED_PERF 1
+#define WIFI_PM_POLICY_FIXED_SAVE 2
+#define WIFI_PM_POLICY_FIXED_DEFAULT 3
+
+#ifndef WIFI_PM_POLICY
+#define WIFI_PM_POLICY WIFI_PM_POLICY_SCHEDULED
+#endif
+#ifndef WIFI_PM_LEAD_MS
+#define WIFI_PM_LEAD_MS 150 // publish 予定の何ms前に performance に上げるか
+#endif
+#ifndef WIFI_PM_ACK_WAIT_MS
+#define WIFI_PM_ACK_WAIT_MS 300 // publish 完了を待ってから省電力に落とす上限
+#endif
+
+typedef enum
+{
+    WIFI_PM_SAVE = 0,
+    WIFI_PM_PERF,
+    WIFI_PM_DEFAULT,
+    WIFI_PM_MODE_COUNT
+} wifi_pm_mode_t;
+
+void wifi_pm_init(void);
+// flush の WIFI_PM_LEAD_MS 前に呼ぶ（performance に上げる）
+void wifi_pm_prepare_publish(void);
+// 直前の publish がまだ ACK 待ちか
+bool wifi_pm_publish_pending(void);
+// ACK を受けた（または WIFI_PM_ACK_WAIT_MS 待った）後に呼ぶ（省電力に落とす）
+void wifi_pm_publish_settled(void);
+// mqtt_publish 直前 / publish コールバックで呼ぶ（遅延計測用）
+void wifi_pm_publish_begin(void);
+void wifi_pm_publish_done(void);
+// モード別の publish 遅延と切り替えコストを表示
+void wifi_pm_report(void);